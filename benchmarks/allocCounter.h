@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) 2016-2017 Jonathan Glines
+ * Jonathan Glines <jonathan@glines.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef TTOY_BENCH_ALLOC_COUNTER_H_
+#define TTOY_BENCH_ALLOC_COUNTER_H_
+
+#include <stddef.h>
+
+/*
+ * Linking allocCounter.c into a benchmark replaces malloc() and friends with
+ * versions that count calls before deferring to the C library, so that
+ * benchmarks can report heap traffic alongside timings.
+ *
+ * NOTE: The counts include allocations made by other threads and by the GL
+ * driver.
+ */
+
+size_t ttoy_Bench_allocations();
+
+size_t ttoy_Bench_frees();
+
+#endif
@@ -0,0 +1,319 @@
+/*
+ * Copyright (c) 2016-2017 Jonathan Glines
+ * Jonathan Glines <jonathan@glines.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <GL/glew.h>
+#include <SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <ttoy/backgroundToy.h>
+
+#include "../src/backgroundRenderer.h"
+#include "../src/common/glError.h"
+#include "../src/common/shader.h"
+#include "../src/logging.h"
+#include "../src/profile.h"
+
+/*
+ * ttoy-bench-background measures the cost of drawing a background toy that
+ * changes every frame, once with the toy rendering to a texture that is then
+ * composited into the window, and once with the toy rendering directly to
+ * the window. The toy itself is as cheap as a toy can be, so that the
+ * difference is dominated by the fill rate of writing and reading the
+ * texture.
+ *
+ * NOTE: The window must fit on screen, since some drivers do not shade
+ * fragments that are not visible.
+ */
+
+#define TTOY_BENCH_DEFAULT_WIDTH 1920
+#define TTOY_BENCH_DEFAULT_HEIGHT 1080
+#define TTOY_BENCH_DEFAULT_FRAMES 600
+#define TTOY_BENCH_WARMUP_FRAMES 60
+
+/* A background toy that fills the viewport with a gradient that moves every
+ * frame */
+typedef struct ttoy_Bench_FillToy_ {
+  ttoy_BackgroundToy base;
+
+  ttoy_Shader shader;
+  GLuint vao;
+  GLint frameLocation;
+  int frame;
+  int initialized;
+} ttoy_Bench_FillToy;
+
+static const char *vert_shader =
+  "#version 330\n"
+  "\n"
+  "const vec2 corners[4] = vec2[4](\n"
+  "    vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(-1.0, 1.0), vec2(1.0, 1.0));\n"
+  "\n"
+  "void main(void) {\n"
+  "  gl_Position = vec4(corners[gl_VertexID], 0.0, 1.0);\n"
+  "}\n";
+
+static const char *frag_shader =
+  "#version 330\n"
+  "\n"
+  "uniform int frame;\n"
+  "\n"
+  "out vec4 fragColor;\n"
+  "\n"
+  "void main(void) {\n"
+  "  fragColor = vec4(fract((gl_FragCoord.xy + float(frame)) / 256.0),\n"
+  "      0.5, 1.0);\n"
+  "}\n";
+
+void ttoy_Bench_FillToy_destroy(
+    ttoy_Bench_FillToy *self)
+{
+  /* NOTE: Our GL objects belong to whichever context drew the toy, which
+   * might be gone by now; they go away with the process */
+}
+
+void ttoy_Bench_FillToy_draw(
+    ttoy_Bench_FillToy *self,
+    int viewportWidth,
+    int viewportHeight)
+{
+  ttoy_ErrorCode error;
+
+  if (!self->initialized) {
+    /* Initialize our GL objects in the context that draws the toy */
+    ttoy_Shader_init(&self->shader);
+    error = ttoy_Shader_compileShaderFromString(&self->shader,
+        vert_shader,  /* code */
+        strlen(vert_shader),  /* length */
+        GL_VERTEX_SHADER  /* type */
+        );
+    if (error == TTOY_NO_ERROR) {
+      error = ttoy_Shader_compileShaderFromString(&self->shader,
+          frag_shader,  /* code */
+          strlen(frag_shader),  /* length */
+          GL_FRAGMENT_SHADER  /* type */
+          );
+    }
+    if (error == TTOY_NO_ERROR) {
+      error = ttoy_Shader_linkProgram(&self->shader);
+    }
+    if (error != TTOY_NO_ERROR) {
+      TTOY_LOG_ERROR_CODE(error);
+      exit(1);
+    }
+    self->frameLocation = glGetUniformLocation(
+        self->shader.program,  /* program */
+        "frame"  /* name */
+        );
+    ASSERT_GL_ERROR();
+    glGenVertexArrays(
+        1,  /* n */
+        &self->vao  /* arrays */
+        );
+    ASSERT_GL_ERROR();
+    self->initialized = 1;
+  }
+
+  glUseProgram(
+      self->shader.program  /* program */
+      );
+  ASSERT_GL_ERROR();
+  glUniform1i(
+      self->frameLocation,  /* location */
+      self->frame++  /* v0 */
+      );
+  ASSERT_GL_ERROR();
+  glBindVertexArray(
+      self->vao  /* array */
+      );
+  ASSERT_GL_ERROR();
+  glDrawArrays(
+      GL_TRIANGLE_STRIP,  /* mode */
+      0,  /* first */
+      4  /* count */
+      );
+  ASSERT_GL_ERROR();
+  glBindVertexArray(
+      0  /* array */
+      );
+  ASSERT_GL_ERROR();
+}
+
+static const ttoy_BackgroundToy_Dispatch ttoy_Bench_FillToy_dispatch = {
+  .init = NULL,
+  .destroy = (ttoy_BackgroundToy_Destroy)ttoy_Bench_FillToy_destroy,
+  .draw = (ttoy_BackgroundToy_Draw)ttoy_Bench_FillToy_draw,
+  .isDirty = NULL,  /* always dirty */
+};
+
+/* Draws the given number of frames with a fresh fill toy and returns the
+ * average wall clock time per frame, in milliseconds */
+double ttoy_Bench_run(
+    SDL_Window *window,
+    uint32_t flags,
+    int width,
+    int height,
+    int frames)
+{
+  ttoy_Bench_FillToy toy;
+  ttoy_Profile profile;
+  ttoy_BackgroundRenderer renderer;
+  Uint64 start, end;
+
+  memset(&toy, 0, sizeof(toy));
+  ttoy_BackgroundToy_init(&toy.base,
+      "fill",  /* name */
+      &ttoy_Bench_FillToy_dispatch  /* dispatch */
+      );
+  ttoy_Profile_init(&profile, "bench");
+  ttoy_Profile_setFlags(&profile, flags);
+  ttoy_Profile_setBackgroundToy(&profile, &toy.base);
+  /* Keep the toy at full resolution and update rate no matter what */
+  profile.backgroundBudget = 1.0e6f;
+  ttoy_BackgroundRenderer_init(&renderer, &profile);
+
+  start = 0;
+  for (int i = 0; i < TTOY_BENCH_WARMUP_FRAMES + frames; ++i) {
+    if (i == TTOY_BENCH_WARMUP_FRAMES) {
+      glFinish();
+      ASSERT_GL_ERROR();
+      start = SDL_GetPerformanceCounter();
+    }
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    ASSERT_GL_ERROR();
+    ttoy_BackgroundRenderer_draw(&renderer,
+        width,  /* viewportWidth */
+        height  /* viewportHeight */
+        );
+    SDL_GL_SwapWindow(window);
+  }
+  glFinish();
+  ASSERT_GL_ERROR();
+  end = SDL_GetPerformanceCounter();
+
+  ttoy_BackgroundRenderer_destroy(&renderer);
+  ttoy_BackgroundToy_destroy(&toy.base);
+  ttoy_Profile_destroy(&profile);
+
+  return (double)(end - start) * 1000.0
+    / (double)SDL_GetPerformanceFrequency() / (double)frames;
+}
+
+void usage() {
+  fprintf(stderr, "Usage: ttoy-bench-background [width height [frames]]\n");
+}
+
+int main(int argc, char **argv) {
+  SDL_Window *window;
+  SDL_GLContext context;
+  GLenum glewError;
+  double textureTime, directTime, megapixels;
+  int width, height, frames;
+
+  width = TTOY_BENCH_DEFAULT_WIDTH;
+  height = TTOY_BENCH_DEFAULT_HEIGHT;
+  frames = TTOY_BENCH_DEFAULT_FRAMES;
+  if (argc == 3 || argc == 4) {
+    width = atoi(argv[1]);
+    height = atoi(argv[2]);
+    if (argc == 4) {
+      frames = atoi(argv[3]);
+    }
+  } else if (argc != 1) {
+    usage();
+    exit(1);
+  }
+  if (width <= 0 || height <= 0 || frames <= 0) {
+    usage();
+    exit(1);
+  }
+
+  SDL_Init(SDL_INIT_VIDEO);
+  window = SDL_CreateWindow(
+      "ttoy-bench-background",  /* title */
+      SDL_WINDOWPOS_UNDEFINED,  /* x */
+      SDL_WINDOWPOS_UNDEFINED,  /* y */
+      width,  /* w */
+      height,  /* h */
+      SDL_WINDOW_OPENGL  /* flags */
+      );
+  if (window == NULL) {
+    fprintf(stderr, "Failed to create SDL window: %s\n", SDL_GetError());
+    exit(1);
+  }
+  SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+  SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+  context = SDL_GL_CreateContext(window);
+  if (context == NULL) {
+    fprintf(stderr, "Failed to initialize OpenGL context: %s\n",
+        SDL_GetError());
+    exit(1);
+  }
+  glewExperimental = 1;
+  glewError = glewInit();
+  if (glewError != GLEW_OK) {
+    fprintf(stderr, "Failed to initialize GLEW: %s\n",
+        glewGetErrorString(glewError));
+    exit(1);
+  }
+  /* Swallow the error generated by GLEW */
+  while (glGetError() != GL_NO_ERROR);
+  /* Draw as fast as we can */
+  SDL_GL_SetSwapInterval(0);
+  glViewport(0, 0, width, height);
+  ASSERT_GL_ERROR();
+  glEnable(GL_DEPTH_TEST);
+  ASSERT_GL_ERROR();
+
+  textureTime = ttoy_Bench_run(window,
+      0,  /* flags */
+      width,  /* width */
+      height,  /* height */
+      frames  /* frames */
+      );
+  directTime = ttoy_Bench_run(window,
+      TTOY_PROFILE_DIRECT_BACKGROUND,  /* flags */
+      width,  /* width */
+      height,  /* height */
+      frames  /* frames */
+      );
+
+  /* The texture path writes every pixel of the texture and reads it back to
+   * write the window; the direct path only writes the window */
+  megapixels = (double)width * (double)height * 1.0e-6;
+  printf("%dx%d, %d frames\n", width, height, frames);
+  printf("  texture: %8.3f ms/frame  (%.1f Mpx written, %.1f Mpx read)\n",
+      textureTime, 2.0 * megapixels, megapixels);
+  printf("  direct:  %8.3f ms/frame  (%.1f Mpx written)\n",
+      directTime, megapixels);
+  printf("  saved:   %8.3f ms/frame  (%.1f%%)\n",
+      textureTime - directTime,
+      100.0 * (textureTime - directTime) / textureTime);
+
+  SDL_GL_DeleteContext(context);
+  SDL_DestroyWindow(window);
+  SDL_Quit();
+
+  exit(0);
+}
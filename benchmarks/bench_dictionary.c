@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2016-2017 Jonathan Glines
+ * Jonathan Glines <jonathan@glines.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/common/dictionary.h"
+
+/*
+ * ttoy-bench-dictionary measures building a ttoy_Dictionary and looking up
+ * keys in it, both keys that are present and keys that are not, at a few
+ * sizes. Small dictionaries are built many times over so that each
+ * measurement covers roughly the same number of operations.
+ */
+
+#define TTOY_BENCH_OPERATIONS 2000000
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1.0e9 + (double)ts.tv_nsec;
+}
+
+void bench(size_t numKeys) {
+  ttoy_Dictionary dictionary;
+  char **keys, **missingKeys;
+  double start, insertTime, hitTime, missTime;
+  size_t repeat, found;
+
+  /* Keys look like the names in config files, with a shared prefix */
+  keys = (char **)malloc(sizeof(char *) * numKeys);
+  missingKeys = (char **)malloc(sizeof(char *) * numKeys);
+  for (size_t i = 0; i < numKeys; ++i) {
+    keys[i] = (char *)malloc(32);
+    snprintf(keys[i], 32, "toy-%zu", i);
+    missingKeys[i] = (char *)malloc(32);
+    snprintf(missingKeys[i], 32, "missing-toy-%zu", i);
+  }
+
+  repeat = TTOY_BENCH_OPERATIONS / numKeys;
+  if (repeat < 1)
+    repeat = 1;
+  insertTime = hitTime = missTime = 0.0;
+  found = 0;
+  for (size_t r = 0; r < repeat; ++r) {
+    start = now();
+    ttoy_Dictionary_init(&dictionary);
+    for (size_t i = 0; i < numKeys; ++i) {
+      ttoy_Dictionary_insert(&dictionary, keys[i], keys[i]);
+    }
+    insertTime += now() - start;
+
+    start = now();
+    for (size_t i = 0; i < numKeys; ++i) {
+      found += ttoy_Dictionary_getValue(&dictionary, keys[i]) == keys[i];
+    }
+    hitTime += now() - start;
+
+    start = now();
+    for (size_t i = 0; i < numKeys; ++i) {
+      found += ttoy_Dictionary_getValue(&dictionary, missingKeys[i]) != NULL;
+    }
+    missTime += now() - start;
+
+    ttoy_Dictionary_destroy(&dictionary);
+  }
+  if (found != numKeys * repeat) {
+    fprintf(stderr, "Dictionary returned wrong values\n");
+    exit(EXIT_FAILURE);
+  }
+
+  printf("%7zu keys: insert %7.1f ns/key, hit %6.1f ns/key, "
+      "miss %6.1f ns/key\n",
+      numKeys,
+      insertTime / (numKeys * repeat),
+      hitTime / (numKeys * repeat),
+      missTime / (numKeys * repeat));
+
+  for (size_t i = 0; i < numKeys; ++i) {
+    free(keys[i]);
+    free(missingKeys[i]);
+  }
+  free(keys);
+  free(missingKeys);
+}
+
+int main(int argc, char **argv) {
+  bench(10);
+  bench(1000);
+  bench(100000);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,265 @@
+/*
+ * Copyright (c) 2016-2017 Jonathan Glines
+ * Jonathan Glines <jonathan@glines.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <GL/glew.h>
+#include <SDL.h>
+#include <libtsm.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/common/arena.h"
+#include "../src/common/glError.h"
+#include "../src/embeddedFont.h"
+#include "../src/fonts.h"
+#include "../src/glyphRenderer.h"
+#include "../src/glyphRendererRef.h"
+#include "../src/logging.h"
+#include "../src/profile.h"
+#include "../src/textRenderer.h"
+#include "allocCounter.h"
+
+/*
+ * ttoy-bench-text measures the cost of rebuilding and drawing a full screen
+ * of text every frame, as happens while a program floods the terminal with
+ * output. Along with the time per frame, it counts the heap allocations made
+ * while the text renderer rebuilds its instances, which should be zero once
+ * the renderer has warmed up, and the allocations made during the frame as a
+ * whole, which includes libtsm and the GL driver.
+ *
+ * ttoy-bench-text-checked is the same benchmark built with per-call
+ * glGetError() checks compiled in, as in debug builds. Comparing the CPU time
+ * per frame of the two shows what the checks cost.
+ */
+
+#define TTOY_BENCH_DEFAULT_COLUMNS 200
+#define TTOY_BENCH_DEFAULT_ROWS 60
+#define TTOY_BENCH_DEFAULT_FRAMES 600
+#define TTOY_BENCH_WARMUP_FRAMES 60
+
+static const char *lines[] = {
+  "\033[1;32muser@host\033[0m:\033[1;34m~/src/ttoy\033[0m$ make -j8\r\n",
+  "[ 42%] Building C object src/CMakeFiles/ttoy.dir/textRenderer.c.o\r\n",
+  "\033[4mwarning\033[0m: unused variable \033[33m'result'\033[0m\r\n",
+  "\033[7m inverse \033[0m \033[41;37m error \033[0m plain text after colors\r\n",
+};
+
+void ttoy_Bench_tsmWrite(
+    struct tsm_vte *vte,
+    const char *u8,
+    size_t len,
+    void *data)
+{
+  /* We have no child process to answer */
+}
+
+void usage() {
+  fprintf(stderr, "Usage: ttoy-bench-text [columns rows [frames]]\n");
+}
+
+int main(int argc, char **argv) {
+  SDL_Window *window;
+  SDL_GLContext context;
+  GLenum glewError;
+  ttoy_Profile profile;
+  ttoy_GlyphRendererRef *glyphRenderer;
+  ttoy_TextRenderer textRenderer;
+  struct tsm_screen *screen;
+  struct tsm_vte *vte;
+  Uint64 start, end;
+  struct timespec cpuStart, cpuEnd;
+  size_t textAllocations, frameAllocations, allocations;
+  int columns, rows, frames, cellWidth, cellHeight, width, height;
+  ttoy_ErrorCode error;
+
+  columns = TTOY_BENCH_DEFAULT_COLUMNS;
+  rows = TTOY_BENCH_DEFAULT_ROWS;
+  frames = TTOY_BENCH_DEFAULT_FRAMES;
+  if (argc == 3 || argc == 4) {
+    columns = atoi(argv[1]);
+    rows = atoi(argv[2]);
+    if (argc == 4) {
+      frames = atoi(argv[3]);
+    }
+  } else if (argc != 1) {
+    usage();
+    exit(1);
+  }
+  if (columns <= 0 || rows <= 0 || frames <= 0) {
+    usage();
+    exit(1);
+  }
+
+  /* Use the embedded font, so that results do not depend on the fonts that
+   * happen to be installed */
+  ttoy_Fonts_init();
+  ttoy_Profile_init(&profile, "bench");
+  error = ttoy_Profile_setPrimaryFont(&profile,
+      TTOY_EMBEDDED_FONT_FACE,  /* fontFace */
+      TTOY_EMBEDDED_FONT_SIZE  /* fontSize */
+      );
+  if (error != TTOY_NO_ERROR) {
+    TTOY_LOG_ERROR_CODE(error);
+    exit(1);
+  }
+  ttoy_GlyphRendererRef_init(&glyphRenderer);
+  ttoy_GlyphRenderer_init(ttoy_GlyphRendererRef_get(glyphRenderer),
+      &profile  /* profile */
+      );
+  ttoy_GlyphRenderer_getCellSize(ttoy_GlyphRendererRef_get(glyphRenderer),
+      &cellWidth,  /* width */
+      &cellHeight  /* height */
+      );
+  width = columns * cellWidth;
+  height = rows * cellHeight;
+
+  SDL_Init(SDL_INIT_VIDEO);
+  window = SDL_CreateWindow(
+      "ttoy-bench-text",  /* title */
+      SDL_WINDOWPOS_UNDEFINED,  /* x */
+      SDL_WINDOWPOS_UNDEFINED,  /* y */
+      width,  /* w */
+      height,  /* h */
+      SDL_WINDOW_OPENGL  /* flags */
+      );
+  if (window == NULL) {
+    fprintf(stderr, "Failed to create SDL window: %s\n", SDL_GetError());
+    exit(1);
+  }
+  SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+  SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+  context = SDL_GL_CreateContext(window);
+  if (context == NULL) {
+    fprintf(stderr, "Failed to initialize OpenGL context: %s\n",
+        SDL_GetError());
+    exit(1);
+  }
+  glewExperimental = 1;
+  glewError = glewInit();
+  if (glewError != GLEW_OK) {
+    fprintf(stderr, "Failed to initialize GLEW: %s\n",
+        glewGetErrorString(glewError));
+    exit(1);
+  }
+  /* Swallow the error generated by GLEW */
+  while (glGetError() != GL_NO_ERROR);
+  ttoy_initGLDebugOutput();
+  /* Draw as fast as we can */
+  SDL_GL_SetSwapInterval(0);
+  glViewport(0, 0, width, height);
+  ASSERT_GL_ERROR();
+
+  ttoy_TextRenderer_init(&textRenderer,
+      glyphRenderer,  /* glyphRenderer */
+      &profile,  /* profile */
+      NULL  /* stagingAtlas */
+      );
+  tsm_screen_new(
+      &screen,  /* out */
+      NULL,  /* log */
+      NULL  /* log_data */
+      );
+  tsm_vte_new(
+      &vte,  /* out */
+      screen,  /* con */
+      ttoy_Bench_tsmWrite,  /* write_cb */
+      NULL,  /* data */
+      NULL,  /* log */
+      NULL  /* log_data */
+      );
+  if (tsm_screen_resize(screen, columns, rows) < 0) {
+    fprintf(stderr, "Failed to resize libtsm screen\n");
+    exit(1);
+  }
+
+  start = 0;
+  textAllocations = 0;
+  frameAllocations = 0;
+  for (int i = 0; i < TTOY_BENCH_WARMUP_FRAMES + frames; ++i) {
+    if (i == TTOY_BENCH_WARMUP_FRAMES) {
+      glFinish();
+      ASSERT_GL_ERROR();
+      start = SDL_GetPerformanceCounter();
+      clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpuStart);
+      textAllocations = 0;
+      frameAllocations = ttoy_Bench_allocations();
+    }
+    /* Scroll a new line of output onto the screen */
+    tsm_vte_input(vte,
+        lines[i % (sizeof(lines) / sizeof(lines[0]))],  /* u8 */
+        strlen(lines[i % (sizeof(lines) / sizeof(lines[0]))])  /* len */
+        );
+    allocations = ttoy_Bench_allocations();
+    ttoy_TextRenderer_updateScreen(&textRenderer,
+        screen,  /* screen */
+        NULL,  /* scrollback */
+        0,  /* scrollOffset */
+        cellWidth,  /* cellWidth */
+        cellHeight  /* cellHeight */
+        );
+    ttoy_Arena_reset(ttoy_Arena_frame());
+    textAllocations += ttoy_Bench_allocations() - allocations;
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    ASSERT_GL_ERROR();
+    ttoy_TextRenderer_draw(&textRenderer,
+        cellWidth,  /* cellWidth */
+        cellHeight,  /* cellHeight */
+        width,  /* viewportWidth */
+        height  /* viewportHeight */
+        );
+    SDL_GL_SwapWindow(window);
+  }
+  glFinish();
+  ASSERT_GL_ERROR();
+  end = SDL_GetPerformanceCounter();
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpuEnd);
+  frameAllocations = ttoy_Bench_allocations() - frameAllocations;
+
+  printf("%dx%d cells, %d frames, GL error checks %s\n",
+      columns, rows, frames,
+      TTOY_CHECK_GL_ERRORS ? "per call" : "via KHR_debug");
+  printf("  time:        %8.3f ms/frame\n",
+      (double)(end - start) * 1000.0
+      / (double)SDL_GetPerformanceFrequency() / (double)frames);
+  printf("  cpu time:    %8.3f ms/frame\n",
+      ((double)(cpuEnd.tv_sec - cpuStart.tv_sec) * 1000.0
+       + (double)(cpuEnd.tv_nsec - cpuStart.tv_nsec) / 1000000.0)
+      / (double)frames);
+  printf("  text allocs: %8.3f /frame\n",
+      (double)textAllocations / (double)frames);
+  printf("  all allocs:  %8.3f /frame\n",
+      (double)frameAllocations / (double)frames);
+
+  tsm_vte_unref(vte);
+  tsm_screen_unref(screen);
+  ttoy_TextRenderer_destroy(&textRenderer);
+  ttoy_GlyphRendererRef_decrement(glyphRenderer);
+  ttoy_Profile_destroy(&profile);
+  ttoy_Fonts_destroy();
+  SDL_GL_DeleteContext(context);
+  SDL_DestroyWindow(window);
+  SDL_Quit();
+
+  exit(0);
+}
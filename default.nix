@@ -1,4 +1,4 @@
-{ stdenv, fetchgit, cmake, SDL2, glew, freetype, dejavu_fonts, pkgconfig, check, vimNox, gprof2dot, oprofile, jansson, fontconfig, expat, doxygen, python27Packages, git, xorg, autoconf, automake, libtool }:
+{ stdenv, fetchgit, cmake, SDL2, glew, freetype, dejavu_fonts, pkgconfig, check, vimNox, gprof2dot, oprofile, jansson, libpng, fontconfig, expat, doxygen, python27Packages, git, xorg, autoconf, automake, libtool }:
 
 stdenv.mkDerivation rec {
   name = "ttoy-${version}";
@@ -7,7 +7,7 @@ stdenv.mkDerivation rec {
   src = ./.;
 
   buildInputs = [ cmake SDL2 glew freetype dejavu_fonts pkgconfig check
-    jansson fontconfig expat doxygen
+    jansson libpng fontconfig expat doxygen
     vimNox  /* For the xxd utility */
     python27Packages.sphinx
     git
@@ -0,0 +1,71 @@
+/*
+ * Screen Scroll-Back Extraction
+ *
+ * This is not a source file of its own. extern/CMakeLists.txt appends it to
+ * the copy of libtsm's tsm-screen.c that we build, so that it has access to
+ * the screen internals (see tsm_screen_clear_sb(), which it follows closely).
+ * ttoy keeps lines that scroll off the screen in its own compressed
+ * scrollback, and only needs libtsm to hold them until it takes them out
+ * with this function. The declaration is in tsm_screen_sb_pop.h.
+ */
+
+SHL_EXPORT
+int tsm_screen_sb_pop(struct tsm_screen *con, tsm_screen_draw_cb draw_cb,
+		      void *data)
+{
+	struct line *line;
+	struct tsm_screen_attr attr;
+	const uint32_t *ch;
+	size_t len;
+	unsigned int i;
+	int ret;
+
+	if (!con || !draw_cb)
+		return -EINVAL;
+
+	line = con->sb_first;
+	if (!line)
+		return -ENOENT;
+
+	/* Draw the whole line as it was stored, which might be wider than the
+	 * screen is now */
+	for (i = 0; i < line->size; ++i) {
+		memcpy(&attr, &line->cells[i].attr, sizeof(attr));
+		ch = tsm_symbol_get(con->sym_table, &line->cells[i].ch, &len);
+		if (line->cells[i].ch == ' ' || line->cells[i].ch == 0)
+			len = 0;
+		ret = draw_cb(con, line->cells[i].ch, ch, len,
+			      line->cells[i].width, i, 0, &attr, 0, data);
+		if (ret)
+			break;
+	}
+
+	/* Unlink the line, keeping the scroll-back position and the selection
+	 * away from it */
+	con->sb_first = line->next;
+	if (line->next)
+		line->next->prev = NULL;
+	else
+		con->sb_last = NULL;
+	--con->sb_count;
+
+	if (con->sb_pos == line) {
+		con->sb_pos = con->sb_first;
+		con->age = con->age_cnt;
+	}
+
+	if (con->sel_active) {
+		if (con->sel_start.line == line) {
+			con->sel_start.line = NULL;
+			con->sel_start.y = SELECTION_TOP;
+		}
+		if (con->sel_end.line == line) {
+			con->sel_end.line = NULL;
+			con->sel_end.y = SELECTION_TOP;
+		}
+	}
+
+	line_free(line);
+
+	return 0;
+}
@@ -0,0 +1,16 @@
+#ifndef TSM_SCREEN_SB_POP_H
+#define TSM_SCREEN_SB_POP_H
+
+#include <libtsm.h>
+
+/*
+ * Removes the oldest line from the scroll-back buffer of the screen, after
+ * passing each of its cells to draw_cb with posy set to zero. Returns
+ * -ENOENT when the scroll-back buffer is empty.
+ *
+ * This is our addition to libtsm; see tsm_screen_sb_pop.c.
+ */
+int tsm_screen_sb_pop(struct tsm_screen *con, tsm_screen_draw_cb draw_cb,
+		      void *data);
+
+#endif
@@ -56,10 +56,15 @@ typedef void (*ttoy_BackgroundToy_Draw)(
     int  /* viewportHeight */
     );
 
+typedef int (*ttoy_BackgroundToy_IsDirty)(
+    ttoy_BackgroundToy *  /* self */
+    );
+
 typedef struct ttoy_BackgroundToy_Dispatch_ {
   ttoy_BackgroundToy_Init init;
   ttoy_BackgroundToy_Destroy destroy;
   ttoy_BackgroundToy_Draw draw;
+  ttoy_BackgroundToy_IsDirty isDirty;
 } ttoy_BackgroundToy_Dispatch;
 
 void ttoy_BackgroundToy_init(
@@ -75,11 +80,24 @@ void ttoy_BackgroundToy_draw(
     int viewportWidth,
     int viewportHeight);
 
+/**
+ * Returns non-zero if drawing the toy again at the same viewport size would
+ * draw something different, e.g. because the toy animates over time, responds
+ * to input, or is still loading. The last frame drawn by a toy that is not
+ * dirty is reused until the viewport changes. Toys that do not implement this
+ * method are always dirty.
+ *
+ * Called on the same thread as ttoy_BackgroundToy_draw().
+ */
+int ttoy_BackgroundToy_isDirty(
+    ttoy_BackgroundToy *self);
+
 #define TTOY_BACKGROUND_TOY_DISPATCH( \
     BACKGROUND_TOY_STRUCT, \
     INIT_CB, \
     DESTROY_CB, \
-    DRAW_CB) \
+    DRAW_CB, \
+    IS_DIRTY_CB) \
   const ttoy_BackgroundToy_Attributes TTOY_BACKGROUND_TOY_ATTRIBUTES = { \
     .size = sizeof(BACKGROUND_TOY_STRUCT), \
   }; \
@@ -87,6 +105,7 @@ void ttoy_BackgroundToy_draw(
     .init = INIT_CB, \
     .destroy = DESTROY_CB, \
     .draw = DRAW_CB, \
+    .isDirty = IS_DIRTY_CB, \
   };
 
 #endif
@@ -33,6 +33,18 @@ TTOY_DECLARE_ERROR_CODE(
     TTOY_ERROR_ATLAS_GLYPH_NOT_FOUND,  /* code */
     "Could not find atlas glyph"  /* string */
     )
+TTOY_DECLARE_ERROR_CODE(
+    TTOY_ERROR_CACHE_DIRECTORY_NOT_FOUND,  /* code */
+    "Could not determine the cache directory"  /* string */
+    )
+TTOY_DECLARE_ERROR_CODE(
+    TTOY_ERROR_CACHE_MISS,  /* code */
+    "Cache entry is missing or out of date"  /* string */
+    )
+TTOY_DECLARE_ERROR_CODE(
+    TTOY_ERROR_CACHE_WRITE_FAILED,  /* code */
+    "Failed to write cache file"  /* string */
+    )
 TTOY_DECLARE_ERROR_CODE(
     TTOY_ERROR_CONFIG,  /* code */
     "Error in the configuration file"  /* string */
@@ -89,6 +101,14 @@ TTOY_DECLARE_ERROR_CODE(
     TTOY_ERROR_FREETYPE_ERROR,  /* code */
     "FreeType error; could not load a font"  /* string */
     )
+TTOY_DECLARE_ERROR_CODE(
+    TTOY_ERROR_IMAGE_DECODE_FAILED,  /* code */
+    "Failed to decode image"  /* string */
+    )
+TTOY_DECLARE_ERROR_CODE(
+    TTOY_ERROR_IMAGE_FILE_READ,  /* code */
+    "Error reading an image file"  /* string */
+    )
 /* FIXME: FONT_NOT_FOUND and MISSING_FONT are too similar */
 TTOY_DECLARE_ERROR_CODE(
     TTOY_ERROR_MISSING_FONT,  /* code */
@@ -134,6 +154,18 @@ TTOY_DECLARE_ERROR_CODE(
     TTOY_ERROR_PROFILE_NO_PRIMARY_FONT,  /* code */
     "Profile has no primary font"  /* string */
     )
+TTOY_DECLARE_ERROR_CODE(
+    TTOY_ERROR_SCROLLBACK_CORRUPT,  /* code */
+    "Scrollback block could not be decoded"  /* string */
+    )
+TTOY_DECLARE_ERROR_CODE(
+    TTOY_ERROR_SCROLLBACK_LINE_NOT_FOUND,  /* code */
+    "Scrollback line not found"  /* string */
+    )
+TTOY_DECLARE_ERROR_CODE(
+    TTOY_ERROR_SCROLLBACK_SPILL_FAILED,  /* code */
+    "Failed to spill scrollback to disk"  /* string */
+    )
 TTOY_DECLARE_ERROR_CODE(
     TTOY_ERROR_SDL_ERROR,  /* code */
     "SDL error"  /* string */
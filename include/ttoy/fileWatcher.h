@@ -41,6 +41,19 @@ void
 ttoy_FileWatcher_init(
     ttoy_FileWatcher *self);
 
+/**
+ * Stops watching the files of this watcher. Its callback is not called after
+ * this returns.
+ */
+void
+ttoy_FileWatcher_destroy(
+    ttoy_FileWatcher *self);
+
+/**
+ * Sets the function called when one of the watched files changes. The
+ * callback is called from the main loop of ttoy, once the file has stopped
+ * changing for a moment, rather than for every write to the file.
+ */
 void
 ttoy_FileWatcher_setCallback(
     ttoy_FileWatcher *self,
@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2016-2017 Jonathan Glines
+ * Jonathan Glines <jonathan@glines.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../embeddedFont.h"
+#include "../fonts.h"
+#include "../glyphAtlas.h"
+#include "../glyphRenderer.h"
+#include "../logging.h"
+#include "../profile.h"
+
+/*
+ * ttoy-atlasgen packs the printable ASCII glyphs of the font embedded in ttoy
+ * into a glyph atlas cache file at build time. The resulting file is embedded
+ * in the ttoy binary, so that ttoy can show text on its very first run without
+ * rasterizing any glyphs.
+ *
+ * NOTE: The atlas is only used if it was packed at the same DPI that ttoy
+ * renders the embedded font with, which is currently the DPI hardcoded in
+ * ttoy_Profile_init().
+ */
+
+void usage() {
+  fprintf(stderr, "Usage: ttoy-atlasgen <output>\n");
+}
+
+int main(int argc, char **argv) {
+  ttoy_Profile profile;
+  ttoy_GlyphRenderer glyphRenderer;
+  ttoy_ErrorCode error;
+
+  if (argc != 2) {
+    usage();
+    exit(1);
+  }
+
+  ttoy_Fonts_init();
+
+  ttoy_Profile_init(&profile, "embedded");
+  error = ttoy_Profile_setPrimaryFont(&profile,
+      TTOY_EMBEDDED_FONT_FACE,  /* fontFace */
+      TTOY_EMBEDDED_FONT_SIZE  /* fontSize */
+      );
+  if (error != TTOY_NO_ERROR) {
+    TTOY_LOG_ERROR_CODE(error);
+    exit(1);
+  }
+
+  ttoy_GlyphRenderer_init(&glyphRenderer, &profile);
+  error = ttoy_GlyphAtlas_writeASCIICache(&glyphRenderer,
+      argv[1]  /* path */
+      );
+  if (error != TTOY_NO_ERROR) {
+    TTOY_LOG_ERROR_CODE(error);
+    exit(1);
+  }
+
+  ttoy_GlyphRenderer_destroy(&glyphRenderer);
+  ttoy_Profile_destroy(&profile);
+  ttoy_Fonts_destroy();
+
+  exit(0);
+}
@@ -22,36 +22,129 @@
  */
 
 #include <GL/glew.h>
+#include <SDL.h>
+#include <SDL_thread.h>
+#include <assert.h>
+#include <math.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "./common/glContext.h"
 #include "./common/glError.h"
+#include "./common/renderTargetPool.h"
 #include "./common/shader.h"
 #include "logging.h"
 
 #include "backgroundRenderer.h"
 
+typedef struct ttoy_BackgroundRenderer_Buffer_ {
+  /* Covers the whole viewport, so that the toy can render at full resolution
+   * when the GPU has the headroom */
+  ttoy_RenderTarget *target;
+  /* The region of the texture that the toy last rendered to */
+  int toyWidth, toyHeight;
+  /* Fences for the GPU to finish writing to and reading from this buffer,
+   * since the toy and the compositor draw with different GL contexts */
+  GLsync writeFence, readFence;
+} ttoy_BackgroundRenderer_Buffer;
+
 /* Private methods */
 void ttoy_BackgroundRenderer_initShader(
     ttoy_BackgroundRenderer *self);
-void ttoy_BackgroundRenderer_initFramebuffer(
-    ttoy_BackgroundRenderer *self);
 void ttoy_BackgroundRenderer_initQuad(
     ttoy_BackgroundRenderer *self);
+void ttoy_BackgroundRenderer_startRenderThread(
+    ttoy_BackgroundRenderer *self);
 
-void ttoy_BackgroundRenderer_drawBackgroundTexture(
+int ttoy_BackgroundRenderer_renderThread(
+    ttoy_BackgroundRenderer *self);
+void ttoy_BackgroundRenderer_initToyObjects(
+    ttoy_BackgroundRenderer *self);
+void ttoy_BackgroundRenderer_destroyToyObjects(
+    ttoy_BackgroundRenderer *self);
+void ttoy_BackgroundRenderer_initBuffer(
+    ttoy_BackgroundRenderer *self,
+    ttoy_BackgroundRenderer_Buffer *buffer);
+void ttoy_BackgroundRenderer_resizeBuffer(
+    ttoy_BackgroundRenderer *self,
+    ttoy_BackgroundRenderer_Buffer *buffer,
+    int width,
+    int height);
+/* Given a NULL buffer, these render the toy straight to the current
+ * framebuffer, at full resolution */
+void ttoy_BackgroundRenderer_updateToy(
+    ttoy_BackgroundRenderer *self,
+    ttoy_BackgroundRenderer_Buffer *buffer,
+    int viewportWidth,
+    int viewportHeight);
+void ttoy_BackgroundRenderer_drawToy(
+    ttoy_BackgroundRenderer *self,
+    ttoy_BackgroundRenderer_Buffer *buffer,
+    int viewportWidth,
+    int viewportHeight);
+int ttoy_BackgroundRenderer_needsUpdate(
+    ttoy_BackgroundRenderer *self,
+    const ttoy_BackgroundRenderer_Buffer *newest,
+    int viewportWidth,
+    int viewportHeight);
+void ttoy_BackgroundRenderer_readTimerQueries(
+    ttoy_BackgroundRenderer *self);
+void ttoy_BackgroundRenderer_adjustQuality(
     ttoy_BackgroundRenderer *self);
 
+void ttoy_BackgroundRenderer_drawBackgroundTexture(
+    ttoy_BackgroundRenderer *self,
+    ttoy_BackgroundRenderer_Buffer *buffer);
+
 typedef struct ttoy_BackgroundRenderer_QuadVertex_ {
   GLfloat pos[3], texCoord[2];
 } ttoy_BackgroundRenderer_QuadVertex;
 
 struct ttoy_BackgroundRenderer_Internal_ {
   ttoy_BackgroundToy *backgroundToy;
+  /* Objects for compositing the toy, used by the thread calling draw() */
   ttoy_Shader shader;
-  GLuint texture, framebuffer, quadVertexBuffer, quadIndexBuffer, vao;
-  GLuint toySamplerLocation;
+  GLuint quadVertexBuffer, quadIndexBuffer, vao;
+  GLuint toySamplerLocation, toyScaleLocation;
   int initializedDrawObjects;
+  /* The toy is rendered into one buffer while the other is composited. The
+   * following are guarded by the mutex when the toy has its own thread. */
+  ttoy_BackgroundRenderer_Buffer buffers[2];
+  int front;  /* The newest complete buffer, or -1 */
+  int reading;  /* The buffer being composited, or -1 */
+  int framesComposited;  /* Frames composited since the toy last rendered */
+  /* The resolution at which the toy renders, and the number of composited
+   * frames between its updates, as set by the governor on the thread that
+   * renders the toy */
+  float scale;
+  int interval;
+  int viewportWidth, viewportHeight;
+  /* Whether the toy would draw anything new, as of the last time that it was
+   * asked, and whether it is paused while the window is not being looked
+   * at */
+  int toyDirty, paused;
+  /* Whether the toy may render directly to the framebuffer that we draw to,
+   * and whether the newest frame was rendered that way */
+  int direct, directFrame;
+  int quit;
+  /* The thread that renders the toy, and its GL context. Without these, the
+   * toy is rendered synchronously by draw(). */
+  SDL_Window *window;
+  SDL_GLContext context;
+  SDL_Thread *thread;
+  SDL_mutex *mutex;
+  SDL_cond *cond;
+  /* Objects for rendering the toy, which belong to the toy's GL context */
+  ttoy_RenderTargetPool renderTargetPool;
+  int initializedToyObjects;
+  /* State for governing the GPU time taken by the toy. Timer queries are
+   * issued in a ring and read back frames later, so that we never wait on
+   * the GPU. */
+  GLuint timerQueries[TTOY_BACKGROUND_RENDERER_NUM_QUERIES];
+  int nextQuery, numPendingQueries;
+  float budget;  /* milliseconds per frame */
+  float toyTime;  /* smoothed milliseconds per toy update */
+  int settleSamples;
 };
 
 void ttoy_BackgroundRenderer_init(
@@ -62,8 +155,53 @@ void ttoy_BackgroundRenderer_init(
   self->internal = (ttoy_BackgroundRenderer_Internal *)malloc(
       sizeof(ttoy_BackgroundRenderer_Internal));
   self->internal->initializedDrawObjects = 0;
+  self->internal->initializedToyObjects = 0;
   /* Store a pointer to the background toy */
   self->internal->backgroundToy = ttoy_Profile_getBackgroundToy(profile);
+  memset(self->internal->buffers, 0, sizeof(self->internal->buffers));
+  self->internal->front = -1;
+  self->internal->reading = -1;
+  self->internal->framesComposited = 0;
+  self->internal->viewportWidth = 0;
+  self->internal->viewportHeight = 0;
+  self->internal->toyDirty = 1;
+  self->internal->paused = 0;
+  self->internal->direct =
+    (profile->flags & TTOY_PROFILE_DIRECT_BACKGROUND) != 0;
+  self->internal->directFrame = 0;
+  self->internal->quit = 0;
+  self->internal->window = NULL;
+  self->internal->context = NULL;
+  self->internal->thread = NULL;
+  self->internal->mutex = SDL_CreateMutex();
+  self->internal->cond = SDL_CreateCond();
+  /* Start at full quality, and lower it only if the toy goes over budget */
+  self->internal->budget = profile->backgroundBudget;
+  self->internal->toyTime = 0.0f;
+  self->internal->scale = 1.0f;
+  self->internal->interval = 1;
+  self->internal->settleSamples = TTOY_BACKGROUND_RENDERER_SETTLE_SAMPLES;
+  self->internal->nextQuery = 0;
+  self->internal->numPendingQueries = 0;
+  /* Register our event type while we are still on the main thread */
+  ttoy_BackgroundRenderer_eventType();
+}
+
+int ttoy_BackgroundRenderer_eventType() {
+  static int eventType = -1;
+
+  /* Register the event type with SDL, if we have not done so already */
+  if (eventType == -1) {
+    eventType = SDL_RegisterEvents(1);
+    if (eventType == -1) {
+      TTOY_LOG_ERROR("Failed to register background event with SDL: %s",
+          SDL_GetError());
+      /* TODO: Fail gracefully */
+      assert(0);
+    }
+  }
+
+  return eventType;
 }
 
 static const char *vert_shader =
@@ -83,11 +221,16 @@ static const char *frag_shader =
   "#version 330\n"
   "\n"
   "uniform sampler2D toySampler;\n"
+  "uniform vec2 toyScale;\n"
   "\n"
   "smooth in vec2 texCoord;\n"
   "\n"
   "void main(void) {\n"
-  "  gl_FragColor = vec4(texture(toySampler, texCoord).rgb, 1.0);\n"
+  "  /* The toy might have rendered to only part of its texture, which we\n"
+  "   * upscale with bilinear filtering */\n"
+  "  vec2 halfTexel = 0.5 / vec2(textureSize(toySampler, 0));\n"
+  "  vec2 uv = min(texCoord * toyScale, toyScale - halfTexel);\n"
+  "  gl_FragColor = vec4(texture(toySampler, uv).rgb, 1.0);\n"
   "}\n";
 
 
@@ -138,89 +281,98 @@ void ttoy_BackgroundRenderer_initShader(
         self->internal->shader.program,  /* program */ \
         #NAME  /* name */ \
         ); \
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   GET_UNIFORM(toySampler)
+  GET_UNIFORM(toyScale)
 }
 
-void ttoy_BackgroundRenderer_initFramebuffer(
-    ttoy_BackgroundRenderer *self)
+void ttoy_BackgroundRenderer_initBuffer(
+    ttoy_BackgroundRenderer *self,
+    ttoy_BackgroundRenderer_Buffer *buffer)
 {
-#ifndef NDEBUG
-  GLenum result;
-#endif
-
-  /* Prepare the texture */
-  glGenTextures(
-      1,  /* n */
-      &self->internal->texture  /* textures */
-      );
-  FORCE_ASSERT_GL_ERROR();
-  glBindTexture(
-      GL_TEXTURE_2D,  /* target */
-      self->internal->texture  /* texture */
-      );
-  FORCE_ASSERT_GL_ERROR();
-  glTexParameteri(
-      GL_TEXTURE_2D,  /* target */
-      GL_TEXTURE_MIN_FILTER,  /* pname */
-      GL_LINEAR  /* param */
-      );
-  FORCE_ASSERT_GL_ERROR();
-  glTexParameteri(
-      GL_TEXTURE_2D,  /* target */
-      GL_TEXTURE_MAG_FILTER,  /* pname */
-      GL_LINEAR  /* param */
-      );
-  FORCE_ASSERT_GL_ERROR();
-  glTexImage2D(
-      GL_TEXTURE_2D,  /* target */
-      0,  /* level */
-      GL_RGBA,  /* internalFormat */
-      640,  /* width */
-      480,  /* height */
-      0,  /* border */
-      GL_RGBA,  /* format */
-      GL_UNSIGNED_INT_8_8_8_8,  /* type */
-      NULL  /* data */
-      );
-  FORCE_ASSERT_GL_ERROR();
-
-  /* Prepare the framebuffer */
-  glGenFramebuffers(
-      1,  /* n */
-      &self->internal->framebuffer  /* ids */
+  buffer->target = NULL;
+  ttoy_BackgroundRenderer_resizeBuffer(self,
+      buffer,  /* buffer */
+      1,  /* width */
+      1  /* height */
       );
-  FORCE_ASSERT_GL_ERROR();
-  glBindFramebuffer(
-      GL_DRAW_FRAMEBUFFER,  /* target */
-      self->internal->framebuffer  /* framebuffer */
-      );
-  FORCE_ASSERT_GL_ERROR();
-  glFramebufferTexture2D(
-      GL_DRAW_FRAMEBUFFER,  /* target */
-      GL_COLOR_ATTACHMENT0,  /* attachment */
-      GL_TEXTURE_2D,  /* textarget */
-      self->internal->texture,  /* texture */
-      0  /* level */
+}
+
+void ttoy_BackgroundRenderer_resizeBuffer(
+    ttoy_BackgroundRenderer *self,
+    ttoy_BackgroundRenderer_Buffer *buffer,
+    int width,
+    int height)
+{
+  ttoy_RenderTarget *previous;
+  ttoy_ErrorCode error;
+
+  if (width < 1)
+    width = 1;
+  if (height < 1)
+    height = 1;
+  if (buffer->target != NULL
+      && width == buffer->target->width
+      && height == buffer->target->height)
+  {
+    return;
+  }
+
+  /* NOTE: The pool only reallocates the texture once the viewport has grown
+   * or shrunk past a power of two, so resizing the window does not reallocate
+   * on every frame */
+  previous = buffer->target;
+  error = ttoy_RenderTargetPool_resize(&self->internal->renderTargetPool,
+      &buffer->target,  /* target */
+      width,  /* width */
+      height,  /* height */
+      GL_RGBA8  /* internalFormat */
       );
-  FORCE_ASSERT_GL_ERROR();
+  if (error != TTOY_NO_ERROR) {
+    TTOY_LOG_ERROR_CODE(error);
+    /* FIXME: Fail gracefully here */
+    assert(0);
+  }
+  if (buffer->target != previous) {
+    /* The contents of the texture are gone, so the toy must render again */
+    buffer->toyWidth = 0;
+    buffer->toyHeight = 0;
+  }
+}
 
-  /* Check the validity of the framebuffer */
-#ifndef NDEBUG
-  result =
-#endif
-  glCheckFramebufferStatus(
-      GL_DRAW_FRAMEBUFFER  /* target */
+void ttoy_BackgroundRenderer_initToyObjects(
+    ttoy_BackgroundRenderer *self)
+{
+  /* NOTE: Framebuffer and query objects are not shared between GL contexts,
+   * so these are created by whichever thread renders the toy */
+  ttoy_RenderTargetPool_init(&self->internal->renderTargetPool);
+  for (int i = 0; i < 2; ++i) {
+    ttoy_BackgroundRenderer_initBuffer(self,
+        &self->internal->buffers[i]  /* buffer */
+        );
+  }
+  glGenQueries(
+      TTOY_BACKGROUND_RENDERER_NUM_QUERIES,  /* n */
+      self->internal->timerQueries  /* ids */
       );
-  FORCE_ASSERT_GL_ERROR();
-  assert(result == GL_FRAMEBUFFER_COMPLETE);
+  ASSERT_GL_ERROR();
+  self->internal->initializedToyObjects = 1;
+}
 
-  /* Clear the framebuffer binding */
-  glBindFramebuffer(
-      GL_DRAW_FRAMEBUFFER,  /* target */
-      0  /* framebuffer */
+void ttoy_BackgroundRenderer_destroyToyObjects(
+    ttoy_BackgroundRenderer *self)
+{
+  if (!self->internal->initializedToyObjects) {
+    return;
+  }
+  /* This deletes the render targets of both buffers */
+  ttoy_RenderTargetPool_destroy(&self->internal->renderTargetPool);
+  glDeleteQueries(
+      TTOY_BACKGROUND_RENDERER_NUM_QUERIES,  /* n */
+      self->internal->timerQueries  /* ids */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
+  self->internal->initializedToyObjects = 0;
 }
 
 void ttoy_BackgroundRenderer_initQuad(
@@ -254,54 +406,54 @@ void ttoy_BackgroundRenderer_initQuad(
       1,  /* n */
       &self->internal->quadVertexBuffer  /* buffers */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glBindBuffer(
       GL_ARRAY_BUFFER,  /* target */
       self->internal->quadVertexBuffer  /* buffer */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glBufferData(
       GL_ARRAY_BUFFER,  /* target */
       sizeof(vertices),  /* size */
       vertices,  /* data */
       GL_STATIC_DRAW  /* usage */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
 
   /* Prepare the buffer for quad indices */
   glGenBuffers(
       1,  /* n */
       &self->internal->quadIndexBuffer  /* buffers */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glBindBuffer(
       GL_ELEMENT_ARRAY_BUFFER,  /* target */
       self->internal->quadIndexBuffer  /* buffer */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glBufferData(
       GL_ELEMENT_ARRAY_BUFFER,  /* target */
       sizeof(indices),  /* size */
       indices,  /* data */
       GL_STATIC_DRAW  /* usage */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
 
   /* Prepare the vertex array object */
   glGenVertexArrays(
       1,  /* n */
       &self->internal->vao  /* arrays */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glBindVertexArray(
       self->internal->vao  /* array */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   /* Prepare the pos vertex attribute */
   glEnableVertexAttribArray(
       0  /* index */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glVertexAttribPointer(
       0,  /* index */
       3,  /* size */
@@ -310,12 +462,12 @@ void ttoy_BackgroundRenderer_initQuad(
       sizeof(ttoy_BackgroundRenderer_QuadVertex),  /* stride */
       (GLvoid *)offsetof(ttoy_BackgroundRenderer_QuadVertex, pos)  /* pointer */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   /* Prepare the texCoord vertex attribute */
   glEnableVertexAttribArray(
       1  /* index */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glVertexAttribPointer(
       1,  /* index */
       2,  /* size */
@@ -324,81 +476,113 @@ void ttoy_BackgroundRenderer_initQuad(
       sizeof(ttoy_BackgroundRenderer_QuadVertex),  /* stride */
       (GLvoid *)offsetof(ttoy_BackgroundRenderer_QuadVertex, texCoord)  /* pointer */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   /* Clear the vertex array object binding */
   glBindVertexArray(
       0  /* array */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
 }
 
 void ttoy_BackgroundRenderer_destroy(
     ttoy_BackgroundRenderer *self)
 {
+  if (self->internal->thread != NULL) {
+    /* Tell the toy's thread to quit; it cleans up its own GL objects */
+    SDL_LockMutex(self->internal->mutex);
+    self->internal->quit = 1;
+    SDL_CondSignal(self->internal->cond);
+    SDL_UnlockMutex(self->internal->mutex);
+    SDL_WaitThread(self->internal->thread, NULL);
+    SDL_GL_DeleteContext(self->internal->context);
+  } else {
+    ttoy_BackgroundRenderer_destroyToyObjects(self);
+  }
+  for (int i = 0; i < 2; ++i) {
+    if (self->internal->buffers[i].writeFence != NULL) {
+      glDeleteSync(self->internal->buffers[i].writeFence);
+      ASSERT_GL_ERROR();
+    }
+    if (self->internal->buffers[i].readFence != NULL) {
+      glDeleteSync(self->internal->buffers[i].readFence);
+      ASSERT_GL_ERROR();
+    }
+  }
   if (self->internal->initializedDrawObjects) {
-    /* TODO: Clean up the GL objects that we initialized */
+    /* TODO: Clean up the other GL objects that we initialized */
   }
+  SDL_DestroyCond(self->internal->cond);
+  SDL_DestroyMutex(self->internal->mutex);
   free(self->internal);
 }
 
 void ttoy_BackgroundRenderer_drawBackgroundTexture(
-    ttoy_BackgroundRenderer *self)
+    ttoy_BackgroundRenderer *self,
+    ttoy_BackgroundRenderer_Buffer *buffer)
 {
   glUseProgram(
       self->internal->shader.program  /* program */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glBindBuffer(
       GL_ARRAY_BUFFER,  /* target */
       self->internal->quadVertexBuffer  /* buffer */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glBindVertexArray(
       self->internal->vao  /* array */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
 
   /* Prepare the toy texture sampler */
   glActiveTexture(
       GL_TEXTURE0  /* texture */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glBindTexture(
       GL_TEXTURE_2D,  /* target */
-      self->internal->texture  /* texture */
+      buffer->target->texture  /* texture */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glUniform1i(
       self->internal->toySamplerLocation,  /* location */
       0  /* v0 */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
+  glUniform2f(
+      self->internal->toyScaleLocation,  /* location */
+      (float)buffer->toyWidth
+        / (float)buffer->target->textureWidth,  /* v0 */
+      (float)buffer->toyHeight
+        / (float)buffer->target->textureHeight  /* v1 */
+      );
+  ASSERT_GL_ERROR();
 
   /* Draw our texture to the screen */
   glDisable(GL_DEPTH_TEST);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glBindBuffer(
       GL_ELEMENT_ARRAY_BUFFER,  /* target */
       self->internal->quadIndexBuffer  /* buffer */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glDrawElements(
       GL_TRIANGLES,  /* mode */
       6,  /* count */
       GL_UNSIGNED_INT,  /* type */
       0  /* indices */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
 
   /* Restore the depth test */
   glEnable(GL_DEPTH_TEST);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
 
   /* Clear the vertex array object binding */
   glBindVertexArray(
       0  /* array */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
 }
 
 void ttoy_BackgroundRenderer_draw(
@@ -406,34 +590,527 @@ void ttoy_BackgroundRenderer_draw(
     int viewportWidth,
     int viewportHeight)
 {
+  ttoy_BackgroundRenderer_Buffer *buffer;
+  GLsync writeFence, readFence;
+  int front, update;
+
   if (self->internal->backgroundToy != NULL) {
     if (!self->internal->initializedDrawObjects) {
       /* Initialize our GL objects on the first frame */
       ttoy_BackgroundRenderer_initShader(self);
-      ttoy_BackgroundRenderer_initFramebuffer(self);
       ttoy_BackgroundRenderer_initQuad(self);
+      if (!self->internal->direct) {
+        /* NOTE: A toy that renders directly must render on this thread */
+        ttoy_BackgroundRenderer_startRenderThread(self);
+      }
       self->internal->initializedDrawObjects = 1;
     }
 
-    /* Render the background toy to our texture framebuffer */
-    glBindFramebuffer(
-        GL_DRAW_FRAMEBUFFER,  /* target */
-        self->internal->framebuffer  /* framebuffer */
+    if (self->internal->thread == NULL) {
+      /* Render the toy on this thread, into a single buffer, unless we are
+       * lowering its update rate or the last frame it rendered is still
+       * current */
+      buffer = &self->internal->buffers[0];
+      if (self->internal->framesComposited < self->internal->interval)
+        self->internal->framesComposited += 1;
+      update = ttoy_BackgroundRenderer_needsUpdate(self,
+          self->internal->directFrame ? NULL : buffer,  /* newest */
+          viewportWidth,  /* viewportWidth */
+          viewportHeight  /* viewportHeight */
+          );
+      if (self->internal->direct
+          && self->internal->toyDirty
+          && !self->internal->paused
+          && self->internal->scale == 1.0f
+          && self->internal->interval == 1)
+      {
+        /* The toy renders a new frame at full resolution every frame, so
+         * there is nothing to gain from rendering it to a texture first; we
+         * save the fill rate of writing and then reading that texture */
+        ttoy_BackgroundRenderer_updateToy(self,
+            NULL,  /* buffer */
+            viewportWidth,  /* viewportWidth */
+            viewportHeight  /* viewportHeight */
+            );
+        self->internal->directFrame = 1;
+        return;
+      }
+      if ((self->internal->framesComposited >= self->internal->interval
+            && update)
+          || buffer->target == NULL
+          || buffer->target->width != viewportWidth
+          || buffer->target->height != viewportHeight)
+      {
+        self->internal->framesComposited = 0;
+        self->internal->directFrame = 0;
+        ttoy_BackgroundRenderer_updateToy(self,
+            buffer,  /* buffer */
+            viewportWidth,  /* viewportWidth */
+            viewportHeight  /* viewportHeight */
+            );
+      }
+      ttoy_BackgroundRenderer_drawBackgroundTexture(self,
+          buffer  /* buffer */
+          );
+      return;
+    }
+
+    /* Take the newest frame that the toy's thread has finished, and let it
+     * know that the toy can render another */
+    SDL_LockMutex(self->internal->mutex);
+    self->internal->viewportWidth = viewportWidth;
+    self->internal->viewportHeight = viewportHeight;
+    if (self->internal->framesComposited < self->internal->interval)
+      self->internal->framesComposited += 1;
+    front = self->internal->front;
+    writeFence = NULL;
+    if (front >= 0) {
+      self->internal->reading = front;
+      writeFence = self->internal->buffers[front].writeFence;
+      self->internal->buffers[front].writeFence = NULL;
+    }
+    SDL_CondSignal(self->internal->cond);
+    SDL_UnlockMutex(self->internal->mutex);
+    if (front < 0) {
+      /* The toy has yet to finish its first frame */
+      return;
+    }
+    buffer = &self->internal->buffers[front];
+
+    /* Have the GPU wait for the toy to finish rendering before we sample the
+     * texture; we never wait on the CPU */
+    if (writeFence != NULL) {
+      glWaitSync(writeFence, 0, GL_TIMEOUT_IGNORED);
+      ASSERT_GL_ERROR();
+      glDeleteSync(writeFence);
+      ASSERT_GL_ERROR();
+    }
+
+    /* Draw the rendered toy texture on a quad that fills the screen */
+    ttoy_BackgroundRenderer_drawBackgroundTexture(self,
+        buffer  /* buffer */
         );
-    FORCE_ASSERT_GL_ERROR();
-    ttoy_BackgroundToy_draw(self->internal->backgroundToy,
+
+    /* The toy must not render to this buffer again until the GPU is done
+     * reading from it */
+    readFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    ASSERT_GL_ERROR();
+    glFlush();
+    ASSERT_GL_ERROR();
+    SDL_LockMutex(self->internal->mutex);
+    if (buffer->readFence != NULL) {
+      glDeleteSync(buffer->readFence);
+      ASSERT_GL_ERROR();
+    }
+    buffer->readFence = readFence;
+    self->internal->reading = -1;
+    SDL_CondSignal(self->internal->cond);
+    SDL_UnlockMutex(self->internal->mutex);
+  }
+  /* TODO: Without a background toy, what should we do really? We need to draw
+   * a solid color. */
+}
+
+void ttoy_BackgroundRenderer_setPaused(
+    ttoy_BackgroundRenderer *self,
+    int paused)
+{
+  SDL_LockMutex(self->internal->mutex);
+  self->internal->paused = paused;
+  SDL_CondSignal(self->internal->cond);
+  SDL_UnlockMutex(self->internal->mutex);
+}
+
+int ttoy_BackgroundRenderer_isAnimating(
+    ttoy_BackgroundRenderer *self)
+{
+  int result;
+
+  if (self->internal->backgroundToy == NULL) {
+    return 0;
+  }
+  if (!self->internal->initializedDrawObjects) {
+    /* We have yet to draw the first frame */
+    return 1;
+  }
+  SDL_LockMutex(self->internal->mutex);
+  result = self->internal->toyDirty && !self->internal->paused;
+  SDL_UnlockMutex(self->internal->mutex);
+
+  return result;
+}
+
+void ttoy_BackgroundRenderer_startRenderThread(
+    ttoy_BackgroundRenderer *self)
+{
+  ttoy_ErrorCode error;
+
+  error = ttoy_createSharedGLContext(
+      &self->internal->window,  /* window */
+      &self->internal->context  /* context */
+      );
+  if (error != TTOY_NO_ERROR) {
+    /* NOTE: Not a fatal error; we render the toy on the drawing thread */
+    TTOY_LOG_ERROR_CODE(error);
+    self->internal->context = NULL;
+    return;
+  }
+  self->internal->thread = SDL_CreateThread(
+      (SDL_ThreadFunction)ttoy_BackgroundRenderer_renderThread,  /* fn */
+      "ttoy_BackgroundRenderer_renderThread",  /* name */
+      (void *)self  /* data */
+      );
+  if (self->internal->thread == NULL) {
+    TTOY_LOG_ERROR("Failed to create background toy thread: %s",
+        SDL_GetError());
+    SDL_GL_DeleteContext(self->internal->context);
+    self->internal->context = NULL;
+  }
+}
+
+int ttoy_BackgroundRenderer_renderThread(
+    ttoy_BackgroundRenderer *self)
+{
+  ttoy_BackgroundRenderer_Buffer *buffer;
+  SDL_Event event;
+  GLsync readFence, writeFence;
+  int back, viewportWidth, viewportHeight;
+
+  SDL_GL_MakeCurrent(self->internal->window, self->internal->context);
+
+  SDL_LockMutex(self->internal->mutex);
+  while (1) {
+    /* Render into the buffer that is not the newest frame, once that frame
+     * has been composited and the compositor is done with the buffer. The toy
+     * thus animates at its own pace, but never faster than we draw, nor
+     * faster than the update rate that the governor allows, and not at all
+     * while its newest frame is still current. */
+    back = self->internal->front == 0 ? 1 : 0;
+    while (!self->internal->quit
+        && (self->internal->framesComposited < self->internal->interval
+          || self->internal->reading == back
+          || !ttoy_BackgroundRenderer_needsUpdate(self,
+            self->internal->front >= 0
+              ? &self->internal->buffers[self->internal->front]
+              : NULL,  /* newest */
+            self->internal->viewportWidth,  /* viewportWidth */
+            self->internal->viewportHeight  /* viewportHeight */
+            )))
+    {
+      SDL_CondWait(self->internal->cond, self->internal->mutex);
+    }
+    if (self->internal->quit)
+      break;
+    self->internal->framesComposited = 0;
+    buffer = &self->internal->buffers[back];
+    viewportWidth = self->internal->viewportWidth;
+    viewportHeight = self->internal->viewportHeight;
+    readFence = buffer->readFence;
+    buffer->readFence = NULL;
+    SDL_UnlockMutex(self->internal->mutex);
+
+    if (readFence != NULL) {
+      glWaitSync(readFence, 0, GL_TIMEOUT_IGNORED);
+      ASSERT_GL_ERROR();
+      glDeleteSync(readFence);
+      ASSERT_GL_ERROR();
+    }
+    ttoy_BackgroundRenderer_updateToy(self,
+        buffer,  /* buffer */
         viewportWidth,  /* viewportWidth */
         viewportHeight  /* viewportHeight */
         );
-    /* Clear the framebuffer binding */
+    writeFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    ASSERT_GL_ERROR();
+    glFlush();
+    ASSERT_GL_ERROR();
+    ttoy_checkGLFrameErrors();
+
+    /* Publish the new frame */
+    SDL_LockMutex(self->internal->mutex);
+    if (buffer->writeFence != NULL) {
+      /* The previous frame in this buffer was never composited */
+      glDeleteSync(buffer->writeFence);
+      ASSERT_GL_ERROR();
+    }
+    buffer->writeFence = writeFence;
+    self->internal->front = back;
+
+    /* Wake the main loop, which might be waiting for events if it thought
+     * that the background was not changing */
+    if (SDL_PeepEvents(
+          &event,  /* events */
+          1,  /* numevents */
+          SDL_PEEKEVENT,  /* action */
+          ttoy_BackgroundRenderer_eventType(),  /* minType */
+          ttoy_BackgroundRenderer_eventType()  /* maxType */
+          ) < 1)
+    {
+      memset(&event, 0, sizeof(event));
+      event.type = ttoy_BackgroundRenderer_eventType();
+      event.user.data1 = self;
+      if (SDL_PushEvent(&event) < 0) {
+        TTOY_LOG_ERROR("Failed to push background event to SDL: %s",
+            SDL_GetError());
+      }
+    }
+  }
+  SDL_UnlockMutex(self->internal->mutex);
+
+  ttoy_BackgroundRenderer_destroyToyObjects(self);
+  SDL_GL_MakeCurrent(self->internal->window, NULL);
+
+  return 0;
+}
+
+void ttoy_BackgroundRenderer_updateToy(
+    ttoy_BackgroundRenderer *self,
+    ttoy_BackgroundRenderer_Buffer *buffer,
+    int viewportWidth,
+    int viewportHeight)
+{
+  if (!self->internal->initializedToyObjects) {
+    ttoy_BackgroundRenderer_initToyObjects(self);
+  }
+  if (buffer != NULL) {
+    ttoy_BackgroundRenderer_resizeBuffer(self,
+        buffer,  /* buffer */
+        viewportWidth,  /* width */
+        viewportHeight  /* height */
+        );
+  }
+
+  /* Free any render targets that have gone unused since a resize */
+  ttoy_RenderTargetPool_collect(&self->internal->renderTargetPool);
+
+  /* Adjust the quality of the toy to the GPU time it has been taking */
+  ttoy_BackgroundRenderer_readTimerQueries(self);
+
+  /* Render the background toy to the buffer */
+  ttoy_BackgroundRenderer_drawToy(self,
+      buffer,  /* buffer */
+      viewportWidth,  /* viewportWidth */
+      viewportHeight  /* viewportHeight */
+      );
+}
+
+void ttoy_BackgroundRenderer_drawToy(
+    ttoy_BackgroundRenderer *self,
+    ttoy_BackgroundRenderer_Buffer *buffer,
+    int viewportWidth,
+    int viewportHeight)
+{
+  GLuint query;
+  int width, height;
+
+  if (buffer == NULL) {
+    /* Draw the toy directly to the current framebuffer, on top of which the
+     * text is drawn. We leave the depth buffer alone for the text. */
+    width = viewportWidth;
+    height = viewportHeight;
+    glDisable(GL_DEPTH_TEST);
+    ASSERT_GL_ERROR();
+  } else {
+    width = (int)(buffer->target->width * self->internal->scale);
+    height = (int)(buffer->target->height * self->internal->scale);
+    if (width < 1)
+      width = 1;
+    if (height < 1)
+      height = 1;
+
     glBindFramebuffer(
         GL_DRAW_FRAMEBUFFER,  /* target */
-        0  /* framebuffer */
+        buffer->target->framebuffer  /* framebuffer */
         );
-    FORCE_ASSERT_GL_ERROR();
-    /* Draw the rendered shader texture on a quad that fills the screen */
-    ttoy_BackgroundRenderer_drawBackgroundTexture(self);
+    ASSERT_GL_ERROR();
+    glViewport(0, 0, width, height);
+    ASSERT_GL_ERROR();
   }
-  /* TODO: Without a background toy, what should we do really? We need to draw
-   * a solid color. */
+
+  /* Time the toy on the GPU, if we have a query available */
+  query = 0;
+  if (self->internal->numPendingQueries
+      < TTOY_BACKGROUND_RENDERER_NUM_QUERIES)
+  {
+    query = self->internal->timerQueries[self->internal->nextQuery];
+    glBeginQuery(
+        GL_TIME_ELAPSED,  /* target */
+        query  /* id */
+        );
+    ASSERT_GL_ERROR();
+  }
+  ttoy_BackgroundToy_draw(self->internal->backgroundToy,
+      width,  /* viewportWidth */
+      height  /* viewportHeight */
+      );
+  if (query != 0) {
+    glEndQuery(
+        GL_TIME_ELAPSED  /* target */
+        );
+    ASSERT_GL_ERROR();
+    self->internal->nextQuery = (self->internal->nextQuery + 1)
+      % TTOY_BACKGROUND_RENDERER_NUM_QUERIES;
+    self->internal->numPendingQueries += 1;
+  }
+  if (buffer == NULL) {
+    /* Restore the depth test */
+    glEnable(GL_DEPTH_TEST);
+    ASSERT_GL_ERROR();
+    return;
+  }
+  buffer->toyWidth = width;
+  buffer->toyHeight = height;
+
+  /* Restore the framebuffer binding and viewport */
+  glBindFramebuffer(
+      GL_DRAW_FRAMEBUFFER,  /* target */
+      0  /* framebuffer */
+      );
+  ASSERT_GL_ERROR();
+  glViewport(0, 0, viewportWidth, viewportHeight);
+  ASSERT_GL_ERROR();
+}
+
+int ttoy_BackgroundRenderer_needsUpdate(
+    ttoy_BackgroundRenderer *self,
+    const ttoy_BackgroundRenderer_Buffer *newest,
+    int viewportWidth,
+    int viewportHeight)
+{
+  /* NOTE: This is called on the thread that renders the toy, with the mutex
+   * held if that is not the thread calling draw(). We ask the toy whether it
+   * is dirty every time, so that a paused or static toy notices changes such
+   * as a rebuilt shader. */
+  self->internal->toyDirty = ttoy_BackgroundToy_isDirty(
+      self->internal->backgroundToy);
+
+  if (newest == NULL
+      || newest->target == NULL
+      || newest->target->width != viewportWidth
+      || newest->target->height != viewportHeight)
+  {
+    /* The toy must render at least once for the current viewport */
+    return 1;
+  }
+  return self->internal->toyDirty && !self->internal->paused;
+}
+
+void ttoy_BackgroundRenderer_readTimerQueries(
+    ttoy_BackgroundRenderer *self)
+{
+  GLuint query, available;
+  GLuint64 elapsed;
+  float toyTime;
+  int oldest;
+
+  /* Read back the results of timer queries that the GPU has finished with,
+   * oldest first */
+  while (self->internal->numPendingQueries > 0) {
+    oldest = (self->internal->nextQuery
+        - self->internal->numPendingQueries
+        + TTOY_BACKGROUND_RENDERER_NUM_QUERIES)
+      % TTOY_BACKGROUND_RENDERER_NUM_QUERIES;
+    query = self->internal->timerQueries[oldest];
+    glGetQueryObjectuiv(
+        query,  /* id */
+        GL_QUERY_RESULT_AVAILABLE,  /* pname */
+        &available  /* params */
+        );
+    ASSERT_GL_ERROR();
+    if (!available)
+      break;
+    glGetQueryObjectui64v(
+        query,  /* id */
+        GL_QUERY_RESULT,  /* pname */
+        &elapsed  /* params */
+        );
+    ASSERT_GL_ERROR();
+    self->internal->numPendingQueries -= 1;
+
+    if (self->internal->settleSamples > 0) {
+      self->internal->settleSamples -= 1;
+      if (self->internal->settleSamples
+          >= TTOY_BACKGROUND_RENDERER_SETTLE_SAMPLES
+             - TTOY_BACKGROUND_RENDERER_NUM_QUERIES)
+      {
+        /* This query might have been issued before the quality last
+         * changed, or might include the driver compiling the toy's shaders
+         * on its first draw */
+        continue;
+      }
+    }
+
+    /* Smooth out the timings, since a single slow frame should not cost the
+     * toy its quality */
+    toyTime = (float)elapsed * 1.0e-6f;
+    if (self->internal->toyTime == 0.0f) {
+      self->internal->toyTime = toyTime;
+    } else {
+      self->internal->toyTime =
+        0.8f * self->internal->toyTime + 0.2f * toyTime;
+    }
+    if (self->internal->settleSamples == 0) {
+      ttoy_BackgroundRenderer_adjustQuality(self);
+    }
+  }
+}
+
+void ttoy_BackgroundRenderer_adjustQuality(
+    ttoy_BackgroundRenderer *self)
+{
+  float frameTime, budget, scale;
+  int interval;
+
+  /* This runs on the thread that renders the toy, which is the only one to
+   * change the scale and interval, so it can read them without the lock */
+  scale = self->internal->scale;
+  interval = self->internal->interval;
+
+  /* The GPU time the toy takes per frame, averaged over the frames where we
+   * skip updating it */
+  frameTime = self->internal->toyTime / (float)interval;
+  budget = self->internal->budget;
+
+  if (frameTime > budget) {
+    if (scale > TTOY_BACKGROUND_RENDERER_MIN_SCALE) {
+      /* Lower the resolution first. GPU time grows with the number of
+       * pixels, so aim for the resolution that fits within the budget. */
+      scale = self->internal->scale * sqrtf(0.9f * budget / frameTime);
+      if (scale > 0.9f * self->internal->scale)
+        scale = 0.9f * self->internal->scale;
+      if (scale < TTOY_BACKGROUND_RENDERER_MIN_SCALE)
+        scale = TTOY_BACKGROUND_RENDERER_MIN_SCALE;
+    } else if (interval < TTOY_BACKGROUND_RENDERER_MAX_INTERVAL) {
+      /* Then lower the update rate */
+      interval += 1;
+    } else {
+      /* There is nothing more that we can do */
+      return;
+    }
+  } else if (frameTime < 0.5f * budget) {
+    /* We have headroom; recover the update rate first, then the resolution,
+     * in steps small enough to stay within the budget */
+    if (interval > 1) {
+      interval -= 1;
+    } else if (scale < 1.0f) {
+      scale *= 1.1f;
+      if (scale > 1.0f)
+        scale = 1.0f;
+    } else {
+      return;
+    }
+  } else {
+    return;
+  }
+
+  /* Publish the new quality to the thread calling draw() */
+  SDL_LockMutex(self->internal->mutex);
+  self->internal->scale = scale;
+  self->internal->interval = interval;
+  SDL_UnlockMutex(self->internal->mutex);
+
+  /* Start timing the toy afresh at its new quality before adjusting it
+   * again */
+  self->internal->toyTime = 0.0f;
+  self->internal->settleSamples = TTOY_BACKGROUND_RENDERER_SETTLE_SAMPLES;
 }
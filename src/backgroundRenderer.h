@@ -26,6 +26,17 @@
 
 #include "profile.h"
 
+/* The lowest fraction of the viewport resolution that background toys are
+ * rendered at before their update rate is lowered instead */
+#define TTOY_BACKGROUND_RENDERER_MIN_SCALE 0.25f
+/* Background toys are updated at least once every this many frames */
+#define TTOY_BACKGROUND_RENDERER_MAX_INTERVAL 4
+/* Number of GL timer queries that can be in flight at once */
+#define TTOY_BACKGROUND_RENDERER_NUM_QUERIES 4
+/* Number of timings to collect after changing the quality of a background
+ * toy, before changing it again */
+#define TTOY_BACKGROUND_RENDERER_SETTLE_SAMPLES 8
+
 struct ttoy_BackgroundRenderer_Internal_;
 typedef struct ttoy_BackgroundRenderer_Internal_ \
           ttoy_BackgroundRenderer_Internal;
@@ -46,4 +57,25 @@ void ttoy_BackgroundRenderer_draw(
     int viewportWidth,
     int viewportHeight);
 
+/**
+ * Pauses an animated background toy, e.g. while the window is hidden or
+ * unfocused. A paused toy keeps showing the last frame it rendered, and only
+ * renders again if the viewport changes size.
+ */
+void ttoy_BackgroundRenderer_setPaused(
+    ttoy_BackgroundRenderer *self,
+    int paused);
+
+/**
+ * Returns non-zero if the background changes from frame to frame, in which
+ * case it must be drawn continuously. Otherwise, the background only needs to
+ * be drawn again when the window changes, or when an event of type
+ * ttoy_BackgroundRenderer_eventType() arrives to say that the toy has
+ * rendered a new frame.
+ */
+int ttoy_BackgroundRenderer_isAnimating(
+    ttoy_BackgroundRenderer *self);
+
+int ttoy_BackgroundRenderer_eventType();
+
 #endif
@@ -68,3 +68,14 @@ void ttoy_BackgroundToy_draw(
       viewportWidth,
       viewportHeight);
 }
+
+int ttoy_BackgroundToy_isDirty(
+    ttoy_BackgroundToy *self)
+{
+  if (self->internal->dispatch->isDirty == NULL) {
+    /* Assume that the toy is animated */
+    return 1;
+  }
+  /* Call isDirty for derived class through dispatch table */
+  return self->internal->dispatch->isDirty(self);
+}
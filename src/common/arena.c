@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2016-2017 Jonathan Glines
+ * Jonathan Glines <jonathan@glines.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "arena.h"
+
+/* Enough alignment for any type we would put in an arena */
+#define TTOY_ARENA_ALIGNMENT 16
+#define TTOY_ARENA_ALIGN(size) \
+  (((size) + TTOY_ARENA_ALIGNMENT - 1) & ~(size_t)(TTOY_ARENA_ALIGNMENT - 1))
+#define TTOY_ARENA_FRAME_CHUNK_SIZE (256 * 1024)
+
+typedef struct ttoy_Arena_Chunk_ {
+  struct ttoy_Arena_Chunk_ *prev;
+  /* The number of bytes in this chunk, and the number of bytes in all of
+   * the chunks before it */
+  size_t size, base;
+} ttoy_Arena_Chunk;
+
+#define TTOY_ARENA_CHUNK_HEADER_SIZE TTOY_ARENA_ALIGN(sizeof(ttoy_Arena_Chunk))
+
+static struct {
+  ttoy_Arena arena;
+  int initialized;
+} frame;
+
+/* Private methods */
+ttoy_Arena_Chunk *ttoy_Arena_newChunk(
+    ttoy_Arena *self,
+    size_t size);
+void ttoy_Arena_freeChunks(
+    ttoy_Arena *self,
+    ttoy_Arena_Chunk *until);
+
+void ttoy_Arena_init(
+    ttoy_Arena *self,
+    size_t chunkSize)
+{
+  /* Defer allocating the first chunk until something is allocated */
+  self->chunk = NULL;
+  self->offset = 0;
+  self->peak = 0;
+  self->chunkSize = TTOY_ARENA_ALIGN(chunkSize);
+}
+
+void ttoy_Arena_destroy(
+    ttoy_Arena *self)
+{
+  ttoy_Arena_freeChunks(self, NULL);
+}
+
+ttoy_Arena_Chunk *ttoy_Arena_newChunk(
+    ttoy_Arena *self,
+    size_t size)
+{
+  ttoy_Arena_Chunk *chunk;
+
+  chunk = (ttoy_Arena_Chunk *)malloc(TTOY_ARENA_CHUNK_HEADER_SIZE + size);
+  if (chunk == NULL)
+    return NULL;
+  chunk->prev = self->chunk;
+  chunk->size = size;
+  chunk->base = self->chunk != NULL ? self->chunk->base + self->offset : 0;
+  self->chunk = chunk;
+  self->offset = 0;
+
+  return chunk;
+}
+
+void ttoy_Arena_freeChunks(
+    ttoy_Arena *self,
+    ttoy_Arena_Chunk *until)
+{
+  ttoy_Arena_Chunk *chunk;
+
+  while (self->chunk != until) {
+    chunk = self->chunk;
+    self->chunk = chunk->prev;
+    free(chunk);
+  }
+}
+
+void *ttoy_Arena_alloc(
+    ttoy_Arena *self,
+    size_t size)
+{
+  void *result;
+
+  size = TTOY_ARENA_ALIGN(size);
+  if (self->chunk == NULL || self->offset + size > self->chunk->size) {
+    /* Start a new chunk, making sure that oversized allocations fit */
+    if (ttoy_Arena_newChunk(self,
+          size > self->chunkSize ? size : self->chunkSize  /* size */
+          ) == NULL)
+    {
+      return NULL;
+    }
+  }
+
+  result = (char *)self->chunk + TTOY_ARENA_CHUNK_HEADER_SIZE + self->offset;
+  self->offset += size;
+  if (self->chunk->base + self->offset > self->peak)
+    self->peak = self->chunk->base + self->offset;
+
+  return result;
+}
+
+ttoy_ArenaMark ttoy_Arena_mark(
+    const ttoy_Arena *self)
+{
+  ttoy_ArenaMark mark;
+
+  mark.chunk = self->chunk;
+  mark.offset = self->offset;
+
+  return mark;
+}
+
+void ttoy_Arena_rewind(
+    ttoy_Arena *self,
+    ttoy_ArenaMark mark)
+{
+  if (mark.chunk == NULL
+      || (mark.chunk->prev == NULL && mark.offset == 0))
+  {
+    /* Rewinding to the start of the arena is the same as a reset, which is
+     * our chance to consolidate chunks */
+    ttoy_Arena_reset(self);
+    return;
+  }
+
+  /* Release any chunks that were started after the mark was taken */
+  ttoy_Arena_freeChunks(self, mark.chunk);
+  assert(self->chunk == mark.chunk);
+  self->offset = mark.offset;
+}
+
+void ttoy_Arena_reset(
+    ttoy_Arena *self)
+{
+  if (self->chunk != NULL && self->chunk->prev != NULL) {
+    /* We needed more than one chunk since the last reset; replace them all
+     * with a single chunk that would have held everything */
+    ttoy_Arena_freeChunks(self, NULL);
+    if (self->peak > self->chunkSize)
+      self->chunkSize = TTOY_ARENA_ALIGN(self->peak);
+    /* NOTE: If this fails, we simply allocate the chunk again later */
+    ttoy_Arena_newChunk(self,
+        self->chunkSize  /* size */
+        );
+  }
+  self->offset = 0;
+  self->peak = 0;
+}
+
+ttoy_Arena *ttoy_Arena_frame()
+{
+  if (!frame.initialized) {
+    ttoy_Arena_init(&frame.arena,
+        TTOY_ARENA_FRAME_CHUNK_SIZE  /* chunkSize */
+        );
+    frame.initialized = 1;
+  }
+
+  return &frame.arena;
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2016-2017 Jonathan Glines
+ * Jonathan Glines <jonathan@glines.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef TTOY_COMMON_ARENA_H_
+#define TTOY_COMMON_ARENA_H_
+
+#include <stddef.h>
+
+struct ttoy_Arena_Chunk_;
+
+/**
+ * A bump-pointer allocator for transient data. Allocations are carved out of
+ * large chunks and are never freed individually; instead, the whole arena is
+ * reset or rewound to a previous mark at once.
+ *
+ * When an arena outgrows its first chunk, resetting it replaces all of its
+ * chunks with a single chunk large enough for everything that was allocated,
+ * so that an arena reset once per frame or once per operation quickly settles
+ * into never calling malloc().
+ */
+typedef struct ttoy_Arena_ {
+  struct ttoy_Arena_Chunk_ *chunk;
+  size_t offset, peak, chunkSize;
+} ttoy_Arena;
+
+/**
+ * A position within an arena that the arena can later be rewound to,
+ * releasing everything allocated after the mark was taken.
+ */
+typedef struct ttoy_ArenaMark_ {
+  struct ttoy_Arena_Chunk_ *chunk;
+  size_t offset;
+} ttoy_ArenaMark;
+
+void ttoy_Arena_init(
+    ttoy_Arena *self,
+    size_t chunkSize);
+
+void ttoy_Arena_destroy(
+    ttoy_Arena *self);
+
+/**
+ * Allocates the given number of bytes from the arena, aligned for any type.
+ * Returns NULL if the memory could not be allocated.
+ */
+void *ttoy_Arena_alloc(
+    ttoy_Arena *self,
+    size_t size);
+
+ttoy_ArenaMark ttoy_Arena_mark(
+    const ttoy_Arena *self);
+
+void ttoy_Arena_rewind(
+    ttoy_Arena *self,
+    ttoy_ArenaMark mark);
+
+void ttoy_Arena_reset(
+    ttoy_Arena *self);
+
+/**
+ * Returns the arena for data that lives no longer than the frame being
+ * drawn. The frame arena belongs to the main thread, which resets it once
+ * per frame.
+ */
+ttoy_Arena *ttoy_Arena_frame();
+
+#endif
@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2016-2017 Jonathan Glines
+ * Jonathan Glines <jonathan@glines.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../logging.h"
+#include "mkdir.h"
+
+#include "cacheDir.h"
+
+ttoy_ErrorCode
+ttoy_getCacheDir(
+    const char *subdir,
+    char **path)
+{
+  const char *cacheHome, *home, *cacheRel;
+  ttoy_ErrorCode error;
+  char *dir;
+  int len;
+
+  /* The XDG base directory specification says relative paths in
+   * XDG_CACHE_HOME are invalid and should be ignored */
+  cacheHome = getenv("XDG_CACHE_HOME");
+  if (cacheHome != NULL && cacheHome[0] == '/') {
+    cacheRel = "ttoy";
+  } else {
+    home = getenv("HOME");
+    if (home == NULL) {
+      TTOY_LOG_ERROR("%s",
+          "Neither XDG_CACHE_HOME nor HOME are set");
+      return TTOY_ERROR_CACHE_DIRECTORY_NOT_FOUND;
+    }
+    cacheHome = home;
+    cacheRel = ".cache/ttoy";
+  }
+
+  /* Build the path to the cache subdirectory */
+  len = snprintf(NULL, 0, "%s/%s/%s", cacheHome, cacheRel, subdir);
+  dir = (char *)malloc(len + 1);
+  if (dir == NULL) {
+    return TTOY_ERROR_OUT_OF_MEMORY;
+  }
+  sprintf(dir, "%s/%s/%s", cacheHome, cacheRel, subdir);
+  /* Make sure the cache subdirectory exists, along with XDG_CACHE_HOME
+   * itself which might not have been created yet */
+  if (dir[0] == '/') {
+    error = ttoy_mkdir("", dir + 1);
+  } else {
+    error = ttoy_mkdir(".", dir);
+  }
+  if (error != TTOY_NO_ERROR) {
+    free(dir);
+    return error;
+  }
+
+  *path = dir;
+
+  return TTOY_NO_ERROR;
+}
+
+ttoy_ErrorCode
+ttoy_createCacheFile(
+    const char *path,
+    FILE **fp,
+    char **tempPath)
+{
+  char *temp;
+  int len, fd;
+
+  /* Several threads of one process may store the same cache entry at once,
+   * so the temporary name must be unique within the process as well */
+  len = snprintf(NULL, 0, "%s.XXXXXX", path);
+  temp = (char *)malloc(len + 1);
+  if (temp == NULL) {
+    return TTOY_ERROR_OUT_OF_MEMORY;
+  }
+  sprintf(temp, "%s.XXXXXX", path);
+  fd = mkstemp(temp);
+  if (fd < 0) {
+    TTOY_LOG_ERROR("Failed to create temporary file for '%s': %s",
+        path,
+        strerror(errno));
+    free(temp);
+    return TTOY_ERROR_CACHE_WRITE_FAILED;
+  }
+  *fp = fdopen(fd, "wb");
+  if (*fp == NULL) {
+    TTOY_LOG_ERROR("Failed to open '%s' for writing: %s",
+        temp,
+        strerror(errno));
+    close(fd);
+    unlink(temp);
+    free(temp);
+    return TTOY_ERROR_CACHE_WRITE_FAILED;
+  }
+
+  *tempPath = temp;
+
+  return TTOY_NO_ERROR;
+}
+
+ttoy_ErrorCode
+ttoy_replaceCacheFile(
+    const char *path,
+    FILE *fp,
+    char *tempPath)
+{
+  ttoy_ErrorCode error;
+
+  error = TTOY_ERROR_CACHE_WRITE_FAILED;
+  /* NOTE: Short writes set the error indicator of the stream */
+  if (ferror(fp) | fclose(fp)) {
+    TTOY_LOG_ERROR("Failed to write cache file '%s'",
+        tempPath);
+    goto replaceCacheFile_cleanup;
+  }
+  if (rename(tempPath, path) < 0) {
+    TTOY_LOG_ERROR("Failed to rename '%s' to '%s': %s",
+        tempPath,
+        path,
+        strerror(errno));
+    goto replaceCacheFile_cleanup;
+  }
+  free(tempPath);
+
+  return TTOY_NO_ERROR;
+
+replaceCacheFile_cleanup:
+  unlink(tempPath);
+  free(tempPath);
+  return error;
+}
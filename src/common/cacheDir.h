@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2016-2017 Jonathan Glines
+ * Jonathan Glines <jonathan@glines.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef TTOY_COMMON_CACHE_DIR_H_
+#define TTOY_COMMON_CACHE_DIR_H_
+
+#include <stdio.h>
+
+#include <ttoy/error.h>
+
+/**
+ * Determines the path to the given subdirectory of the ttoy cache directory,
+ * creating any directories along the way.
+ *
+ * The ttoy cache directory is "$XDG_CACHE_HOME/ttoy", falling back to
+ * "$HOME/.cache/ttoy" when XDG_CACHE_HOME is not set. The resulting path is
+ * allocated with malloc(3) and must be freed by the caller.
+ */
+ttoy_ErrorCode
+ttoy_getCacheDir(
+    const char *subdir,
+    char **path);
+
+/**
+ * Opens a new, uniquely named temporary file next to the cache file at the
+ * given path, for writing a replacement of the cache file. The temporary file
+ * is put into place with ttoy_replaceCacheFile(), so that no reader, in this
+ * or any other ttoy process, ever sees a partially written cache file.
+ *
+ * The temporary path is allocated with malloc(3) and is freed by
+ * ttoy_replaceCacheFile().
+ */
+ttoy_ErrorCode
+ttoy_createCacheFile(
+    const char *path,
+    FILE **fp,
+    char **tempPath);
+
+/**
+ * Closes a temporary file opened with ttoy_createCacheFile() and renames it
+ * over the cache file at the given path. If anything failed while writing
+ * the temporary file, it is removed instead and the cache file is left alone.
+ */
+ttoy_ErrorCode
+ttoy_replaceCacheFile(
+    const char *path,
+    FILE *fp,
+    char *tempPath);
+
+#endif
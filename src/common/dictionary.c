@@ -22,23 +22,50 @@
  */
 
 #include <assert.h>
+#include <inttypes.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "hash.h"
+
 #include "dictionary.h"
 
+/* NOTE: Pairs are stored densely in insertion order, which is the order of
+ * ttoy_Dictionary_getValueAtIndex(). Keys are looked up through a separate
+ * open-addressing table of slots, probed linearly. Each slot holds the hash
+ * of its key alongside the index of its pair, so that a probe only touches
+ * the key string of a pair whose hash matches. */
 typedef struct ttoy_Dictionary_KeyValuePair_ {
   const char *key;
   void *value;
 } ttoy_Dictionary_KeyValuePair;
 
+typedef struct ttoy_Dictionary_Slot_ {
+  uint32_t hash;
+  uint32_t index;  /* One more than the index of the pair; zero if empty */
+} ttoy_Dictionary_Slot;
+
 struct ttoy_Dictionary_Internal_ {
   ttoy_Dictionary_KeyValuePair *pairs;
   size_t sizePairs, numPairs;
+  ttoy_Dictionary_Slot *slots;
+  size_t numSlots;  /* Always a power of two */
 };
 
 #define INIT_DICTIONARY_SIZE 8
 
+/* Private methods */
+uint32_t ttoy_Dictionary_hashKey(
+    const char *key);
+
+ttoy_Dictionary_Slot *ttoy_Dictionary_findSlot(
+    ttoy_Dictionary *self,
+    const char *key,
+    uint32_t hash);
+
+int ttoy_Dictionary_growSlots(
+    ttoy_Dictionary *self);
+
 void ttoy_Dictionary_init(
     ttoy_Dictionary *self)
 {
@@ -49,6 +76,9 @@ void ttoy_Dictionary_init(
       sizeof(ttoy_Dictionary_KeyValuePair) * INIT_DICTIONARY_SIZE);
   self->internal->sizePairs = INIT_DICTIONARY_SIZE;
   self->internal->numPairs = 0;
+  self->internal->slots = (ttoy_Dictionary_Slot *)calloc(
+      INIT_DICTIONARY_SIZE * 2, sizeof(ttoy_Dictionary_Slot));
+  self->internal->numSlots = INIT_DICTIONARY_SIZE * 2;
 }
 
 void ttoy_Dictionary_destroy(
@@ -60,14 +90,72 @@ void ttoy_Dictionary_destroy(
   }
   /* Free allocated memory */
   free(self->internal->pairs);
+  free(self->internal->slots);
   free(self->internal);
 }
 
-int comp_keyValuePair(
-    const ttoy_Dictionary_KeyValuePair *a,
-    const ttoy_Dictionary_KeyValuePair *b)
+uint32_t ttoy_Dictionary_hashKey(
+    const char *key)
+{
+  uint64_t hash;
+
+  hash = ttoy_hashString(TTOY_HASH_INIT, key);
+  /* Fold the upper bits in, since slots are chosen by the lower bits */
+  return (uint32_t)(hash ^ (hash >> 32));
+}
+
+ttoy_Dictionary_Slot *ttoy_Dictionary_findSlot(
+    ttoy_Dictionary *self,
+    const char *key,
+    uint32_t hash)
+{
+  ttoy_Dictionary_Slot *slot;
+  size_t mask, i;
+
+  /* Probe until we find the slot with the given key, or an empty slot where
+   * the key would be inserted. Our load factor keeps at least one slot
+   * empty, so this terminates. */
+  mask = self->internal->numSlots - 1;
+  for (i = hash & mask; ; i = (i + 1) & mask) {
+    slot = &self->internal->slots[i];
+    if (slot->index == 0) {
+      return slot;
+    }
+    if (slot->hash == hash
+        && strcmp(key, self->internal->pairs[slot->index - 1].key) == 0)
+    {
+      return slot;
+    }
+  }
+}
+
+int ttoy_Dictionary_growSlots(
+    ttoy_Dictionary *self)
 {
-  return strcmp(a->key, b->key);
+  ttoy_Dictionary_Slot *slots, *slot;
+  size_t numSlots, mask, i;
+
+  /* Double the number of slots and re-insert every pair, using the hashes
+   * stored in the old slots so that no keys are hashed again */
+  numSlots = self->internal->numSlots * 2;
+  slots = (ttoy_Dictionary_Slot *)calloc(
+      numSlots, sizeof(ttoy_Dictionary_Slot));
+  if (slots == NULL) {
+    return 0;
+  }
+  mask = numSlots - 1;
+  for (size_t j = 0; j < self->internal->numSlots; ++j) {
+    slot = &self->internal->slots[j];
+    if (slot->index == 0) {
+      continue;
+    }
+    for (i = slot->hash & mask; slots[i].index != 0; i = (i + 1) & mask);
+    slots[i] = *slot;
+  }
+  free(self->internal->slots);
+  self->internal->slots = slots;
+  self->internal->numSlots = numSlots;
+  return 1;
 }
 
 void ttoy_Dictionary_insert(
@@ -76,9 +164,20 @@ void ttoy_Dictionary_insert(
     void *value)
 {
   ttoy_Dictionary_KeyValuePair *pair;
+  ttoy_Dictionary_Slot *slot;
+  uint32_t hash;
+
+  /* Keep the table at most three quarters full, so that probes stay short */
+  if ((self->internal->numPairs + 1) * 4 > self->internal->numSlots * 3) {
+    if (!ttoy_Dictionary_growSlots(self)) {
+      return;
+    }
+  }
 
   /* Check for an existing pair with the given key */
-  if (ttoy_Dictionary_getValue(self, key) != NULL) {
+  hash = ttoy_Dictionary_hashKey(key);
+  slot = ttoy_Dictionary_findSlot(self, key, hash);
+  if (slot->index != 0) {
     /* TODO: Maybe we should return an error code here? */
     return;
   }
@@ -86,13 +185,12 @@ void ttoy_Dictionary_insert(
   /* Ensure we have enough memory allocated to insert this pair */
   if (self->internal->numPairs + 1 > self->internal->sizePairs) {
     ttoy_Dictionary_KeyValuePair *newPairs;
-    newPairs = (ttoy_Dictionary_KeyValuePair *)malloc(
+    newPairs = (ttoy_Dictionary_KeyValuePair *)realloc(
+        self->internal->pairs,
         sizeof(ttoy_Dictionary_KeyValuePair) * self->internal->sizePairs * 2);
-    memcpy(
-        newPairs,
-        self->internal->pairs, 
-        sizeof(ttoy_Dictionary_KeyValuePair) * self->internal->numPairs);
-    free(self->internal->pairs);
+    if (newPairs == NULL) {
+      return;
+    }
     self->internal->pairs = newPairs;
     self->internal->sizePairs *= 2;
   }
@@ -104,49 +202,25 @@ void ttoy_Dictionary_insert(
    * especially JSON config files) */
   pair->key = (const char *)malloc(strlen(key) + 1);
   strcpy((char *)pair->key, key);
-
-  /* Sort the key value pairs by key */
-  qsort(
-      self->internal->pairs,  /* ptr */
-      self->internal->numPairs,  /* count */
-      sizeof(ttoy_Dictionary_KeyValuePair),  /* size */
-      (int (*)(const void *, const void *))comp_keyValuePair  /* comp */
-      );
+  slot->hash = hash;
+  slot->index = self->internal->numPairs;
 }
 
 void *ttoy_Dictionary_getValue(
     ttoy_Dictionary *self,
     const char *key)
 {
-  int a, b, i;
-  if (self->internal->numPairs == 0) {
+  ttoy_Dictionary_Slot *slot;
+
+  slot = ttoy_Dictionary_findSlot(self,
+      key,  /* key */
+      ttoy_Dictionary_hashKey(key)  /* hash */
+      );
+  if (slot->index == 0) {
+    /* Key value pair with the given key was not found */
     return NULL;
   }
-  /* Binary search for the key value pair with the given key */
-  a = 0; b = self->internal->numPairs;
-  while (b - a > 0) {
-    int result;
-    i = (b - a) / 2 + a;
-    result = strcmp(key, self->internal->pairs[i].key);
-    if (result < 0) {
-      b = i;
-    } else if (result > 0) {
-      i = a + 1;
-    } else {
-      /* result == 0 */
-      return self->internal->pairs[i].value;
-    }
-  }
-  /* Scan for the key value pair with the given key */
-  for (i = a; i < b; ++i) {
-    int result;
-    result = strcmp(key, self->internal->pairs[i].key);
-    if (result == 0) {
-      return self->internal->pairs[i].value;
-    }
-  }
-  /* Key value pair with the given key was not found */
-  return NULL;
+  return self->internal->pairs[slot->index - 1].value;
 }
 
 size_t ttoy_Dictionary_size(
@@ -51,6 +51,9 @@ void *ttoy_Dictionary_getValue(
 size_t ttoy_Dictionary_size(
     ttoy_Dictionary *self);
 
+/**
+ * Pairs are indexed in the order that they were inserted.
+ */
 void *ttoy_Dictionary_getValueAtIndex(
     ttoy_Dictionary *self,
     size_t index);
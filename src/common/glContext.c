@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2016-2017 Jonathan Glines
+ * Jonathan Glines <jonathan@glines.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <SDL.h>
+
+#include "../logging.h"
+#include "glError.h"
+
+#include "glContext.h"
+
+ttoy_ErrorCode
+ttoy_createSharedGLContext(
+    SDL_Window **window,
+    SDL_GLContext *context)
+{
+  SDL_GLContext currentContext;
+#if TTOY_CHECK_GL_ERRORS
+  int flags;
+#endif
+
+  *window = SDL_GL_GetCurrentWindow();
+  currentContext = SDL_GL_GetCurrentContext();
+  if (*window == NULL || currentContext == NULL) {
+    TTOY_LOG_ERROR("%s", "No current GL context to share objects with");
+    return TTOY_ERROR_SDL_ERROR;
+  }
+
+  /* NOTE: The new context gets the remaining SDL GL attributes (version,
+   * profile, etc.) that the current context was created with */
+  SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 1);
+#if TTOY_CHECK_GL_ERRORS
+  /* Debug contexts report more problems through KHR_debug */
+  SDL_GL_GetAttribute(SDL_GL_CONTEXT_FLAGS, &flags);
+  SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, flags | SDL_GL_CONTEXT_DEBUG_FLAG);
+#endif
+  *context = SDL_GL_CreateContext(*window);
+  SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 0);
+  if (*context == NULL) {
+    TTOY_LOG_ERROR("Failed to create shared GL context: %s",
+        SDL_GetError());
+    SDL_GL_MakeCurrent(*window, currentContext);
+    return TTOY_ERROR_SDL_ERROR;
+  }
+  /* SDL_GL_CreateContext() made the new context current on this thread;
+   * debug output is per-context state, so we ask for it here */
+  ttoy_initGLDebugOutput();
+  SDL_GL_MakeCurrent(*window, currentContext);
+
+  return TTOY_NO_ERROR;
+}
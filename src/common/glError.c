@@ -21,21 +21,122 @@
  * IN THE SOFTWARE.
  */
 
-#include <stdio.h>
+#include <string.h>
+
+#include "../logging.h"
 
 #include "glError.h"
 
+static int debugOutput;
+
+/* Private methods */
+void GLAPIENTRY ttoy_glDebugCallback(
+    GLenum source,
+    GLenum type,
+    GLuint id,
+    GLenum severity,
+    GLsizei length,
+    const GLchar *message,
+    const void *userParam);
+
 int ttoy_checkGLError(const char *file, int line) {
+  static ttoy_LogSite site;
   int result = 0;
   GLenum error;
   while ((error = glGetError()) != GL_NO_ERROR) {
-    fprintf(stderr, "GL error: '%s'\n",
+    ttoy_log(&site,
+        TTOY_LOG_LEVEL_ERROR,  /* level */
+        strrchr(file, '/') ? strrchr(file, '/') + 1 : file,  /* file */
+        line,  /* line */
+        "GL error: '%s'",  /* format */
         ttoy_glErrorToString(error));
     result = 1;
   }
+  if (result) {
+    ttoy_Logging_flush();
+  }
   return result;
 }
 
+void GLAPIENTRY ttoy_glDebugCallback(
+    GLenum source,
+    GLenum type,
+    GLuint id,
+    GLenum severity,
+    GLsizei length,
+    const GLchar *message,
+    const void *userParam)
+{
+  int level;
+
+  switch (severity) {
+    case GL_DEBUG_SEVERITY_HIGH:
+      level = TTOY_LOG_LEVEL_ERROR;
+      break;
+    case GL_DEBUG_SEVERITY_MEDIUM:
+      level = TTOY_LOG_LEVEL_WARNING;
+      break;
+    case GL_DEBUG_SEVERITY_LOW:
+      level = TTOY_LOG_LEVEL_INFO;
+      break;
+    default:
+      level = TTOY_LOG_LEVEL_DEBUG;
+  }
+  if (type == GL_DEBUG_TYPE_ERROR) {
+    level = TTOY_LOG_LEVEL_ERROR;
+  }
+  /* NOTE: In release builds this might be called from a driver thread; our
+   * logging is safe to call from any thread */
+  TTOY_LOG(level, "GL debug message 0x%x: %s", id, message);
+#if TTOY_CHECK_GL_ERRORS
+  if (type == GL_DEBUG_TYPE_ERROR) {
+    /* We asked for synchronous output, so the offending GL call is on the
+     * stack */
+    ttoy_Logging_flush();
+    assert(0);
+  }
+#endif
+}
+
+int ttoy_initGLDebugOutput() {
+  if (!GLEW_KHR_debug) {
+    debugOutput = 0;
+    return 0;
+  }
+
+  glEnable(GL_DEBUG_OUTPUT);
+#if TTOY_CHECK_GL_ERRORS
+  glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+#else
+  glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+  /* Notifications are only interesting while debugging */
+  glDebugMessageControl(
+      GL_DONT_CARE,  /* source */
+      GL_DONT_CARE,  /* type */
+      GL_DEBUG_SEVERITY_NOTIFICATION,  /* severity */
+      0,  /* count */
+      NULL,  /* ids */
+      GL_FALSE  /* enabled */
+      );
+#endif
+  glDebugMessageCallback(
+      ttoy_glDebugCallback,  /* callback */
+      NULL  /* userParam */
+      );
+  debugOutput = 1;
+
+  return 1;
+}
+
+void ttoy_checkGLFrameErrors() {
+#if !TTOY_CHECK_GL_ERRORS
+  if (!debugOutput) {
+    /* Once per frame is cheap compared to once per call */
+    FORCE_CHECK_GL_ERROR();
+  }
+#endif
+}
+
 const char *ttoy_glErrorToString(GLenum error) {
 #define TTOY_GL_E2S(error) \
   case GL_ ## error: \
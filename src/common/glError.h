@@ -28,39 +28,68 @@
 
 #include <GL/glew.h>
 
-/* Checking for errors significantly affects performance with WebGL, so we
- * disable checking when compiling with Emscripten. */
-#ifdef __EMSCRIPTEN__
-#define DISABLE_CHECK_GL_ERROR 1
+/* Calling glGetError() after every GL call can force the driver to
+ * synchronize with the GPU, so the per-call checks are only compiled into
+ * debug builds. Release builds rely on the GL reporting errors to our
+ * KHR_debug callback instead (see ttoy_initGLDebugOutput()). Checking for
+ * errors also significantly affects performance with WebGL, so we disable
+ * checking when compiling with Emscripten. */
+#ifndef TTOY_CHECK_GL_ERRORS
+#if defined(NDEBUG) || defined(__EMSCRIPTEN__)
+#define TTOY_CHECK_GL_ERRORS 0
 #else
-#define DISABLE_CHECK_GL_ERROR 0
+#define TTOY_CHECK_GL_ERRORS 1
+#endif
 #endif
 
 #define FORCE_CHECK_GL_ERROR() \
   (ttoy_checkGLError(__FILE__, __LINE__))
 
 #define FORCE_ASSERT_GL_ERROR() \
-  if (ttoy_checkGLError(__FILE__, __LINE__)) \
-    assert(0);
-
-#if DISABLE_CHECK_GL_ERROR
-
-#define CHECK_GL_ERROR() (0)
+  do { \
+    if (ttoy_checkGLError(__FILE__, __LINE__)) \
+      assert(0); \
+  } while (0)
 
-#define ASSERT_GL_ERROR() ;
-
-#else  // DISABLE_CHECK_GL_ERROR
+#if TTOY_CHECK_GL_ERRORS
 
 #define CHECK_GL_ERROR() \
   (ttoy_checkGLError(__FILE__, __LINE__))
 
 #define ASSERT_GL_ERROR() \
-  if (ttoy_checkGLError(__FILE__, __LINE__)) \
-    assert(0);
+  do { \
+    if (ttoy_checkGLError(__FILE__, __LINE__)) \
+      assert(0); \
+  } while (0)
+
+#else  // TTOY_CHECK_GL_ERRORS
+
+#define CHECK_GL_ERROR() (0)
+
+#define ASSERT_GL_ERROR() do { } while (0)
 
-#endif  // DISABLE_CHECK_GL_ERROR
+#endif  // TTOY_CHECK_GL_ERRORS
 
 int ttoy_checkGLError(const char *file, int line);
 const char *ttoy_glErrorToString(GLenum error);
 
+/**
+ * Asks the GL of the current context to report errors and other debug
+ * messages to our log through KHR_debug. Debug builds receive messages
+ * synchronously, so that an assertion failure points to the offending call;
+ * release builds receive them asynchronously, which costs nothing until
+ * something goes wrong.
+ *
+ * Returns zero if KHR_debug is not available, in which case errors are only
+ * noticed by ttoy_checkGLFrameErrors().
+ */
+int ttoy_initGLDebugOutput();
+
+/**
+ * Checks for GL errors once per frame when neither per-call checks nor a
+ * KHR_debug callback would catch them. Since GL errors are per-context, each
+ * thread with a GL context calls this after its own unit of work.
+ */
+void ttoy_checkGLFrameErrors();
+
 #endif
@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2016-2017 Jonathan Glines
+ * Jonathan Glines <jonathan@glines.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <string.h>
+
+#include "hash.h"
+
+#define FNV_PRIME ((uint64_t)0x100000001b3ULL)
+
+uint64_t
+ttoy_hash(
+    uint64_t hash,
+    const void *data,
+    size_t size)
+{
+  const uint8_t *bytes = (const uint8_t *)data;
+
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= (uint64_t)bytes[i];
+    hash *= FNV_PRIME;
+  }
+
+  return hash;
+}
+
+uint64_t
+ttoy_hashString(
+    uint64_t hash,
+    const char *str)
+{
+  if (str == NULL) {
+    str = "";
+  }
+  return ttoy_hash(hash, str, strlen(str) + 1);
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2016-2017 Jonathan Glines
+ * Jonathan Glines <jonathan@glines.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef TTOY_COMMON_HASH_H_
+#define TTOY_COMMON_HASH_H_
+
+#include <inttypes.h>
+#include <stddef.h>
+
+/* Initial value for the 64-bit FNV-1a hash function */
+#define TTOY_HASH_INIT ((uint64_t)0xcbf29ce484222325ULL)
+
+/**
+ * Continues the 64-bit FNV-1a hash given in \p hash over \p size bytes of
+ * \p data. Start a new hash by passing TTOY_HASH_INIT.
+ *
+ * This hash is used for cache keys; it is fast and well-distributed, but it is
+ * not suitable for anything security-related.
+ */
+uint64_t
+ttoy_hash(
+    uint64_t hash,
+    const void *data,
+    size_t size);
+
+/**
+ * Continues the hash given in \p hash over the given null-terminated string,
+ * including the terminating null byte so that consecutive strings hash
+ * differently than their concatenation.
+ */
+uint64_t
+ttoy_hashString(
+    uint64_t hash,
+    const char *str);
+
+#endif
@@ -0,0 +1,360 @@
+/*
+ * Copyright (c) 2016-2017 Jonathan Glines
+ * Jonathan Glines <jonathan@glines.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "glError.h"
+
+#include "renderTargetPool.h"
+
+struct ttoy_RenderTargetPool_Internal_ {
+  /* Singly linked lists of the targets that are in use and those that are
+   * waiting to be used again */
+  ttoy_RenderTarget *acquired, *released;
+};
+
+/* Private methods */
+int ttoy_RenderTargetPool_allocationSize(
+    int size);
+
+ttoy_ErrorCode
+ttoy_RenderTargetPool_createTarget(
+    ttoy_RenderTargetPool *self,
+    int textureWidth,
+    int textureHeight,
+    GLenum internalFormat,
+    ttoy_RenderTarget **target);
+
+void ttoy_RenderTargetPool_deleteTarget(
+    ttoy_RenderTargetPool *self,
+    ttoy_RenderTarget *target);
+
+void ttoy_RenderTargetPool_init(
+    ttoy_RenderTargetPool *self)
+{
+  /* Allocate memory for internal structures */
+  self->internal = (ttoy_RenderTargetPool_Internal *)malloc(
+      sizeof(ttoy_RenderTargetPool_Internal));
+  self->internal->acquired = NULL;
+  self->internal->released = NULL;
+}
+
+void ttoy_RenderTargetPool_destroy(
+    ttoy_RenderTargetPool *self)
+{
+  ttoy_RenderTarget *target, *next;
+
+  for (target = self->internal->acquired; target != NULL; target = next) {
+    next = target->next;
+    ttoy_RenderTargetPool_deleteTarget(self, target);
+  }
+  for (target = self->internal->released; target != NULL; target = next) {
+    next = target->next;
+    ttoy_RenderTargetPool_deleteTarget(self, target);
+  }
+  /* Free memory from internal structures */
+  free(self->internal);
+}
+
+int ttoy_RenderTargetPool_allocationSize(
+    int size)
+{
+  int result;
+
+  /* Round up to the next power of two, so that a target only needs to be
+   * reallocated when its size doubles or halves */
+  result = TTOY_RENDER_TARGET_POOL_MIN_SIZE;
+  while (result < size) {
+    result *= 2;
+  }
+  return result;
+}
+
+ttoy_ErrorCode
+ttoy_RenderTargetPool_acquire(
+    ttoy_RenderTargetPool *self,
+    int width,
+    int height,
+    GLenum internalFormat,
+    ttoy_RenderTarget **target)
+{
+  ttoy_RenderTarget **prev, *current;
+  ttoy_ErrorCode error;
+  int textureWidth, textureHeight;
+
+  if (width < 1)
+    width = 1;
+  if (height < 1)
+    height = 1;
+  textureWidth = ttoy_RenderTargetPool_allocationSize(width);
+  textureHeight = ttoy_RenderTargetPool_allocationSize(height);
+
+  /* Look for a released target of the same size and format */
+  for (prev = &self->internal->released, current = *prev;
+      current != NULL;
+      prev = &current->next, current = *prev)
+  {
+    if (current->textureWidth == textureWidth
+        && current->textureHeight == textureHeight
+        && current->internalFormat == internalFormat)
+    {
+      *prev = current->next;
+      break;
+    }
+  }
+
+  if (current == NULL) {
+    /* Create a new target */
+    error = ttoy_RenderTargetPool_createTarget(self,
+        textureWidth,  /* textureWidth */
+        textureHeight,  /* textureHeight */
+        internalFormat,  /* internalFormat */
+        &current  /* target */
+        );
+    if (error != TTOY_NO_ERROR) {
+      return error;
+    }
+  }
+
+  current->width = width;
+  current->height = height;
+  current->idle = 0;
+  current->next = self->internal->acquired;
+  self->internal->acquired = current;
+  *target = current;
+
+  return TTOY_NO_ERROR;
+}
+
+void ttoy_RenderTargetPool_release(
+    ttoy_RenderTargetPool *self,
+    ttoy_RenderTarget *target)
+{
+  ttoy_RenderTarget **prev;
+
+  /* Move the target from our acquired list to our released list */
+  for (prev = &self->internal->acquired;
+      *prev != target;
+      prev = &(*prev)->next)
+  {
+    assert(*prev != NULL);
+  }
+  *prev = target->next;
+  target->idle = 0;
+  target->next = self->internal->released;
+  self->internal->released = target;
+}
+
+ttoy_ErrorCode
+ttoy_RenderTargetPool_resize(
+    ttoy_RenderTargetPool *self,
+    ttoy_RenderTarget **target,
+    int width,
+    int height,
+    GLenum internalFormat)
+{
+  ttoy_RenderTarget *current;
+
+  if (width < 1)
+    width = 1;
+  if (height < 1)
+    height = 1;
+
+  current = *target;
+  if (current != NULL
+      && current->internalFormat == internalFormat
+      && current->textureWidth == ttoy_RenderTargetPool_allocationSize(width)
+      && current->textureHeight == ttoy_RenderTargetPool_allocationSize(height))
+  {
+    /* The texture that we have is still the right size */
+    current->width = width;
+    current->height = height;
+    return TTOY_NO_ERROR;
+  }
+
+  if (current != NULL) {
+    ttoy_RenderTargetPool_release(self, current);
+    *target = NULL;
+  }
+  return ttoy_RenderTargetPool_acquire(self,
+      width,  /* width */
+      height,  /* height */
+      internalFormat,  /* internalFormat */
+      target  /* target */
+      );
+}
+
+void ttoy_RenderTargetPool_collect(
+    ttoy_RenderTargetPool *self)
+{
+  ttoy_RenderTarget **prev, *current;
+
+  prev = &self->internal->released;
+  while (*prev != NULL) {
+    current = *prev;
+    current->idle += 1;
+    if (current->idle > TTOY_RENDER_TARGET_POOL_MAX_IDLE) {
+      /* Nobody has needed this target in a while */
+      *prev = current->next;
+      ttoy_RenderTargetPool_deleteTarget(self, current);
+      continue;
+    }
+    prev = &current->next;
+  }
+}
+
+ttoy_ErrorCode
+ttoy_RenderTargetPool_createTarget(
+    ttoy_RenderTargetPool *self,
+    int textureWidth,
+    int textureHeight,
+    GLenum internalFormat,
+    ttoy_RenderTarget **target)
+{
+  ttoy_RenderTarget *result;
+#ifndef NDEBUG
+  GLenum status;
+#endif
+
+  result = (ttoy_RenderTarget *)malloc(sizeof(ttoy_RenderTarget));
+  if (result == NULL) {
+    return TTOY_ERROR_OUT_OF_MEMORY;
+  }
+  result->internalFormat = internalFormat;
+  result->textureWidth = textureWidth;
+  result->textureHeight = textureHeight;
+
+  /* Prepare the texture */
+  glGenTextures(
+      1,  /* n */
+      &result->texture  /* textures */
+      );
+  ASSERT_GL_ERROR();
+  glBindTexture(
+      GL_TEXTURE_2D,  /* target */
+      result->texture  /* texture */
+      );
+  ASSERT_GL_ERROR();
+  glTexParameteri(
+      GL_TEXTURE_2D,  /* target */
+      GL_TEXTURE_MIN_FILTER,  /* pname */
+      GL_LINEAR  /* param */
+      );
+  ASSERT_GL_ERROR();
+  glTexParameteri(
+      GL_TEXTURE_2D,  /* target */
+      GL_TEXTURE_MAG_FILTER,  /* pname */
+      GL_LINEAR  /* param */
+      );
+  ASSERT_GL_ERROR();
+  glTexParameteri(
+      GL_TEXTURE_2D,  /* target */
+      GL_TEXTURE_WRAP_S,  /* pname */
+      GL_CLAMP_TO_EDGE  /* param */
+      );
+  ASSERT_GL_ERROR();
+  glTexParameteri(
+      GL_TEXTURE_2D,  /* target */
+      GL_TEXTURE_WRAP_T,  /* pname */
+      GL_CLAMP_TO_EDGE  /* param */
+      );
+  ASSERT_GL_ERROR();
+  /* NOTE: The format and type only describe the data that we are not
+   * passing, but they must still be valid for the internal format */
+  glTexImage2D(
+      GL_TEXTURE_2D,  /* target */
+      0,  /* level */
+      internalFormat,  /* internalFormat */
+      textureWidth,  /* width */
+      textureHeight,  /* height */
+      0,  /* border */
+      GL_RGBA,  /* format */
+      GL_FLOAT,  /* type */
+      NULL  /* data */
+      );
+  ASSERT_GL_ERROR();
+  glBindTexture(
+      GL_TEXTURE_2D,  /* target */
+      0  /* texture */
+      );
+  ASSERT_GL_ERROR();
+
+  /* Prepare the framebuffer */
+  glGenFramebuffers(
+      1,  /* n */
+      &result->framebuffer  /* ids */
+      );
+  ASSERT_GL_ERROR();
+  glBindFramebuffer(
+      GL_DRAW_FRAMEBUFFER,  /* target */
+      result->framebuffer  /* framebuffer */
+      );
+  ASSERT_GL_ERROR();
+  glFramebufferTexture2D(
+      GL_DRAW_FRAMEBUFFER,  /* target */
+      GL_COLOR_ATTACHMENT0,  /* attachment */
+      GL_TEXTURE_2D,  /* textarget */
+      result->texture,  /* texture */
+      0  /* level */
+      );
+  ASSERT_GL_ERROR();
+
+  /* Check the validity of the framebuffer */
+#ifndef NDEBUG
+  status =
+#endif
+  glCheckFramebufferStatus(
+      GL_DRAW_FRAMEBUFFER  /* target */
+      );
+  ASSERT_GL_ERROR();
+  assert(status == GL_FRAMEBUFFER_COMPLETE);
+
+  /* Clear the framebuffer binding */
+  glBindFramebuffer(
+      GL_DRAW_FRAMEBUFFER,  /* target */
+      0  /* framebuffer */
+      );
+  ASSERT_GL_ERROR();
+
+  *target = result;
+
+  return TTOY_NO_ERROR;
+}
+
+void ttoy_RenderTargetPool_deleteTarget(
+    ttoy_RenderTargetPool *self,
+    ttoy_RenderTarget *target)
+{
+  glDeleteFramebuffers(
+      1,  /* n */
+      &target->framebuffer  /* framebuffers */
+      );
+  ASSERT_GL_ERROR();
+  glDeleteTextures(
+      1,  /* n */
+      &target->texture  /* textures */
+      );
+  ASSERT_GL_ERROR();
+  free(target);
+}
@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2016-2017 Jonathan Glines
+ * Jonathan Glines <jonathan@glines.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef TTOY_COMMON_RENDER_TARGET_POOL_H_
+#define TTOY_COMMON_RENDER_TARGET_POOL_H_
+
+#include <GL/glew.h>
+
+#include <ttoy/error.h>
+
+/* Render target textures are never allocated smaller than this */
+#define TTOY_RENDER_TARGET_POOL_MIN_SIZE 64
+/* Number of calls to ttoy_RenderTargetPool_collect() that a released target
+ * survives without being acquired again, before it is deleted */
+#define TTOY_RENDER_TARGET_POOL_MAX_IDLE 120
+
+/**
+ * A texture that can be rendered to through its framebuffer object.
+ *
+ * The texture is allocated with power-of-two dimensions that are at least
+ * the width and height that the target was acquired for. Only the lower left
+ * width by height region of the texture is meant to be used.
+ */
+typedef struct ttoy_RenderTarget_ {
+  GLuint texture, framebuffer;
+  GLenum internalFormat;
+  int width, height;
+  int textureWidth, textureHeight;
+
+  /* Private */
+  struct ttoy_RenderTarget_ *next;
+  int idle;
+} ttoy_RenderTarget;
+
+struct ttoy_RenderTargetPool_Internal_;
+typedef struct ttoy_RenderTargetPool_Internal_
+ttoy_RenderTargetPool_Internal;
+
+/**
+ * Recycles render targets, so that render targets are not reallocated every
+ * time that the size they are needed at changes slightly, such as while the
+ * window is being resized.
+ *
+ * Framebuffer objects are not shared between GL contexts, so a pool must only
+ * be used on the thread with the GL context that it was first used with.
+ */
+typedef struct ttoy_RenderTargetPool_ {
+  ttoy_RenderTargetPool_Internal *internal;
+} ttoy_RenderTargetPool;
+
+void ttoy_RenderTargetPool_init(
+    ttoy_RenderTargetPool *self);
+
+/**
+ * Deletes all of the targets of the pool, including those that were not
+ * released.
+ */
+void ttoy_RenderTargetPool_destroy(
+    ttoy_RenderTargetPool *self);
+
+/**
+ * Gets a render target of at least the given size and internal format,
+ * reusing a released target if one is allocated at the size that a new
+ * target would be.
+ */
+ttoy_ErrorCode
+ttoy_RenderTargetPool_acquire(
+    ttoy_RenderTargetPool *self,
+    int width,
+    int height,
+    GLenum internalFormat,
+    ttoy_RenderTarget **target);
+
+/**
+ * Returns the given target to the pool. Its texture must no longer be in use
+ * by the GL, since the target may be acquired again right away.
+ */
+void ttoy_RenderTargetPool_release(
+    ttoy_RenderTargetPool *self,
+    ttoy_RenderTarget *target);
+
+/**
+ * Changes the size of the given target, which is NULL or was acquired from
+ * this pool. The target is only replaced if its texture is too small, or much
+ * larger than it needs to be; otherwise, the contents of its texture are
+ * preserved.
+ */
+ttoy_ErrorCode
+ttoy_RenderTargetPool_resize(
+    ttoy_RenderTargetPool *self,
+    ttoy_RenderTarget **target,
+    int width,
+    int height,
+    GLenum internalFormat);
+
+/**
+ * Ages the released targets of the pool, deleting those that have been idle
+ * for too long. This is meant to be called once per frame.
+ */
+void ttoy_RenderTargetPool_collect(
+    ttoy_RenderTargetPool *self);
+
+#endif
@@ -25,65 +25,189 @@
 #include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "glError.h"
 #include "../logging.h"
+#include "shaderCache.h"
 
 #include "shader.h"
 
+typedef struct ttoy_Shader_Stage_ {
+  GLuint shader;
+  GLchar *source;
+  GLint length;
+  int compilePending;
+} ttoy_Shader_Stage;
+
 struct ttoy_Shader_Internal_ {
-  GLuint vert, frag;
+  ttoy_Shader_Stage vert, frag;
   char *log;
+  uint64_t cacheKey;
+  int linkPending;
 };
 
+/* Private methods */
+ttoy_ErrorCode
+ttoy_Shader_getStage(
+    ttoy_Shader *self,
+    GLenum type,
+    ttoy_Shader_Stage **stage);
+
+void
+ttoy_Shader_beginCompileStage(
+    ttoy_Shader *self,
+    ttoy_Shader_Stage *stage,
+    GLenum type);
+
+ttoy_ErrorCode
+ttoy_Shader_finishCompileStage(
+    ttoy_Shader *self,
+    ttoy_Shader_Stage *stage);
+
 void ttoy_Shader_init(
     ttoy_Shader *self)
 {
   /* Allocate internal memory */
   self->internal = (ttoy_Shader_Internal *)malloc(sizeof(ttoy_Shader_Internal));
+  memset(&self->internal->vert, 0, sizeof(self->internal->vert));
+  memset(&self->internal->frag, 0, sizeof(self->internal->frag));
   self->internal->log = NULL;
+  self->internal->linkPending = 0;
   self->program = 0;
 }
 
 void ttoy_Shader_destroy(
     ttoy_Shader *self)
 {
-  /* TODO: Free resources allocated in the GL */
+  /* Free resources allocated in the GL */
+  if (self->internal->vert.shader != 0) {
+    glDeleteShader(self->internal->vert.shader);
+    ASSERT_GL_ERROR();
+  }
+  if (self->internal->frag.shader != 0) {
+    glDeleteShader(self->internal->frag.shader);
+    ASSERT_GL_ERROR();
+  }
+  if (self->program != 0) {
+    glDeleteProgram(self->program);
+    ASSERT_GL_ERROR();
+  }
   /* Free allocated memory */
+  free(self->internal->vert.source);
+  free(self->internal->frag.source);
   free(self->internal->log);
   free(self->internal);
 }
 
 ttoy_ErrorCode
-ttoy_Shader_compileShaderFromString(
+ttoy_Shader_getStage(
     ttoy_Shader *self,
-    const GLchar *code,
-    GLint length,
-    GLenum type)
+    GLenum type,
+    ttoy_Shader_Stage **stage)
 {
-  GLuint *shader;
-  GLint status;
-
   switch (type) {
     case GL_VERTEX_SHADER:
-      shader = &self->internal->vert;
+      *stage = &self->internal->vert;
       break;
     case GL_FRAGMENT_SHADER:
-      shader = &self->internal->frag;
+      *stage = &self->internal->frag;
       break;
     default:
       return TTOY_ERROR_UNKNOWN_SHADER_TYPE;
   }
+  return TTOY_NO_ERROR;
+}
+
+ttoy_ErrorCode
+ttoy_Shader_compileShaderFromString(
+    ttoy_Shader *self,
+    const GLchar *code,
+    GLint length,
+    GLenum type)
+{
+  ttoy_Shader_Stage *stage;
+  ttoy_ErrorCode error;
+
+  error = ttoy_Shader_getStage(self,
+      type,  /* type */
+      &stage  /* stage */
+      );
+  if (error != TTOY_NO_ERROR) {
+    return error;
+  }
+
+  /* Keep a copy of the source, which we need both for the program cache key
+   * and to compile the shader later if the cache misses */
+  if (length < 0) {
+    length = strlen(code);
+  }
+  free(stage->source);
+  stage->source = (GLchar *)malloc(length);
+  if (stage->source == NULL && length > 0) {
+    return TTOY_ERROR_OUT_OF_MEMORY;
+  }
+  memcpy(stage->source, code, length);
+  stage->length = length;
+  if (stage->shader != 0) {
+    /* The previous shader object is no longer needed; the GL keeps it alive
+     * for as long as it is attached to a program */
+    glDeleteShader(stage->shader);
+    ASSERT_GL_ERROR();
+    stage->shader = 0;
+  }
+
+  if (ttoy_ShaderCache_isSupported()) {
+    /* Defer compilation to ttoy_Shader_linkProgram(), which might find the
+     * linked program in the shader cache */
+    return TTOY_NO_ERROR;
+  }
+
+  ttoy_Shader_beginCompileStage(self,
+      stage,  /* stage */
+      type  /* type */
+      );
+  return ttoy_Shader_finishCompileStage(self,
+      stage  /* stage */
+      );
+}
+
+void
+ttoy_Shader_beginCompileStage(
+    ttoy_Shader *self,
+    ttoy_Shader_Stage *stage,
+    GLenum type)
+{
+  const GLchar *code;
+
+  code = stage->source;
 
   /* Create a shader object in the GL */
-  *shader = glCreateShader(type);
-  FORCE_ASSERT_GL_ERROR();
+  stage->shader = glCreateShader(type);
+  ASSERT_GL_ERROR();
+
+  /* Load and compile the shader source. We do not query the compile status
+   * here, since that would wait for the compiler to finish. */
+  glShaderSource(stage->shader, 1, &code, &stage->length);
+  ASSERT_GL_ERROR();
+  glCompileShader(stage->shader);
+  ASSERT_GL_ERROR();
+  stage->compilePending = 1;
+}
 
-  /* Load and compile the shader source */
-  glShaderSource(*shader, 1, &code, &length);
-  FORCE_ASSERT_GL_ERROR();
-  glCompileShader(*shader);
-  FORCE_ASSERT_GL_ERROR();
+ttoy_ErrorCode
+ttoy_Shader_finishCompileStage(
+    ttoy_Shader *self,
+    ttoy_Shader_Stage *stage)
+{
+  GLuint *shader;
+  GLint status;
+
+  if (!stage->compilePending) {
+    return TTOY_NO_ERROR;
+  }
+  stage->compilePending = 0;
+  shader = &stage->shader;
 
   /* Check for compilation errors */
   glGetShaderiv(
@@ -91,7 +215,7 @@ ttoy_Shader_compileShaderFromString(
       GL_COMPILE_STATUS,  /* pname */
       &status  /* params */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   if (status != GL_TRUE) {
     int logLength;
     /* Store the shader compilation log for future access via the
@@ -101,7 +225,7 @@ ttoy_Shader_compileShaderFromString(
         GL_INFO_LOG_LENGTH,  /* pname */
         &logLength  /* params */
         );
-    FORCE_ASSERT_GL_ERROR();
+    ASSERT_GL_ERROR();
     free(self->internal->log);
     self->internal->log = (char*)malloc(logLength);
     if (self->internal->log == NULL) {
@@ -113,11 +237,14 @@ ttoy_Shader_compileShaderFromString(
         NULL,  /* length */
         self->internal->log  /* infoLog */
         );
-    FORCE_ASSERT_GL_ERROR();
+    ASSERT_GL_ERROR();
     TTOY_LOG_ERROR(
         "Error compiling shader: \n"
         "%s",
         self->internal->log);
+    glDeleteShader(*shader);
+    ASSERT_GL_ERROR();
+    *shader = 0;
     return TTOY_ERROR_SHADER_COMPILATION_FAILED;
   }
 
@@ -192,40 +319,173 @@ ttoy_ErrorCode
 ttoy_Shader_linkProgram(
     ttoy_Shader *self)
 {
-  GLint status;
-  char *log;
-  int logLength;
+  ttoy_ErrorCode error;
+
+  error = ttoy_Shader_beginLinkProgram(self);
+  if (error != TTOY_NO_ERROR) {
+    return error;
+  }
+  return ttoy_Shader_finishLinkProgram(self);
+}
+
+ttoy_ErrorCode
+ttoy_Shader_beginLinkProgram(
+    ttoy_Shader *self)
+{
+  int useCache;
+  ttoy_ErrorCode error;
+
+  /* Look for a binary of this program linked by a previous run of ttoy */
+  useCache = ttoy_ShaderCache_isSupported();
+  if (useCache) {
+    self->internal->cacheKey = ttoy_ShaderCache_getKey(
+        self->internal->vert.source,  /* vertSource */
+        self->internal->vert.length,  /* vertLength */
+        self->internal->frag.source,  /* fragSource */
+        self->internal->frag.length  /* fragLength */
+        );
+    self->program = glCreateProgram();
+    ASSERT_GL_ERROR();
+    error = ttoy_ShaderCache_loadProgram(
+        self->internal->cacheKey,  /* key */
+        self->program  /* program */
+        );
+    if (error == TTOY_NO_ERROR) {
+      self->internal->linkPending = 0;
+      return TTOY_NO_ERROR;
+    }
+    glDeleteProgram(self->program);
+    ASSERT_GL_ERROR();
+  }
+
+  /* Compile any shaders whose compilation was deferred */
+  if (self->internal->vert.shader == 0) {
+    ttoy_Shader_beginCompileStage(self,
+        &self->internal->vert,  /* stage */
+        GL_VERTEX_SHADER  /* type */
+        );
+  }
+  if (self->internal->frag.shader == 0) {
+    ttoy_Shader_beginCompileStage(self,
+        &self->internal->frag,  /* stage */
+        GL_FRAGMENT_SHADER  /* type */
+        );
+  }
 
   /* Create the program object */
   self->program = glCreateProgram();
+  ASSERT_GL_ERROR();
+  if (useCache) {
+    /* Ask the GL to keep the binary around so that we can cache it */
+    glProgramParameteri(self->program,
+        GL_PROGRAM_BINARY_RETRIEVABLE_HINT,  /* pname */
+        GL_TRUE  /* value */
+        );
+    ASSERT_GL_ERROR();
+  }
   /* Attach the shaders */
   /* TODO: Support attaching shader types other than vert and frag */
-  glAttachShader(self->program, self->internal->vert);
-  FORCE_ASSERT_GL_ERROR();
-  glAttachShader(self->program, self->internal->frag);
-  FORCE_ASSERT_GL_ERROR();
-  /* Link the shader program and check for linker errors */
+  glAttachShader(self->program, self->internal->vert.shader);
+  ASSERT_GL_ERROR();
+  glAttachShader(self->program, self->internal->frag.shader);
+  ASSERT_GL_ERROR();
+  /* Link the shader program; errors are checked for in
+   * ttoy_Shader_finishLinkProgram() */
   glLinkProgram(self->program);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
+  self->internal->linkPending = 1;
+
+  return TTOY_NO_ERROR;
+}
+
+int
+ttoy_Shader_isLinkComplete(
+    ttoy_Shader *self)
+{
+  GLint status;
+
+  if (!self->internal->linkPending) {
+    return 1;
+  }
+  if (!GLEW_KHR_parallel_shader_compile
+      && !GLEW_ARB_parallel_shader_compile)
+  {
+    /* Without KHR_parallel_shader_compile we cannot ask, and
+     * ttoy_Shader_finishLinkProgram() will simply block */
+    return 1;
+  }
+  glGetProgramiv(
+      self->program,  /* program */
+      GL_COMPLETION_STATUS_KHR,  /* pname */
+      &status  /* params */
+      );
+  ASSERT_GL_ERROR();
+  return status == GL_TRUE;
+}
+
+ttoy_ErrorCode
+ttoy_Shader_finishLinkProgram(
+    ttoy_Shader *self)
+{
+  GLint status;
+  char *log;
+  int logLength;
+  ttoy_ErrorCode error;
+
+  if (!self->internal->linkPending) {
+    /* The program was loaded from the shader cache */
+    return TTOY_NO_ERROR;
+  }
+  self->internal->linkPending = 0;
+
+  /* Check the status of shaders compiled by ttoy_Shader_beginLinkProgram() */
+  error = ttoy_Shader_finishCompileStage(self,
+      &self->internal->vert  /* stage */
+      );
+  if (error == TTOY_NO_ERROR) {
+    error = ttoy_Shader_finishCompileStage(self,
+        &self->internal->frag  /* stage */
+        );
+  }
+  if (error != TTOY_NO_ERROR) {
+    glDeleteProgram(self->program);
+    ASSERT_GL_ERROR();
+    self->program = 0;
+    return error;
+  }
+
+  /* Check for linker errors */
   glGetProgramiv(self->program, GL_LINK_STATUS, &status);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   if (status != GL_TRUE) {
     /* Get the output of the linker log */
     glGetProgramiv(
         self->program,
         GL_INFO_LOG_LENGTH,
         &logLength);
-    FORCE_ASSERT_GL_ERROR();
+    ASSERT_GL_ERROR();
     log = (char *)malloc(logLength);
     glGetProgramInfoLog(
         self->program,
         logLength,
         NULL,
         log);
-    FORCE_ASSERT_GL_ERROR();
+    ASSERT_GL_ERROR();
     fprintf(stderr, "Error linking shader program:\n%s", log);
     free(log);
     return TTOY_ERROR_SHADER_LINKING_FAILED;
   }
+  if (ttoy_ShaderCache_isSupported()) {
+    /* Store the program binary so that the next run can skip compiling and
+     * linking this program */
+    error = ttoy_ShaderCache_storeProgram(
+        self->internal->cacheKey,  /* key */
+        self->program  /* program */
+        );
+    if (error != TTOY_NO_ERROR) {
+      /* NOTE: Not a fatal error */
+      TTOY_LOG_ERROR_CODE(error);
+    }
+  }
   return TTOY_NO_ERROR;
 }
@@ -39,9 +39,21 @@ typedef struct {
 void ttoy_Shader_init(
     ttoy_Shader *self);
 
+/**
+ * Frees the shader and deletes its program and shader objects, which requires
+ * a current GL context that shares objects with the one they were created in.
+ */
 void ttoy_Shader_destroy(
     ttoy_Shader *self);
 
+/**
+ * Sets the source of the shader of the given type, and compiles it.
+ *
+ * When the GL supports program binaries, compilation is deferred to
+ * ttoy_Shader_linkProgram(), which first looks for the linked program in the
+ * shader cache. In that case compilation errors are reported by
+ * ttoy_Shader_linkProgram() instead.
+ */
 ttoy_ErrorCode
 ttoy_Shader_compileShaderFromString(
     ttoy_Shader *self,
@@ -55,10 +67,42 @@ ttoy_Shader_compileShaderFromFile(
     const char *filePath,
     GLenum type);
 
+/**
+ * Links the shader program from the shaders given so far. The linked program
+ * is loaded from the shader cache if it was linked from the same sources by
+ * the same GL driver before, and stored in the cache otherwise.
+ */
 ttoy_ErrorCode
 ttoy_Shader_linkProgram(
     ttoy_Shader *self);
 
+/**
+ * Starts linking the shader program without waiting for the GL to finish
+ * compiling and linking it. Together with ttoy_Shader_isLinkComplete() and
+ * ttoy_Shader_finishLinkProgram(), this allows a program to be built across
+ * several frames on drivers with KHR_parallel_shader_compile.
+ */
+ttoy_ErrorCode
+ttoy_Shader_beginLinkProgram(
+    ttoy_Shader *self);
+
+/**
+ * Returns non-zero once ttoy_Shader_finishLinkProgram() can be called
+ * without blocking. Always returns non-zero without
+ * KHR_parallel_shader_compile.
+ */
+int
+ttoy_Shader_isLinkComplete(
+    ttoy_Shader *self);
+
+/**
+ * Checks the results of a link started with ttoy_Shader_beginLinkProgram(),
+ * reporting any compilation or linking errors.
+ */
+ttoy_ErrorCode
+ttoy_Shader_finishLinkProgram(
+    ttoy_Shader *self);
+
 void
 ttoy_Shader_getLog(
     ttoy_Shader *self,
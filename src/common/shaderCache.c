@@ -0,0 +1,252 @@
+/*
+ * Copyright (c) 2016-2017 Jonathan Glines
+ * Jonathan Glines <jonathan@glines.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../logging.h"
+#include "cacheDir.h"
+#include "glError.h"
+#include "hash.h"
+
+#include "shaderCache.h"
+
+/* Layout of the shader cache files. The header is followed by the program
+ * binary itself. */
+#define TTOY_SHADER_CACHE_MAGIC "ttoySHDR"
+typedef struct ttoy_ShaderCacheHeader_ {
+  char magic[8];
+  uint32_t version;
+  uint32_t format;
+  uint64_t key;
+  uint32_t length;
+} ttoy_ShaderCacheHeader;
+
+/* Private methods */
+ttoy_ErrorCode
+ttoy_ShaderCache_getPath(
+    uint64_t key,
+    char **path);
+
+int
+ttoy_ShaderCache_isSupported()
+{
+  static int supported = -1;
+  GLint numFormats;
+
+  if (supported == -1) {
+    supported = 0;
+    if (GLEW_ARB_get_program_binary) {
+      glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+      ASSERT_GL_ERROR();
+      supported = numFormats > 0;
+    }
+  }
+
+  return supported;
+}
+
+uint64_t
+ttoy_ShaderCache_getKey(
+    const GLchar *vertSource,
+    GLint vertLength,
+    const GLchar *fragSource,
+    GLint fragLength)
+{
+  const uint32_t version = TTOY_SHADER_CACHE_VERSION;
+  const char *str;
+  uint64_t key;
+
+  key = ttoy_hash(TTOY_HASH_INIT, &version, sizeof(version));
+  /* Program binaries are only valid for the driver that produced them */
+  str = (const char *)glGetString(GL_VENDOR);
+  ASSERT_GL_ERROR();
+  key = ttoy_hashString(key, str != NULL ? str : "");
+  str = (const char *)glGetString(GL_RENDERER);
+  ASSERT_GL_ERROR();
+  key = ttoy_hashString(key, str != NULL ? str : "");
+  str = (const char *)glGetString(GL_VERSION);
+  ASSERT_GL_ERROR();
+  key = ttoy_hashString(key, str != NULL ? str : "");
+  /* Hash the shader sources along with their lengths, so that moving text
+   * from one shader to the other changes the key */
+  key = ttoy_hash(key, &vertLength, sizeof(vertLength));
+  key = ttoy_hash(key, vertSource, vertLength);
+  key = ttoy_hash(key, &fragLength, sizeof(fragLength));
+  key = ttoy_hash(key, fragSource, fragLength);
+
+  return key;
+}
+
+ttoy_ErrorCode
+ttoy_ShaderCache_getPath(
+    uint64_t key,
+    char **path)
+{
+  ttoy_ErrorCode error;
+  char *dir;
+  int len;
+
+  error = ttoy_getCacheDir("shaders", &dir);
+  if (error != TTOY_NO_ERROR) {
+    return error;
+  }
+  len = snprintf(NULL, 0, "%s/%016" PRIx64 ".bin", dir, key);
+  *path = (char *)malloc(len + 1);
+  if (*path == NULL) {
+    free(dir);
+    return TTOY_ERROR_OUT_OF_MEMORY;
+  }
+  sprintf(*path, "%s/%016" PRIx64 ".bin", dir, key);
+  free(dir);
+
+  return TTOY_NO_ERROR;
+}
+
+ttoy_ErrorCode
+ttoy_ShaderCache_loadProgram(
+    uint64_t key,
+    GLuint program)
+{
+  ttoy_ShaderCacheHeader header;
+  FILE *fp;
+  char *path;
+  void *binary;
+  GLint status;
+  ttoy_ErrorCode error;
+
+  error = ttoy_ShaderCache_getPath(key, &path);
+  if (error != TTOY_NO_ERROR) {
+    return error;
+  }
+  fp = fopen(path, "rb");
+  free(path);
+  if (fp == NULL) {
+    /* Cache files that do not exist yet are not worth complaining about */
+    return TTOY_ERROR_CACHE_MISS;
+  }
+
+  /* Make sure the cache file was written by this version of ttoy for the same
+   * shaders, and that it is not truncated */
+  error = TTOY_ERROR_CACHE_MISS;
+  binary = NULL;
+  if (fread(&header, sizeof(header), 1, fp) != 1)
+    goto loadProgram_cleanup;
+  if (memcmp(header.magic, TTOY_SHADER_CACHE_MAGIC,
+        sizeof(header.magic)) != 0)
+    goto loadProgram_cleanup;
+  if (header.version != TTOY_SHADER_CACHE_VERSION
+      || header.key != key
+      || header.length == 0)
+    goto loadProgram_cleanup;
+  binary = malloc(header.length);
+  if (binary == NULL) {
+    error = TTOY_ERROR_OUT_OF_MEMORY;
+    goto loadProgram_cleanup;
+  }
+  if (fread(binary, header.length, 1, fp) != 1)
+    goto loadProgram_cleanup;
+
+  /* The GL is free to reject binaries it does not like, in which case we
+   * report a cache miss and the caller links the program from source */
+  glProgramBinary(
+      program,  /* program */
+      header.format,  /* binaryFormat */
+      binary,  /* binary */
+      header.length  /* length */
+      );
+  while (glGetError() != GL_NO_ERROR);
+  glGetProgramiv(program, GL_LINK_STATUS, &status);
+  ASSERT_GL_ERROR();
+  if (status == GL_TRUE) {
+    error = TTOY_NO_ERROR;
+  }
+
+loadProgram_cleanup:
+  free(binary);
+  fclose(fp);
+  return error;
+}
+
+ttoy_ErrorCode
+ttoy_ShaderCache_storeProgram(
+    uint64_t key,
+    GLuint program)
+{
+  ttoy_ShaderCacheHeader header;
+  GLint length;
+  GLenum format;
+  void *binary;
+  FILE *fp;
+  char *path, *tempPath;
+  ttoy_ErrorCode error;
+
+  /* Retrieve the program binary from the GL */
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+  ASSERT_GL_ERROR();
+  if (length <= 0) {
+    return TTOY_ERROR_CACHE_WRITE_FAILED;
+  }
+  binary = malloc(length);
+  if (binary == NULL) {
+    return TTOY_ERROR_OUT_OF_MEMORY;
+  }
+  glGetProgramBinary(
+      program,  /* program */
+      length,  /* bufSize */
+      &length,  /* length */
+      &format,  /* binaryFormat */
+      binary  /* binary */
+      );
+  ASSERT_GL_ERROR();
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, TTOY_SHADER_CACHE_MAGIC, sizeof(header.magic));
+  header.version = TTOY_SHADER_CACHE_VERSION;
+  header.format = format;
+  header.key = key;
+  header.length = length;
+
+  error = ttoy_ShaderCache_getPath(key, &path);
+  if (error != TTOY_NO_ERROR) {
+    free(binary);
+    return error;
+  }
+
+  /* Write to a temporary file first and then rename it into place */
+  error = ttoy_createCacheFile(path, &fp, &tempPath);
+  if (error != TTOY_NO_ERROR) {
+    goto storeProgram_cleanup1;
+  }
+  fwrite(&header, sizeof(header), 1, fp);
+  fwrite(binary, length, 1, fp);
+  error = ttoy_replaceCacheFile(path, fp, tempPath);
+
+storeProgram_cleanup1:
+  free(path);
+  free(binary);
+  return error;
+}
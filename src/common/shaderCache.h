@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2016-2017 Jonathan Glines
+ * Jonathan Glines <jonathan@glines.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef TTOY_COMMON_SHADER_CACHE_H_
+#define TTOY_COMMON_SHADER_CACHE_H_
+
+#include <GL/glew.h>
+#include <inttypes.h>
+
+#include <ttoy/error.h>
+
+/* Bump this whenever the layout of shader cache files changes */
+#define TTOY_SHADER_CACHE_VERSION 1
+
+/**
+ * Returns non-zero if the GL can give us linked program binaries, in which
+ * case shader programs are cached on disk under "$XDG_CACHE_HOME/ttoy/shaders"
+ * so that later launches can skip compiling and linking them.
+ *
+ * This must be called with a current GL context.
+ */
+int
+ttoy_ShaderCache_isSupported();
+
+/**
+ * Computes the cache key for a shader program built from the given shader
+ * sources. Since program binaries are specific to the driver that produced
+ * them, the key also covers the GL vendor, renderer and version strings.
+ */
+uint64_t
+ttoy_ShaderCache_getKey(
+    const GLchar *vertSource,
+    GLint vertLength,
+    const GLchar *fragSource,
+    GLint fragLength);
+
+/**
+ * Loads the cached binary for the given key into the given program object.
+ * Returns TTOY_ERROR_CACHE_MISS if there is no such binary, or if the GL
+ * rejects it (e.g. after a driver update), in which case the program must be
+ * compiled and linked from source.
+ */
+ttoy_ErrorCode
+ttoy_ShaderCache_loadProgram(
+    uint64_t key,
+    GLuint program);
+
+/**
+ * Stores the binary of the given linked program in the cache under the given
+ * key. The program should have been linked with
+ * GL_PROGRAM_BINARY_RETRIEVABLE_HINT set.
+ */
+ttoy_ErrorCode
+ttoy_ShaderCache_storeProgram(
+    uint64_t key,
+    GLuint program);
+
+#endif
@@ -0,0 +1,369 @@
+/*
+ * Copyright (c) 2016-2017 Jonathan Glines
+ * Jonathan Glines <jonathan@glines.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <GL/glew.h>
+#include <SDL.h>
+#include <SDL_thread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "glContext.h"
+#include "glError.h"
+#include "../logging.h"
+
+#include "shaderCompiler.h"
+
+typedef struct ttoy_ShaderCompiler_Job_ {
+  char *vertSource, *fragPath;
+} ttoy_ShaderCompiler_Job;
+
+struct ttoy_ShaderCompiler_Internal_ {
+  SDL_Window *window;
+  /* The GL context of our worker thread, or NULL if we build programs on the
+   * thread that calls poll() */
+  SDL_GLContext context;
+  SDL_Thread *thread;
+  SDL_mutex *mutex;
+  SDL_cond *jobCond;
+  ttoy_ShaderCompiler_Job job;
+  int hasJob;
+  /* Non-zero while the worker thread is building a program */
+  int building;
+  /* The most recently built program, waiting to be polled */
+  ttoy_Shader result;
+  ttoy_ErrorCode resultError;
+  int hasResult;
+  /* The program being built on the polling thread, when we have no worker */
+  ttoy_Shader pending;
+  int hasPending;
+  int quit;
+};
+
+/* Private methods */
+int
+ttoy_ShaderCompiler_compileThread(
+    ttoy_ShaderCompiler *self);
+
+ttoy_ErrorCode
+ttoy_ShaderCompiler_beginBuild(
+    ttoy_ShaderCompiler_Job *job,
+    ttoy_Shader *shader);
+
+ttoy_ErrorCode
+ttoy_ShaderCompiler_pollPending(
+    ttoy_ShaderCompiler *self,
+    ttoy_Shader *shader,
+    int *ready);
+
+void
+ttoy_ShaderCompiler_freeJob(
+    ttoy_ShaderCompiler_Job *job);
+
+ttoy_ErrorCode
+ttoy_ShaderCompiler_init(
+    ttoy_ShaderCompiler *self)
+{
+  ttoy_ErrorCode error;
+
+  /* Allocate memory for internal structures */
+  self->internal = (ttoy_ShaderCompiler_Internal *)malloc(
+      sizeof(ttoy_ShaderCompiler_Internal));
+  if (self->internal == NULL) {
+    return TTOY_ERROR_OUT_OF_MEMORY;
+  }
+  memset(self->internal, 0, sizeof(ttoy_ShaderCompiler_Internal));
+  self->internal->mutex = SDL_CreateMutex();
+  self->internal->jobCond = SDL_CreateCond();
+
+  /* Create a GL context for our worker thread that shares objects with the
+   * current context, so that the programs it links can be drawn with */
+  error = ttoy_createSharedGLContext(
+      &self->internal->window,  /* window */
+      &self->internal->context  /* context */
+      );
+  if (error != TTOY_NO_ERROR) {
+    /* NOTE: Not a fatal error; we build programs on the polling thread */
+    self->internal->context = NULL;
+    return TTOY_NO_ERROR;
+  }
+
+  self->internal->thread = SDL_CreateThread(
+      (SDL_ThreadFunction)ttoy_ShaderCompiler_compileThread,  /* fn */
+      "ttoy_ShaderCompiler_compileThread",  /* name */
+      (void *)self  /* data */
+      );
+  if (self->internal->thread == NULL) {
+    TTOY_LOG_ERROR("Failed to create shader compiler thread: %s",
+        SDL_GetError());
+    SDL_GL_DeleteContext(self->internal->context);
+    self->internal->context = NULL;
+  }
+
+  return TTOY_NO_ERROR;
+}
+
+void
+ttoy_ShaderCompiler_destroy(
+    ttoy_ShaderCompiler *self)
+{
+  if (self->internal->thread != NULL) {
+    /* Tell our worker thread to quit */
+    SDL_LockMutex(self->internal->mutex);
+    self->internal->quit = 1;
+    SDL_CondSignal(self->internal->jobCond);
+    SDL_UnlockMutex(self->internal->mutex);
+    SDL_WaitThread(self->internal->thread, NULL);
+    SDL_GL_DeleteContext(self->internal->context);
+  }
+
+  /* Discard any programs that nobody asked for */
+  if (self->internal->hasResult) {
+    ttoy_Shader_destroy(&self->internal->result);
+  }
+  if (self->internal->hasPending) {
+    ttoy_Shader_destroy(&self->internal->pending);
+  }
+  if (self->internal->hasJob) {
+    ttoy_ShaderCompiler_freeJob(&self->internal->job);
+  }
+
+  SDL_DestroyCond(self->internal->jobCond);
+  SDL_DestroyMutex(self->internal->mutex);
+  free(self->internal);
+}
+
+void
+ttoy_ShaderCompiler_compileProgram(
+    ttoy_ShaderCompiler *self,
+    const char *vertSource,
+    const char *fragPath)
+{
+  ttoy_ShaderCompiler_Job *job;
+
+  SDL_LockMutex(self->internal->mutex);
+  job = &self->internal->job;
+  if (self->internal->hasJob) {
+    /* The previous request is out of date */
+    ttoy_ShaderCompiler_freeJob(job);
+  }
+  job->vertSource = (char *)malloc(strlen(vertSource) + 1);
+  strcpy(job->vertSource, vertSource);
+  job->fragPath = (char *)malloc(strlen(fragPath) + 1);
+  strcpy(job->fragPath, fragPath);
+  self->internal->hasJob = 1;
+  SDL_CondSignal(self->internal->jobCond);
+  SDL_UnlockMutex(self->internal->mutex);
+}
+
+ttoy_ErrorCode
+ttoy_ShaderCompiler_poll(
+    ttoy_ShaderCompiler *self,
+    ttoy_Shader *shader,
+    int *ready)
+{
+  ttoy_ErrorCode error;
+
+  if (self->internal->thread == NULL) {
+    return ttoy_ShaderCompiler_pollPending(self,
+        shader,  /* shader */
+        ready  /* ready */
+        );
+  }
+
+  SDL_LockMutex(self->internal->mutex);
+  *ready = self->internal->hasResult;
+  error = TTOY_NO_ERROR;
+  if (self->internal->hasResult) {
+    error = self->internal->resultError;
+    if (error == TTOY_NO_ERROR) {
+      *shader = self->internal->result;
+    }
+    self->internal->hasResult = 0;
+  }
+  SDL_UnlockMutex(self->internal->mutex);
+
+  return error;
+}
+
+int
+ttoy_ShaderCompiler_isBusy(
+    ttoy_ShaderCompiler *self)
+{
+  int result;
+
+  SDL_LockMutex(self->internal->mutex);
+  result = self->internal->hasJob
+    || self->internal->building
+    || self->internal->hasResult
+    || self->internal->hasPending;
+  SDL_UnlockMutex(self->internal->mutex);
+
+  return result;
+}
+
+ttoy_ErrorCode
+ttoy_ShaderCompiler_pollPending(
+    ttoy_ShaderCompiler *self,
+    ttoy_Shader *shader,
+    int *ready)
+{
+  ttoy_ErrorCode error;
+
+  *ready = 0;
+  if (!self->internal->hasPending) {
+    if (!self->internal->hasJob) {
+      return TTOY_NO_ERROR;
+    }
+    /* Start building the requested program */
+    ttoy_Shader_init(&self->internal->pending);
+    error = ttoy_ShaderCompiler_beginBuild(
+        &self->internal->job,  /* job */
+        &self->internal->pending  /* shader */
+        );
+    ttoy_ShaderCompiler_freeJob(&self->internal->job);
+    self->internal->hasJob = 0;
+    if (error != TTOY_NO_ERROR) {
+      ttoy_Shader_destroy(&self->internal->pending);
+      *ready = 1;
+      return error;
+    }
+    self->internal->hasPending = 1;
+  }
+
+  /* Check on the program without waiting for the GL */
+  if (!ttoy_Shader_isLinkComplete(&self->internal->pending)) {
+    return TTOY_NO_ERROR;
+  }
+  self->internal->hasPending = 0;
+  *ready = 1;
+  error = ttoy_Shader_finishLinkProgram(&self->internal->pending);
+  if (error != TTOY_NO_ERROR) {
+    ttoy_Shader_destroy(&self->internal->pending);
+    return error;
+  }
+  *shader = self->internal->pending;
+
+  return TTOY_NO_ERROR;
+}
+
+int
+ttoy_ShaderCompiler_compileThread(
+    ttoy_ShaderCompiler *self)
+{
+  ttoy_ShaderCompiler_Job job;
+  ttoy_Shader shader;
+  ttoy_ErrorCode error;
+
+  SDL_GL_MakeCurrent(self->internal->window, self->internal->context);
+  /* Let the driver compile on as many threads as it likes */
+  if (GLEW_KHR_parallel_shader_compile) {
+    glMaxShaderCompilerThreadsKHR(0xffffffff);
+    ASSERT_GL_ERROR();
+  } else if (GLEW_ARB_parallel_shader_compile) {
+    glMaxShaderCompilerThreadsARB(0xffffffff);
+    ASSERT_GL_ERROR();
+  }
+
+  SDL_LockMutex(self->internal->mutex);
+  while (1) {
+    while (!self->internal->hasJob && !self->internal->quit) {
+      SDL_CondWait(self->internal->jobCond, self->internal->mutex);
+    }
+    if (self->internal->quit)
+      break;
+    job = self->internal->job;
+    self->internal->hasJob = 0;
+    self->internal->building = 1;
+    SDL_UnlockMutex(self->internal->mutex);
+
+    /* Build the program; this is where a heavy shader takes its time */
+    ttoy_Shader_init(&shader);
+    error = ttoy_ShaderCompiler_beginBuild(
+        &job,  /* job */
+        &shader  /* shader */
+        );
+    if (error == TTOY_NO_ERROR) {
+      error = ttoy_Shader_finishLinkProgram(&shader);
+    }
+    ttoy_ShaderCompiler_freeJob(&job);
+    if (error != TTOY_NO_ERROR) {
+      ttoy_Shader_destroy(&shader);
+    }
+    /* Make sure the GL is done with the program before another context
+     * draws with it */
+    glFinish();
+    ASSERT_GL_ERROR();
+    ttoy_checkGLFrameErrors();
+
+    SDL_LockMutex(self->internal->mutex);
+    if (self->internal->hasResult) {
+      /* Nobody polled the previous program before this one was built */
+      ttoy_Shader_destroy(&self->internal->result);
+    }
+    self->internal->result = shader;
+    self->internal->resultError = error;
+    self->internal->hasResult = 1;
+    self->internal->building = 0;
+  }
+  SDL_UnlockMutex(self->internal->mutex);
+
+  SDL_GL_MakeCurrent(self->internal->window, NULL);
+
+  return 0;
+}
+
+ttoy_ErrorCode
+ttoy_ShaderCompiler_beginBuild(
+    ttoy_ShaderCompiler_Job *job,
+    ttoy_Shader *shader)
+{
+  ttoy_ErrorCode error;
+
+  error = ttoy_Shader_compileShaderFromString(shader,
+      job->vertSource,  /* code */
+      -1,  /* length */
+      GL_VERTEX_SHADER  /* type */
+      );
+  if (error != TTOY_NO_ERROR) {
+    return error;
+  }
+  error = ttoy_Shader_compileShaderFromFile(shader,
+      job->fragPath,  /* filePath */
+      GL_FRAGMENT_SHADER  /* type */
+      );
+  if (error != TTOY_NO_ERROR) {
+    return error;
+  }
+  return ttoy_Shader_beginLinkProgram(shader);
+}
+
+void
+ttoy_ShaderCompiler_freeJob(
+    ttoy_ShaderCompiler_Job *job)
+{
+  free(job->vertSource);
+  free(job->fragPath);
+  job->vertSource = NULL;
+  job->fragPath = NULL;
+}
+
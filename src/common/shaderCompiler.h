@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2016-2017 Jonathan Glines
+ * Jonathan Glines <jonathan@glines.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef TTOY_COMMON_SHADER_COMPILER_H_
+#define TTOY_COMMON_SHADER_COMPILER_H_
+
+#include <ttoy/error.h>
+
+#include "shader.h"
+
+struct ttoy_ShaderCompiler_Internal_;
+typedef struct ttoy_ShaderCompiler_Internal_ ttoy_ShaderCompiler_Internal;
+
+/**
+ * Builds shader programs without stalling the thread that draws with them.
+ *
+ * Programs are compiled and linked on a worker thread with its own GL
+ * context, shared with the context that was current when the compiler was
+ * initialized. If a shared context cannot be created, programs are instead
+ * built on the calling thread from ttoy_ShaderCompiler_poll(), spread across
+ * several calls where the GL supports KHR_parallel_shader_compile.
+ */
+typedef struct ttoy_ShaderCompiler_ {
+  ttoy_ShaderCompiler_Internal *internal;
+} ttoy_ShaderCompiler;
+
+/**
+ * Must be called on the thread with the current GL context, and with the
+ * same SDL GL attributes that the current context was created with.
+ */
+ttoy_ErrorCode
+ttoy_ShaderCompiler_init(
+    ttoy_ShaderCompiler *self);
+
+void
+ttoy_ShaderCompiler_destroy(
+    ttoy_ShaderCompiler *self);
+
+/**
+ * Requests a shader program built from the given vertex shader source and
+ * the fragment shader source in the given file. A request that has not
+ * started building yet is replaced.
+ */
+void
+ttoy_ShaderCompiler_compileProgram(
+    ttoy_ShaderCompiler *self,
+    const char *vertSource,
+    const char *fragPath);
+
+/**
+ * Checks for a finished program without blocking. When a build has finished,
+ * sets ready to non-zero and returns the result of the build; on success the
+ * given shader is initialized with the linked program and must be destroyed
+ * by the caller.
+ */
+ttoy_ErrorCode
+ttoy_ShaderCompiler_poll(
+    ttoy_ShaderCompiler *self,
+    ttoy_Shader *shader,
+    int *ready);
+
+/**
+ * Returns non-zero while a requested program has yet to be polled, i.e. while
+ * ttoy_ShaderCompiler_poll() might still return a new program.
+ */
+int
+ttoy_ShaderCompiler_isBusy(
+    ttoy_ShaderCompiler *self);
+
+#endif
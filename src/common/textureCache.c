@@ -0,0 +1,556 @@
+/*
+ * Copyright (c) 2016-2017 Jonathan Glines
+ * Jonathan Glines <jonathan@glines.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <SDL.h>
+#include <SDL_mutex.h>
+#include <SDL_thread.h>
+#include <assert.h>
+#include <png.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../logging.h"
+#include "glError.h"
+#include "hash.h"
+
+#include "textureCache.h"
+
+/* A GL texture, shared by every cached texture with the same contents */
+typedef struct ttoy_TextureCache_Entry_ {
+  uint64_t key;
+  GLuint texture;
+  int refCount;
+  struct ttoy_TextureCache_Entry_ *next;
+} ttoy_TextureCache_Entry;
+
+typedef enum ttoy_CachedTexture_State_ {
+  TTOY_CACHED_TEXTURE_QUEUED,
+  TTOY_CACHED_TEXTURE_DECODING,
+  TTOY_CACHED_TEXTURE_DECODED,
+  TTOY_CACHED_TEXTURE_READY,
+  TTOY_CACHED_TEXTURE_FAILED,
+} ttoy_CachedTexture_State;
+
+struct ttoy_CachedTexture_ {
+  char *path;
+  int width, height;
+  /* The following are guarded by the cache mutex until the texture is ready
+   * or has failed */
+  ttoy_CachedTexture_State state;
+  int released;
+  uint64_t key;
+  unsigned char *pixels;
+  ttoy_TextureCache_Entry *entry;
+  struct ttoy_CachedTexture_ *next;
+};
+
+/* Private methods */
+void ttoy_TextureCache_init();
+
+int ttoy_TextureCache_decodeThread(
+    void *data);
+
+ttoy_ErrorCode
+ttoy_TextureCache_decode(
+    ttoy_CachedTexture *texture);
+
+ttoy_ErrorCode
+ttoy_TextureCache_readFile(
+    const char *path,
+    unsigned char **data,
+    size_t *size);
+
+void ttoy_TextureCache_upload(
+    ttoy_CachedTexture *texture);
+
+void ttoy_TextureCache_unlink(
+    ttoy_CachedTexture *texture);
+
+/* NOTE: The cache is shared by every toy in the process, so that toys loading
+ * the same image share its texture. The textures themselves are shared with
+ * every GL context that shares objects with the one that uploaded them. */
+static struct {
+  SDL_SpinLock initLock;
+  SDL_mutex *mutex;
+  ttoy_CachedTexture *textures;
+  ttoy_TextureCache_Entry *entries;
+  int decoding;  /* Whether the decode thread is running */
+} cache;
+
+void ttoy_TextureCache_init()
+{
+  SDL_AtomicLock(&cache.initLock);
+  if (cache.mutex == NULL) {
+    cache.mutex = SDL_CreateMutex();
+  }
+  SDL_AtomicUnlock(&cache.initLock);
+}
+
+ttoy_CachedTexture *
+ttoy_TextureCache_load(
+    const char *path,
+    int width,
+    int height)
+{
+  ttoy_CachedTexture *texture;
+  SDL_Thread *thread;
+
+  ttoy_TextureCache_init();
+
+  texture = (ttoy_CachedTexture *)malloc(sizeof(ttoy_CachedTexture));
+  if (texture == NULL) {
+    return NULL;
+  }
+  texture->path = (char *)malloc(strlen(path) + 1);
+  if (texture->path == NULL) {
+    free(texture);
+    return NULL;
+  }
+  strcpy(texture->path, path);
+  texture->width = width;
+  texture->height = height;
+  texture->state = TTOY_CACHED_TEXTURE_QUEUED;
+  texture->released = 0;
+  texture->pixels = NULL;
+  texture->entry = NULL;
+
+  SDL_LockMutex(cache.mutex);
+  texture->next = cache.textures;
+  cache.textures = texture;
+  if (!cache.decoding) {
+    /* Start a thread to decode the queued images. The thread exits once it
+     * runs out of images. */
+    thread = SDL_CreateThread(
+        ttoy_TextureCache_decodeThread,  /* fn */
+        "ttoy_TextureCache_decodeThread",  /* name */
+        NULL  /* data */
+        );
+    if (thread == NULL) {
+      TTOY_LOG_ERROR("Failed to create image decode thread: %s",
+          SDL_GetError());
+      texture->state = TTOY_CACHED_TEXTURE_FAILED;
+    } else {
+      SDL_DetachThread(thread);
+      cache.decoding = 1;
+    }
+  }
+  SDL_UnlockMutex(cache.mutex);
+
+  return texture;
+}
+
+int ttoy_TextureCache_decodeThread(
+    void *data)
+{
+  ttoy_CachedTexture *texture, *queued;
+  ttoy_ErrorCode error;
+
+  while (1) {
+    /* Find the oldest image waiting to be decoded */
+    SDL_LockMutex(cache.mutex);
+    queued = NULL;
+    for (texture = cache.textures; texture != NULL; texture = texture->next) {
+      if (texture->state == TTOY_CACHED_TEXTURE_QUEUED) {
+        queued = texture;
+      }
+    }
+    if (queued == NULL) {
+      cache.decoding = 0;
+      SDL_UnlockMutex(cache.mutex);
+      return 0;
+    }
+    queued->state = TTOY_CACHED_TEXTURE_DECODING;
+    SDL_UnlockMutex(cache.mutex);
+
+    /* Decode the image without holding the mutex */
+    error = ttoy_TextureCache_decode(queued);
+    if (error != TTOY_NO_ERROR) {
+      TTOY_LOG_ERROR("Failed to load image '%s': %s",
+          queued->path,
+          ttoy_ErrorString(error));
+    }
+
+    SDL_LockMutex(cache.mutex);
+    queued->state = error == TTOY_NO_ERROR
+      ? TTOY_CACHED_TEXTURE_DECODED : TTOY_CACHED_TEXTURE_FAILED;
+    if (queued->released) {
+      /* Nobody wants this image anymore */
+      ttoy_TextureCache_unlink(queued);
+      free(queued->pixels);
+      free(queued->path);
+      free(queued);
+    }
+    SDL_UnlockMutex(cache.mutex);
+  }
+}
+
+ttoy_ErrorCode
+ttoy_TextureCache_decode(
+    ttoy_CachedTexture *texture)
+{
+  png_image image;
+  unsigned char *data;
+  size_t size;
+  ttoy_ErrorCode error;
+
+  error = ttoy_TextureCache_readFile(texture->path,
+      &data,  /* data */
+      &size  /* size */
+      );
+  if (error != TTOY_NO_ERROR) {
+    return error;
+  }
+  /* Images are identified by their contents, so that the same image in
+   * different files is only uploaded once */
+  texture->key = ttoy_hash(TTOY_HASH_INIT, data, size);
+
+  if (texture->width > 0 && texture->height > 0) {
+    /* The file holds raw pixels, which we use as they are */
+    if (size != (size_t)texture->width * (size_t)texture->height * 4) {
+      free(data);
+      return TTOY_ERROR_IMAGE_DECODE_FAILED;
+    }
+    texture->key = ttoy_hash(texture->key,
+        &texture->width, sizeof(texture->width));
+    texture->key = ttoy_hash(texture->key,
+        &texture->height, sizeof(texture->height));
+    texture->pixels = data;
+    return TTOY_NO_ERROR;
+  }
+
+  /* Decode the PNG image */
+  memset(&image, 0, sizeof(image));
+  image.version = PNG_IMAGE_VERSION;
+  if (!png_image_begin_read_from_memory(&image, data, size)) {
+    TTOY_LOG_ERROR("libpng: %s", image.message);
+    free(data);
+    return TTOY_ERROR_IMAGE_DECODE_FAILED;
+  }
+  image.format = PNG_FORMAT_RGBA;
+  texture->width = image.width;
+  texture->height = image.height;
+  texture->pixels = (unsigned char *)malloc(PNG_IMAGE_SIZE(image));
+  if (texture->pixels == NULL) {
+    png_image_free(&image);
+    free(data);
+    return TTOY_ERROR_OUT_OF_MEMORY;
+  }
+  /* NOTE: A negative row stride stores the rows from the bottom up, which is
+   * the order that the GL expects */
+  if (!png_image_finish_read(&image,
+        NULL,  /* background */
+        texture->pixels,  /* buffer */
+        -(png_int_32)PNG_IMAGE_ROW_STRIDE(image),  /* row_stride */
+        NULL  /* colormap */
+        ))
+  {
+    TTOY_LOG_ERROR("libpng: %s", image.message);
+    free(texture->pixels);
+    texture->pixels = NULL;
+    free(data);
+    return TTOY_ERROR_IMAGE_DECODE_FAILED;
+  }
+  free(data);
+
+  return TTOY_NO_ERROR;
+}
+
+ttoy_ErrorCode
+ttoy_TextureCache_readFile(
+    const char *path,
+    unsigned char **data,
+    size_t *size)
+{
+  FILE *file;
+  long length;
+
+  file = fopen(path, "rb");
+  if (file == NULL) {
+    return TTOY_ERROR_IMAGE_FILE_READ;
+  }
+  if (fseek(file, 0, SEEK_END) != 0
+      || (length = ftell(file)) < 0
+      || fseek(file, 0, SEEK_SET) != 0)
+  {
+    fclose(file);
+    return TTOY_ERROR_IMAGE_FILE_READ;
+  }
+  *data = (unsigned char *)malloc(length > 0 ? length : 1);
+  if (*data == NULL) {
+    fclose(file);
+    return TTOY_ERROR_OUT_OF_MEMORY;
+  }
+  if (fread(*data, 1, length, file) != (size_t)length) {
+    free(*data);
+    fclose(file);
+    return TTOY_ERROR_IMAGE_FILE_READ;
+  }
+  fclose(file);
+  *size = length;
+
+  return TTOY_NO_ERROR;
+}
+
+void
+ttoy_TextureCache_update()
+{
+  ttoy_CachedTexture *texture;
+  ttoy_TextureCache_Entry *entry;
+  int numUploads;
+
+  if (cache.mutex == NULL) {
+    /* Nothing has been loaded yet */
+    return;
+  }
+
+  numUploads = 0;
+  SDL_LockMutex(cache.mutex);
+  for (texture = cache.textures; texture != NULL; texture = texture->next) {
+    if (texture->state != TTOY_CACHED_TEXTURE_DECODED
+        || texture->released)
+    {
+      continue;
+    }
+    /* Look for a texture with the same contents */
+    for (entry = cache.entries; entry != NULL; entry = entry->next) {
+      if (entry->key == texture->key) {
+        break;
+      }
+    }
+    if (entry != NULL) {
+      entry->refCount += 1;
+      texture->entry = entry;
+    } else {
+      if (numUploads >= TTOY_TEXTURE_CACHE_MAX_UPLOADS) {
+        /* Leave the rest for later calls */
+        continue;
+      }
+      ttoy_TextureCache_upload(texture);
+      numUploads += 1;
+    }
+    free(texture->pixels);
+    texture->pixels = NULL;
+    texture->state = texture->entry != NULL
+      ? TTOY_CACHED_TEXTURE_READY : TTOY_CACHED_TEXTURE_FAILED;
+  }
+  SDL_UnlockMutex(cache.mutex);
+}
+
+void ttoy_TextureCache_upload(
+    ttoy_CachedTexture *texture)
+{
+  static GLuint pixelBuffer = 0;
+  ttoy_TextureCache_Entry *entry;
+  GLsizeiptr size;
+  void *mapped;
+
+  entry = (ttoy_TextureCache_Entry *)malloc(sizeof(ttoy_TextureCache_Entry));
+  if (entry == NULL) {
+    TTOY_LOG_ERROR_CODE(TTOY_ERROR_OUT_OF_MEMORY);
+    return;
+  }
+  size = (GLsizeiptr)texture->width * texture->height * 4;
+
+  /* Copy the pixels into a pixel buffer object, so that the driver can
+   * transfer them to the texture asynchronously rather than copying them
+   * before glTexImage2D() returns */
+  if (pixelBuffer == 0) {
+    glGenBuffers(
+        1,  /* n */
+        &pixelBuffer  /* buffers */
+        );
+    ASSERT_GL_ERROR();
+  }
+  glBindBuffer(
+      GL_PIXEL_UNPACK_BUFFER,  /* target */
+      pixelBuffer  /* buffer */
+      );
+  ASSERT_GL_ERROR();
+  /* NOTE: Reallocating the storage orphans the storage of the previous
+   * upload, which the GL might still be reading from */
+  glBufferData(
+      GL_PIXEL_UNPACK_BUFFER,  /* target */
+      size,  /* size */
+      NULL,  /* data */
+      GL_STREAM_DRAW  /* usage */
+      );
+  ASSERT_GL_ERROR();
+  mapped = glMapBufferRange(
+      GL_PIXEL_UNPACK_BUFFER,  /* target */
+      0,  /* offset */
+      size,  /* length */
+      GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT  /* access */
+      );
+  ASSERT_GL_ERROR();
+  memcpy(mapped, texture->pixels, size);
+  glUnmapBuffer(
+      GL_PIXEL_UNPACK_BUFFER  /* target */
+      );
+  ASSERT_GL_ERROR();
+
+  /* Create the texture from the pixel buffer */
+  glGenTextures(
+      1,  /* n */
+      &entry->texture  /* textures */
+      );
+  ASSERT_GL_ERROR();
+  glBindTexture(
+      GL_TEXTURE_2D,  /* target */
+      entry->texture  /* texture */
+      );
+  ASSERT_GL_ERROR();
+  glTexParameteri(
+      GL_TEXTURE_2D,  /* target */
+      GL_TEXTURE_MIN_FILTER,  /* pname */
+      GL_LINEAR_MIPMAP_LINEAR  /* param */
+      );
+  ASSERT_GL_ERROR();
+  glTexParameteri(
+      GL_TEXTURE_2D,  /* target */
+      GL_TEXTURE_MAG_FILTER,  /* pname */
+      GL_LINEAR  /* param */
+      );
+  ASSERT_GL_ERROR();
+  glTexParameteri(
+      GL_TEXTURE_2D,  /* target */
+      GL_TEXTURE_WRAP_S,  /* pname */
+      GL_REPEAT  /* param */
+      );
+  ASSERT_GL_ERROR();
+  glTexParameteri(
+      GL_TEXTURE_2D,  /* target */
+      GL_TEXTURE_WRAP_T,  /* pname */
+      GL_REPEAT  /* param */
+      );
+  ASSERT_GL_ERROR();
+  glTexImage2D(
+      GL_TEXTURE_2D,  /* target */
+      0,  /* level */
+      GL_RGBA8,  /* internalFormat */
+      texture->width,  /* width */
+      texture->height,  /* height */
+      0,  /* border */
+      GL_RGBA,  /* format */
+      GL_UNSIGNED_BYTE,  /* type */
+      (const GLvoid *)0  /* data (offset into the pixel buffer) */
+      );
+  ASSERT_GL_ERROR();
+  glGenerateMipmap(
+      GL_TEXTURE_2D  /* target */
+      );
+  ASSERT_GL_ERROR();
+  glBindTexture(
+      GL_TEXTURE_2D,  /* target */
+      0  /* texture */
+      );
+  ASSERT_GL_ERROR();
+  glBindBuffer(
+      GL_PIXEL_UNPACK_BUFFER,  /* target */
+      0  /* buffer */
+      );
+  ASSERT_GL_ERROR();
+
+  entry->key = texture->key;
+  entry->refCount = 1;
+  entry->next = cache.entries;
+  cache.entries = entry;
+  texture->entry = entry;
+}
+
+GLuint
+ttoy_TextureCache_getTexture(
+    ttoy_CachedTexture *texture)
+{
+  GLuint result;
+
+  SDL_LockMutex(cache.mutex);
+  result = texture->state == TTOY_CACHED_TEXTURE_READY
+    ? texture->entry->texture : 0;
+  SDL_UnlockMutex(cache.mutex);
+
+  return result;
+}
+
+int
+ttoy_TextureCache_isPending(
+    ttoy_CachedTexture *texture)
+{
+  int result;
+
+  SDL_LockMutex(cache.mutex);
+  result = texture->state != TTOY_CACHED_TEXTURE_READY
+    && texture->state != TTOY_CACHED_TEXTURE_FAILED;
+  SDL_UnlockMutex(cache.mutex);
+
+  return result;
+}
+
+void
+ttoy_TextureCache_release(
+    ttoy_CachedTexture *texture)
+{
+  ttoy_TextureCache_Entry **prev, *entry;
+
+  SDL_LockMutex(cache.mutex);
+  if (texture->state == TTOY_CACHED_TEXTURE_DECODING) {
+    /* The decode thread frees the texture once it is done with it */
+    texture->released = 1;
+    SDL_UnlockMutex(cache.mutex);
+    return;
+  }
+  ttoy_TextureCache_unlink(texture);
+  entry = texture->entry;
+  if (entry != NULL) {
+    entry->refCount -= 1;
+    if (entry->refCount == 0) {
+      /* Delete the texture, since nothing else shares it */
+      for (prev = &cache.entries; *prev != entry; prev = &(*prev)->next) {
+        assert(*prev != NULL);
+      }
+      *prev = entry->next;
+      glDeleteTextures(
+          1,  /* n */
+          &entry->texture  /* textures */
+          );
+      ASSERT_GL_ERROR();
+      free(entry);
+    }
+  }
+  SDL_UnlockMutex(cache.mutex);
+  free(texture->pixels);
+  free(texture->path);
+  free(texture);
+}
+
+void ttoy_TextureCache_unlink(
+    ttoy_CachedTexture *texture)
+{
+  ttoy_CachedTexture **prev;
+
+  /* NOTE: The mutex must be held */
+  for (prev = &cache.textures; *prev != texture; prev = &(*prev)->next) {
+    assert(*prev != NULL);
+  }
+  *prev = texture->next;
+}
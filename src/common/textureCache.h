@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2016-2017 Jonathan Glines
+ * Jonathan Glines <jonathan@glines.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef TTOY_COMMON_TEXTURE_CACHE_H_
+#define TTOY_COMMON_TEXTURE_CACHE_H_
+
+#include <GL/glew.h>
+
+#include <ttoy/error.h>
+
+/* Maximum number of textures uploaded to the GL per call to
+ * ttoy_TextureCache_update(), so that loading many images at once does not
+ * stall a frame */
+#define TTOY_TEXTURE_CACHE_MAX_UPLOADS 1
+
+struct ttoy_CachedTexture_;
+typedef struct ttoy_CachedTexture_ ttoy_CachedTexture;
+
+/**
+ * Requests a texture for the image in the given file, without blocking.
+ *
+ * If width and height are zero, the file is decoded as a PNG image; otherwise
+ * it must hold exactly width by height RGBA pixels with 8 bits per channel,
+ * given from the bottom row up. Files are read and decoded on a worker thread.
+ * Images with the same contents share a single GL texture, even if they were
+ * loaded from different files.
+ *
+ * The returned texture must be released with ttoy_TextureCache_release().
+ * Returns NULL if out of memory.
+ */
+ttoy_CachedTexture *
+ttoy_TextureCache_load(
+    const char *path,
+    int width,
+    int height);
+
+/**
+ * Uploads decoded images to the GL. This must be called regularly, on a
+ * thread with a GL context that shares objects with the contexts that draw
+ * the textures.
+ */
+void
+ttoy_TextureCache_update();
+
+/**
+ * Returns the GL texture of the given cached texture, or zero if its image
+ * has not been uploaded yet or could not be loaded. Textures have mipmaps and
+ * repeat.
+ */
+GLuint
+ttoy_TextureCache_getTexture(
+    ttoy_CachedTexture *texture);
+
+/**
+ * Returns non-zero while the image of the given texture is still being
+ * loaded, i.e. until ttoy_TextureCache_getTexture() has its final result.
+ */
+int
+ttoy_TextureCache_isPending(
+    ttoy_CachedTexture *texture);
+
+/**
+ * Releases the given texture, deleting its GL texture if no other cached
+ * texture shares it. Must be called on a thread with a GL context.
+ */
+void
+ttoy_TextureCache_release(
+    ttoy_CachedTexture *texture);
+
+#endif
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2016-2017 Jonathan Glines
+ * Jonathan Glines <jonathan@glines.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "vector.h"
+
+/* Allocate at least one cache line worth of elements on first growth */
+#define TTOY_VECTOR_MIN_BYTES 64
+
+void ttoy_Vector_init(
+    ttoy_Vector *self)
+{
+  /* Defer allocation until the first element is added */
+  self->data = NULL;
+  self->size = 0;
+  self->capacity = 0;
+}
+
+void ttoy_Vector_destroy(
+    ttoy_Vector *self)
+{
+  free(self->data);
+}
+
+ttoy_ErrorCode
+ttoy_Vector_reserve(
+    ttoy_Vector *self,
+    size_t elementSize,
+    size_t capacity)
+{
+  void *newData;
+
+  if (capacity <= self->capacity)
+    return TTOY_NO_ERROR;
+
+  /* Reallocate in place when possible, which avoids the copy entirely for
+   * large arrays that the allocator can extend */
+  newData = realloc(self->data, elementSize * capacity);
+  if (newData == NULL) {
+    return TTOY_ERROR_OUT_OF_MEMORY;
+  }
+  self->data = newData;
+  self->capacity = capacity;
+
+  return TTOY_NO_ERROR;
+}
+
+void ttoy_Vector_shrink(
+    ttoy_Vector *self,
+    size_t elementSize)
+{
+  void *newData;
+
+  if (self->size == self->capacity)
+    return;
+  if (self->size == 0) {
+    free(self->data);
+    self->data = NULL;
+    self->capacity = 0;
+    return;
+  }
+
+  newData = realloc(self->data, elementSize * self->size);
+  if (newData == NULL) {
+    /* Keeping the larger buffer around is harmless */
+    return;
+  }
+  self->data = newData;
+  self->capacity = self->size;
+}
+
+ttoy_ErrorCode
+ttoy_Vector_append(
+    ttoy_Vector *self,
+    size_t elementSize,
+    const void *values,
+    size_t count)
+{
+  ttoy_ErrorCode error;
+
+  /* Ensure we have enough memory to hold the additional values */
+  if (self->size + count > self->capacity) {
+    size_t capacity;
+    /* Grow geometrically so that appending is amortized constant time */
+    capacity = self->capacity * 2;
+    if (capacity * elementSize < TTOY_VECTOR_MIN_BYTES)
+      capacity = (TTOY_VECTOR_MIN_BYTES + elementSize - 1) / elementSize;
+    while (capacity < self->size + count)
+      capacity *= 2;
+    error = ttoy_Vector_reserve(self,
+        elementSize,  /* elementSize */
+        capacity  /* capacity */
+        );
+    if (error != TTOY_NO_ERROR)
+      return error;
+  }
+
+  /* Copy the new values to the end of our data */
+  memcpy(
+      (char *)self->data + self->size * elementSize,
+      values,
+      count * elementSize);
+  self->size += count;
+
+  return TTOY_NO_ERROR;
+}
@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2016-2017 Jonathan Glines
+ * Jonathan Glines <jonathan@glines.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef TTOY_COMMON_VECTOR_H_
+#define TTOY_COMMON_VECTOR_H_
+
+#include <ttoy/error.h>
+
+#include <assert.h>
+#include <stddef.h>
+
+/**
+ * A dynamic array that stores its elements inline in a single contiguous
+ * allocation. A ttoy_Vector owns copies of its elements, so iterating over it
+ * does not chase pointers and the data can be handed directly to the GL.
+ *
+ * The generic functions operate on raw bytes given the size of each element;
+ * use TTOY_DECLARE_VECTOR() to declare a type-safe vector of some type, or
+ * TTOY_DECLARE_NAMED_VECTOR() when the value type is not a plain identifier,
+ * such as a pointer type.
+ */
+typedef struct ttoy_Vector_ {
+  void *data;
+  size_t size, capacity;
+} ttoy_Vector;
+
+void ttoy_Vector_init(
+    ttoy_Vector *self);
+
+void ttoy_Vector_destroy(
+    ttoy_Vector *self);
+
+ttoy_ErrorCode
+ttoy_Vector_reserve(
+    ttoy_Vector *self,
+    size_t elementSize,
+    size_t capacity);
+
+void ttoy_Vector_shrink(
+    ttoy_Vector *self,
+    size_t elementSize);
+
+ttoy_ErrorCode
+ttoy_Vector_append(
+    ttoy_Vector *self,
+    size_t elementSize,
+    const void *values,
+    size_t count);
+
+#define TTOY_DECLARE_VECTOR( \
+    VALUE_TYPE) \
+  TTOY_DECLARE_NAMED_VECTOR(VALUE_TYPE ## Vector, VALUE_TYPE)
+
+/* NOTE: The value type is always written before const, so that vectors of
+ * pointers hand out pointers to const pointers rather than pointers to
+ * pointers to const values */
+#define TTOY_DECLARE_NAMED_VECTOR( \
+    VECTOR_TYPE, \
+    VALUE_TYPE) \
+typedef struct VECTOR_TYPE ## _ { \
+  ttoy_Vector base; \
+} VECTOR_TYPE; \
+static inline void VECTOR_TYPE ## _init( \
+    VECTOR_TYPE *self) \
+{ \
+  ttoy_Vector_init(&self->base); \
+} \
+static inline void VECTOR_TYPE ## _destroy( \
+    VECTOR_TYPE *self) \
+{ \
+  ttoy_Vector_destroy(&self->base); \
+} \
+static inline ttoy_ErrorCode VECTOR_TYPE ## _reserve( \
+    VECTOR_TYPE *self, \
+    size_t capacity) \
+{ \
+  return ttoy_Vector_reserve(&self->base, sizeof(VALUE_TYPE), capacity); \
+} \
+static inline void VECTOR_TYPE ## _shrink( \
+    VECTOR_TYPE *self) \
+{ \
+  ttoy_Vector_shrink(&self->base, sizeof(VALUE_TYPE)); \
+} \
+static inline ttoy_ErrorCode VECTOR_TYPE ## _append( \
+    VECTOR_TYPE *self, \
+    VALUE_TYPE const *value) \
+{ \
+  if (self->base.size < self->base.capacity) { \
+    /* Fast path for when no growth is needed */ \
+    ((VALUE_TYPE *)self->base.data)[self->base.size++] = *value; \
+    return TTOY_NO_ERROR; \
+  } \
+  return ttoy_Vector_append(&self->base, sizeof(VALUE_TYPE), value, 1); \
+} \
+static inline ttoy_ErrorCode VECTOR_TYPE ## _appendN( \
+    VECTOR_TYPE *self, \
+    VALUE_TYPE const *values, \
+    size_t count) \
+{ \
+  return ttoy_Vector_append(&self->base, sizeof(VALUE_TYPE), values, count); \
+} \
+static inline VALUE_TYPE *VECTOR_TYPE ## _get( \
+    VECTOR_TYPE *self, \
+    size_t index) \
+{ \
+  assert(index < self->base.size); \
+  return &((VALUE_TYPE *)self->base.data)[index]; \
+} \
+static inline VALUE_TYPE *VECTOR_TYPE ## _data( \
+    VECTOR_TYPE *self) \
+{ \
+  return (VALUE_TYPE *)self->base.data; \
+} \
+static inline size_t VECTOR_TYPE ## _size( \
+    const VECTOR_TYPE *self) \
+{ \
+  return self->base.size; \
+} \
+/* NOTE: Removal moves the last value into the removed slot, so it does not \
+ * preserve the order of values */ \
+static inline void VECTOR_TYPE ## _remove( \
+    VECTOR_TYPE *self, \
+    size_t index) \
+{ \
+  assert(index < self->base.size); \
+  self->base.size -= 1; \
+  ((VALUE_TYPE *)self->base.data)[index] = \
+    ((VALUE_TYPE *)self->base.data)[self->base.size]; \
+} \
+static inline void VECTOR_TYPE ## _clear( \
+    VECTOR_TYPE *self) \
+{ \
+  self->base.size = 0; \
+}
+
+#endif
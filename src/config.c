@@ -24,6 +24,7 @@
 #include <assert.h>
 #include <errno.h>
 #include <jansson.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -64,6 +65,8 @@ ttoy_ErrorCode ttoy_Config_insertNewProfile(
 ttoy_ErrorCode ttoy_Config_serialize(
     const ttoy_Config *self,
     const char *path);
+size_t ttoy_Config_megabytesToBytes(
+    double megabytes);
 
 struct ttoy_Config_Internal {
   /* FIXME: Since we are returning pointers to these profiles, this might be
@@ -531,7 +534,8 @@ ttoy_Config_buildProfile(
     json_t *profile_json)
 {
   json_t *name, *fontFace, *fallbackFontFaces, *fontSize, *antialiasFont,
-      *brightIsBold, *colors, *background;
+      *brightIsBold, *colors, *scrollbackLimit, *scrollbackSpill,
+      *scrollbackSpillLimit, *background;
   uint32_t flags;
   ttoy_ErrorCode error;
 
@@ -647,12 +651,64 @@ ttoy_Config_buildProfile(
     }
   }
 
+  /* The scrollback memory limit is optional */
+  scrollbackLimit = json_object_get(profile_json, "scrollbackLimit");
+  if (scrollbackLimit == NULL || json_is_null(scrollbackLimit)) {
+    /* Use the default limit */
+  } else if (!json_is_number(scrollbackLimit)
+      || json_number_value(scrollbackLimit) < 0.0)
+  {
+    TTOY_LOG_ERROR(
+        "Scrollback limit must be a non-negative number of megabytes in "
+        "profile '%s'",
+        json_string_value(name));
+    return TTOY_ERROR_CONFIG_FILE_FORMAT;
+  } else {
+    /* NOTE: A limit of zero disables the scrollback, and a limit too large
+     * to represent leaves it unlimited */
+    profile->scrollbackLimit = ttoy_Config_megabytesToBytes(
+        json_number_value(scrollbackLimit)  /* megabytes */
+        );
+  }
+  /* Spilling old scrollback to disk is optional, and off unless enabled */
+  scrollbackSpill = json_object_get(profile_json, "scrollbackSpill");
+  if (scrollbackSpill == NULL || json_is_null(scrollbackSpill)) {
+    /* Discard the oldest lines once the memory limit is reached */
+  } else if (!json_is_boolean(scrollbackSpill)) {
+    TTOY_LOG_ERROR("Scrollback spill must be a boolean in profile '%s'",
+        json_string_value(name));
+    return TTOY_ERROR_CONFIG_FILE_FORMAT;
+  } else if (json_boolean_value(scrollbackSpill)) {
+    ttoy_Profile_setFlags(profile,
+        profile->flags | TTOY_PROFILE_SPILL_SCROLLBACK);
+  }
+  /* The disk limit for spilled scrollback is optional */
+  scrollbackSpillLimit = json_object_get(profile_json,
+      "scrollbackSpillLimit");
+  if (scrollbackSpillLimit == NULL || json_is_null(scrollbackSpillLimit)) {
+    /* Use the default limit */
+  } else if (!json_is_number(scrollbackSpillLimit)
+      || json_number_value(scrollbackSpillLimit) < 0.0)
+  {
+    TTOY_LOG_ERROR(
+        "Scrollback spill limit must be a non-negative number of megabytes "
+        "in profile '%s'",
+        json_string_value(name));
+    return TTOY_ERROR_CONFIG_FILE_FORMAT;
+  } else {
+    /* NOTE: A limit of zero disables spilling, and a limit too large to
+     * represent leaves the spilled scrollback unlimited */
+    profile->scrollbackSpillLimit = ttoy_Config_megabytesToBytes(
+        json_number_value(scrollbackSpillLimit)  /* megabytes */
+        );
+  }
+
   /* Get the background toy used by this profile */
   background = json_object_get(profile_json, "background");
   if (background == NULL || json_is_null(background)) {
     /* The background was not specified; this is okay */
   } else if (json_is_object(background)) {
-    json_t *toyName;
+    json_t *toyName, *budget, *direct;
     ttoy_BackgroundToy *backgroundToy;
     toyName = json_object_get(background, "toy");
     if (!json_is_string(toyName)) {
@@ -672,6 +728,31 @@ ttoy_Config_buildProfile(
       return TTOY_ERROR_CONFIG_FILE_FORMAT;
     }
     ttoy_Profile_setBackgroundToy(profile, backgroundToy);
+    /* The GPU time budget of the background toy is optional */
+    budget = json_object_get(background, "budget");
+    if (budget == NULL || json_is_null(budget)) {
+      /* Use the default budget */
+    } else if (!json_is_number(budget) || json_number_value(budget) <= 0.0) {
+      TTOY_LOG_ERROR(
+          "Background budget must be a positive number of milliseconds in "
+          "profile '%s'",
+          json_string_value(name));
+      return TTOY_ERROR_CONFIG_FILE_FORMAT;
+    } else {
+      profile->backgroundBudget = (float)json_number_value(budget);
+    }
+    /* Rendering the background toy directly to the window is optional */
+    direct = json_object_get(background, "direct");
+    if (direct == NULL || json_is_null(direct)) {
+      /* Render the toy to a texture on its own thread */
+    } else if (!json_is_boolean(direct)) {
+      TTOY_LOG_ERROR("Background direct must be a boolean in profile '%s'",
+          json_string_value(name));
+      return TTOY_ERROR_CONFIG_FILE_FORMAT;
+    } else if (json_boolean_value(direct)) {
+      ttoy_Profile_setFlags(profile,
+          profile->flags | TTOY_PROFILE_DIRECT_BACKGROUND);
+    }
   } else {
     TTOY_LOG_ERROR("Background must be a JSON object in profile '%s'",
         json_string_value(name));
@@ -681,6 +762,16 @@ ttoy_Config_buildProfile(
   return TTOY_NO_ERROR;
 }
 
+size_t ttoy_Config_megabytesToBytes(
+    double megabytes)
+{
+  /* Clamp sizes that do not fit in a size_t, which would otherwise be
+   * undefined behavior to convert */
+  if (megabytes >= (double)SIZE_MAX / (1024.0 * 1024.0))
+    return SIZE_MAX;
+  return (size_t)(megabytes * 1024.0 * 1024.0);
+}
+
 ttoy_ErrorCode ttoy_Config_buildColorScheme(
     ttoy_Config *self,
     ttoy_Profile *profile,
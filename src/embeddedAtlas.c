@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2016-2017 Jonathan Glines
+ * Jonathan Glines <jonathan@glines.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "embeddedFont.h"
+
+/* The embedded atlas is generated at build time by ttoy-atlasgen, which is
+ * itself built without an embedded atlas */
+#ifdef TTOY_EMBEDDED_ATLAS
+#include "embeddedAtlas.atlas.c"
+#endif
+
+void
+ttoy_getEmbeddedAtlas(
+    const uint8_t **data,
+    size_t *size)
+{
+#ifdef TTOY_EMBEDDED_ATLAS
+  *data = (const uint8_t *)embeddedAtlas_atlas;
+  *size = embeddedAtlas_atlas_len;
+#else
+  *data = NULL;
+  *size = 0;
+#endif
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2016-2017 Jonathan Glines
+ * Jonathan Glines <jonathan@glines.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <string.h>
+
+#include "common/hash.h"
+
+#include "embeddedFont.h"
+
+/* Generated at build time from assets/fonts/DejaVuSansMono.ttf */
+#include "assets_fonts_DejaVuSansMono.ttf.c"
+
+int
+ttoy_isEmbeddedFontPath(
+    const char *path)
+{
+  return strcmp(path, TTOY_EMBEDDED_FONT_PATH) == 0;
+}
+
+void
+ttoy_getEmbeddedFont(
+    const FT_Byte **data,
+    size_t *size)
+{
+  *data = (const FT_Byte *)assets_fonts_DejaVuSansMono_ttf;
+  *size = assets_fonts_DejaVuSansMono_ttf_len;
+}
+
+uint64_t
+ttoy_getEmbeddedFontHash()
+{
+  static uint64_t hash = 0;
+
+  if (hash == 0) {
+    hash = ttoy_hash(TTOY_HASH_INIT,
+        assets_fonts_DejaVuSansMono_ttf,  /* data */
+        assets_fonts_DejaVuSansMono_ttf_len  /* size */
+        );
+  }
+
+  return hash;
+}
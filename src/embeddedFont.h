@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2016-2017 Jonathan Glines
+ * Jonathan Glines <jonathan@glines.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef TTOY_EMBEDDED_FONT_H_
+#define TTOY_EMBEDDED_FONT_H_
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+#include <inttypes.h>
+#include <stddef.h>
+
+/**
+ * ttoy carries a monospace font inside its binary, so that it can always
+ * start without Fontconfig or any font files on the system. Profiles naming
+ * this face use the embedded font directly, and it is also used whenever
+ * Fontconfig cannot find the face a profile asks for.
+ */
+#define TTOY_EMBEDDED_FONT_FACE "DejaVu Sans Mono"
+/* The pseudo path through which fonts refer to the embedded font */
+#define TTOY_EMBEDDED_FONT_PATH "[embedded]/DejaVuSansMono.ttf"
+/* The font size of the ASCII atlas packed at build time, which matches the
+ * font size of the default profile */
+#define TTOY_EMBEDDED_FONT_SIZE 12.0f
+
+int
+ttoy_isEmbeddedFontPath(
+    const char *path);
+
+void
+ttoy_getEmbeddedFont(
+    const FT_Byte **data,
+    size_t *size);
+
+/**
+ * Returns a hash of the contents of the embedded font, which stands in for
+ * the modification time of ordinary font files in cache keys.
+ */
+uint64_t
+ttoy_getEmbeddedFontHash();
+
+/**
+ * Returns the glyph atlas cache file packed at build time for the ASCII
+ * glyphs of the embedded font at TTOY_EMBEDDED_FONT_SIZE, or NULL if ttoy was
+ * built without one.
+ */
+void
+ttoy_getEmbeddedAtlas(
+    const uint8_t **data,
+    size_t *size);
+
+#endif
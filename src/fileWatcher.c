@@ -21,82 +21,180 @@
  * IN THE SOFTWARE.
  */
 
+#include <SDL.h>
+#include <SDL_mutex.h>
 #include <SDL_thread.h>
+#include <assert.h>
 #include <errno.h>
 #include <limits.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <sys/inotify.h>
 #include <unistd.h>
 
-#include "./common/array.h"
+#include "./common/hash.h"
+#include "./common/vector.h"
 #include "logging.h"
 
+#include "fileWatcherEvents.h"
+
 #include <ttoy/fileWatcher.h>
 
-/* Private methods */
-int ttoy_FileWatcher_watchThread(
-    ttoy_FileWatcher *self);
+/* Milliseconds that a file must go without changes before its callbacks are
+ * dispatched */
+#define TTOY_FILE_WATCHER_DEBOUNCE 100
+/* Initial size of the hash table of watches, which must be a power of two */
+#define TTOY_FILE_WATCHER_MIN_BUCKETS 16
 
+/* A file watched by a ttoy_FileWatcher */
 typedef struct ttoy_FileWatcher_Watch_ {
-  int descriptor;
-  char *filePath, *fileName, *dirPath;
+  ttoy_FileWatcher *watcher;
+  int descriptor;  /* Watch descriptor of the directory containing the file */
+  const char *fileName;  /* Points into filePath */
+  uint64_t key;
+  /* Ticks of the last change to the file, while a change is waiting to be
+   * dispatched */
+  uint32_t changedTicks;
+  int changed;
+  /* Links for the hash table, the list of watches of the same watcher and
+   * the list of changed watches */
+  struct ttoy_FileWatcher_Watch_ *nextInBucket, *nextInWatcher, *nextChanged;
+  /* The path is stored along with the watch, in the same allocation */
+  char filePath[];
 } ttoy_FileWatcher_Watch;
 
-TTOY_DECLARE_ARRAY(ttoy_FileWatcher_Watch)
-TTOY_DEFINE_ARRAY(ttoy_FileWatcher_Watch)
+/* A directory watched with inotify, shared by all files in it */
+typedef struct ttoy_FileWatcher_Directory_ {
+  int descriptor;
+  int refCount;
+} ttoy_FileWatcher_Directory;
+
+TTOY_DECLARE_VECTOR(ttoy_FileWatcher_Directory)
 
 struct ttoy_FileWatcher_Internal_ {
-  ttoy_FileWatcher_WatchArray watches;
+  ttoy_FileWatcher_Watch *watches;
   ttoy_FileWatcher_FileChangedCallback callback;
   void *callbackData;
-  int fd;
 };
 
+/* Private methods */
+void ttoy_FileWatcher_initService();
+
+int ttoy_FileWatcher_watchThread(
+    void *data);
+
+void ttoy_FileWatcher_handleEvent(
+    const struct inotify_event *event);
+
+int ttoy_FileWatcher_watchDirectory(
+    const char *dirPath);
+
+void ttoy_FileWatcher_unwatchDirectory(
+    int descriptor);
+
+uint64_t ttoy_FileWatcher_hashKey(
+    int descriptor,
+    const char *fileName);
+
+void ttoy_FileWatcher_insertWatch(
+    ttoy_FileWatcher_Watch *watch);
+
+void ttoy_FileWatcher_removeWatch(
+    ttoy_FileWatcher_Watch *watch);
+
+/* NOTE: All file watchers share a single inotify instance and thread. Events
+ * are matched to watches through a hash table keyed on the watch descriptor
+ * of the directory and the name of the file, and callbacks are dispatched
+ * from the main loop once a file has stopped changing. */
+static struct {
+  SDL_SpinLock initLock;
+  SDL_mutex *mutex;
+  int fd;
+  ttoy_FileWatcher_DirectoryVector directories;
+  ttoy_FileWatcher_Watch **buckets;
+  size_t numBuckets, numWatches;
+  ttoy_FileWatcher_Watch *changed;
+} service;
+
+int ttoy_FileWatcher_eventType() {
+  static int eventType = -1;
+
+  /* Register the event type with SDL, if we have not done so already */
+  if (eventType == -1) {
+    /* FIXME: This call to SDL_RegisterEvents() might not be thread safe */
+    eventType = SDL_RegisterEvents(1);
+    if (eventType == -1) {
+      TTOY_LOG_ERROR("%s", "Failed to register file watcher event with SDL");
+      ttoy_Logging_flush();
+      /* TODO: Fail gracefully */
+      assert(0);
+    }
+  }
+
+  return eventType;
+}
+
+void ttoy_FileWatcher_initService()
+{
+  SDL_AtomicLock(&service.initLock);
+  if (service.mutex != NULL) {
+    SDL_AtomicUnlock(&service.initLock);
+    return;
+  }
+  /* NOTE: SDL mutexes are recursive, which lets callbacks watch more files */
+  service.mutex = SDL_CreateMutex();
+  ttoy_FileWatcher_DirectoryVector_init(&service.directories);
+  service.numBuckets = TTOY_FILE_WATCHER_MIN_BUCKETS;
+  service.buckets = (ttoy_FileWatcher_Watch **)calloc(
+      service.numBuckets, sizeof(ttoy_FileWatcher_Watch *));
+  /* Register our event type before the watch thread can push events */
+  ttoy_FileWatcher_eventType();
+  /* Create an inotify instance and store the resulting file descriptor */
+  service.fd = inotify_init1(IN_CLOEXEC);
+  if (service.fd < 0) {
+    TTOY_LOG_ERROR("Error initializing inotify: %s",
+        strerror(errno));
+  } else {
+    /* Spawn a thread to watch the inotify file descriptor for changes */
+    SDL_DetachThread(SDL_CreateThread(
+        ttoy_FileWatcher_watchThread,  /* fn */
+        "ttoy_FileWatcher_watchThread",  /* name */
+        NULL  /* data */
+        ));
+  }
+  SDL_AtomicUnlock(&service.initLock);
+}
+
 void
 ttoy_FileWatcher_init(
     ttoy_FileWatcher *self)
 {
+  ttoy_FileWatcher_initService();
   /* Allocate memory for internal structures */
   self->internal = (ttoy_FileWatcher_Internal *)malloc(
       sizeof(ttoy_FileWatcher_Internal));
-  ttoy_FileWatcher_WatchArray_init(&self->internal->watches);
+  self->internal->watches = NULL;
   self->internal->callback = NULL;
   self->internal->callbackData = NULL;
-  /* Create an inotify instance and store the resulting file descriptor */
-  self->internal->fd = inotify_init();
-  if (self->internal->fd < 0) {
-    TTOY_LOG_ERROR("Error initializing inotify: %s",
-        strerror(errno));
-  }
-  /* Spawn a thread to watch the inotify file descriptor for changes */
-  SDL_CreateThread(
-      (SDL_ThreadFunction)ttoy_FileWatcher_watchThread,  /* fn */
-      "ttoy_FileWatcher_watchThread",  /* name */
-      (void *)self  /* data */
-      );
 }
 
 void
 ttoy_FileWatcher_destroy(
     ttoy_FileWatcher *self)
 {
+  ttoy_FileWatcher_Watch *watch, *next;
+
+  SDL_LockMutex(service.mutex);
   /* Free each of our watch objects */
-  for (size_t i = 0;
-      i < ttoy_FileWatcher_WatchArray_size(&self->internal->watches);
-      ++i)
-  {
-    ttoy_FileWatcher_Watch *watch;
-    watch = ttoy_FileWatcher_WatchArray_get(&self->internal->watches, i);
-    free(watch->filePath);
-    free(watch->fileName);
-    free(watch->dirPath);
+  for (watch = self->internal->watches; watch != NULL; watch = next) {
+    next = watch->nextInWatcher;
+    ttoy_FileWatcher_removeWatch(watch);
+    ttoy_FileWatcher_unwatchDirectory(watch->descriptor);
     free(watch);
   }
-  /* Destroy our watch array */
-  ttoy_FileWatcher_WatchArray_destroy(&self->internal->watches);
-  /* TODO: Close the inotify file descriptor to signal our thread to stop */
-  /* TODO: Join the watch thread */
+  SDL_UnlockMutex(service.mutex);
+  free(self->internal);
 }
 
 void
@@ -105,9 +203,10 @@ ttoy_FileWatcher_setCallback(
     ttoy_FileWatcher_FileChangedCallback callback,
     void *data)
 {
-  /* FIXME: We need this in init. It's ugly to synchronize these. */
+  SDL_LockMutex(service.mutex);
   self->internal->callback = callback;
   self->internal->callbackData = data;
+  SDL_UnlockMutex(service.mutex);
 }
 
 ttoy_ErrorCode
@@ -116,125 +215,321 @@ ttoy_FileWatcher_watchFile(
     const char *filePath)
 {
   const char *fileName;
+  char *dirPath;
   ttoy_FileWatcher_Watch *watch;
-  /* Allocate memory for the watch entry */
-  watch = (ttoy_FileWatcher_Watch *)malloc(sizeof(ttoy_FileWatcher_Watch));
-  /* Copy the file path */
-  watch->filePath = (char *)malloc(strlen(filePath) + 1);
-  strcpy(watch->filePath, filePath);
+  int descriptor;
+
   /* NOTE: Many editors on Linux will actually write to a new file and then
    * replace the original file with the new file by renaming the files. This
    * results in an entirely new file with an entirely new hard link. The
    * inotify API will not detect this situation if we simply watch the file
    * itself; we must watch the entire directory for changes. */
   fileName = strrchr(filePath, '/') ? strrchr(filePath, '/') + 1 : filePath;
-  watch->fileName = (char *)malloc(strlen(fileName) + 1);
-  strcpy(watch->fileName, fileName);
   if (fileName == filePath) {
-    watch->dirPath = (char *)malloc(2);
-    strcpy(watch->dirPath, ".");
+    dirPath = (char *)malloc(2);
+    if (dirPath == NULL) {
+      return TTOY_ERROR_OUT_OF_MEMORY;
+    }
+    strcpy(dirPath, ".");
   } else {
-    watch->dirPath = (char *)malloc(fileName - filePath + 1);
-    memcpy(watch->dirPath, filePath, fileName - filePath);
-    watch->dirPath[fileName - filePath] = '\0';
-  }
-  fprintf(stderr, "watch dir: %s\n", watch->dirPath);
-  /* Add the file at the given file path to inotify's list of files to watch */
-  watch->descriptor =
-    inotify_add_watch(
-      self->internal->fd,  /* fd */
-      watch->dirPath,  /* pathname */
-      IN_CLOSE_WRITE | IN_MOVED_TO | IN_MODIFY  /* mask */
-      );
-  fprintf(stderr, "watch descriptor: %d\n", watch->descriptor);  /* XXX */
-  /* Add this watch to our list of watches */
-  /* FIXME: Why are we adding this to our list? It is not very useful... We
-   * need to somehow quickly index the watches by their descriptors in order to
-   * find the file path. (I don't know if we can rely on inotify to always give
-   * us the file path in the event structure) */
-  ttoy_FileWatcher_WatchArray_append(&self->internal->watches, watch);
+    dirPath = (char *)malloc(fileName - filePath + 1);
+    if (dirPath == NULL) {
+      return TTOY_ERROR_OUT_OF_MEMORY;
+    }
+    memcpy(dirPath, filePath, fileName - filePath);
+    dirPath[fileName - filePath] = '\0';
+  }
+
+  /* Allocate memory for the watch entry */
+  watch = (ttoy_FileWatcher_Watch *)malloc(
+      sizeof(ttoy_FileWatcher_Watch) + strlen(filePath) + 1);
+  if (watch == NULL) {
+    free(dirPath);
+    return TTOY_ERROR_OUT_OF_MEMORY;
+  }
+  strcpy(watch->filePath, filePath);
+  watch->fileName = watch->filePath + (fileName - filePath);
+  watch->watcher = self;
+  watch->changed = 0;
+
+  SDL_LockMutex(service.mutex);
+  descriptor = ttoy_FileWatcher_watchDirectory(dirPath);
+  free(dirPath);
+  watch->descriptor = descriptor;
+  watch->key = ttoy_FileWatcher_hashKey(descriptor, fileName);
+  /* Add this watch to the hash table and to our list of watches */
+  ttoy_FileWatcher_insertWatch(watch);
+  watch->nextInWatcher = self->internal->watches;
+  self->internal->watches = watch;
+  SDL_UnlockMutex(service.mutex);
+
   return TTOY_NO_ERROR;
 }
 
+int ttoy_FileWatcher_watchDirectory(
+    const char *dirPath)
+{
+  ttoy_FileWatcher_Directory *directory, newDirectory;
+  int descriptor;
+
+  /* NOTE: We only watch for files being written and closed or moved into
+   * place, rather than for every write, so that busy directories do not keep
+   * waking our thread */
+  descriptor = inotify_add_watch(
+      service.fd,  /* fd */
+      dirPath,  /* pathname */
+      IN_CLOSE_WRITE | IN_MOVED_TO  /* mask */
+      );
+  if (descriptor < 0) {
+    TTOY_LOG_ERROR("Error watching directory '%s': %s",
+        dirPath,
+        strerror(errno));
+    return -1;
+  }
+  /* inotify gives us the same descriptor for a directory that is already
+   * watched, so we count the files watched in each directory */
+  for (size_t i = 0;
+      i < ttoy_FileWatcher_DirectoryVector_size(&service.directories);
+      ++i)
+  {
+    directory = ttoy_FileWatcher_DirectoryVector_get(&service.directories, i);
+    if (directory->descriptor == descriptor) {
+      directory->refCount += 1;
+      return descriptor;
+    }
+  }
+  newDirectory.descriptor = descriptor;
+  newDirectory.refCount = 1;
+  if (ttoy_FileWatcher_DirectoryVector_append(&service.directories,
+        &newDirectory  /* value */
+        ) != TTOY_NO_ERROR)
+  {
+    inotify_rm_watch(service.fd, descriptor);
+    return -1;
+  }
+
+  return descriptor;
+}
+
+void ttoy_FileWatcher_unwatchDirectory(
+    int descriptor)
+{
+  ttoy_FileWatcher_Directory *directory;
+
+  for (size_t i = 0;
+      i < ttoy_FileWatcher_DirectoryVector_size(&service.directories);
+      ++i)
+  {
+    directory = ttoy_FileWatcher_DirectoryVector_get(&service.directories, i);
+    if (directory->descriptor != descriptor) {
+      continue;
+    }
+    directory->refCount -= 1;
+    if (directory->refCount == 0) {
+      /* No files in this directory are watched anymore */
+      inotify_rm_watch(service.fd, descriptor);
+      ttoy_FileWatcher_DirectoryVector_remove(&service.directories, i);
+    }
+    return;
+  }
+}
+
+uint64_t ttoy_FileWatcher_hashKey(
+    int descriptor,
+    const char *fileName)
+{
+  uint64_t key;
+
+  key = ttoy_hash(TTOY_HASH_INIT, &descriptor, sizeof(descriptor));
+  return ttoy_hashString(key, fileName);
+}
+
+void ttoy_FileWatcher_insertWatch(
+    ttoy_FileWatcher_Watch *watch)
+{
+  ttoy_FileWatcher_Watch **buckets, *current, *next;
+  size_t numBuckets, index;
+
+  if (service.numWatches + 1 > service.numBuckets) {
+    /* Double the number of buckets to keep the chains short */
+    numBuckets = service.numBuckets * 2;
+    buckets = (ttoy_FileWatcher_Watch **)calloc(
+        numBuckets, sizeof(ttoy_FileWatcher_Watch *));
+    if (buckets != NULL) {
+      for (size_t i = 0; i < service.numBuckets; ++i) {
+        for (current = service.buckets[i]; current != NULL; current = next) {
+          next = current->nextInBucket;
+          index = current->key & (numBuckets - 1);
+          current->nextInBucket = buckets[index];
+          buckets[index] = current;
+        }
+      }
+      free(service.buckets);
+      service.buckets = buckets;
+      service.numBuckets = numBuckets;
+    }
+  }
+  index = watch->key & (service.numBuckets - 1);
+  watch->nextInBucket = service.buckets[index];
+  service.buckets[index] = watch;
+  service.numWatches += 1;
+}
+
+void ttoy_FileWatcher_removeWatch(
+    ttoy_FileWatcher_Watch *watch)
+{
+  ttoy_FileWatcher_Watch **prev;
+
+  for (prev = &service.buckets[watch->key & (service.numBuckets - 1)];
+      *prev != watch;
+      prev = &(*prev)->nextInBucket)
+  {
+    assert(*prev != NULL);
+  }
+  *prev = watch->nextInBucket;
+  service.numWatches -= 1;
+  if (watch->changed) {
+    for (prev = &service.changed;
+        *prev != watch;
+        prev = &(*prev)->nextChanged)
+    {
+      assert(*prev != NULL);
+    }
+    *prev = watch->nextChanged;
+  }
+}
+
 int
 ttoy_FileWatcher_watchThread(
-    ttoy_FileWatcher *self)
+    void *data)
 {
-  struct inotify_event *buf, *event;
-  size_t bufSize;
-  fprintf(stderr, "file watch thread started\n");  /* XXX */
-  /* Allocate a buffer large enough to read the next inotify event (see the
+  /* NOTE: The buffer must be aligned for struct inotify_event (see the
    * inotify(7) man page for details) */
-  /* FIXME: Align this buffer to the allignment of struct inotify_event (see
-   * the inotify(7) man page for details) */
-  bufSize = (sizeof(struct inotify_event *) + NAME_MAX + 1) * 3;
-  buf = (struct inotify_event *)malloc(bufSize);
+  char buf[4096]
+    __attribute__ ((aligned(__alignof__(struct inotify_event))));
+  const struct inotify_event *event;
+  ssize_t bytesRead;
 
   /* Watch the inotify file descriptor for events until it closes */
   while (1) {
-    ssize_t bytesRead;
-    // fprintf(stderr, "reading inotify file descriptor (hopefully blocking)\n");  /* XXX */
     bytesRead = read(
-        self->internal->fd,  /* fd */
+        service.fd,  /* fd */
         buf,  /* buf */
-        bufSize  /* count */
+        sizeof(buf)  /* count */
         );
-    // fprintf(stderr, "read inotify fd, with %ld byte(s) read\n", bytesRead);  /* XXX */
     if (bytesRead < 0) {
-      /* TODO: Figure out which of these error codes signal us to join the main
-       * thread */
+      if (errno == EINTR) {
+        continue;
+      }
       TTOY_LOG_ERROR(
-          "inotify file descriptor error: %s\n",
-          strerror(errno));  /* XXX */
+          "inotify file descriptor error: %s",
+          strerror(errno));
       break;  /* Exit our thread */
     }
-    if (self->internal->callback == NULL) {  /* FIXME: Synchronize this! Ugh! */
-      /* Nothing to do with no callback */
-      continue;
-    }
     /* Iterate over the inotify events we received */
-    for (
-        event = buf;
-        event < buf + bytesRead;
-        event += sizeof(struct inotify_event) + event->len)
+    SDL_LockMutex(service.mutex);
+    for (char *ptr = buf;
+        ptr < buf + bytesRead;
+        ptr += sizeof(struct inotify_event) + event->len)
     {
-      /* TODO: Check for relevant events */
-      /* Note that a number of different events can indicate changes to our
-       * file, namely creation, modification, and renaming. */
-      /* XXX */
-      /*
-      if (event->mask & IN_CLOSE_WRITE) {
-        fprintf(stderr, "file close write '%s'\n", event->name);
-      }
-      if (event->mask & IN_MOVED_TO) {
-        fprintf(stderr, "file moved to '%s'\n", event->name);
-      }
-      if (event->mask & IN_MODIFY) {
-        fprintf(stderr, "file modified '%s'\n", event->name);
-      }
-      */
-      /* TODO: Check for watches matching this event */
-      for (size_t i = 0;
-          i < ttoy_FileWatcher_WatchArray_size(&self->internal->watches);
-          ++i)
+      event = (const struct inotify_event *)ptr;
+      ttoy_FileWatcher_handleEvent(event);
+    }
+    SDL_UnlockMutex(service.mutex);
+  }
+  return 0;
+}
+
+void ttoy_FileWatcher_handleEvent(
+    const struct inotify_event *event)
+{
+  ttoy_FileWatcher_Watch *watch;
+  SDL_Event sdlEvent;
+  uint64_t key;
+  int notify;
+
+  if (event->len == 0) {
+    /* The event is for the directory itself */
+    return;
+  }
+  /* Find the watches for this file in our hash table */
+  notify = 0;
+  key = ttoy_FileWatcher_hashKey(event->wd, event->name);
+  for (watch = service.buckets[key & (service.numBuckets - 1)];
+      watch != NULL;
+      watch = watch->nextInBucket)
+  {
+    if (watch->key != key
+        || watch->descriptor != event->wd
+        || strcmp(watch->fileName, event->name) != 0)
+    {
+      continue;
+    }
+    /* Editors tend to write a file several times when saving, so each
+     * change restarts the debounce window of the file */
+    watch->changedTicks = SDL_GetTicks();
+    if (!watch->changed) {
+      watch->changed = 1;
+      watch->nextChanged = service.changed;
+      service.changed = watch;
+    }
+    notify = 1;
+  }
+  if (notify) {
+    /* Wake the main loop, which dispatches the callbacks */
+    memset(&sdlEvent, 0, sizeof(sdlEvent));
+    sdlEvent.type = ttoy_FileWatcher_eventType();
+    if (SDL_PushEvent(&sdlEvent) < 0) {
+      TTOY_LOG_ERROR("Failed to push file watcher event to SDL: %s",
+          SDL_GetError());
+    }
+  }
+}
+
+int ttoy_FileWatcher_dispatch()
+{
+  ttoy_FileWatcher_Watch **prev, *watch;
+  ttoy_FileWatcher_Internal *internal;
+  uint32_t now, elapsed;
+  int timeout;
+
+  if (service.mutex == NULL) {
+    /* Nothing is being watched */
+    return -1;
+  }
+
+  timeout = -1;
+  SDL_LockMutex(service.mutex);
+  now = SDL_GetTicks();
+  prev = &service.changed;
+  while (*prev != NULL) {
+    watch = *prev;
+    elapsed = now - watch->changedTicks;
+    if (elapsed < TTOY_FILE_WATCHER_DEBOUNCE) {
+      /* This file might still be being written */
+      if (timeout == -1
+          || TTOY_FILE_WATCHER_DEBOUNCE - elapsed < (uint32_t)timeout)
       {
-        ttoy_FileWatcher_Watch *watch;
-        watch = ttoy_FileWatcher_WatchArray_get(&self->internal->watches, i);
-        /* Check for matching watch descriptors (i.e. the directory matches) */
-        if (watch->descriptor != event->wd)
-          continue;
-        /* Check for matching file names */
-        if (strcmp(watch->fileName, event->name) != 0)
-          continue;
-        assert(self->internal->callback != NULL);
-        self->internal->callback(
-            self->internal->callbackData,  /* data */
-            watch->filePath  /* filePath */
-            );
+        timeout = TTOY_FILE_WATCHER_DEBOUNCE - elapsed;
       }
+      prev = &watch->nextChanged;
+      continue;
+    }
+    *prev = watch->nextChanged;
+    watch->changed = 0;
+    internal = watch->watcher->internal;
+    if (internal->callback != NULL) {
+      /* NOTE: The callback might destroy its watcher, which removes any of
+       * its watches from the list of changed watches, so we start over from
+       * the beginning of the list afterwards */
+      internal->callback(
+          internal->callbackData,  /* data */
+          watch->filePath  /* filePath */
+          );
+      prev = &service.changed;
     }
   }
-  free(buf);
-  fprintf(stderr, "Whoops, we left the watch thread\n");  /* XXX */
-  return 0;
+  SDL_UnlockMutex(service.mutex);
+
+  return timeout;
 }
@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2016-2017 Jonathan Glines
+ * Jonathan Glines <jonathan@glines.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef TTOY_FILE_WATCHER_EVENTS_H_
+#define TTOY_FILE_WATCHER_EVENTS_H_
+
+/**
+ * The type of the SDL user event pushed when a watched file changes. The
+ * event carries no data; it only wakes the main loop, which should then call
+ * ttoy_FileWatcher_dispatch().
+ */
+int ttoy_FileWatcher_eventType();
+
+/**
+ * Calls the callbacks of the watched files that have changed and since
+ * settled. Must be called from the main loop, which is the only thread that
+ * file watcher callbacks are called from.
+ *
+ * Returns the number of milliseconds until the next changed file settles, or
+ * -1 if no files are waiting to settle.
+ */
+int ttoy_FileWatcher_dispatch();
+
+#endif
@@ -21,8 +21,12 @@
  * IN THE SOFTWARE.
  */
 
+#include <errno.h>
 #include <math.h>
+#include <sys/stat.h>
 
+#include "common/hash.h"
+#include "embeddedFont.h"
 #include "fonts.h"
 #include "logging.h"
 
@@ -38,6 +42,10 @@
     ((int)(trunc(value)) << 6) \
     + (int)trunc(((value) - trunc(value)) * (float)(1 << 6)))
 
+/* The FreeType flags we load and render glyphs with */
+#define TTOY_FONT_LOAD_FLAGS FT_LOAD_DEFAULT
+#define TTOY_FONT_RENDER_MODE FT_RENDER_MODE_NORMAL
+
 const char *
 ttoy_FreeTypeErrorString(
     FT_Error error)
@@ -51,25 +59,59 @@ ttoy_FreeTypeErrorString(
 }
 
 struct ttoy_Font_Internal_ {
-  /* TODO: Somewhere in the FreeType documentation they suggest disposing of
-   * FT_Face objects whenever possible. We tend to keep them for as long as the
-   * font does not change. It might be best not to keep these objects around,
-   * but I don't know. */
-  FT_Face face;
+  /* Faces and sizes are owned by the FreeType cache manager, which may flush
+   * them at any time to stay within its memory limits. We only hold on to the
+   * font file (which serves as the cache face ID) and the scaler describing
+   * our size. */
+  ttoy_FontFile *fontFile;
+  FTC_ScalerRec scaler;
+  /* Storage for the most recently rendered glyph bitmap */
+  FT_Bitmap bitmap;
+  FT_Glyph bitmapGlyph;
   char *faceName, *fontPath;
   float size;
+  int dpi[2];
 };
 
+/* Private methods */
+ttoy_ErrorCode
+ttoy_Font_lookupSize(
+    const ttoy_Font *self,
+    FT_Size *size);
+FT_UInt
+ttoy_Font_lookupGlyphIndex(
+    const ttoy_Font *self,
+    uint32_t character);
+ttoy_ErrorCode
+ttoy_Font_lookupGlyph(
+    ttoy_Font *self,
+    uint32_t character,
+    FTC_SBit *sbit,
+    FT_Glyph *glyph);
+void
+ttoy_Font_releaseBitmap(
+    ttoy_Font *self);
+int
+ttoy_Font_calculateVerticalOffset(
+    const FT_Size_Metrics *metrics,
+    FT_Pos bottom);
+
 void
 ttoy_Font_init(
     ttoy_Font *self)
 {
   /* Allocate memory for internal structures */
   self->internal = (ttoy_Font_Internal *)malloc(sizeof(ttoy_Font_Internal));
-  /* Fonts are not valid until FreeType font face has been loaded */
-  self->internal->face = NULL;
+  /* Fonts are not valid until a font file has been loaded */
+  self->internal->fontFile = NULL;
+  memset(&self->internal->scaler, 0, sizeof(self->internal->scaler));
+  memset(&self->internal->bitmap, 0, sizeof(self->internal->bitmap));
+  self->internal->bitmapGlyph = NULL;
   self->internal->faceName = NULL;
+  self->internal->fontPath = NULL;
   self->internal->size = -1.0f;
+  self->internal->dpi[0] = 0;
+  self->internal->dpi[1] = 0;
 }
 
 ttoy_ErrorCode
@@ -81,42 +123,37 @@ ttoy_Font_load(
     int x_dpi,
     int y_dpi)
 {
-  FT_Error ftError;
-  FT_Library ft;
-
-  ft = ttoy_Fonts_getFreeTypeInstance();
+  ttoy_ErrorCode error;
+  FT_Size size;
 
-  /* Load the FreeType font face from file */
-  ftError = FT_New_Face(
-      ft,  /* library */
-      fontPath,  /* filepathname */
-      0,  /* face_index */
-      &self->internal->face  /* aface */
+  /* Get the font file from the registry, loading it if needed */
+  error = ttoy_Fonts_openFontFile(
+      fontPath,  /* path */
+      &self->internal->fontFile  /* fontFile */
       );
-  if (ftError != FT_Err_Ok) {
-    TTOY_LOG_ERROR("Freetype encountered an error reading file '%s': %s",
-        fontPath,
-        ttoy_FreeTypeErrorString(ftError));
-    return TTOY_ERROR_FAILED_TO_LOAD_FONT;
+  if (error != TTOY_NO_ERROR) {
+    self->internal->fontFile = NULL;
+    return error;
   }
 
-  /* Attempt to set the font size */
-  ftError = FT_Set_Char_Size(
-      self->internal->face,  /* face */
-      0,  /* char_width */
-      FLOAT_TO_TWENTY_SIX_SIX(fontSize),  /* char_height */
-      x_dpi,  /* horz_resolution */
-      y_dpi  /* vert_resolution */
-      );
-  if (ftError != FT_Err_Ok) {
-    TTOY_LOG_ERROR("Freetype failed to set character size for font: %s",
-        fontPath);
-    /* TODO: Print the specific error message from Freetype */
-    /* NOTE: Not a fatal error */
-  }
+  /* Describe our size to the FreeType cache manager */
+  self->internal->scaler.face_id = (FTC_FaceID)self->internal->fontFile;
+  self->internal->scaler.width = FLOAT_TO_TWENTY_SIX_SIX(fontSize);
+  self->internal->scaler.height = FLOAT_TO_TWENTY_SIX_SIX(fontSize);
+  self->internal->scaler.pixel = 0;
+  self->internal->scaler.x_res = x_dpi;
+  self->internal->scaler.y_res = y_dpi;
 
-  /* Store the size */
+  /* Store the size and resolution */
   self->internal->size = fontSize;
+  self->internal->dpi[0] = x_dpi;
+  self->internal->dpi[1] = y_dpi;
+  /* Store the font path */
+  self->internal->fontPath = (char *)malloc(strlen(fontPath) + 1);
+  if (self->internal->fontPath == NULL) {
+    return TTOY_ERROR_OUT_OF_MEMORY;
+  }
+  strcpy(self->internal->fontPath, fontPath);
   /* Store the face name */
   self->internal->faceName = (char *)malloc(strlen(faceName) + 1);
   if (self->internal->faceName == NULL) {
@@ -124,6 +161,15 @@ ttoy_Font_load(
   }
   strcpy(self->internal->faceName, faceName);
 
+  /* Load the face at our size, which makes sure the font file is actually a
+   * font that FreeType can read */
+  error = ttoy_Font_lookupSize(self, &size);
+  if (error != TTOY_NO_ERROR) {
+    ttoy_Fonts_closeFontFile(self->internal->fontFile);
+    self->internal->fontFile = NULL;
+    return TTOY_ERROR_FAILED_TO_LOAD_FONT;
+  }
+
   return TTOY_NO_ERROR;
 }
 
@@ -131,20 +177,23 @@ int
 ttoy_Font_isValid(
     const ttoy_Font *self)
 {
-  /* Without a face loaded, the font is invalid */
-  return self->internal->face != NULL;
+  /* Without a font file loaded, the font is invalid */
+  return self->internal->fontFile != NULL;
 }
 
 void
 ttoy_Font_destroy(
     ttoy_Font *self)
 {
-  if (self->internal->face != NULL) {
-    /* Release the FreeType font face */
-    FT_Done_Face(self->internal->face);
+  ttoy_Font_releaseBitmap(self);
+  if (self->internal->fontFile != NULL) {
+    /* Release our reference to the font file, which also drops its faces and
+     * sizes from the FreeType cache once nobody else is using it */
+    ttoy_Fonts_closeFontFile(self->internal->fontFile);
   }
   /* Free allocated memory */
   free(self->internal->faceName);
+  free(self->internal->fontPath);
   free(self->internal);
 }
 
@@ -153,13 +202,10 @@ ttoy_Font_hasCharacter(
     ttoy_Font *self,
     uint32_t character)
 {
-  if (self->internal->face == NULL)
+  if (self->internal->fontFile == NULL)
     return 0;
-  /* Look for the character in our FreeType font face */
-  return FT_Get_Char_Index(
-      self->internal->face,  /* face */
-      character  /* charcode */
-      ) != 0;
+  /* Look for the character in the cached charmap of our face */
+  return ttoy_Font_lookupGlyphIndex(self, character) != 0;
 }
 
 ttoy_ErrorCode
@@ -169,38 +215,44 @@ ttoy_Font_getGlyphDimensions(
     int *width,
     int *height)
 {
-  int glyph_index;
-  FT_Error ftError;
-
-  /* Look for the glyph that corresponds with the given character code */
-  glyph_index = FT_Get_Char_Index(self->internal->face, character);
-  if (!glyph_index)
-    return TTOY_ERROR_FONT_GLYPH_NOT_FOUND;  /* Error; could not find the glyph */
-
-  /* Load the glyph */
-  ftError = FT_Load_Glyph(
-      self->internal->face,  /* face */
-      glyph_index,  /* glyph_index */
-      FT_LOAD_DEFAULT  /* load_flags */
+  FTC_SBit sbit;
+  FT_Glyph glyph;
+  FT_BBox cbox;
+  ttoy_ErrorCode error;
+
+  /* Look up the glyph in the FreeType cache */
+  error = ttoy_Font_lookupGlyph(self,
+      character,  /* character */
+      &sbit,  /* sbit */
+      &glyph  /* glyph */
       );
-  if (ftError != FT_Err_Ok) {
-    /* TODO: Print out the specific FreeType error */
-    TTOY_LOG_ERROR(
-        "Freetype error loading glyph for the character '0x%08x': %s",
-        character,
-        ttoy_FreeTypeErrorString(ftError));
-    return TTOY_ERROR_FREETYPE_ERROR;
+  if (error != TTOY_NO_ERROR) {
+    return error;
   }
 
   /* Calculate the pixel dimensions of this glyph, as we would render it */
-  *width = 
-    TWENTY_SIX_SIX_TO_PIXELS(self->internal->face->glyph->metrics.width);
-  *height = 
-    TWENTY_SIX_SIX_TO_PIXELS(self->internal->face->glyph->metrics.height);
+  if (sbit != NULL) {
+    *width = sbit->width;
+    *height = sbit->height;
+  } else {
+    FT_Glyph_Get_CBox(glyph, FT_GLYPH_BBOX_GRIDFIT, &cbox);
+    *width = TWENTY_SIX_SIX_TO_PIXELS(cbox.xMax - cbox.xMin);
+    *height = TWENTY_SIX_SIX_TO_PIXELS(cbox.yMax - cbox.yMin);
+  }
 
   return TTOY_NO_ERROR;
 }
 
+void
+ttoy_Font_getFaceGlyphDimensions(
+    FT_Face face,
+    int *width,
+    int *height)
+{
+  *width = TWENTY_SIX_SIX_TO_PIXELS(face->glyph->metrics.width);
+  *height = TWENTY_SIX_SIX_TO_PIXELS(face->glyph->metrics.height);
+}
+
 ttoy_ErrorCode
 ttoy_Font_getGlyphOffset(
     ttoy_Font *self,
@@ -208,44 +260,70 @@ ttoy_Font_getGlyphOffset(
     int *x,
     int *y)
 {
-  FT_UInt glyph_index;
-  FT_Face face;
-  FT_Error ftError;
-
-  face = self->internal->face;
-
-  /* Look for the glyph that corresponds with the given character code */
-  glyph_index = FT_Get_Char_Index(self->internal->face, character);
-  if (!glyph_index)
-    return TTOY_ERROR_FONT_GLYPH_NOT_FOUND;  /* Error; could not find the glyph */
-
-  /* Load the glyph */
-  ftError = FT_Load_Glyph(
-      self->internal->face,  /* face */
-      glyph_index,  /* glyph_index */
-      FT_LOAD_DEFAULT  /* load_flags */
+  FTC_SBit sbit;
+  FT_Glyph glyph;
+  FT_BBox cbox;
+  FT_Size size;
+  ttoy_ErrorCode error;
+
+  /* Look up the glyph in the FreeType cache */
+  error = ttoy_Font_lookupGlyph(self,
+      character,  /* character */
+      &sbit,  /* sbit */
+      &glyph  /* glyph */
       );
-  if (ftError != FT_Err_Ok) {
-    /* TODO: Print out the specific FreeType error */
-    TTOY_LOG_ERROR(
-        "Freetype error loading glyph for the character '0x%08x'",
-        character);
-    return TTOY_ERROR_FREETYPE_ERROR;
+  if (error != TTOY_NO_ERROR) {
+    return error;
+  }
+  error = ttoy_Font_lookupSize(self, &size);
+  if (error != TTOY_NO_ERROR) {
+    return error;
+  }
+
+  /* Calculate the offset of this glyph within its cell */
+  if (sbit != NULL) {
+    *x = sbit->left;
+    *y = ttoy_Font_calculateVerticalOffset(&size->metrics,
+        (FT_Pos)(sbit->top - sbit->height) * 64  /* bottom */
+        );
+  } else {
+    FT_Glyph_Get_CBox(glyph, FT_GLYPH_BBOX_GRIDFIT, &cbox);
+    *x = TWENTY_SIX_SIX_TO_PIXELS(cbox.xMin);
+    *y = ttoy_Font_calculateVerticalOffset(&size->metrics,
+        cbox.yMin  /* bottom */
+        );
   }
 
+  return TTOY_NO_ERROR;
+}
+
+void
+ttoy_Font_getFaceGlyphOffset(
+    FT_Face face,
+    int *x,
+    int *y)
+{
   /* Calculate the horizontal offset of this glyph */
   *x = TWENTY_SIX_SIX_TO_PIXELS(face->glyph->metrics.horiBearingX);
   /* Calculate the vertical offset of this glyph */
-  FT_Pos linegap = face->size->metrics.height
-    - face->size->metrics.ascender
-    + face->size->metrics.descender;
-  *y = TWENTY_SIX_SIX_TO_PIXELS(
+  *y = ttoy_Font_calculateVerticalOffset(&face->size->metrics,
       face->glyph->metrics.horiBearingY
-      - face->size->metrics.descender
-      - face->glyph->metrics.height
-      - linegap / 2);  /* Distribute the linegap above and below the glyph */
+      - face->glyph->metrics.height  /* bottom */
+      );
+}
 
-  return TTOY_NO_ERROR;
+int
+ttoy_Font_calculateVerticalOffset(
+    const FT_Size_Metrics *metrics,
+    FT_Pos bottom)
+{
+  FT_Pos linegap = metrics->height
+    - metrics->ascender
+    + metrics->descender;
+  return TWENTY_SIX_SIX_TO_PIXELS(
+      bottom
+      - metrics->descender
+      - linegap / 2);  /* Distribute the linegap above and below the glyph */
 }
 
 ttoy_ErrorCode
@@ -254,40 +332,50 @@ ttoy_Font_renderGlyph(
     uint32_t character,
     FT_Bitmap **bitmap)
 {
-  int glyph_index;
+  FTC_SBit sbit;
+  FT_Glyph glyph;
   FT_Error ftError;
+  ttoy_ErrorCode error;
 
-  /* Look for the glyph that corresponds with the given character code */
-  glyph_index = FT_Get_Char_Index(self->internal->face, character);
-  if (!glyph_index)
-    return TTOY_ERROR_FONT_GLYPH_NOT_FOUND;  /* Error; could not find the glyph */
-
-  /* Load the glyph */
-  ftError = FT_Load_Glyph(
-      self->internal->face,  /* face */
-      glyph_index,  /* glyph_index */
-      FT_LOAD_DEFAULT  /* load_flags */
+  /* Look up the glyph in the FreeType cache */
+  error = ttoy_Font_lookupGlyph(self,
+      character,  /* character */
+      &sbit,  /* sbit */
+      &glyph  /* glyph */
       );
-  if (ftError != FT_Err_Ok) {
-    /* TODO: Print out the specific FreeType error */
-    TTOY_LOG_ERROR(
-        "Freetype error loading glyph for the character '0x%08x'",
-        character);
-    return TTOY_ERROR_FREETYPE_ERROR;
+  if (error != TTOY_NO_ERROR) {
+    return error;
   }
 
-  /* Render the glyph */
-  ftError = FT_Render_Glyph(
-      self->internal->face->glyph,
-      FT_RENDER_MODE_NORMAL);
-  if (ftError != FT_Err_Ok) {
-    /* TODO: Print out the specific FreeType error */
-    TTOY_LOG_ERROR("Freetype error rendering the glyph for '0x%08x'\n",
-        character);
-    return TTOY_ERROR_FREETYPE_ERROR;
+  ttoy_Font_releaseBitmap(self);
+  if (sbit != NULL) {
+    /* Small glyphs are rendered and stored by the cache itself */
+    self->internal->bitmap.rows = sbit->height;
+    self->internal->bitmap.width = sbit->width;
+    self->internal->bitmap.pitch = sbit->pitch;
+    self->internal->bitmap.buffer = sbit->buffer;
+    self->internal->bitmap.num_grays = sbit->max_grays + 1;
+    self->internal->bitmap.pixel_mode = sbit->format;
+  } else {
+    /* Render a copy of the cached outline; the cached glyph itself must not
+     * be modified */
+    ftError = FT_Glyph_To_Bitmap(
+        &glyph,  /* the_glyph */
+        TTOY_FONT_RENDER_MODE,  /* render_mode */
+        NULL,  /* origin */
+        0  /* destroy */
+        );
+    if (ftError != FT_Err_Ok) {
+      TTOY_LOG_ERROR("Freetype error rendering the glyph for '0x%08x': %s",
+          character,
+          ttoy_FreeTypeErrorString(ftError));
+      return TTOY_ERROR_FREETYPE_ERROR;
+    }
+    self->internal->bitmapGlyph = glyph;
+    self->internal->bitmap = ((FT_BitmapGlyph)glyph)->bitmap;
   }
 
-  *bitmap = &self->internal->face->glyph->bitmap;
+  *bitmap = &self->internal->bitmap;
 
   return TTOY_NO_ERROR;
 }
@@ -313,32 +401,132 @@ ttoy_Font_getSize(
   return self->internal->size;
 }
 
+void
+ttoy_Font_getDpi(
+    const ttoy_Font *self,
+    int *x_dpi,
+    int *y_dpi)
+{
+  *x_dpi = self->internal->dpi[0];
+  *y_dpi = self->internal->dpi[1];
+}
+
 ttoy_ErrorCode
 ttoy_Font_setSize(
     const ttoy_Font *self,
     float size)
+{
+  FTC_ScalerRec oldScaler;
+  FT_Size ftSize;
+  ttoy_ErrorCode error;
+
+  /* Switch our scaler to the new size; the cache manager keeps the old size
+   * around in case we switch back */
+  oldScaler = self->internal->scaler;
+  self->internal->scaler.width = FLOAT_TO_TWENTY_SIX_SIX(size);
+  self->internal->scaler.height = FLOAT_TO_TWENTY_SIX_SIX(size);
+  error = ttoy_Font_lookupSize(self, &ftSize);
+  if (error != TTOY_NO_ERROR) {
+    self->internal->scaler = oldScaler;
+    return error;
+  }
+
+  /* Store the new font size */
+  self->internal->size = size;
+
+  return TTOY_NO_ERROR;
+}
+
+ttoy_ErrorCode
+ttoy_Font_getCacheKey(
+    const ttoy_Font *self,
+    uint64_t *key)
+{
+  struct stat sbuf;
+  uint64_t hash, embeddedHash;
+  int result;
+  const FT_Int32 loadFlags = TTOY_FONT_LOAD_FLAGS;
+  const FT_Render_Mode renderMode = TTOY_FONT_RENDER_MODE;
+
+  if (self->internal->fontPath == NULL)
+    return TTOY_ERROR_MISSING_FONT;
+
+  hash = ttoy_hashString(TTOY_HASH_INIT, self->internal->fontPath);
+  if (ttoy_isEmbeddedFontPath(self->internal->fontPath)) {
+    /* The embedded font has no file to stat, but its contents are fixed for
+     * the lifetime of the ttoy binary */
+    embeddedHash = ttoy_getEmbeddedFontHash();
+    hash = ttoy_hash(hash, &embeddedHash, sizeof(embeddedHash));
+  } else {
+    /* The modification time and size of the font file stand in for a hash of
+     * its contents, which would be too expensive to compute at startup */
+    result = stat(self->internal->fontPath, &sbuf);
+    if (result < 0) {
+      TTOY_LOG_ERROR("Could not stat font file '%s': %s",
+          self->internal->fontPath,
+          strerror(errno));
+      return TTOY_ERROR_MISSING_FONT;
+    }
+    hash = ttoy_hash(hash, &sbuf.st_mtim.tv_sec, sizeof(sbuf.st_mtim.tv_sec));
+    hash = ttoy_hash(hash, &sbuf.st_mtim.tv_nsec,
+        sizeof(sbuf.st_mtim.tv_nsec));
+    hash = ttoy_hash(hash, &sbuf.st_size, sizeof(sbuf.st_size));
+  }
+  /* NOTE: The face name is left out, since it does not affect the glyphs we
+   * render from this font file */
+  hash = ttoy_hash(hash, &self->internal->size, sizeof(self->internal->size));
+  hash = ttoy_hash(hash, self->internal->dpi, sizeof(self->internal->dpi));
+  /* Include the FreeType flags we render glyphs with */
+  hash = ttoy_hash(hash, &loadFlags, sizeof(loadFlags));
+  hash = ttoy_hash(hash, &renderMode, sizeof(renderMode));
+
+  *key = hash;
+
+  return TTOY_NO_ERROR;
+}
+
+ttoy_ErrorCode
+ttoy_Font_newFace(
+    const ttoy_Font *self,
+    FT_Library library,
+    FT_Face *face)
 {
   FT_Error ftError;
 
-  /* Attempt to set the FreeType font size */
+  if (self->internal->fontFile == NULL)
+    return TTOY_ERROR_FAILED_TO_LOAD_FONT;
+
+  /* Create a new face over our memory-mapped font file */
+  ftError = FT_New_Memory_Face(
+      library,  /* library */
+      ttoy_FontFile_getData(self->internal->fontFile),  /* file_base */
+      ttoy_FontFile_getSize(self->internal->fontFile),  /* file_size */
+      0,  /* face_index */
+      face  /* aface */
+      );
+  if (ftError != FT_Err_Ok) {
+    TTOY_LOG_ERROR("Freetype encountered an error reading file '%s': %s",
+        self->internal->fontPath,
+        ttoy_FreeTypeErrorString(ftError));
+    return TTOY_ERROR_FAILED_TO_LOAD_FONT;
+  }
+
+  /* Match the size of our own face */
   ftError = FT_Set_Char_Size(
-      self->internal->face,  /* face */
+      *face,  /* face */
       0,  /* char_width */
-      FLOAT_TO_TWENTY_SIX_SIX(size),  /* char_height */
-      /* FIXME: Actually pass the DPI somehow */
-      144,  /* horz_resolution */
-      144  /* vert_resolution */
+      FLOAT_TO_TWENTY_SIX_SIX(self->internal->size),  /* char_height */
+      self->internal->dpi[0],  /* horz_resolution */
+      self->internal->dpi[1]  /* vert_resolution */
       );
   if (ftError != FT_Err_Ok) {
     TTOY_LOG_ERROR("Freetype failed to set character size for font '%s': %s",
         self->internal->fontPath,
         ttoy_FreeTypeErrorString(ftError));
+    FT_Done_Face(*face);
     return TTOY_ERROR_FREETYPE_ERROR;
   }
 
-  /* Store the new font size */
-  self->internal->size = size;
-
   return TTOY_NO_ERROR;
 }
 
@@ -346,5 +534,136 @@ FT_Face
 ttoy_Font_getFtFace(
     ttoy_Font *self)
 {
-  return self->internal->face;
+  FT_Size size;
+  ttoy_ErrorCode error;
+
+  /* Looking up our size in the cache also makes it the active size of the
+   * face */
+  error = ttoy_Font_lookupSize(self, &size);
+  if (error != TTOY_NO_ERROR) {
+    return NULL;
+  }
+  return size->face;
+}
+
+ttoy_ErrorCode
+ttoy_Font_lookupSize(
+    const ttoy_Font *self,
+    FT_Size *size)
+{
+  FT_Error ftError;
+
+  if (self->internal->fontFile == NULL)
+    return TTOY_ERROR_FAILED_TO_LOAD_FONT;
+
+  ftError = FTC_Manager_LookupSize(
+      ttoy_Fonts_getCacheManager(),  /* manager */
+      (FTC_Scaler)&self->internal->scaler,  /* scaler */
+      size  /* asize */
+      );
+  if (ftError != FT_Err_Ok) {
+    TTOY_LOG_ERROR("Freetype failed to load font '%s' at size %g: %s",
+        self->internal->fontPath,
+        self->internal->size,
+        ttoy_FreeTypeErrorString(ftError));
+    return TTOY_ERROR_FREETYPE_ERROR;
+  }
+
+  return TTOY_NO_ERROR;
+}
+
+FT_UInt
+ttoy_Font_lookupGlyphIndex(
+    const ttoy_Font *self,
+    uint32_t character)
+{
+  return FTC_CMapCache_Lookup(
+      ttoy_Fonts_getCMapCache(),  /* cache */
+      self->internal->scaler.face_id,  /* face_id */
+      -1,  /* cmap_index */
+      character  /* char_code */
+      );
+}
+
+/**
+ * Looks up the glyph for the given character in the FreeType caches. Glyphs
+ * small enough for the small bitmap cache are returned through \p sbit, with
+ * \p glyph set to NULL. Other glyphs are returned as cached outlines through
+ * \p glyph, with \p sbit set to NULL.
+ *
+ * Either result remains valid only until the next lookup in the FreeType
+ * caches.
+ */
+ttoy_ErrorCode
+ttoy_Font_lookupGlyph(
+    ttoy_Font *self,
+    uint32_t character,
+    FTC_SBit *sbit,
+    FT_Glyph *glyph)
+{
+  FT_UInt glyph_index;
+  FT_Error ftError;
+
+  *sbit = NULL;
+  *glyph = NULL;
+
+  /* Look for the glyph that corresponds with the given character code */
+  glyph_index = ttoy_Font_lookupGlyphIndex(self, character);
+  if (!glyph_index)
+    return TTOY_ERROR_FONT_GLYPH_NOT_FOUND;  /* Error; could not find the glyph */
+
+  /* Most glyphs fit in the small bitmap cache, which stores them already
+   * rendered */
+  ftError = FTC_SBitCache_LookupScaler(
+      ttoy_Fonts_getSBitCache(),  /* cache */
+      &self->internal->scaler,  /* scaler */
+      TTOY_FONT_LOAD_FLAGS | FT_LOAD_RENDER,  /* load_flags */
+      glyph_index,  /* gindex */
+      sbit,  /* sbit */
+      NULL  /* anode */
+      );
+  if (ftError != FT_Err_Ok) {
+    TTOY_LOG_ERROR(
+        "Freetype error loading glyph for the character '0x%08x': %s",
+        character,
+        ttoy_FreeTypeErrorString(ftError));
+    *sbit = NULL;
+    return TTOY_ERROR_FREETYPE_ERROR;
+  }
+  if ((*sbit)->buffer != NULL || (*sbit)->width == 0) {
+    return TTOY_NO_ERROR;
+  }
+
+  /* This glyph is too large for the small bitmap cache; fall back to the
+   * outline stored in the image cache */
+  *sbit = NULL;
+  ftError = FTC_ImageCache_LookupScaler(
+      ttoy_Fonts_getImageCache(),  /* cache */
+      &self->internal->scaler,  /* scaler */
+      TTOY_FONT_LOAD_FLAGS,  /* load_flags */
+      glyph_index,  /* gindex */
+      glyph,  /* aglyph */
+      NULL  /* anode */
+      );
+  if (ftError != FT_Err_Ok) {
+    TTOY_LOG_ERROR(
+        "Freetype error loading glyph for the character '0x%08x': %s",
+        character,
+        ttoy_FreeTypeErrorString(ftError));
+    *glyph = NULL;
+    return TTOY_ERROR_FREETYPE_ERROR;
+  }
+
+  return TTOY_NO_ERROR;
+}
+
+void
+ttoy_Font_releaseBitmap(
+    ttoy_Font *self)
+{
+  if (self->internal->bitmapGlyph != NULL) {
+    FT_Done_Glyph(self->internal->bitmapGlyph);
+    self->internal->bitmapGlyph = NULL;
+  }
+  memset(&self->internal->bitmap, 0, sizeof(self->internal->bitmap));
 }
@@ -26,11 +26,16 @@
 
 #include <ft2build.h>
 #include FT_FREETYPE_H
+#include FT_GLYPH_H
 
 #include <inttypes.h>
 
 #include <ttoy/error.h>
 
+const char *
+ttoy_FreeTypeErrorString(
+    FT_Error error);
+
 struct ttoy_Font_Internal_;
 typedef struct ttoy_Font_Internal_ ttoy_Font_Internal;
 
@@ -75,6 +80,11 @@ ttoy_Font_getGlyphOffset(
     int *x,
     int *y);
 
+/**
+ * Renders the glyph for the given character. The bitmap returned is owned by
+ * the font (or by the FreeType cache) and is only valid until the next call
+ * to any font method.
+ */
 ttoy_ErrorCode
 ttoy_Font_renderGlyph(
     ttoy_Font *self,
@@ -99,11 +109,63 @@ float
 ttoy_Font_getSize(
     const ttoy_Font *self);
 
+void
+ttoy_Font_getDpi(
+    const ttoy_Font *self,
+    int *x_dpi,
+    int *y_dpi);
+
 ttoy_ErrorCode
 ttoy_Font_setSize(
     const ttoy_Font *self,
     float size);
 
+/**
+ * Computes a key identifying the glyphs this font renders, for use with
+ * on-disk caches. The key covers the font file path, the modification time
+ * and size of that file, the face name, the font size, the resolution and the
+ * FreeType rendering flags.
+ */
+ttoy_ErrorCode
+ttoy_Font_getCacheKey(
+    const ttoy_Font *self,
+    uint64_t *key);
+
+/**
+ * Creates a new FreeType face over the same font file data as this font, with
+ * the same size and resolution. FreeType faces are not thread-safe, so each
+ * thread rendering glyphs needs a face of its own, created within that
+ * thread's FreeType library instance.
+ *
+ * The face must be released with FT_Done_Face() before this font is
+ * destroyed.
+ */
+ttoy_ErrorCode
+ttoy_Font_newFace(
+    const ttoy_Font *self,
+    FT_Library library,
+    FT_Face *face);
+
+/**
+ * Computes the pixel dimensions of the glyph currently loaded in the glyph
+ * slot of the given face.
+ */
+void
+ttoy_Font_getFaceGlyphDimensions(
+    FT_Face face,
+    int *width,
+    int *height);
+
+/**
+ * Computes the offset of the glyph currently loaded in the glyph slot of the
+ * given face, relative to the bottom left corner of its cell.
+ */
+void
+ttoy_Font_getFaceGlyphOffset(
+    FT_Face face,
+    int *x,
+    int *y);
+
 FT_Face
 ttoy_Font_getFtFace(
     ttoy_Font *self);
@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2016-2017 Jonathan Glines
+ * Jonathan Glines <jonathan@glines.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "logging.h"
+
+#include "fontFile.h"
+
+struct ttoy_FontFile_Internal_ {
+  char *path;
+  const FT_Byte *data;
+  size_t size;
+  /* Non-zero if data was mapped by us and needs to be unmapped */
+  int mapped;
+};
+
+void
+ttoy_FontFile_init(
+    ttoy_FontFile *self)
+{
+  /* Allocate memory for internal structures */
+  self->internal = (ttoy_FontFile_Internal *)malloc(
+      sizeof(ttoy_FontFile_Internal));
+  self->internal->path = NULL;
+  self->internal->data = NULL;
+  self->internal->size = 0;
+  self->internal->mapped = 0;
+}
+
+ttoy_ErrorCode
+ttoy_FontFile_load(
+    ttoy_FontFile *self,
+    const char *path)
+{
+  struct stat sbuf;
+  void *data;
+  int fd, result;
+
+  /* Map the font file into memory */
+  fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    TTOY_LOG_ERROR("Could not open font file '%s': %s",
+        path,
+        strerror(errno));
+    return TTOY_ERROR_FAILED_TO_LOAD_FONT;
+  }
+  result = fstat(fd, &sbuf);
+  if (result < 0 || sbuf.st_size == 0) {
+    TTOY_LOG_ERROR("Could not stat font file '%s'",
+        path);
+    close(fd);
+    return TTOY_ERROR_FAILED_TO_LOAD_FONT;
+  }
+  data = mmap(
+      NULL,  /* addr */
+      sbuf.st_size,  /* length */
+      PROT_READ,  /* prot */
+      MAP_PRIVATE,  /* flags */
+      fd,  /* fd */
+      0  /* offset */
+      );
+  close(fd);
+  if (data == MAP_FAILED) {
+    TTOY_LOG_ERROR("Could not map font file '%s': %s",
+        path,
+        strerror(errno));
+    return TTOY_ERROR_FAILED_TO_LOAD_FONT;
+  }
+
+  self->internal->data = (const FT_Byte *)data;
+  self->internal->size = sbuf.st_size;
+  self->internal->mapped = 1;
+
+  /* Store the path */
+  self->internal->path = (char *)malloc(strlen(path) + 1);
+  if (self->internal->path == NULL) {
+    return TTOY_ERROR_OUT_OF_MEMORY;
+  }
+  strcpy(self->internal->path, path);
+
+  return TTOY_NO_ERROR;
+}
+
+ttoy_ErrorCode
+ttoy_FontFile_loadMemory(
+    ttoy_FontFile *self,
+    const char *path,
+    const FT_Byte *data,
+    size_t size)
+{
+  self->internal->data = data;
+  self->internal->size = size;
+  self->internal->mapped = 0;
+
+  /* Store the path */
+  self->internal->path = (char *)malloc(strlen(path) + 1);
+  if (self->internal->path == NULL) {
+    return TTOY_ERROR_OUT_OF_MEMORY;
+  }
+  strcpy(self->internal->path, path);
+
+  return TTOY_NO_ERROR;
+}
+
+void
+ttoy_FontFile_destroy(
+    ttoy_FontFile *self)
+{
+  if (self->internal->mapped) {
+    /* The FreeType cache manager must already be done with any face over
+     * this memory */
+    munmap((void *)self->internal->data, self->internal->size);
+  }
+  /* Free allocated memory */
+  free(self->internal->path);
+  free(self->internal);
+}
+
+const char *
+ttoy_FontFile_getPath(
+    const ttoy_FontFile *self)
+{
+  return (const char *)self->internal->path;
+}
+
+const FT_Byte *
+ttoy_FontFile_getData(
+    const ttoy_FontFile *self)
+{
+  return self->internal->data;
+}
+
+size_t
+ttoy_FontFile_getSize(
+    const ttoy_FontFile *self)
+{
+  return self->internal->size;
+}
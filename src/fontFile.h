@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2016-2017 Jonathan Glines
+ * Jonathan Glines <jonathan@glines.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef TTOY_FONT_FILE_H_
+#define TTOY_FONT_FILE_H_
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+#include <stddef.h>
+
+#include <ttoy/error.h>
+
+struct ttoy_FontFile_Internal_;
+typedef struct ttoy_FontFile_Internal_ ttoy_FontFile_Internal;
+
+/**
+ * A font file that has been mapped into memory.
+ *
+ * Font files are shared by all fonts loaded from the same path, and should be
+ * obtained through ttoy_Fonts_openFontFile() rather than being loaded
+ * directly. Each font file also serves as the face ID of its face in the
+ * FreeType cache manager, which creates the face over the mapped memory when
+ * it is needed.
+ */
+typedef struct ttoy_FontFile_ {
+  ttoy_FontFile_Internal *internal;
+} ttoy_FontFile;
+
+void
+ttoy_FontFile_init(
+    ttoy_FontFile *self);
+
+ttoy_ErrorCode
+ttoy_FontFile_load(
+    ttoy_FontFile *self,
+    const char *path);
+
+/**
+ * Loads a font file from memory that remains valid for the lifetime of the
+ * font file, such as a font embedded in the ttoy binary. The path given only
+ * serves to identify the font file.
+ */
+ttoy_ErrorCode
+ttoy_FontFile_loadMemory(
+    ttoy_FontFile *self,
+    const char *path,
+    const FT_Byte *data,
+    size_t size);
+
+void
+ttoy_FontFile_destroy(
+    ttoy_FontFile *self);
+
+const char *
+ttoy_FontFile_getPath(
+    const ttoy_FontFile *self);
+
+const FT_Byte *
+ttoy_FontFile_getData(
+    const ttoy_FontFile *self);
+
+size_t
+ttoy_FontFile_getSize(
+    const ttoy_FontFile *self);
+
+#endif
@@ -0,0 +1,472 @@
+/*
+ * Copyright (c) 2016-2017 Jonathan Glines
+ * Jonathan Glines <jonathan@glines.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "common/cacheDir.h"
+#include "logging.h"
+
+#include "fontPathCache.h"
+
+#define TTOY_FONT_PATH_CACHE_MAGIC "ttoy-font-paths"
+#define TTOY_FONT_PATH_CACHE_FILE "fontPaths"
+#define TTOY_FONT_PATH_CACHE_MAX_LINE 8192
+
+typedef struct ttoy_FontPathCache_Dir_ {
+  char *path;
+  int64_t mtimeSec, mtimeNsec;  /* mtimeSec is -1 for missing paths */
+  struct ttoy_FontPathCache_Dir_ *next;
+} ttoy_FontPathCache_Dir;
+
+typedef struct ttoy_FontPathCache_Entry_ {
+  char *key, *path;
+  struct ttoy_FontPathCache_Entry_ *next;
+} ttoy_FontPathCache_Entry;
+
+struct ttoy_FontPathCache_Internal_ {
+  /* Font directories and configuration files the cached paths depend on */
+  ttoy_FontPathCache_Dir *dirs;
+  ttoy_FontPathCache_Entry *entries;
+  /* Non-zero once the recorded directories are known to be current */
+  int valid;
+};
+
+/* Private methods */
+void
+ttoy_FontPathCache_clear(
+    ttoy_FontPathCache *self);
+ttoy_ErrorCode
+ttoy_FontPathCache_getPath(
+    char **path);
+void
+ttoy_FontPathCache_statPath(
+    const char *path,
+    int64_t *mtimeSec,
+    int64_t *mtimeNsec);
+ttoy_ErrorCode
+ttoy_FontPathCache_addDir(
+    ttoy_FontPathCache *self,
+    const char *path,
+    int64_t mtimeSec,
+    int64_t mtimeNsec);
+ttoy_ErrorCode
+ttoy_FontPathCache_addEntry(
+    ttoy_FontPathCache *self,
+    const char *key,
+    const char *path);
+ttoy_ErrorCode
+ttoy_FontPathCache_recordDirs(
+    ttoy_FontPathCache *self,
+    FcConfig *fc);
+
+void
+ttoy_FontPathCache_init(
+    ttoy_FontPathCache *self)
+{
+  /* Allocate memory for internal structures */
+  self->internal = (ttoy_FontPathCache_Internal *)malloc(
+      sizeof(ttoy_FontPathCache_Internal));
+  self->internal->dirs = NULL;
+  self->internal->entries = NULL;
+  self->internal->valid = 0;
+}
+
+void
+ttoy_FontPathCache_destroy(
+    ttoy_FontPathCache *self)
+{
+  ttoy_FontPathCache_clear(self);
+  /* Free allocated memory */
+  free(self->internal);
+}
+
+void
+ttoy_FontPathCache_clear(
+    ttoy_FontPathCache *self)
+{
+  while (self->internal->dirs != NULL) {
+    ttoy_FontPathCache_Dir *dir = self->internal->dirs;
+    self->internal->dirs = dir->next;
+    free(dir->path);
+    free(dir);
+  }
+  while (self->internal->entries != NULL) {
+    ttoy_FontPathCache_Entry *entry = self->internal->entries;
+    self->internal->entries = entry->next;
+    free(entry->key);
+    free(entry->path);
+    free(entry);
+  }
+  self->internal->valid = 0;
+}
+
+ttoy_ErrorCode
+ttoy_FontPathCache_load(
+    ttoy_FontPathCache *self)
+{
+  char line[TTOY_FONT_PATH_CACHE_MAX_LINE];
+  char *cachePath, *end, *value;
+  int64_t mtimeSec, mtimeNsec, currentSec, currentNsec;
+  int version, offset;
+  ttoy_ErrorCode error;
+  FILE *fp;
+
+  ttoy_FontPathCache_clear(self);
+
+  error = ttoy_FontPathCache_getPath(&cachePath);
+  if (error != TTOY_NO_ERROR) {
+    return error;
+  }
+  fp = fopen(cachePath, "r");
+  free(cachePath);
+  if (fp == NULL) {
+    return TTOY_ERROR_CACHE_MISS;
+  }
+
+  /* Check the cache file format */
+  error = TTOY_ERROR_CACHE_MISS;
+  if (fgets(line, sizeof(line), fp) == NULL
+      || sscanf(line, TTOY_FONT_PATH_CACHE_MAGIC " %d", &version) != 1
+      || version != TTOY_FONT_PATH_CACHE_VERSION)
+  {
+    goto load_cleanup1;
+  }
+
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    /* Lines that did not fit in our buffer can only come from a corrupt
+     * cache file */
+    end = strchr(line, '\n');
+    if (end == NULL) {
+      goto load_cleanup1;
+    }
+    *end = '\0';
+    switch (line[0]) {
+      case 'D':
+        /* A font directory or configuration file along with its modification
+         * time when the cache was written */
+        if (sscanf(line, "D %" SCNd64 " %" SCNd64 " %n",
+              &mtimeSec, &mtimeNsec, &offset) != 2)
+        {
+          goto load_cleanup1;
+        }
+        /* The cache is stale if anything has changed since */
+        ttoy_FontPathCache_statPath(line + offset,
+            &currentSec, &currentNsec);
+        if (currentSec != mtimeSec || currentNsec != mtimeNsec) {
+          goto load_cleanup1;
+        }
+        error = ttoy_FontPathCache_addDir(self,
+            line + offset,  /* path */
+            mtimeSec,  /* mtimeSec */
+            mtimeNsec  /* mtimeNsec */
+            );
+        if (error != TTOY_NO_ERROR) {
+          goto load_cleanup1;
+        }
+        break;
+      case 'F':
+        /* A font path resolved for some key */
+        value = strchr(line, '\t');
+        if (line[1] != ' ' || value == NULL) {
+          goto load_cleanup1;
+        }
+        *value++ = '\0';
+        error = ttoy_FontPathCache_addEntry(self,
+            line + 2,  /* key */
+            value  /* path */
+            );
+        if (error != TTOY_NO_ERROR) {
+          goto load_cleanup1;
+        }
+        break;
+      default:
+        goto load_cleanup1;
+    }
+  }
+  if (self->internal->dirs == NULL) {
+    /* Without any recorded directories, we have no way to validate the
+     * cached paths */
+    error = TTOY_ERROR_CACHE_MISS;
+    goto load_cleanup1;
+  }
+  fclose(fp);
+
+  self->internal->valid = 1;
+
+  return TTOY_NO_ERROR;
+
+load_cleanup1:
+  fclose(fp);
+  ttoy_FontPathCache_clear(self);
+  return error != TTOY_NO_ERROR ? error : TTOY_ERROR_CACHE_MISS;
+}
+
+const char *
+ttoy_FontPathCache_lookup(
+    const ttoy_FontPathCache *self,
+    const char *key)
+{
+  ttoy_FontPathCache_Entry *entry;
+
+  if (!self->internal->valid)
+    return NULL;
+  for (entry = self->internal->entries; entry != NULL; entry = entry->next) {
+    if (strcmp(entry->key, key) == 0)
+      return entry->path;
+  }
+  return NULL;
+}
+
+ttoy_ErrorCode
+ttoy_FontPathCache_insert(
+    ttoy_FontPathCache *self,
+    FcConfig *fc,
+    const char *key,
+    const char *path)
+{
+  ttoy_FontPathCache_Entry *entry;
+  ttoy_ErrorCode error;
+  char *pathCopy;
+
+  /* Keys and paths with tabs or newlines would break our file format; these
+   * are simply not cached */
+  if (strpbrk(key, "\t\n") != NULL || strpbrk(path, "\t\n") != NULL)
+    return TTOY_NO_ERROR;
+
+  if (!self->internal->valid) {
+    /* Start over with the current state of the font directories */
+    ttoy_FontPathCache_clear(self);
+    error = ttoy_FontPathCache_recordDirs(self, fc);
+    if (error != TTOY_NO_ERROR) {
+      ttoy_FontPathCache_clear(self);
+      return error;
+    }
+    self->internal->valid = 1;
+  }
+
+  /* Replace any path previously cached for this key */
+  for (entry = self->internal->entries; entry != NULL; entry = entry->next) {
+    if (strcmp(entry->key, key) == 0) {
+      pathCopy = (char *)malloc(strlen(path) + 1);
+      if (pathCopy == NULL) {
+        return TTOY_ERROR_OUT_OF_MEMORY;
+      }
+      strcpy(pathCopy, path);
+      free(entry->path);
+      entry->path = pathCopy;
+      return TTOY_NO_ERROR;
+    }
+  }
+
+  return ttoy_FontPathCache_addEntry(self, key, path);
+}
+
+ttoy_ErrorCode
+ttoy_FontPathCache_store(
+    const ttoy_FontPathCache *self)
+{
+  ttoy_FontPathCache_Dir *dir;
+  ttoy_FontPathCache_Entry *entry;
+  char *cachePath, *tempPath;
+  ttoy_ErrorCode error;
+  FILE *fp;
+
+  if (!self->internal->valid)
+    return TTOY_NO_ERROR;  /* Nothing worth storing */
+
+  error = ttoy_FontPathCache_getPath(&cachePath);
+  if (error != TTOY_NO_ERROR) {
+    return error;
+  }
+
+  /* Write to a temporary file first and then rename it into place */
+  error = ttoy_createCacheFile(cachePath, &fp, &tempPath);
+  if (error != TTOY_NO_ERROR) {
+    free(cachePath);
+    return error;
+  }
+  fprintf(fp, "%s %d\n",
+      TTOY_FONT_PATH_CACHE_MAGIC,
+      TTOY_FONT_PATH_CACHE_VERSION);
+  for (dir = self->internal->dirs; dir != NULL; dir = dir->next) {
+    fprintf(fp, "D %" PRId64 " %" PRId64 " %s\n",
+        dir->mtimeSec,
+        dir->mtimeNsec,
+        dir->path);
+  }
+  for (entry = self->internal->entries; entry != NULL; entry = entry->next) {
+    fprintf(fp, "F %s\t%s\n",
+        entry->key,
+        entry->path);
+  }
+  error = ttoy_replaceCacheFile(cachePath, fp, tempPath);
+  free(cachePath);
+
+  return error;
+}
+
+ttoy_ErrorCode
+ttoy_FontPathCache_getPath(
+    char **path)
+{
+  char *cacheDir;
+  ttoy_ErrorCode error;
+  int len;
+
+  error = ttoy_getCacheDir("fonts", &cacheDir);
+  if (error != TTOY_NO_ERROR) {
+    return error;
+  }
+  len = snprintf(NULL, 0, "%s/%s", cacheDir, TTOY_FONT_PATH_CACHE_FILE);
+  *path = (char *)malloc(len + 1);
+  if (*path == NULL) {
+    free(cacheDir);
+    return TTOY_ERROR_OUT_OF_MEMORY;
+  }
+  sprintf(*path, "%s/%s", cacheDir, TTOY_FONT_PATH_CACHE_FILE);
+  free(cacheDir);
+
+  return TTOY_NO_ERROR;
+}
+
+void
+ttoy_FontPathCache_statPath(
+    const char *path,
+    int64_t *mtimeSec,
+    int64_t *mtimeNsec)
+{
+  struct stat sbuf;
+
+  if (stat(path, &sbuf) < 0) {
+    /* Paths that do not exist are recorded too, since creating them later
+     * might make new fonts available */
+    *mtimeSec = -1;
+    *mtimeNsec = 0;
+    return;
+  }
+  *mtimeSec = sbuf.st_mtim.tv_sec;
+  *mtimeNsec = sbuf.st_mtim.tv_nsec;
+}
+
+ttoy_ErrorCode
+ttoy_FontPathCache_addDir(
+    ttoy_FontPathCache *self,
+    const char *path,
+    int64_t mtimeSec,
+    int64_t mtimeNsec)
+{
+  ttoy_FontPathCache_Dir *dir;
+
+  dir = (ttoy_FontPathCache_Dir *)malloc(sizeof(ttoy_FontPathCache_Dir));
+  if (dir == NULL) {
+    return TTOY_ERROR_OUT_OF_MEMORY;
+  }
+  dir->path = (char *)malloc(strlen(path) + 1);
+  if (dir->path == NULL) {
+    free(dir);
+    return TTOY_ERROR_OUT_OF_MEMORY;
+  }
+  strcpy(dir->path, path);
+  dir->mtimeSec = mtimeSec;
+  dir->mtimeNsec = mtimeNsec;
+  dir->next = self->internal->dirs;
+  self->internal->dirs = dir;
+
+  return TTOY_NO_ERROR;
+}
+
+ttoy_ErrorCode
+ttoy_FontPathCache_addEntry(
+    ttoy_FontPathCache *self,
+    const char *key,
+    const char *path)
+{
+  ttoy_FontPathCache_Entry *entry;
+
+  entry = (ttoy_FontPathCache_Entry *)malloc(
+      sizeof(ttoy_FontPathCache_Entry));
+  if (entry == NULL) {
+    return TTOY_ERROR_OUT_OF_MEMORY;
+  }
+  entry->key = (char *)malloc(strlen(key) + 1);
+  entry->path = (char *)malloc(strlen(path) + 1);
+  if (entry->key == NULL || entry->path == NULL) {
+    free(entry->key);
+    free(entry->path);
+    free(entry);
+    return TTOY_ERROR_OUT_OF_MEMORY;
+  }
+  strcpy(entry->key, key);
+  strcpy(entry->path, path);
+  entry->next = self->internal->entries;
+  self->internal->entries = entry;
+
+  return TTOY_NO_ERROR;
+}
+
+ttoy_ErrorCode
+ttoy_FontPathCache_recordDirs(
+    ttoy_FontPathCache *self,
+    FcConfig *fc)
+{
+  FcStrList *lists[2];
+  FcChar8 *path;
+  int64_t mtimeSec, mtimeNsec;
+  ttoy_ErrorCode error;
+
+  /* Fontconfig reports every font directory it scanned, including
+   * subdirectories, so a font being added or removed anywhere changes the
+   * modification time of at least one of these. Changes to the Fontconfig
+   * configuration itself are caught by the configuration files. */
+  lists[0] = FcConfigGetFontDirs(fc);
+  lists[1] = FcConfigGetConfigFiles(fc);
+  error = TTOY_NO_ERROR;
+  for (int i = 0; i < 2; ++i) {
+    if (lists[i] == NULL) {
+      error = TTOY_ERROR_FONTCONFIG_ERROR;
+      continue;
+    }
+    while (error == TTOY_NO_ERROR
+        && (path = FcStrListNext(lists[i])) != NULL)
+    {
+      if (strchr((const char *)path, '\n') != NULL)
+        continue;
+      ttoy_FontPathCache_statPath((const char *)path,
+          &mtimeSec, &mtimeNsec);
+      error = ttoy_FontPathCache_addDir(self,
+          (const char *)path,  /* path */
+          mtimeSec,  /* mtimeSec */
+          mtimeNsec  /* mtimeNsec */
+          );
+    }
+    FcStrListDone(lists[i]);
+  }
+
+  return error;
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2016-2017 Jonathan Glines
+ * Jonathan Glines <jonathan@glines.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef TTOY_FONT_PATH_CACHE_H_
+#define TTOY_FONT_PATH_CACHE_H_
+
+#include <fontconfig/fontconfig.h>
+
+#include <ttoy/error.h>
+
+#define TTOY_FONT_PATH_CACHE_VERSION 1
+
+struct ttoy_FontPathCache_Internal_;
+typedef struct ttoy_FontPathCache_Internal_ ttoy_FontPathCache_Internal;
+
+/**
+ * An on-disk cache of font file paths resolved with Fontconfig, so that ttoy
+ * does not need to initialize Fontconfig at all when the fonts it needs have
+ * been resolved before.
+ *
+ * Along with the paths, the cache records the modification times of every
+ * font directory and configuration file Fontconfig knew about when the paths
+ * were resolved. If any of these have changed since, the entire cache is
+ * considered stale and is discarded when loaded.
+ */
+typedef struct ttoy_FontPathCache_ {
+  ttoy_FontPathCache_Internal *internal;
+} ttoy_FontPathCache;
+
+void
+ttoy_FontPathCache_init(
+    ttoy_FontPathCache *self);
+
+void
+ttoy_FontPathCache_destroy(
+    ttoy_FontPathCache *self);
+
+/**
+ * Loads the cache from the ttoy cache directory. Returns
+ * TTOY_ERROR_CACHE_MISS and leaves the cache empty if there is no cache file
+ * or if the cache file is stale.
+ */
+ttoy_ErrorCode
+ttoy_FontPathCache_load(
+    ttoy_FontPathCache *self);
+
+/**
+ * Returns the font path cached for the given key, or NULL if no path has been
+ * cached for that key.
+ */
+const char *
+ttoy_FontPathCache_lookup(
+    const ttoy_FontPathCache *self,
+    const char *key);
+
+/**
+ * Caches the font path resolved for the given key. If the cache is stale,
+ * this first discards all cached paths and records the current state of the
+ * font directories known to the given Fontconfig configuration.
+ */
+ttoy_ErrorCode
+ttoy_FontPathCache_insert(
+    ttoy_FontPathCache *self,
+    FcConfig *fc,
+    const char *key,
+    const char *path);
+
+/**
+ * Writes the cache to the ttoy cache directory.
+ */
+ttoy_ErrorCode
+ttoy_FontPathCache_store(
+    const ttoy_FontPathCache *self);
+
+#endif
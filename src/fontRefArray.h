@@ -24,9 +24,11 @@
 #ifndef TTOY_FONT_REF_ARRAY_H_
 #define TTOY_FONT_REF_ARRAY_H_
 
-#include "./common/array.h"
+#include "./common/vector.h"
 #include "fontRef.h"
 
-TTOY_DECLARE_ARRAY(ttoy_FontRef)
+/* Fonts are shared between profiles and glyph renderers, so the array holds
+ * references to them rather than copies */
+TTOY_DECLARE_NAMED_VECTOR(ttoy_FontRefArray, ttoy_FontRef *)
 
 #endif
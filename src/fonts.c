@@ -25,8 +25,17 @@
 #include <fontconfig/fontconfig.h>
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#include "common/unicodeBlocks.h"
+#include "embeddedFont.h"
 #include "error.h"
+#include "font.h"
+#include "glyphRasterizer.h"
+#include "logging.h"
+#include "fontPathCache.h"
 #include "fonts.h"
 
 /* Private methods */
@@ -34,12 +43,37 @@ void ttoy_Fonts_initFreetype();
 void ttoy_Fonts_destroyFreetype();
 void ttoy_Fonts_initFontconfig();
 void ttoy_Fonts_destroyFontconfig();
+FT_Error ttoy_Fonts_requestFace(
+    FTC_FaceID faceId,
+    FT_Library library,
+    FT_Pointer requestData,
+    FT_Face *face);
+
+typedef struct ttoy_Fonts_FontFileEntry_ {
+  ttoy_FontFile fontFile;  /* NOTE: Must be the first member */
+  int refCount;
+  struct ttoy_Fonts_FontFileEntry_ *next;
+} ttoy_Fonts_FontFileEntry;
 
 typedef struct ttoy_Fonts_ {
   ttoy_MonospaceFontFace *monospaceFonts;
   size_t numMonospaceFonts, sizeMonospaceFonts;
   FT_Library ft;
+  /* Cache of FreeType faces, sizes, charmaps and glyphs shared by all fonts.
+   * The face IDs in these caches are ttoy_FontFile pointers. */
+  FTC_Manager ftcManager;
+  FTC_CMapCache ftcCMapCache;
+  FTC_SBitCache ftcSBitCache;
+  FTC_ImageCache ftcImageCache;
+  /* Fontconfig is not initialized until a font lookup misses our font path
+   * cache */
   FcConfig *fcConfig;
+  ttoy_FontPathCache fontPathCache;
+  int fontPathCacheLoaded;
+  ttoy_GlyphRasterizer *glyphRasterizer;
+  /* Registry of font files currently in use, so that each font file is only
+   * mapped and parsed once no matter how many fonts are loaded from it */
+  ttoy_Fonts_FontFileEntry *fontFiles;
 } ttoy_Fonts;
 
 #define TTOY_FONTS_INIT_MONOSPACE_FONTS_SIZE 4
@@ -57,13 +91,42 @@ void ttoy_Fonts_init() {
       sizeof(void*) * TTOY_FONTS_INIT_MONOSPACE_FONTS_SIZE);
   self->sizeMonospaceFonts = TTOY_FONTS_INIT_MONOSPACE_FONTS_SIZE;
   self->numMonospaceFonts = 0;
+  /* The glyph rasterizer threads are not started until they are needed */
+  self->glyphRasterizer = NULL;
+  self->fontFiles = NULL;
+  /* Fontconfig is initialized lazily, since resolving font paths usually
+   * only needs our font path cache */
+  self->fcConfig = NULL;
+  ttoy_FontPathCache_init(&self->fontPathCache);
+  self->fontPathCacheLoaded = 0;
 
   ttoy_Fonts_initFreetype();
-  ttoy_Fonts_initFontconfig();
 }
 
 void ttoy_Fonts_destroy() {
-  ttoy_Fonts_destroyFontconfig();
+  ttoy_Fonts *self = ttoy_Fonts_instance();
+  if (self->glyphRasterizer != NULL) {
+    ttoy_GlyphRasterizer_destroy(self->glyphRasterizer);
+    free(self->glyphRasterizer);
+    self->glyphRasterizer = NULL;
+  }
+  /* The cache manager must release its faces before we unmap the font files
+   * they were created from */
+  if (self->ftcManager != NULL) {
+    FTC_Manager_Done(self->ftcManager);
+    self->ftcManager = NULL;
+  }
+  /* Release any font files that are still open */
+  while (self->fontFiles != NULL) {
+    ttoy_Fonts_FontFileEntry *entry = self->fontFiles;
+    self->fontFiles = entry->next;
+    ttoy_FontFile_destroy(&entry->fontFile);
+    free(entry);
+  }
+  ttoy_FontPathCache_destroy(&self->fontPathCache);
+  if (self->fcConfig != NULL) {
+    ttoy_Fonts_destroyFontconfig();
+  }
   ttoy_Fonts_destroyFreetype();
 }
 
@@ -76,6 +139,58 @@ void ttoy_Fonts_initFreetype() {
     fprintf(stderr, "Error initializing FreeType 2 library\n");
     /* TODO: Print out an error string for this specific error */
   }
+
+  /* Initialize the FreeType cache manager and the caches we use with it */
+  self->ftcManager = NULL;
+  error = FTC_Manager_New(
+      self->ft,  /* library */
+      TTOY_FONTS_CACHE_MAX_FACES,  /* max_faces */
+      TTOY_FONTS_CACHE_MAX_SIZES,  /* max_sizes */
+      TTOY_FONTS_CACHE_MAX_BYTES,  /* max_bytes */
+      ttoy_Fonts_requestFace,  /* requester */
+      NULL,  /* req_data */
+      &self->ftcManager  /* amanager */
+      );
+  if (error != FT_Err_Ok) {
+    TTOY_LOG_ERROR("Error initializing FreeType cache manager: %s",
+        ttoy_FreeTypeErrorString(error));
+    self->ftcManager = NULL;
+    return;
+  }
+  error = FTC_CMapCache_New(self->ftcManager, &self->ftcCMapCache);
+  if (error != FT_Err_Ok) {
+    TTOY_LOG_ERROR("Error creating FreeType charmap cache: %s",
+        ttoy_FreeTypeErrorString(error));
+  }
+  error = FTC_SBitCache_New(self->ftcManager, &self->ftcSBitCache);
+  if (error != FT_Err_Ok) {
+    TTOY_LOG_ERROR("Error creating FreeType small bitmap cache: %s",
+        ttoy_FreeTypeErrorString(error));
+  }
+  error = FTC_ImageCache_New(self->ftcManager, &self->ftcImageCache);
+  if (error != FT_Err_Ok) {
+    TTOY_LOG_ERROR("Error creating FreeType image cache: %s",
+        ttoy_FreeTypeErrorString(error));
+  }
+}
+
+FT_Error ttoy_Fonts_requestFace(
+    FTC_FaceID faceId,
+    FT_Library library,
+    FT_Pointer requestData,
+    FT_Face *face)
+{
+  ttoy_FontFile *fontFile = (ttoy_FontFile *)faceId;
+
+  /* Create the face over the memory-mapped font file; the font file outlives
+   * the face, since we remove it from the cache manager before closing it */
+  return FT_New_Memory_Face(
+      library,  /* library */
+      ttoy_FontFile_getData(fontFile),  /* file_base */
+      ttoy_FontFile_getSize(fontFile),  /* file_size */
+      0,  /* face_index */
+      face  /* aface */
+      );
 }
 
 void ttoy_Fonts_destroyFreetype() {
@@ -99,6 +214,7 @@ void ttoy_Fonts_destroyFontconfig() {
   ttoy_Fonts *self = ttoy_Fonts_instance();
 
   FcConfigDestroy(self->fcConfig);
+  self->fcConfig = NULL;
   FcFini();
 }
 
@@ -111,9 +227,397 @@ FT_Library ttoy_Fonts_getFreeTypeInstance() {
 FcConfig *ttoy_Fonts_getFontconfigInstance() {
   ttoy_Fonts *self = ttoy_Fonts_instance();
 
+  if (self->fcConfig == NULL) {
+    /* Building the Fontconfig font sets can take a while on systems with
+     * many fonts, so we only do this once Fontconfig is actually needed */
+    ttoy_Fonts_initFontconfig();
+  }
+
   return self->fcConfig;
 }
 
+ttoy_ErrorCode ttoy_Fonts_findFont(
+    const char *faceName,
+    char **fontPath)
+{
+  ttoy_Fonts *self = ttoy_Fonts_instance();
+  FcConfig *fc;
+  FcPattern *pattern;
+  FcFontSet *sourceFontSets[2];
+  FcFontSet *resultFontSet;
+  FcResult fcResult;
+  FcValue fcValue;
+  struct stat sbuf;
+  const char *path;
+  char *key;
+  ttoy_ErrorCode error;
+
+  /* The embedded font needs neither Fontconfig nor our font path cache */
+  if (strcmp(faceName, TTOY_EMBEDDED_FONT_FACE) == 0) {
+    *fontPath = (char *)malloc(strlen(TTOY_EMBEDDED_FONT_PATH) + 1);
+    if (*fontPath == NULL) {
+      return TTOY_ERROR_OUT_OF_MEMORY;
+    }
+    strcpy(*fontPath, TTOY_EMBEDDED_FONT_PATH);
+    return TTOY_NO_ERROR;
+  }
+
+  /* Font paths are cached under a key describing our Fontconfig query */
+  key = (char *)malloc(strlen("mono:") + strlen(faceName) + 1);
+  if (key == NULL) {
+    return TTOY_ERROR_OUT_OF_MEMORY;
+  }
+  sprintf(key, "mono:%s", faceName);
+
+  /* Look for the font path in our font path cache first */
+  if (!self->fontPathCacheLoaded) {
+    /* A stale or missing cache simply starts out empty */
+    ttoy_FontPathCache_load(&self->fontPathCache);
+    self->fontPathCacheLoaded = 1;
+  }
+  path = ttoy_FontPathCache_lookup(&self->fontPathCache, key);
+  if (path != NULL && stat(path, &sbuf) == 0) {
+    *fontPath = (char *)malloc(strlen(path) + 1);
+    if (*fontPath == NULL) {
+      error = TTOY_ERROR_OUT_OF_MEMORY;
+      goto findFont_cleanup1;
+    }
+    strcpy(*fontPath, path);
+    error = TTOY_NO_ERROR;
+    goto findFont_cleanup1;
+  }
+
+  /* Use fontconfig to look for a font with this face */
+  fc = ttoy_Fonts_getFontconfigInstance();
+
+  /* Build a Fontconfig pattern describing our font criteria */
+  pattern = FcPatternBuild(
+      NULL,  /* pattern */
+      FC_SPACING, FcTypeInteger, FC_MONO,  /* Look for monospace fonts... */
+      FC_FULLNAME, FcTypeString, faceName,  /* ...with this font face. */
+      (char *) NULL  /* terminator */
+      );
+  if (pattern == NULL) {
+    error = TTOY_ERROR_FONTCONFIG_ERROR;
+    goto findFont_cleanup1;
+  }
+
+  /* Look for fonts matching our criteria */
+  sourceFontSets[0] = FcConfigGetFonts(fc, FcSetSystem);
+  sourceFontSets[1] = FcConfigGetFonts(fc, FcSetApplication);
+  resultFontSet = FcFontSetList(
+      fc,  /* config */
+      sourceFontSets,  /* sets */
+      2,  /* nsets */
+      pattern,  /* pattern */
+      /* FIXME: Fontconfig documentation is not clear on the utility of
+       * object_set */
+      NULL  /* object_set */
+      );
+  if (resultFontSet == NULL) {
+    error = TTOY_ERROR_FONTCONFIG_ERROR;
+    goto findFont_cleanup2;
+  }
+
+  /* Select the first font matching our criteria */
+  if (resultFontSet->nfont <= 0) {
+    /* We can always fall back to the embedded font */
+    TTOY_LOG_ERROR(
+        "Fontconfig could not find any suitable fonts for face '%s'; "
+        "using the embedded '%s' font instead",
+        faceName,
+        TTOY_EMBEDDED_FONT_FACE);
+    *fontPath = (char *)malloc(strlen(TTOY_EMBEDDED_FONT_PATH) + 1);
+    if (*fontPath == NULL) {
+      error = TTOY_ERROR_OUT_OF_MEMORY;
+      goto findFont_cleanup3;
+    }
+    strcpy(*fontPath, TTOY_EMBEDDED_FONT_PATH);
+    error = TTOY_NO_ERROR;
+    goto findFont_cleanup3;
+  }
+
+  /* Get the file path of the matching font */
+  fcResult = FcPatternGet(
+      resultFontSet->fonts[0],  /* pattern */
+      FC_FILE,  /* object */
+      0,  /* id */
+      &fcValue  /* value */
+      );
+  if (fcResult != FcResultMatch || fcValue.u.s == NULL) {
+    error = TTOY_ERROR_FONTCONFIG_ERROR;
+    goto findFont_cleanup3;
+  }
+
+  /* Remember this font path for the next time ttoy starts */
+  error = ttoy_FontPathCache_insert(&self->fontPathCache,
+      fc,  /* fc */
+      key,  /* key */
+      (const char *)fcValue.u.s  /* path */
+      );
+  if (error == TTOY_NO_ERROR) {
+    ttoy_FontPathCache_store(&self->fontPathCache);
+  }
+  path = ttoy_FontPathCache_lookup(&self->fontPathCache, key);
+  if (path == NULL) {
+    /* The path could not be cached, but we can still use it */
+    path = (const char *)fcValue.u.s;
+  }
+
+  *fontPath = (char *)malloc(strlen(path) + 1);
+  if (*fontPath == NULL) {
+    error = TTOY_ERROR_OUT_OF_MEMORY;
+    goto findFont_cleanup3;
+  }
+  strcpy(*fontPath, path);
+
+  error = TTOY_NO_ERROR;
+
+findFont_cleanup3:
+  FcFontSetDestroy(resultFontSet);
+findFont_cleanup2:
+  FcPatternDestroy(pattern);
+findFont_cleanup1:
+  free(key);
+
+  return error;
+}
+
+ttoy_ErrorCode ttoy_Fonts_findFallbackFont(
+    uint32_t character,
+    char **fontPath)
+{
+  ttoy_Fonts *self = ttoy_Fonts_instance();
+  FcConfig *fc;
+  FcPattern *pattern;
+  FcCharSet *charSet, *fontCharSet;
+  FcFontSet *resultFontSet;
+  FcResult fcResult;
+  FcChar8 *file;
+  const char *path;
+  char key[32];
+  ttoy_ErrorCode error;
+
+  /* Fallback fonts are resolved once per Unicode block, on the assumption
+   * that a font providing one character in a block likely provides the rest
+   * of that block as well */
+  sprintf(key, "fallback:%04" PRIX32, ttoy_getUnicodeBlockStart(character));
+
+  /* Look for the fallback font in our font path cache first */
+  if (!self->fontPathCacheLoaded) {
+    /* A stale or missing cache simply starts out empty */
+    ttoy_FontPathCache_load(&self->fontPathCache);
+    self->fontPathCacheLoaded = 1;
+  }
+  path = ttoy_FontPathCache_lookup(&self->fontPathCache, key);
+  if (path != NULL && path[0] == '\0') {
+    /* We already know that no font provides this block */
+    return TTOY_ERROR_MISSING_FONT_FOR_CHARACTER_CODE;
+  }
+  if (path != NULL && access(path, R_OK) == 0) {
+    *fontPath = (char *)malloc(strlen(path) + 1);
+    if (*fontPath == NULL) {
+      return TTOY_ERROR_OUT_OF_MEMORY;
+    }
+    strcpy(*fontPath, path);
+    return TTOY_NO_ERROR;
+  }
+
+  /* Ask Fontconfig for the best font providing this character */
+  fc = ttoy_Fonts_getFontconfigInstance();
+
+  charSet = FcCharSetCreate();
+  if (charSet == NULL || !FcCharSetAddChar(charSet, character)) {
+    error = TTOY_ERROR_FONTCONFIG_ERROR;
+    goto findFallbackFont_cleanup1;
+  }
+  pattern = FcPatternCreate();
+  if (pattern == NULL || !FcPatternAddCharSet(pattern, FC_CHARSET, charSet)) {
+    error = TTOY_ERROR_FONTCONFIG_ERROR;
+    goto findFallbackFont_cleanup2;
+  }
+  FcConfigSubstitute(fc, pattern, FcMatchPattern);
+  FcDefaultSubstitute(pattern);
+  resultFontSet = FcFontSort(
+      fc,  /* config */
+      pattern,  /* p */
+      FcTrue,  /* trim */
+      NULL,  /* csp */
+      &fcResult  /* result */
+      );
+  if (resultFontSet == NULL) {
+    error = TTOY_ERROR_FONTCONFIG_ERROR;
+    goto findFallbackFont_cleanup2;
+  }
+
+  /* FcFontSort() orders fonts by how well they match our pattern, but does
+   * not guarantee that they actually provide our character */
+  path = "";
+  for (int i = 0; i < resultFontSet->nfont; ++i) {
+    if (FcPatternGetCharSet(resultFontSet->fonts[i],
+          FC_CHARSET, 0, &fontCharSet) != FcResultMatch
+        || !FcCharSetHasChar(fontCharSet, character))
+    {
+      continue;
+    }
+    if (FcPatternGetString(resultFontSet->fonts[i],
+          FC_FILE, 0, &file) == FcResultMatch)
+    {
+      path = (const char *)file;
+      break;
+    }
+  }
+
+  /* Remember this fallback font for the next time ttoy starts, including
+   * when there is no fallback font at all */
+  error = ttoy_FontPathCache_insert(&self->fontPathCache,
+      fc,  /* fc */
+      key,  /* key */
+      path  /* path */
+      );
+  if (error == TTOY_NO_ERROR) {
+    ttoy_FontPathCache_store(&self->fontPathCache);
+  }
+
+  if (path[0] == '\0') {
+    error = TTOY_ERROR_MISSING_FONT_FOR_CHARACTER_CODE;
+    goto findFallbackFont_cleanup3;
+  }
+  *fontPath = (char *)malloc(strlen(path) + 1);
+  if (*fontPath == NULL) {
+    error = TTOY_ERROR_OUT_OF_MEMORY;
+    goto findFallbackFont_cleanup3;
+  }
+  strcpy(*fontPath, path);
+
+  error = TTOY_NO_ERROR;
+
+findFallbackFont_cleanup3:
+  FcFontSetDestroy(resultFontSet);
+findFallbackFont_cleanup2:
+  if (pattern != NULL)
+    FcPatternDestroy(pattern);
+findFallbackFont_cleanup1:
+  if (charSet != NULL)
+    FcCharSetDestroy(charSet);
+
+  return error;
+}
+
+FTC_Manager ttoy_Fonts_getCacheManager() {
+  ttoy_Fonts *self = ttoy_Fonts_instance();
+
+  return self->ftcManager;
+}
+
+FTC_CMapCache ttoy_Fonts_getCMapCache() {
+  ttoy_Fonts *self = ttoy_Fonts_instance();
+
+  return self->ftcCMapCache;
+}
+
+FTC_SBitCache ttoy_Fonts_getSBitCache() {
+  ttoy_Fonts *self = ttoy_Fonts_instance();
+
+  return self->ftcSBitCache;
+}
+
+FTC_ImageCache ttoy_Fonts_getImageCache() {
+  ttoy_Fonts *self = ttoy_Fonts_instance();
+
+  return self->ftcImageCache;
+}
+
+ttoy_GlyphRasterizer *ttoy_Fonts_getGlyphRasterizer() {
+  ttoy_Fonts *self = ttoy_Fonts_instance();
+  if (self->glyphRasterizer == NULL) {
+    /* Start the glyph rasterizer threads */
+    self->glyphRasterizer = (ttoy_GlyphRasterizer *)malloc(
+        sizeof(ttoy_GlyphRasterizer));
+    ttoy_GlyphRasterizer_init(self->glyphRasterizer);
+  }
+  return self->glyphRasterizer;
+}
+
+ttoy_ErrorCode ttoy_Fonts_openFontFile(
+    const char *path,
+    ttoy_FontFile **fontFile)
+{
+  ttoy_Fonts *self = ttoy_Fonts_instance();
+  ttoy_Fonts_FontFileEntry *entry;
+  ttoy_ErrorCode error;
+
+  /* Look for a font file that has already been loaded from this path */
+  for (entry = self->fontFiles; entry != NULL; entry = entry->next) {
+    if (strcmp(ttoy_FontFile_getPath(&entry->fontFile), path) == 0) {
+      entry->refCount += 1;
+      *fontFile = &entry->fontFile;
+      return TTOY_NO_ERROR;
+    }
+  }
+
+  /* Load the font file and add it to our registry */
+  entry = (ttoy_Fonts_FontFileEntry *)malloc(sizeof(ttoy_Fonts_FontFileEntry));
+  if (entry == NULL) {
+    return TTOY_ERROR_OUT_OF_MEMORY;
+  }
+  ttoy_FontFile_init(&entry->fontFile);
+  if (ttoy_isEmbeddedFontPath(path)) {
+    /* The embedded font is already in memory */
+    const FT_Byte *data;
+    size_t size;
+    ttoy_getEmbeddedFont(&data, &size);
+    error = ttoy_FontFile_loadMemory(&entry->fontFile,
+        path,  /* path */
+        data,  /* data */
+        size  /* size */
+        );
+  } else {
+    error = ttoy_FontFile_load(&entry->fontFile,
+        path  /* path */
+        );
+  }
+  if (error != TTOY_NO_ERROR) {
+    ttoy_FontFile_destroy(&entry->fontFile);
+    free(entry);
+    return error;
+  }
+  entry->refCount = 1;
+  entry->next = self->fontFiles;
+  self->fontFiles = entry;
+
+  *fontFile = &entry->fontFile;
+
+  return TTOY_NO_ERROR;
+}
+
+void ttoy_Fonts_closeFontFile(
+    ttoy_FontFile *fontFile)
+{
+  ttoy_Fonts *self = ttoy_Fonts_instance();
+  ttoy_Fonts_FontFileEntry **entry;
+
+  for (entry = &self->fontFiles; *entry != NULL; entry = &(*entry)->next) {
+    if (&(*entry)->fontFile == fontFile) {
+      (*entry)->refCount -= 1;
+      if ((*entry)->refCount == 0) {
+        /* Nobody is using this font file anymore */
+        ttoy_Fonts_FontFileEntry *unused = *entry;
+        *entry = unused->next;
+        /* Flush the face and sizes we created for this font file from the
+         * cache before unmapping it */
+        FTC_Manager_RemoveFaceID(self->ftcManager,
+            (FTC_FaceID)&unused->fontFile);
+        ttoy_FontFile_destroy(&unused->fontFile);
+        free(unused);
+      }
+      return;
+    }
+  }
+  TTOY_LOG_ERROR("Font file '%s' is not in the font file registry",
+      ttoy_FontFile_getPath(fontFile));
+}
+
 void ttoy_Fonts_calculateFacePixelBBox(
     const FT_Face face,
     int *width, int *height)
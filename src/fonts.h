@@ -26,10 +26,15 @@
 
 #include <ft2build.h>
 #include FT_FREETYPE_H
+#include FT_CACHE_H
 
 #include <fontconfig/fontconfig.h>
 #include <inttypes.h>
 
+#include <ttoy/error.h>
+
+#include "fontFile.h"
+
 typedef struct {
   int w, h, x, y;
 } ttoy_AtlasPos;
@@ -63,8 +68,80 @@ void ttoy_Fonts_init();
 void ttoy_Fonts_destroy();
 
 FT_Library ttoy_Fonts_getFreeTypeInstance();
+/**
+ * Returns the Fontconfig configuration, initializing Fontconfig the first
+ * time it is called.
+ */
 FcConfig *ttoy_Fonts_getFontconfigInstance();
 
+/**
+ * Resolves the path of the monospace font file with the given face name.
+ * Resolved paths are cached on disk, and Fontconfig is only initialized when
+ * the face is not found in that cache. The embedded font is used for its own
+ * face name and for faces Fontconfig cannot find, in which case the path
+ * returned is TTOY_EMBEDDED_FONT_PATH.
+ *
+ * The path returned is allocated with malloc(3) and must be freed by the
+ * caller.
+ */
+ttoy_ErrorCode ttoy_Fonts_findFont(
+    const char *faceName,
+    char **fontPath);
+
+/**
+ * Resolves the path of a font file providing the given character, for use
+ * when none of the fonts in a profile provide it. Fallback fonts are resolved
+ * and cached (both in memory and on disk) per Unicode block, so Fontconfig is
+ * queried at most once for each block.
+ *
+ * Returns TTOY_ERROR_MISSING_FONT_FOR_CHARACTER_CODE if no font provides the
+ * character. The path returned is allocated with malloc(3) and must be freed
+ * by the caller.
+ */
+ttoy_ErrorCode ttoy_Fonts_findFallbackFont(
+    uint32_t character,
+    char **fontPath);
+
+/* Limits of the FreeType cache manager shared by all fonts */
+#define TTOY_FONTS_CACHE_MAX_FACES 8
+#define TTOY_FONTS_CACHE_MAX_SIZES 16
+#define TTOY_FONTS_CACHE_MAX_BYTES (4 * 1024 * 1024)
+
+/**
+ * Returns the FreeType cache manager and caches shared by all fonts. Face IDs
+ * in these caches are the ttoy_FontFile pointers returned by
+ * ttoy_Fonts_openFontFile().
+ *
+ * The FreeType cache is not thread safe; these must only be used from the
+ * main thread.
+ */
+FTC_Manager ttoy_Fonts_getCacheManager();
+FTC_CMapCache ttoy_Fonts_getCMapCache();
+FTC_SBitCache ttoy_Fonts_getSBitCache();
+FTC_ImageCache ttoy_Fonts_getImageCache();
+
+/**
+ * Opens the font file at the given path through the process-wide registry of
+ * font files. Each font file is mapped into memory and parsed by FreeType only
+ * once; subsequent calls with the same path return the same font file.
+ *
+ * Every font file obtained with this function must be released with
+ * ttoy_Fonts_closeFontFile().
+ */
+ttoy_ErrorCode ttoy_Fonts_openFontFile(
+    const char *path,
+    ttoy_FontFile **fontFile);
+
+void ttoy_Fonts_closeFontFile(
+    ttoy_FontFile *fontFile);
+
+struct ttoy_GlyphRasterizer_;
+/**
+ * Returns the process-wide pool of glyph rasterization threads, starting the
+ * threads the first time it is called.
+ */
+struct ttoy_GlyphRasterizer_ *ttoy_Fonts_getGlyphRasterizer();
+
 ttoy_MonospaceFontFace *ttoy_Fonts_loadMonospace(
     int width, int height,
     const char *fontPath);
@@ -22,15 +22,31 @@
  */
 
 #include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "collisionDetection.h"
+#include "common/arena.h"
+#include "common/cacheDir.h"
 #include "common/glError.h"
+#include "common/hash.h"
+#include "common/vector.h"
+#include "embeddedFont.h"
 #include "fonts.h"
 #include "glyphAtlas.h"
+#include "glyphRasterizer.h"
+#include "logging.h"
 #include "naiveCollisionDetection.h"
 
 #define max(a, b) (a) < (b) ? (b) : (a);
 
+/* Packing an atlas needs a few kilobytes of glyph entries and rasterizer jobs;
+ * the atlas texture itself gets a chunk of its own */
+#define TTOY_GLYPH_ATLAS_ARENA_CHUNK_SIZE (16 * 1024)
+
 /* Private data structures */
 typedef struct ttoy_GlyphAtlasEntry_ {
   ttoy_BoundingBox bbox;
@@ -40,13 +56,39 @@ typedef struct ttoy_GlyphAtlasEntry_ {
   int fontIndex;
 } ttoy_GlyphAtlasEntry;
 
+/* Layout of the glyph atlas cache files. The header is followed by the glyph
+ * entries and then the atlas texture itself, so that the texture can be
+ * uploaded straight out of the mapped file. */
+#define TTOY_GLYPH_ATLAS_CACHE_MAGIC "ttoyATLS"
+typedef struct ttoy_GlyphAtlasCacheHeader_ {
+  char magic[8];
+  uint32_t version;
+  uint32_t entrySize;
+  uint64_t key;
+  uint32_t numGlyphs;
+  int32_t textureSize;
+} ttoy_GlyphAtlasCacheHeader;
+
+TTOY_DECLARE_VECTOR(ttoy_GlyphAtlasEntry)
+
 struct ttoy_GlyphAtlas_Internal {
-  ttoy_GlyphAtlasEntry *glyphs;
-  size_t numGlyphs, sizeGlyphs;
+  ttoy_GlyphAtlasEntryVector glyphs;
   GLuint textureBuffer;
   int textureSize;
 };
 
+struct ttoy_GlyphAtlasStaging_Internal {
+  const ttoy_GlyphAtlasEntry *glyphs;
+  size_t numGlyphs;
+  const uint8_t *atlasTexture;
+  int textureSize;
+  /* The glyphs and atlas texture point either into our arena if we packed
+   * them ourselves, into a mapped cache file, or into the embedded atlas */
+  ttoy_Arena arena;
+  void *mapping;
+  size_t mappingSize;
+};
+
 /* Private method declarations */
 void ttoy_GlyphAtlas_blitGlyph(
     const ttoy_GlyphAtlasEntry *glyph,
@@ -54,6 +96,49 @@ void ttoy_GlyphAtlas_blitGlyph(
     int padding,
     uint8_t *atlasTexture,
     int textureSize);
+void ttoy_GlyphAtlas_uploadTexture(
+    ttoy_GlyphAtlas *self,
+    const uint8_t *atlasTexture,
+    int textureSize);
+void ttoy_GlyphAtlas_appendGlyphs(
+    ttoy_GlyphAtlas *self,
+    const ttoy_GlyphAtlasEntry *glyphs,
+    size_t numGlyphs);
+ttoy_ErrorCode
+ttoy_GlyphAtlas_getASCIICacheKey(
+    ttoy_GlyphRenderer *glyphRenderer,
+    uint64_t *key);
+ttoy_ErrorCode
+ttoy_GlyphAtlas_packASCIIGlyphs(
+    ttoy_GlyphRenderer *glyphRenderer,
+    ttoy_Arena *arena,
+    ttoy_GlyphAtlasEntry **glyphs,
+    size_t *numGlyphs,
+    uint8_t **packedTexture,
+    int *packedTextureSize);
+ttoy_ErrorCode
+ttoy_GlyphAtlas_getCachePath(
+    uint64_t key,
+    char **path);
+ttoy_ErrorCode
+ttoy_GlyphAtlasStaging_loadCache(
+    ttoy_GlyphAtlasStaging *self,
+    const char *path,
+    uint64_t key);
+ttoy_ErrorCode
+ttoy_GlyphAtlasStaging_loadCacheData(
+    ttoy_GlyphAtlasStaging *self,
+    const uint8_t *data,
+    size_t size,
+    uint64_t key);
+ttoy_ErrorCode
+ttoy_GlyphAtlas_storeCache(
+    const char *path,
+    uint64_t key,
+    const ttoy_GlyphAtlasEntry *glyphs,
+    size_t numGlyphs,
+    const uint8_t *atlasTexture,
+    int textureSize);
 
 void ttoy_GlyphAtlas_init(
     ttoy_GlyphAtlas_ptr self)
@@ -61,20 +146,20 @@ void ttoy_GlyphAtlas_init(
   /* Allocate memory for internal data structures */
   self->internal = (struct ttoy_GlyphAtlas_Internal *)malloc(
       sizeof(struct ttoy_GlyphAtlas_Internal));
-  self->internal->sizeGlyphs = TTOY_GLYPH_ATLAS_INIT_SIZE_GLYPHS;
-  self->internal->glyphs = (ttoy_GlyphAtlasEntry *)malloc(
-      sizeof(ttoy_GlyphAtlasEntry) * self->internal->sizeGlyphs);
-  self->internal->numGlyphs = 0;
+  ttoy_GlyphAtlasEntryVector_init(&self->internal->glyphs);
+  ttoy_GlyphAtlasEntryVector_reserve(&self->internal->glyphs,
+      TTOY_GLYPH_ATLAS_INIT_SIZE_GLYPHS  /* capacity */
+      );
   /* Initialize our texture buffer */
   glGenTextures(1, &self->internal->textureBuffer);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
 }
 
 void ttoy_GlyphAtlas_destroy(
     ttoy_GlyphAtlas_ptr self)
 {
   /* Free internal data structures */
-  free(self->internal->glyphs);
+  ttoy_GlyphAtlasEntryVector_destroy(&self->internal->glyphs);
   free(self->internal);
 }
 
@@ -107,9 +192,246 @@ int ttoy_compareGlyphs(
   return 0;
 }
 
+int ttoy_compareJobCharacter(
+    const uint32_t *character,
+    const ttoy_GlyphRasterizerJob *job)
+{
+  if (*character < job->character)
+    return -1;
+  if (*character > job->character)
+    return 1;
+  return 0;
+}
+
 void ttoy_GlyphAtlas_renderASCIIGlyphs(
     ttoy_GlyphAtlas *self,
     ttoy_GlyphRenderer *glyphRenderer)
+{
+  ttoy_GlyphAtlasStaging staging;
+  ttoy_ErrorCode error;
+
+  ttoy_GlyphAtlasStaging_init(&staging);
+  error = ttoy_GlyphAtlasStaging_renderASCIIGlyphs(&staging,
+      glyphRenderer  /* glyphRenderer */
+      );
+  if (error != TTOY_NO_ERROR) {
+    TTOY_LOG_ERROR_CODE(error);
+  } else {
+    ttoy_GlyphAtlas_uploadStaging(self,
+        &staging  /* staging */
+        );
+  }
+  ttoy_GlyphAtlasStaging_destroy(&staging);
+}
+
+void ttoy_GlyphAtlas_uploadStaging(
+    ttoy_GlyphAtlas *self,
+    const ttoy_GlyphAtlasStaging *staging)
+{
+  /* Send the staged atlas texture to the GL */
+  ttoy_GlyphAtlas_uploadTexture(self,
+      staging->internal->atlasTexture,  /* atlasTexture */
+      staging->internal->textureSize  /* textureSize */
+      );
+  /* Add the staged glyphs to the glyphs stored in our internal data
+   * structure */
+  ttoy_GlyphAtlas_appendGlyphs(self,
+      staging->internal->glyphs,  /* glyphs */
+      staging->internal->numGlyphs  /* numGlyphs */
+      );
+}
+
+void ttoy_GlyphAtlasStaging_init(
+    ttoy_GlyphAtlasStaging *self)
+{
+  /* Allocate memory for internal data structures */
+  self->internal = (struct ttoy_GlyphAtlasStaging_Internal *)malloc(
+      sizeof(struct ttoy_GlyphAtlasStaging_Internal));
+  self->internal->glyphs = NULL;
+  self->internal->numGlyphs = 0;
+  self->internal->atlasTexture = NULL;
+  self->internal->textureSize = 0;
+  ttoy_Arena_init(&self->internal->arena,
+      TTOY_GLYPH_ATLAS_ARENA_CHUNK_SIZE  /* chunkSize */
+      );
+  self->internal->mapping = NULL;
+  self->internal->mappingSize = 0;
+}
+
+void ttoy_GlyphAtlasStaging_destroy(
+    ttoy_GlyphAtlasStaging *self)
+{
+  /* Release whatever memory is backing the staged atlas */
+  ttoy_Arena_destroy(&self->internal->arena);
+  if (self->internal->mapping != NULL) {
+    munmap(self->internal->mapping, self->internal->mappingSize);
+  }
+  free(self->internal);
+}
+
+ttoy_ErrorCode
+ttoy_GlyphAtlasStaging_renderASCIIGlyphs(
+    ttoy_GlyphAtlasStaging *self,
+    ttoy_GlyphRenderer *glyphRenderer)
+{
+  const uint8_t *embeddedAtlas;
+  size_t embeddedAtlasSize;
+  ttoy_GlyphAtlasEntry *packedGlyphs;
+  uint8_t *packedTexture;
+  uint64_t cacheKey;
+  char *cachePath;
+  ttoy_ErrorCode error, cacheError;
+
+  /* Look for an atlas that was already packed and rendered for these fonts,
+   * either at build time for the embedded font or by a previous run of ttoy,
+   * in which case we can skip FreeType entirely */
+  cachePath = NULL;
+  cacheError = ttoy_GlyphAtlas_getASCIICacheKey(glyphRenderer,
+      &cacheKey  /* key */
+      );
+  if (cacheError == TTOY_NO_ERROR) {
+    ttoy_getEmbeddedAtlas(&embeddedAtlas, &embeddedAtlasSize);
+    if (embeddedAtlas != NULL) {
+      cacheError = ttoy_GlyphAtlasStaging_loadCacheData(self,
+          embeddedAtlas,  /* data */
+          embeddedAtlasSize,  /* size */
+          cacheKey  /* key */
+          );
+      if (cacheError == TTOY_NO_ERROR)
+        return TTOY_NO_ERROR;
+    }
+    cacheError = ttoy_GlyphAtlas_getCachePath(
+        cacheKey,  /* key */
+        &cachePath  /* path */
+        );
+  }
+  if (cacheError == TTOY_NO_ERROR) {
+    cacheError = ttoy_GlyphAtlasStaging_loadCache(self,
+        cachePath,  /* path */
+        cacheKey  /* key */
+        );
+    if (cacheError == TTOY_NO_ERROR) {
+      free(cachePath);
+      return TTOY_NO_ERROR;
+    }
+  }
+
+  /* Render and pack our glyphs */
+  error = ttoy_GlyphAtlas_packASCIIGlyphs(glyphRenderer,
+      &self->internal->arena,  /* arena */
+      &packedGlyphs,  /* glyphs */
+      &self->internal->numGlyphs,  /* numGlyphs */
+      &packedTexture,  /* atlasTexture */
+      &self->internal->textureSize  /* textureSize */
+      );
+  if (error != TTOY_NO_ERROR) {
+    free(cachePath);
+    return error;
+  }
+  self->internal->glyphs = packedGlyphs;
+  self->internal->atlasTexture = packedTexture;
+
+  /* Store the atlas on disk so that the next run can skip all of this work */
+  if (cachePath != NULL) {
+    cacheError = ttoy_GlyphAtlas_storeCache(
+        cachePath,  /* path */
+        cacheKey,  /* key */
+        self->internal->glyphs,  /* glyphs */
+        self->internal->numGlyphs,  /* numGlyphs */
+        self->internal->atlasTexture,  /* atlasTexture */
+        self->internal->textureSize  /* textureSize */
+        );
+    if (cacheError != TTOY_NO_ERROR) {
+      /* NOTE: Not a fatal error */
+      TTOY_LOG_ERROR_CODE(cacheError);
+    }
+    free(cachePath);
+  }
+
+  return TTOY_NO_ERROR;
+}
+
+ttoy_ErrorCode
+ttoy_GlyphAtlas_writeASCIICache(
+    ttoy_GlyphRenderer *glyphRenderer,
+    const char *path)
+{
+  ttoy_Arena arena;
+  ttoy_GlyphAtlasEntry *glyphs;
+  size_t numGlyphs;
+  uint8_t *atlasTexture;
+  int textureSize;
+  uint64_t cacheKey;
+  ttoy_ErrorCode error;
+
+  error = ttoy_GlyphAtlas_getASCIICacheKey(glyphRenderer,
+      &cacheKey  /* key */
+      );
+  if (error != TTOY_NO_ERROR) {
+    return error;
+  }
+  ttoy_Arena_init(&arena,
+      TTOY_GLYPH_ATLAS_ARENA_CHUNK_SIZE  /* chunkSize */
+      );
+  error = ttoy_GlyphAtlas_packASCIIGlyphs(glyphRenderer,
+      &arena,  /* arena */
+      &glyphs,  /* glyphs */
+      &numGlyphs,  /* numGlyphs */
+      &atlasTexture,  /* atlasTexture */
+      &textureSize  /* textureSize */
+      );
+  if (error != TTOY_NO_ERROR) {
+    ttoy_Arena_destroy(&arena);
+    return error;
+  }
+  error = ttoy_GlyphAtlas_storeCache(
+      path,  /* path */
+      cacheKey,  /* key */
+      glyphs,  /* glyphs */
+      numGlyphs,  /* numGlyphs */
+      atlasTexture,  /* atlasTexture */
+      textureSize  /* textureSize */
+      );
+
+  ttoy_Arena_destroy(&arena);
+
+  return error;
+}
+
+ttoy_ErrorCode
+ttoy_GlyphAtlas_getASCIICacheKey(
+    ttoy_GlyphRenderer *glyphRenderer,
+    uint64_t *key)
+{
+  const int padding = TTOY_GLYPH_ATLAS_PADDING;
+  ttoy_ErrorCode error;
+
+  error = ttoy_GlyphRenderer_getCacheKey(glyphRenderer,
+      key  /* key */
+      );
+  if (error != TTOY_NO_ERROR) {
+    return error;
+  }
+  /* Mix the glyph padding into the key, since it affects the layout */
+  *key = ttoy_hash(*key, &padding, sizeof(padding));
+
+  return TTOY_NO_ERROR;
+}
+
+/**
+ * Renders the printable ASCII glyphs of the given glyph renderer and packs
+ * them into an atlas texture in memory. This does not touch the GL, so that
+ * atlases can also be packed at build time. The glyphs, the atlas texture and
+ * all of our scratch memory are allocated from the given arena.
+ */
+ttoy_ErrorCode
+ttoy_GlyphAtlas_packASCIIGlyphs(
+    ttoy_GlyphRenderer *glyphRenderer,
+    ttoy_Arena *arena,
+    ttoy_GlyphAtlasEntry **glyphs,
+    size_t *numGlyphs,
+    uint8_t **packedTexture,
+    int *packedTextureSize)
 {
 #define PRINT_ASCII_FIRST 33
 #define PRINT_ASCII_LAST 126
@@ -120,17 +442,26 @@ void ttoy_GlyphAtlas_renderASCIIGlyphs(
    * detection can be performed more cheaply. */
   ttoy_NaiveCollisionDetection collisionDetection;
   ttoy_GlyphAtlasEntry *currentGlyph, *collidingGlyph;
-  FT_Bitmap *bitmap;
-  size_t numPendingGlyphs;
+  ttoy_GlyphRasterizerJob *jobs, *job;
+  int fontIndices[NUM_PRINT_ASCII];
+  const FT_Bitmap *bitmap;
+  size_t numPendingGlyphs, numJobs;
   int done;
   uint8_t *atlasTexture;
   int textureSize;
-  const int padding = 2;
+  const int padding = TTOY_GLYPH_ATLAS_PADDING;
   int error;
   int cellWidth, cellHeight;
 
-  pendingGlyphs = (ttoy_GlyphAtlasEntry*)malloc(
-      sizeof(ttoy_GlyphAtlasEntry) * NUM_PRINT_ASCII);
+  pendingGlyphs = (ttoy_GlyphAtlasEntry *)ttoy_Arena_alloc(arena,
+      sizeof(ttoy_GlyphAtlasEntry) * NUM_PRINT_ASCII  /* size */
+      );
+  jobs = (ttoy_GlyphRasterizerJob *)ttoy_Arena_alloc(arena,
+      sizeof(ttoy_GlyphRasterizerJob) * NUM_PRINT_ASCII  /* size */
+      );
+  if (pendingGlyphs == NULL || jobs == NULL) {
+    return TTOY_ERROR_OUT_OF_MEMORY;
+  }
 
   /* We will need to store the cell size with each glyph rendered, for future
    * reference if the cell size ever changes */
@@ -139,32 +470,47 @@ void ttoy_GlyphAtlas_renderASCIIGlyphs(
       &cellHeight  /* height */
       );
 
-  /* Iterate over the printable ASCII characters and gather glyphs (without
-   * rendering them) from this face */
-  numPendingGlyphs = 0;
+  /* Iterate over the printable ASCII characters and determine which font
+   * provides each glyph */
+  numJobs = 0;
   for (uint32_t c = PRINT_ASCII_FIRST;
       c <= PRINT_ASCII_LAST;
       ++c)
   {
-    assert(numPendingGlyphs < NUM_PRINT_ASCII);
-    currentGlyph = &pendingGlyphs[numPendingGlyphs];
-    /* Check for the glyph and get its dimensions */
-    error = ttoy_GlyphRenderer_getGlyphDimensions(glyphRenderer,
+    assert(numJobs < NUM_PRINT_ASCII);
+    error = ttoy_GlyphRenderer_getFont(glyphRenderer,
         c,  /* character */
         0,  /* bold */
-        &currentGlyph->bbox.w, &currentGlyph->bbox.h);
+        &jobs[numJobs].font,  /* font */
+        &fontIndices[numJobs]  /* fontIndex */
+        );
     if (error)
       continue;  /* This glyph is not being provided */
+    jobs[numJobs].character = c;
+    numJobs += 1;
+  }
+
+  /* Render all of the glyphs concurrently. The resulting bitmaps are staged
+   * in memory until we know where to place them in the atlas. */
+  ttoy_GlyphRasterizer_rasterize(ttoy_Fonts_getGlyphRasterizer(),
+      jobs,  /* jobs */
+      numJobs  /* numJobs */
+      );
+
+  /* Gather the dimensions of our glyphs */
+  numPendingGlyphs = 0;
+  for (size_t i = 0; i < numJobs; ++i) {
+    if (jobs[i].error != TTOY_NO_ERROR)
+      continue;  /* This glyph could not be rendered */
     /* Add this glyph to our list of glyphs */
+    currentGlyph = &pendingGlyphs[numPendingGlyphs];
     numPendingGlyphs += 1;
-    currentGlyph->ch = c;
-    /* Store the glyph offset */
-    ttoy_GlyphRenderer_getGlyphOffset(glyphRenderer,
-        c,  /* character */
-        0,  /* bold */
-        &currentGlyph->xOffset,  /* x */
-        &currentGlyph->yOffset  /* y */
-        );
+    currentGlyph->ch = jobs[i].character;
+    currentGlyph->fontIndex = fontIndices[i];
+    currentGlyph->bbox.w = jobs[i].width;
+    currentGlyph->bbox.h = jobs[i].height;
+    currentGlyph->xOffset = jobs[i].xOffset;
+    currentGlyph->yOffset = jobs[i].yOffset;
     /* Add padding to the glyph size */
     currentGlyph->bbox.w += 2 * padding;
     currentGlyph->bbox.h += 2 * padding;
@@ -180,15 +526,6 @@ void ttoy_GlyphAtlas_renderASCIIGlyphs(
      * being computed. */
     currentGlyph->cellWidth = cellWidth;
     currentGlyph->cellHeight = cellHeight;
-    /*
-    fprintf(stderr,
-        "currentGlyph: '%c'\n"
-        "    currentGlyph->bbox.w: %d\n"
-        "    currentGlyph->bbox.h: %d\n",
-        (char)currentGlyph->ch,
-        currentGlyph->bbox.w,
-        currentGlyph->bbox.h);
-        */
   }
   /* FIXME: I think there's a bug here in case we ever load a font with no
    * glyphs. The atlas seems to grow out of control. */
@@ -208,7 +545,7 @@ void ttoy_GlyphAtlas_renderASCIIGlyphs(
       textureSize <= TTOY_GLYPH_ATLAS_MAX_TEXTURE_SIZE && !done;
       textureSize *= 2)
   {
-    fprintf(stderr, "Growing atlas texture to %dx%d\n",
+    TTOY_LOG_DEBUG("Growing atlas texture to %dx%d",
         textureSize, textureSize);
     ttoy_NaiveCollisionDetection_init(&collisionDetection);
     /* Position glyphs in the texture, starting with the largest glyphs */
@@ -268,7 +605,7 @@ void ttoy_GlyphAtlas_renderASCIIGlyphs(
       if (!done) {
         /* We were unable to place this glyph in the atlas; break out of this
          * loop to grow the atlas texture */
-        fprintf(stderr, "Could not place glyph '%c'\n",
+        TTOY_LOG_DEBUG("Could not place glyph '%c'",
             (char)currentGlyph->ch);
         break;
       }
@@ -278,21 +615,32 @@ void ttoy_GlyphAtlas_renderASCIIGlyphs(
     ttoy_NaiveCollisionDetection_destroy(&collisionDetection);
   }
   assert(done);
-  fprintf(stderr, "Ultimate atlas texture size: %dx%d\n",
+  TTOY_LOG_DEBUG("Ultimate atlas texture size: %dx%d",
       textureSize, textureSize);
-  self->internal->textureSize = textureSize;
   /* Allocate memory for our atlas texture */
-  atlasTexture = (uint8_t*)malloc(textureSize * textureSize);
+  atlasTexture = (uint8_t *)ttoy_Arena_alloc(arena,
+      textureSize * textureSize  /* size */
+      );
+  if (atlasTexture == NULL) {
+    for (size_t i = 0; i < numJobs; ++i) {
+      ttoy_GlyphRasterizerJob_destroy(&jobs[i]);
+    }
+    return TTOY_ERROR_OUT_OF_MEMORY;
+  }
   memset(atlasTexture, 0 /* XXX */, textureSize * textureSize);
   for (int i = 0; i < numPendingGlyphs; ++i) {
     currentGlyph = &pendingGlyphs[i];
-    /* Render each glyph */
-    error = ttoy_GlyphRenderer_renderGlyph(glyphRenderer,
-        currentGlyph->ch,  /* character */
-        0,  /* bold */
-        &bitmap,  /* bitmap */
-        &currentGlyph->fontIndex  /* fontIndex */
+    /* Find the staged bitmap for this glyph; our jobs are sorted by
+     * character */
+    job = (ttoy_GlyphRasterizerJob *)bsearch(
+        &currentGlyph->ch,  /* key */
+        jobs,  /* base */
+        numJobs,  /* nmemb */
+        sizeof(ttoy_GlyphRasterizerJob),  /* size */
+        (int(*)(const void *, const void *))ttoy_compareJobCharacter  /* compar */
         );
+    assert(job != NULL);
+    bitmap = &job->bitmap;
     assert(bitmap->width < currentGlyph->bbox.w);
     assert(bitmap->rows < currentGlyph->bbox.h);
     /* Blit the rendered glyph onto our texture in memory */
@@ -315,9 +663,27 @@ void ttoy_GlyphAtlas_renderASCIIGlyphs(
   }
   */
   /* TODO: Output the atlas texture to a PNG file for debugging */
-  /* Send our atlas texture to the GL */
+
+  for (size_t i = 0; i < numJobs; ++i) {
+    ttoy_GlyphRasterizerJob_destroy(&jobs[i]);
+  }
+
+  *glyphs = pendingGlyphs;
+  *numGlyphs = numPendingGlyphs;
+  *packedTexture = atlasTexture;
+  *packedTextureSize = textureSize;
+
+  return TTOY_NO_ERROR;
+}
+
+void ttoy_GlyphAtlas_uploadTexture(
+    ttoy_GlyphAtlas *self,
+    const uint8_t *atlasTexture,
+    int textureSize)
+{
+  self->internal->textureSize = textureSize;
   glBindTexture(GL_TEXTURE_2D, self->internal->textureBuffer);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glTexImage2D(
       GL_TEXTURE_2D,  /* target */
       0,  /* level */
@@ -329,54 +695,204 @@ void ttoy_GlyphAtlas_renderASCIIGlyphs(
       GL_UNSIGNED_BYTE,  /* type */
       atlasTexture  /* data */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glTexParameteri(
       GL_TEXTURE_2D,  /* target */
       GL_TEXTURE_MIN_FILTER,  /* pname */
       GL_NEAREST  /* param */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glTexParameteri(
       GL_TEXTURE_2D,  /* target */
       GL_TEXTURE_MAG_FILTER,  /* pname */
       GL_NEAREST  /* param */
       );
-  FORCE_ASSERT_GL_ERROR();
-
-  if (self->internal->numGlyphs + numPendingGlyphs > self->internal->sizeGlyphs) {
-    ttoy_GlyphAtlasEntry *newGlyphs;
-    /* Grow the array of glyphs to hold the new glyphs */
-    /* FIXME: This could probably be moved to an ttoy_GlyphAtlas_growGlyphs()
-     * private method */
-    do {
-      self->internal->sizeGlyphs *= 2;
-    } while (
-        self->internal->numGlyphs + numPendingGlyphs > self->internal->sizeGlyphs);
-    newGlyphs = (ttoy_GlyphAtlasEntry *)malloc(
-        sizeof(ttoy_GlyphAtlasEntry) * self->internal->sizeGlyphs);
-    memcpy(newGlyphs, self->internal->glyphs,
-        sizeof(ttoy_GlyphAtlasEntry) * self->internal->numGlyphs);
-    free(self->internal->glyphs);
-    self->internal->glyphs = newGlyphs;
-  }
+  ASSERT_GL_ERROR();
+}
 
-  /* Copy the pending glyphs to the array of glyphs stored in our internal data
-   * structure */
-  memcpy(
-      &self->internal->glyphs[self->internal->numGlyphs],
-      pendingGlyphs,
-      sizeof(ttoy_GlyphAtlasEntry) * numPendingGlyphs);
-  self->internal->numGlyphs += numPendingGlyphs;
+void ttoy_GlyphAtlas_appendGlyphs(
+    ttoy_GlyphAtlas *self,
+    const ttoy_GlyphAtlasEntry *glyphs,
+    size_t numGlyphs)
+{
+  ttoy_ErrorCode error;
+
+  /* Copy the glyphs to the end of our array of glyphs */
+  error = ttoy_GlyphAtlasEntryVector_appendN(&self->internal->glyphs,
+      glyphs,  /* values */
+      numGlyphs  /* count */
+      );
+  if (error != TTOY_NO_ERROR) {
+    TTOY_LOG_ERROR_CODE(error);
+    /* FIXME: Fail gracefully here */
+    assert(0);
+  }
   /* Sort the glyphs by character so that they can be searched */
   qsort(
-    self->internal->glyphs,  /* ptr */
-    self->internal->numGlyphs,  /* count */
+    ttoy_GlyphAtlasEntryVector_data(&self->internal->glyphs),  /* ptr */
+    ttoy_GlyphAtlasEntryVector_size(&self->internal->glyphs),  /* count */
     sizeof(ttoy_GlyphAtlasEntry),  /* size */
     (int(*)(const void *, const void *))ttoy_compareGlyphs  /* comp */
     );
+}
+
+ttoy_ErrorCode
+ttoy_GlyphAtlas_getCachePath(
+    uint64_t key,
+    char **path)
+{
+  ttoy_ErrorCode error;
+  char *dir;
+  int len;
+
+  error = ttoy_getCacheDir("atlas", &dir);
+  if (error != TTOY_NO_ERROR) {
+    return error;
+  }
+  len = snprintf(NULL, 0, "%s/%016" PRIx64 ".atlas", dir, key);
+  *path = (char *)malloc(len + 1);
+  if (*path == NULL) {
+    free(dir);
+    return TTOY_ERROR_OUT_OF_MEMORY;
+  }
+  sprintf(*path, "%s/%016" PRIx64 ".atlas", dir, key);
+  free(dir);
+
+  return TTOY_NO_ERROR;
+}
+
+ttoy_ErrorCode
+ttoy_GlyphAtlasStaging_loadCache(
+    ttoy_GlyphAtlasStaging *self,
+    const char *path,
+    uint64_t key)
+{
+  struct stat sbuf;
+  void *data;
+  int fd, result;
+  ttoy_ErrorCode error;
+
+  fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    /* Cache files that do not exist yet are not worth complaining about */
+    return TTOY_ERROR_CACHE_MISS;
+  }
+  result = fstat(fd, &sbuf);
+  if (result < 0 || sbuf.st_size < sizeof(ttoy_GlyphAtlasCacheHeader)) {
+    close(fd);
+    return TTOY_ERROR_CACHE_MISS;
+  }
+  data = mmap(
+      NULL,  /* addr */
+      sbuf.st_size,  /* length */
+      PROT_READ,  /* prot */
+      MAP_PRIVATE,  /* flags */
+      fd,  /* fd */
+      0  /* offset */
+      );
+  close(fd);
+  if (data == MAP_FAILED) {
+    TTOY_LOG_ERROR("Failed to map glyph atlas cache '%s': %s",
+        path,
+        strerror(errno));
+    return TTOY_ERROR_CACHE_MISS;
+  }
+
+  error = ttoy_GlyphAtlasStaging_loadCacheData(self,
+      (const uint8_t *)data,  /* data */
+      sbuf.st_size,  /* size */
+      key  /* key */
+      );
+  if (error != TTOY_NO_ERROR) {
+    munmap(data, sbuf.st_size);
+    return error;
+  }
+  /* Keep the file mapped until the staged atlas is destroyed */
+  self->internal->mapping = data;
+  self->internal->mappingSize = sbuf.st_size;
+
+  return TTOY_NO_ERROR;
+}
+
+ttoy_ErrorCode
+ttoy_GlyphAtlasStaging_loadCacheData(
+    ttoy_GlyphAtlasStaging *self,
+    const uint8_t *data,
+    size_t size,
+    uint64_t key)
+{
+  ttoy_GlyphAtlasCacheHeader header;
+  size_t expectedSize;
+
+  /* Copy the header out, since embedded atlas data need not be aligned */
+  if (size < sizeof(header))
+    return TTOY_ERROR_CACHE_MISS;
+  memcpy(&header, data, sizeof(header));
+
+  /* Make sure the cache file was written by this version of ttoy for the same
+   * fonts, and that it is not truncated */
+  if (memcmp(header.magic, TTOY_GLYPH_ATLAS_CACHE_MAGIC,
+        sizeof(header.magic)) != 0)
+    return TTOY_ERROR_CACHE_MISS;
+  if (header.version != TTOY_GLYPH_ATLAS_CACHE_VERSION
+      || header.entrySize != sizeof(ttoy_GlyphAtlasEntry)
+      || header.key != key)
+    return TTOY_ERROR_CACHE_MISS;
+  if (header.textureSize < TTOY_GLYPH_ATLAS_MIN_TEXTURE_SIZE
+      || header.textureSize > TTOY_GLYPH_ATLAS_MAX_TEXTURE_SIZE)
+    return TTOY_ERROR_CACHE_MISS;
+  expectedSize = sizeof(ttoy_GlyphAtlasCacheHeader)
+    + (size_t)header.numGlyphs * sizeof(ttoy_GlyphAtlasEntry)
+    + (size_t)header.textureSize * (size_t)header.textureSize;
+  if (size != expectedSize)
+    return TTOY_ERROR_CACHE_MISS;
+
+  /* Stage the atlas so that its texture is uploaded directly from the cached
+   * data */
+  self->internal->glyphs =
+    (const ttoy_GlyphAtlasEntry *)(data + sizeof(header));
+  self->internal->numGlyphs = header.numGlyphs;
+  self->internal->atlasTexture =
+    (const uint8_t *)(self->internal->glyphs + header.numGlyphs);
+  self->internal->textureSize = header.textureSize;
+
+  return TTOY_NO_ERROR;
+}
+
+ttoy_ErrorCode
+ttoy_GlyphAtlas_storeCache(
+    const char *path,
+    uint64_t key,
+    const ttoy_GlyphAtlasEntry *glyphs,
+    size_t numGlyphs,
+    const uint8_t *atlasTexture,
+    int textureSize)
+{
+  ttoy_GlyphAtlasCacheHeader header;
+  FILE *fp;
+  char *tempPath;
+  ttoy_ErrorCode error;
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, TTOY_GLYPH_ATLAS_CACHE_MAGIC, sizeof(header.magic));
+  header.version = TTOY_GLYPH_ATLAS_CACHE_VERSION;
+  header.entrySize = sizeof(ttoy_GlyphAtlasEntry);
+  header.key = key;
+  header.numGlyphs = numGlyphs;
+  header.textureSize = textureSize;
+
+  /* Write to a temporary file first and then rename it into place */
+  error = ttoy_createCacheFile(path, &fp, &tempPath);
+  if (error != TTOY_NO_ERROR) {
+    return error;
+  }
+  fwrite(&header, sizeof(header), 1, fp);
+  if (numGlyphs > 0) {
+    fwrite(glyphs, sizeof(ttoy_GlyphAtlasEntry), numGlyphs, fp);
+  }
+  fwrite(atlasTexture, textureSize, textureSize, fp);
 
-  free(atlasTexture);
-  free(pendingGlyphs);
+  return ttoy_replaceCacheFile(path, fp, tempPath);
 }
 
 ttoy_ErrorCode
@@ -394,21 +910,24 @@ ttoy_GlyphAtlas_getGlyph(
 {
   int a, b, i;
   float widthRatio, heightRatio;
-  ttoy_GlyphAtlasEntry *currentGlyph;
+  ttoy_GlyphAtlasEntry *glyphs, *currentGlyph;
   ttoy_GlyphAtlasEntry target;
+  size_t numGlyphs;
   int result;
-  if (self->internal->numGlyphs == 0)
+  glyphs = ttoy_GlyphAtlasEntryVector_data(&self->internal->glyphs);
+  numGlyphs = ttoy_GlyphAtlasEntryVector_size(&self->internal->glyphs);
+  if (numGlyphs == 0)
     return TTOY_ERROR_ATLAS_GLYPH_NOT_FOUND;
   target.ch = character;
   target.fontIndex = fontIndex;
-  currentGlyph = &self->internal->glyphs[0];
+  currentGlyph = &glyphs[0];
   /* Binary search for the glyph corresponding to the given character */
   /* FIXME: Check the loop conditions and write some unit tests for this thing;
    * this binary search is probably broken */
-  a = 0; b = self->internal->numGlyphs;
+  a = 0; b = numGlyphs;
   while (a < b) {
     i = (b - a) / 2 + a;
-    currentGlyph = &self->internal->glyphs[i];
+    currentGlyph = &glyphs[i];
     result = ttoy_compareGlyphs(&target, currentGlyph);
     if (result < 0) {
       b = i;
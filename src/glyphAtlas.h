@@ -38,6 +38,9 @@
 #define TTOY_GLYPH_ATLAS_MAX_TEXTURE_SIZE 4096
 #define TTOY_GLYPH_ATLAS_INIT_SIZE_GLYPHS 256
 #define TTOY_GLYPH_ATLAS_MAX_NUM_TEXTURES 4
+#define TTOY_GLYPH_ATLAS_PADDING 2
+/* Bump this whenever the layout of glyph atlas cache files changes */
+#define TTOY_GLYPH_ATLAS_CACHE_VERSION 1
 
 struct ttoy_GlyphAtlas_Internal;
 
@@ -65,6 +68,20 @@ typedef struct ttoy_GlyphAtlas_ {
 } ttoy_GlyphAtlas;
 typedef struct ttoy_GlyphAtlas_ * ttoy_GlyphAtlas_ptr;
 
+struct ttoy_GlyphAtlasStaging_Internal;
+
+/**
+ * Glyphs that have been rendered and packed into an atlas texture in memory,
+ * but not yet sent to the GL.
+ *
+ * Preparing a staging atlas does not touch the GL, so it can be done on a
+ * worker thread (e.g. while the window and GL context are being created at
+ * startup) and uploaded later with ttoy_GlyphAtlas_uploadStaging().
+ */
+typedef struct ttoy_GlyphAtlasStaging_ {
+  struct ttoy_GlyphAtlasStaging_Internal *internal;
+} ttoy_GlyphAtlasStaging;
+
 /* Public methods */
 /**
  * Initializes the internal structures of the given glyph atlas.
@@ -87,6 +104,12 @@ void ttoy_GlyphAtlas_destroy(
  * pack glyphs into the atlas more intelligently, and we avoid the latency of
  * loading glyphs on-demand.
  *
+ * The packed atlas is cached on disk under "$XDG_CACHE_HOME/ttoy/atlas",
+ * keyed by the fonts of the given glyph renderer. When a matching cache file
+ * exists, it is mapped into memory and uploaded directly without rendering
+ * any glyphs. The atlas packed at build time for the embedded font is used
+ * the same way, before looking on disk.
+ *
  * Since adding glyphs might cause the atlas to allocate new texture buffers in
  * the GL, this method must be called after the GL has been initialized.
  */
@@ -94,6 +117,27 @@ void ttoy_GlyphAtlas_renderASCIIGlyphs(
     ttoy_GlyphAtlas *self,
     ttoy_GlyphRenderer *glyphRenderer);
 
+/**
+ * Renders and packs the printable ASCII glyphs of the given glyph renderer,
+ * and writes them to a glyph atlas cache file at the given path. This does
+ * not require the GL, and is used to pack the atlas of the embedded font at
+ * build time.
+ */
+/**
+ * Sends the glyphs of the given staging atlas to the GL and adds them to this
+ * glyph atlas. This has the same effect as
+ * ttoy_GlyphAtlas_renderASCIIGlyphs() for the glyph renderer that the staging
+ * atlas was prepared with.
+ */
+void ttoy_GlyphAtlas_uploadStaging(
+    ttoy_GlyphAtlas *self,
+    const ttoy_GlyphAtlasStaging *staging);
+
+ttoy_ErrorCode
+ttoy_GlyphAtlas_writeASCIICache(
+    ttoy_GlyphRenderer *glyphRenderer,
+    const char *path);
+
 void ttoy_GlyphAtlas_addGlyph(
     /* TODO */);
 
@@ -118,4 +162,21 @@ void ttoy_GlyphAtlas_getTextures(
 int ttoy_GlyphAtlas_getTextureSize(
     const ttoy_GlyphAtlas *self);
 
+void ttoy_GlyphAtlasStaging_init(
+    ttoy_GlyphAtlasStaging *self);
+
+void ttoy_GlyphAtlasStaging_destroy(
+    ttoy_GlyphAtlasStaging *self);
+
+/**
+ * Renders and packs the printable ASCII glyphs of the given glyph renderer
+ * into this staging atlas, going through the same embedded and on-disk atlas
+ * caches as ttoy_GlyphAtlas_renderASCIIGlyphs(). This method does not require
+ * the GL.
+ */
+ttoy_ErrorCode
+ttoy_GlyphAtlasStaging_renderASCIIGlyphs(
+    ttoy_GlyphAtlasStaging *self,
+    ttoy_GlyphRenderer *glyphRenderer);
+
 #endif
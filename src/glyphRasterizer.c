@@ -0,0 +1,353 @@
+/*
+ * Copyright (c) 2016-2017 Jonathan Glines
+ * Jonathan Glines <jonathan@glines.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <SDL.h>
+#include <SDL_thread.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "logging.h"
+
+#include "glyphRasterizer.h"
+
+typedef struct ttoy_GlyphRasterizer_Worker_ {
+  ttoy_GlyphRasterizer *rasterizer;
+  SDL_Thread *thread;
+  FT_Library ft;
+  /* The face this worker is currently rendering glyphs with, which is only
+   * valid for the duration of a single batch */
+  const ttoy_Font *faceFont;
+  FT_Face face;
+} ttoy_GlyphRasterizer_Worker;
+
+struct ttoy_GlyphRasterizer_Internal_ {
+  /* The first worker belongs to the thread that calls rasterize() */
+  ttoy_GlyphRasterizer_Worker workers[TTOY_GLYPH_RASTERIZER_MAX_THREADS];
+  int numWorkers;
+  SDL_mutex *mutex;
+  SDL_cond *workCond, *doneCond;
+  ttoy_GlyphRasterizerJob *jobs;
+  size_t numJobs, nextJob, numDoneJobs;
+  int numActiveWorkers;
+  int quit;
+};
+
+/* Private methods */
+int
+ttoy_GlyphRasterizer_workerThread(
+    ttoy_GlyphRasterizer_Worker *worker);
+void
+ttoy_GlyphRasterizer_work(
+    ttoy_GlyphRasterizer *self,
+    ttoy_GlyphRasterizer_Worker *worker);
+void
+ttoy_GlyphRasterizer_renderJob(
+    ttoy_GlyphRasterizer_Worker *worker,
+    ttoy_GlyphRasterizerJob *job);
+void
+ttoy_GlyphRasterizer_releaseFace(
+    ttoy_GlyphRasterizer_Worker *worker);
+
+void
+ttoy_GlyphRasterizer_init(
+    ttoy_GlyphRasterizer *self)
+{
+  ttoy_GlyphRasterizer_Worker *worker;
+  FT_Error ftError;
+  int numWorkers;
+
+  /* Allocate memory for internal structures */
+  self->internal = (ttoy_GlyphRasterizer_Internal *)malloc(
+      sizeof(ttoy_GlyphRasterizer_Internal));
+  self->internal->mutex = SDL_CreateMutex();
+  self->internal->workCond = SDL_CreateCond();
+  self->internal->doneCond = SDL_CreateCond();
+  self->internal->jobs = NULL;
+  self->internal->numJobs = 0;
+  self->internal->nextJob = 0;
+  self->internal->numDoneJobs = 0;
+  self->internal->numActiveWorkers = 0;
+  self->internal->quit = 0;
+
+  /* Use one worker per core, counting the calling thread */
+  numWorkers = SDL_GetCPUCount();
+  if (numWorkers < 1)
+    numWorkers = 1;
+  if (numWorkers > TTOY_GLYPH_RASTERIZER_MAX_THREADS)
+    numWorkers = TTOY_GLYPH_RASTERIZER_MAX_THREADS;
+
+  self->internal->numWorkers = 0;
+  for (int i = 0; i < numWorkers; ++i) {
+    worker = &self->internal->workers[i];
+    worker->rasterizer = self;
+    worker->thread = NULL;
+    worker->faceFont = NULL;
+    worker->face = NULL;
+    /* Each worker gets its own FreeType library instance, since FreeType
+     * objects must not be shared between threads */
+    ftError = FT_Init_FreeType(&worker->ft);
+    if (ftError != FT_Err_Ok) {
+      TTOY_LOG_ERROR("Error initializing FreeType 2 library: %s",
+          ttoy_FreeTypeErrorString(ftError));
+      break;
+    }
+    self->internal->numWorkers += 1;
+    if (i == 0)
+      continue;  /* The first worker runs on the calling thread */
+    worker->thread = SDL_CreateThread(
+        (SDL_ThreadFunction)ttoy_GlyphRasterizer_workerThread,  /* fn */
+        "ttoy_GlyphRasterizer_workerThread",  /* name */
+        (void *)worker  /* data */
+        );
+    if (worker->thread == NULL) {
+      TTOY_LOG_ERROR("Failed to create glyph rasterizer thread: %s",
+          SDL_GetError());
+      FT_Done_FreeType(worker->ft);
+      self->internal->numWorkers -= 1;
+      break;
+    }
+  }
+}
+
+void
+ttoy_GlyphRasterizer_destroy(
+    ttoy_GlyphRasterizer *self)
+{
+  ttoy_GlyphRasterizer_Worker *worker;
+
+  /* Tell our worker threads to quit */
+  SDL_LockMutex(self->internal->mutex);
+  self->internal->quit = 1;
+  SDL_CondBroadcast(self->internal->workCond);
+  SDL_UnlockMutex(self->internal->mutex);
+
+  for (int i = 0; i < self->internal->numWorkers; ++i) {
+    worker = &self->internal->workers[i];
+    if (worker->thread != NULL) {
+      SDL_WaitThread(worker->thread, NULL);
+    }
+    assert(worker->face == NULL);
+    FT_Done_FreeType(worker->ft);
+  }
+
+  SDL_DestroyCond(self->internal->doneCond);
+  SDL_DestroyCond(self->internal->workCond);
+  SDL_DestroyMutex(self->internal->mutex);
+  free(self->internal);
+}
+
+void
+ttoy_GlyphRasterizer_rasterize(
+    ttoy_GlyphRasterizer *self,
+    ttoy_GlyphRasterizerJob *jobs,
+    size_t numJobs)
+{
+  if (self->internal->numWorkers == 0) {
+    for (size_t i = 0; i < numJobs; ++i) {
+      jobs[i].error = TTOY_ERROR_FREETYPE_ERROR;
+      memset(&jobs[i].bitmap, 0, sizeof(jobs[i].bitmap));
+    }
+    return;
+  }
+
+  /* Hand the batch over to our workers */
+  SDL_LockMutex(self->internal->mutex);
+  assert(self->internal->jobs == NULL);
+  self->internal->jobs = jobs;
+  self->internal->numJobs = numJobs;
+  self->internal->nextJob = 0;
+  self->internal->numDoneJobs = 0;
+  SDL_CondBroadcast(self->internal->workCond);
+
+  /* Render glyphs on this thread as well */
+  ttoy_GlyphRasterizer_work(self,
+      &self->internal->workers[0]  /* worker */
+      );
+
+  /* Wait for the other workers to finish, including releasing their faces,
+   * since the caller might destroy the fonts as soon as we return */
+  while (self->internal->numDoneJobs < self->internal->numJobs
+      || self->internal->numActiveWorkers > 0)
+  {
+    SDL_CondWait(self->internal->doneCond, self->internal->mutex);
+  }
+  self->internal->jobs = NULL;
+  self->internal->numJobs = 0;
+  self->internal->nextJob = 0;
+  SDL_UnlockMutex(self->internal->mutex);
+}
+
+int
+ttoy_GlyphRasterizer_workerThread(
+    ttoy_GlyphRasterizer_Worker *worker)
+{
+  ttoy_GlyphRasterizer *self;
+
+  self = worker->rasterizer;
+
+  SDL_LockMutex(self->internal->mutex);
+  while (!self->internal->quit) {
+    if (self->internal->nextJob >= self->internal->numJobs) {
+      /* Wait for a new batch of glyphs */
+      SDL_CondWait(self->internal->workCond, self->internal->mutex);
+      continue;
+    }
+    ttoy_GlyphRasterizer_work(self, worker);
+    SDL_CondBroadcast(self->internal->doneCond);
+  }
+  SDL_UnlockMutex(self->internal->mutex);
+
+  return 0;
+}
+
+/**
+ * Renders jobs from the current batch until no jobs remain. The mutex must be
+ * locked when calling this method, and it is locked again when it returns.
+ */
+void
+ttoy_GlyphRasterizer_work(
+    ttoy_GlyphRasterizer *self,
+    ttoy_GlyphRasterizer_Worker *worker)
+{
+  ttoy_GlyphRasterizerJob *job;
+
+  self->internal->numActiveWorkers += 1;
+  while (self->internal->nextJob < self->internal->numJobs) {
+    job = &self->internal->jobs[self->internal->nextJob++];
+    SDL_UnlockMutex(self->internal->mutex);
+    ttoy_GlyphRasterizer_renderJob(worker, job);
+    SDL_LockMutex(self->internal->mutex);
+    self->internal->numDoneJobs += 1;
+  }
+  SDL_UnlockMutex(self->internal->mutex);
+
+  /* Our faces are only good for this batch */
+  ttoy_GlyphRasterizer_releaseFace(worker);
+
+  SDL_LockMutex(self->internal->mutex);
+  self->internal->numActiveWorkers -= 1;
+}
+
+void
+ttoy_GlyphRasterizer_renderJob(
+    ttoy_GlyphRasterizer_Worker *worker,
+    ttoy_GlyphRasterizerJob *job)
+{
+  FT_UInt glyph_index;
+  FT_Error ftError;
+  FT_Bitmap *bitmap;
+  size_t bufferSize;
+
+  memset(&job->bitmap, 0, sizeof(job->bitmap));
+  job->width = job->height = 0;
+  job->xOffset = job->yOffset = 0;
+
+  if (worker->faceFont != job->font) {
+    /* Create a face for this font, replacing our face for the last font */
+    ttoy_GlyphRasterizer_releaseFace(worker);
+    job->error = ttoy_Font_newFace(job->font,
+        worker->ft,  /* library */
+        &worker->face  /* face */
+        );
+    if (job->error != TTOY_NO_ERROR) {
+      worker->face = NULL;
+      return;
+    }
+    worker->faceFont = job->font;
+  }
+
+  /* Look for the glyph that corresponds with the given character code */
+  glyph_index = FT_Get_Char_Index(worker->face, job->character);
+  if (!glyph_index) {
+    job->error = TTOY_ERROR_FONT_GLYPH_NOT_FOUND;
+    return;
+  }
+
+  /* Load and render the glyph */
+  ftError = FT_Load_Glyph(
+      worker->face,  /* face */
+      glyph_index,  /* glyph_index */
+      FT_LOAD_DEFAULT  /* load_flags */
+      );
+  if (ftError == FT_Err_Ok) {
+    ftError = FT_Render_Glyph(
+        worker->face->glyph,  /* slot */
+        FT_RENDER_MODE_NORMAL  /* render_mode */
+        );
+  }
+  if (ftError != FT_Err_Ok) {
+    TTOY_LOG_ERROR(
+        "Freetype error rendering the glyph for the character '0x%08x': %s",
+        job->character,
+        ttoy_FreeTypeErrorString(ftError));
+    job->error = TTOY_ERROR_FREETYPE_ERROR;
+    return;
+  }
+
+  /* Compute the glyph metrics while the glyph is still in the glyph slot */
+  ttoy_Font_getFaceGlyphDimensions(worker->face,
+      &job->width,  /* width */
+      &job->height  /* height */
+      );
+  ttoy_Font_getFaceGlyphOffset(worker->face,
+      &job->xOffset,  /* x */
+      &job->yOffset  /* y */
+      );
+
+  /* Copy the rendered glyph into our staging bitmap, since the glyph slot is
+   * overwritten by the next glyph */
+  bitmap = &worker->face->glyph->bitmap;
+  job->bitmap = *bitmap;
+  bufferSize = (size_t)bitmap->rows * (size_t)abs(bitmap->pitch);
+  job->bitmap.buffer = (unsigned char *)malloc(bufferSize > 0 ? bufferSize : 1);
+  if (job->bitmap.buffer == NULL) {
+    memset(&job->bitmap, 0, sizeof(job->bitmap));
+    job->error = TTOY_ERROR_OUT_OF_MEMORY;
+    return;
+  }
+  if (bufferSize > 0) {
+    memcpy(job->bitmap.buffer, bitmap->buffer, bufferSize);
+  }
+
+  job->error = TTOY_NO_ERROR;
+}
+
+void
+ttoy_GlyphRasterizer_releaseFace(
+    ttoy_GlyphRasterizer_Worker *worker)
+{
+  if (worker->face != NULL) {
+    FT_Done_Face(worker->face);
+    worker->face = NULL;
+  }
+  worker->faceFont = NULL;
+}
+
+void
+ttoy_GlyphRasterizerJob_destroy(
+    ttoy_GlyphRasterizerJob *self)
+{
+  free(self->bitmap.buffer);
+  self->bitmap.buffer = NULL;
+}
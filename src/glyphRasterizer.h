@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2016-2017 Jonathan Glines
+ * Jonathan Glines <jonathan@glines.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef TTOY_GLYPH_RASTERIZER_H_
+#define TTOY_GLYPH_RASTERIZER_H_
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+#include <inttypes.h>
+#include <stddef.h>
+
+#include <ttoy/error.h>
+
+#include "font.h"
+
+#define TTOY_GLYPH_RASTERIZER_MAX_THREADS 8
+
+struct ttoy_GlyphRasterizer_Internal_;
+typedef struct ttoy_GlyphRasterizer_Internal_ ttoy_GlyphRasterizer_Internal;
+
+/**
+ * A single glyph to be rendered by the glyph rasterizer.
+ *
+ * The font and character are provided by the caller. The remaining members
+ * are filled in by ttoy_GlyphRasterizer_rasterize(). The bitmap buffer is
+ * allocated with malloc(3) and must be released with
+ * ttoy_GlyphRasterizerJob_destroy().
+ */
+typedef struct ttoy_GlyphRasterizerJob_ {
+  ttoy_Font *font;
+  uint32_t character;
+  ttoy_ErrorCode error;
+  int width, height;
+  int xOffset, yOffset;
+  FT_Bitmap bitmap;
+} ttoy_GlyphRasterizerJob;
+
+/**
+ * A pool of worker threads that render batches of glyphs concurrently.
+ *
+ * FreeType faces are not thread-safe, so each worker keeps its own FreeType
+ * library instance and creates its own faces over the memory-mapped font files
+ * of the fonts it is asked to render. Glyphs are rendered into staging bitmaps
+ * that the caller can then blit into a glyph atlas.
+ */
+typedef struct ttoy_GlyphRasterizer_ {
+  ttoy_GlyphRasterizer_Internal *internal;
+} ttoy_GlyphRasterizer;
+
+void
+ttoy_GlyphRasterizer_init(
+    ttoy_GlyphRasterizer *self);
+
+void
+ttoy_GlyphRasterizer_destroy(
+    ttoy_GlyphRasterizer *self);
+
+/**
+ * Renders the given batch of glyphs, blocking until every glyph in the batch
+ * has been rendered. The calling thread helps render glyphs while it waits.
+ *
+ * Each job reports its own error; glyphs that could not be rendered have an
+ * empty bitmap.
+ */
+void
+ttoy_GlyphRasterizer_rasterize(
+    ttoy_GlyphRasterizer *self,
+    ttoy_GlyphRasterizerJob *jobs,
+    size_t numJobs);
+
+void
+ttoy_GlyphRasterizerJob_destroy(
+    ttoy_GlyphRasterizerJob *self);
+
+#endif
@@ -23,7 +23,11 @@
 
 #include <assert.h>
 #include <math.h>
+#include <stdlib.h>
+#include <string.h>
 
+#include "common/hash.h"
+#include "common/unicodeBlocks.h"
 #include "fontRefArray.h"
 #include "fonts.h"
 #include "logging.h"
@@ -35,6 +39,8 @@
 #define TWENTY_SIX_SIX_TO_PIXELS(value) ( \
     ((value) >> 6) + ((value) & ((1 << 6) - 1) ? 1 : 0))
 
+#define TTOY_GLYPH_RENDERER_INIT_FALLBACK_BLOCKS_SIZE 8
+
 /* Private methods */
 ttoy_ErrorCode
 ttoy_GlyphRenderer_calculateCellSize(
@@ -44,10 +50,33 @@ ttoy_ErrorCode
 ttoy_GlyphRenderer_calculateUnderlineOffset(
     ttoy_GlyphRenderer *self,
     int *offset);
+ttoy_ErrorCode
+ttoy_GlyphRenderer_getFallbackFont(
+    ttoy_GlyphRenderer *self,
+    uint32_t character,
+    ttoy_Font **font,
+    int *fontIndex);
+ttoy_ErrorCode
+ttoy_GlyphRenderer_loadFallbackFont(
+    ttoy_GlyphRenderer *self,
+    uint32_t character,
+    int *fallbackIndex);
+
+/* The fallback font (if any) found for each Unicode block */
+typedef struct ttoy_GlyphRenderer_FallbackBlock_ {
+  uint32_t blockStart;
+  int fallbackIndex;  /* Index into fallbackFonts, or -1 for no font */
+} ttoy_GlyphRenderer_FallbackBlock;
 
 struct ttoy_GlyphRenderer_Internal {
   ttoy_FontRefArray fonts;
   ttoy_FontRefArray boldFonts;
+  /* Fonts discovered with Fontconfig for characters that none of the profile
+   * fonts provide. Fallback font indices come after all of the profile font
+   * indices, so loading a fallback font never changes existing indices. */
+  ttoy_FontRefArray fallbackFonts;
+  ttoy_GlyphRenderer_FallbackBlock *fallbackBlocks;
+  size_t numFallbackBlocks, sizeFallbackBlocks;
   int cellSize[2];
   int underlineOffset;
   float fontSize;
@@ -64,6 +93,11 @@ void ttoy_GlyphRenderer_init(
       sizeof(struct ttoy_GlyphRenderer_Internal));
   ttoy_FontRefArray_init(&self->internal->fonts);
   ttoy_FontRefArray_init(&self->internal->boldFonts);
+  /* Fallback fonts are only loaded once they are needed */
+  ttoy_FontRefArray_init(&self->internal->fallbackFonts);
+  self->internal->fallbackBlocks = NULL;
+  self->internal->numFallbackBlocks = 0;
+  self->internal->sizeFallbackBlocks = 0;
 
   /* Get the current font lists from the profile */
   ttoy_Profile_getFonts(profile,
@@ -186,14 +220,17 @@ void ttoy_GlyphRenderer_destroy(
       ++i) \
   { \
     ttoy_FontRef *fontRef; \
-    fontRef = ttoy_FontRefArray_get(&self->internal->ARRAY, i); \
+    fontRef = *ttoy_FontRefArray_get(&self->internal->ARRAY, i); \
     ttoy_FontRef_decrement(fontRef); \
   }
   DEC_FONT_REFS(fonts)
   DEC_FONT_REFS(boldFonts)
+  DEC_FONT_REFS(fallbackFonts)
   /* Destroy font arrays */
   ttoy_FontRefArray_destroy(&self->internal->fonts);
   ttoy_FontRefArray_destroy(&self->internal->boldFonts);
+  ttoy_FontRefArray_destroy(&self->internal->fallbackFonts);
+  free(self->internal->fallbackBlocks);
   /* Free internal data structures */
   free(self->internal);
 }
@@ -225,9 +262,6 @@ ttoy_GlyphRenderer_getFont(
   int firstTry = 1;
   int foo;
 
-  /* TODO: I don't know how well FcCharSet or FC_Face performs. We might be
-   * able to improve performance here by caching these results */
-
   if (fontIndex == NULL) {
     /* Discard font index result */
     fontIndex = &foo;
@@ -252,7 +286,7 @@ ttoy_GlyphRenderer_getFont(
         i < ttoy_FontRefArray_size(fonts);
         ++i)
     {
-      *font = ttoy_FontRef_get(ttoy_FontRefArray_get(fonts, i));
+      *font = ttoy_FontRef_get(*ttoy_FontRefArray_get(fonts, i));
       if (ttoy_Font_hasCharacter(*font, character)) {
         /* Found a suitable font */
         /* Adjust the font index by the index into this font array */
@@ -274,6 +308,84 @@ ttoy_GlyphRenderer_getFont(
     }
   } while (firstTry--);
 
+  /* None of the profile fonts provide this character; look for a fallback
+   * font that does */
+  return ttoy_GlyphRenderer_getFallbackFont(self,
+      character,  /* character */
+      font,  /* font */
+      fontIndex  /* fontIndex */
+      );
+}
+
+ttoy_ErrorCode
+ttoy_GlyphRenderer_getFallbackFont(
+    ttoy_GlyphRenderer *self,
+    uint32_t character,
+    ttoy_Font **font,
+    int *fontIndex)
+{
+  ttoy_GlyphRenderer_FallbackBlock *block = NULL;
+  ttoy_ErrorCode error;
+  uint32_t blockStart;
+  int fallbackIndex;
+
+  /* Look for the fallback font we found for this block before */
+  blockStart = ttoy_getUnicodeBlockStart(character);
+  for (size_t i = 0; i < self->internal->numFallbackBlocks; ++i) {
+    if (self->internal->fallbackBlocks[i].blockStart == blockStart) {
+      block = &self->internal->fallbackBlocks[i];
+      break;
+    }
+  }
+
+  if (block == NULL) {
+    /* This is the first character from this block that our fonts could not
+     * provide */
+    error = ttoy_GlyphRenderer_loadFallbackFont(self,
+        character,  /* character */
+        &fallbackIndex  /* fallbackIndex */
+        );
+    if (error != TTOY_NO_ERROR
+        && error != TTOY_ERROR_MISSING_FONT_FOR_CHARACTER_CODE)
+    {
+      TTOY_LOG_ERROR_CODE(error);
+    }
+    /* Remember the result for this block, even if no font was found, so that
+     * we do not go looking again every frame */
+    if (self->internal->numFallbackBlocks + 1
+        > self->internal->sizeFallbackBlocks)
+    {
+      ttoy_GlyphRenderer_FallbackBlock *newBlocks;
+      size_t newSize = self->internal->sizeFallbackBlocks > 0
+        ? self->internal->sizeFallbackBlocks * 2
+        : TTOY_GLYPH_RENDERER_INIT_FALLBACK_BLOCKS_SIZE;
+      newBlocks = (ttoy_GlyphRenderer_FallbackBlock *)realloc(
+          self->internal->fallbackBlocks,
+          sizeof(ttoy_GlyphRenderer_FallbackBlock) * newSize);
+      if (newBlocks == NULL) {
+        return TTOY_ERROR_OUT_OF_MEMORY;
+      }
+      self->internal->fallbackBlocks = newBlocks;
+      self->internal->sizeFallbackBlocks = newSize;
+    }
+    block = &self->internal->fallbackBlocks[
+      self->internal->numFallbackBlocks++];
+    block->blockStart = blockStart;
+    block->fallbackIndex = error == TTOY_NO_ERROR ? fallbackIndex : -1;
+  }
+
+  if (block->fallbackIndex >= 0) {
+    *font = ttoy_FontRef_get(*ttoy_FontRefArray_get(
+          &self->internal->fallbackFonts, block->fallbackIndex));
+    /* The fallback font for a block need not provide the whole block */
+    if (ttoy_Font_hasCharacter(*font, character)) {
+      *fontIndex = ttoy_FontRefArray_size(&self->internal->fonts)
+        + ttoy_FontRefArray_size(&self->internal->boldFonts)
+        + block->fallbackIndex;
+      return TTOY_NO_ERROR;
+    }
+  }
+
   /* No suitable font was found */
   *font = NULL;
   *fontIndex = -1;
@@ -281,6 +393,73 @@ ttoy_GlyphRenderer_getFont(
   return TTOY_ERROR_MISSING_FONT_FOR_CHARACTER_CODE;
 }
 
+ttoy_ErrorCode
+ttoy_GlyphRenderer_loadFallbackFont(
+    ttoy_GlyphRenderer *self,
+    uint32_t character,
+    int *fallbackIndex)
+{
+  ttoy_Font *primaryFont, *font;
+  ttoy_FontRef *fontRef;
+  ttoy_ErrorCode error;
+  char *fontPath;
+  int dpi[2];
+
+  if (ttoy_FontRefArray_size(&self->internal->fonts) == 0)
+    return TTOY_ERROR_PROFILE_NO_PRIMARY_FONT;
+  primaryFont = ttoy_FontRef_get(
+      *ttoy_FontRefArray_get(&self->internal->fonts, 0));
+
+  /* Ask for the font providing this character's block */
+  error = ttoy_Fonts_findFallbackFont(
+      character,  /* character */
+      &fontPath  /* fontPath */
+      );
+  if (error != TTOY_NO_ERROR) {
+    return error;
+  }
+
+  /* Several blocks are often provided by the same fallback font */
+  for (size_t i = 0;
+      i < ttoy_FontRefArray_size(&self->internal->fallbackFonts);
+      ++i)
+  {
+    font = ttoy_FontRef_get(
+        *ttoy_FontRefArray_get(&self->internal->fallbackFonts, i));
+    if (strcmp(ttoy_Font_getFontPath(font), fontPath) == 0) {
+      free(fontPath);
+      *fallbackIndex = i;
+      return TTOY_NO_ERROR;
+    }
+  }
+
+  /* Load the fallback font at the same size as our primary font */
+  /* TODO: Scale fallback fonts to fit the cell size of the primary font */
+  ttoy_Font_getDpi(primaryFont, &dpi[0], &dpi[1]);
+  ttoy_FontRef_init(&fontRef);
+  ttoy_Font_init(ttoy_FontRef_get(fontRef));
+  error = ttoy_Font_load(ttoy_FontRef_get(fontRef),
+      fontPath,  /* fontPath */
+      fontPath,  /* faceName */
+      ttoy_Font_getSize(primaryFont),  /* fontSize */
+      dpi[0],  /* x_dpi */
+      dpi[1]  /* y_dpi */
+      );
+  free(fontPath);
+  if (error != TTOY_NO_ERROR) {
+    ttoy_FontRef_decrement(fontRef);
+    return error;
+  }
+  *fallbackIndex = ttoy_FontRefArray_size(&self->internal->fallbackFonts);
+  error = ttoy_FontRefArray_append(&self->internal->fallbackFonts, &fontRef);
+  if (error != TTOY_NO_ERROR) {
+    ttoy_FontRef_decrement(fontRef);
+    return error;
+  }
+
+  return TTOY_NO_ERROR;
+}
+
 ttoy_ErrorCode
 ttoy_GlyphRenderer_getFontIndex(
     ttoy_GlyphRenderer *self,
@@ -371,6 +550,43 @@ ttoy_GlyphRenderer_getGlyphOffset(
   return TTOY_NO_ERROR;
 }
 
+ttoy_ErrorCode
+ttoy_GlyphRenderer_getCacheKey(
+    ttoy_GlyphRenderer *self,
+    uint64_t *key)
+{
+  ttoy_FontRefArray *fonts[2];
+  ttoy_ErrorCode error;
+  uint64_t hash, fontKey;
+
+  hash = TTOY_HASH_INIT;
+  /* Combine the keys of all of our fonts, in the same order that determines
+   * font indices */
+  fonts[0] = &self->internal->fonts;
+  fonts[1] = &self->internal->boldFonts;
+  for (int i = 0; i < 2; ++i) {
+    for (size_t j = 0; j < ttoy_FontRefArray_size(fonts[i]); ++j) {
+      error = ttoy_Font_getCacheKey(
+          ttoy_FontRef_get(*ttoy_FontRefArray_get(fonts[i], j)),  /* self */
+          &fontKey  /* key */
+          );
+      if (error != TTOY_NO_ERROR) {
+        return error;
+      }
+      hash = ttoy_hash(hash, &fontKey, sizeof(fontKey));
+    }
+    /* Distinguish a font at the end of one list from the start of the next */
+    hash = ttoy_hash(hash, &i, sizeof(i));
+  }
+  /* Glyph offsets depend on the cell size */
+  hash = ttoy_hash(hash, self->internal->cellSize,
+      sizeof(self->internal->cellSize));
+
+  *key = hash;
+
+  return TTOY_NO_ERROR;
+}
+
 ttoy_ErrorCode
 ttoy_GlyphRenderer_renderGlyph(
     ttoy_GlyphRenderer *self,
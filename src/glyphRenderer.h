@@ -94,6 +94,15 @@ ttoy_GlyphRenderer_getGlyphOffset(
     int *x,
     int *y);
 
+/**
+ * Computes a key identifying the glyphs produced by this glyph renderer, so
+ * that rendered glyphs can be cached on disk between runs.
+ */
+ttoy_ErrorCode
+ttoy_GlyphRenderer_getCacheKey(
+    ttoy_GlyphRenderer *self,
+    uint64_t *key);
+
 ttoy_ErrorCode
 ttoy_GlyphRenderer_renderGlyph(
     ttoy_GlyphRenderer *self,
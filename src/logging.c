@@ -21,21 +21,448 @@
  * IN THE SOFTWARE.
  */
 
+#include <SDL.h>
+#include <SDL_thread.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <time.h>
 
-void ttoy_logError(
-  const char *file,
-  int line,
-  const char *format,
-  ...)
+#include "common/hash.h"
+#include "logging.h"
+
+/* The queue of messages waiting to be written. Its size must be a power of
+ * two. Messages logged while the queue is full are dropped, since blocking
+ * the thread that logs them is exactly what we are trying to avoid. */
+#define TTOY_LOGGING_QUEUE_SIZE 256
+#define TTOY_LOGGING_MESSAGE_SIZE 512
+/* Each call site may log this many different messages per window before the
+ * rest are counted rather than written. Repeats of the last message written
+ * are always counted, and reported at most once per window. */
+#define TTOY_LOGGING_RATE_BURST 5
+#define TTOY_LOGGING_RATE_WINDOW 1000  /* milliseconds */
+
+typedef struct ttoy_Logging_Entry_ {
+  SDL_atomic_t sequence;
+  size_t length;
+  char message[TTOY_LOGGING_MESSAGE_SIZE];
+} ttoy_Logging_Entry;
+
+/* The queue is a bounded multiple-producer queue as described here:
+ * <http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue>
+ * Each entry's sequence number tells producers and the consumer whose turn
+ * it is to use the entry. */
+static struct {
+  ttoy_Logging_Entry entries[TTOY_LOGGING_QUEUE_SIZE];
+  SDL_atomic_t head;
+  unsigned int tail;
+  SDL_atomic_t dropped;
+  SDL_atomic_t level;
+  SDL_atomic_t running;
+  SDL_SpinLock initLock;
+  int initialized;
+  /* Serializes consumers, i.e. the writer thread and ttoy_Logging_flush() */
+  SDL_mutex *consumerLock;
+  SDL_sem *wake;
+  SDL_Thread *thread;
+  /* Every call site that has logged something, for reporting suppressed
+   * messages */
+  void *sites;
+} logging;
+
+static const char *levelNames[] = {
+  "ERROR",
+  "WARNING",
+  "INFO",
+  "DEBUG",
+};
+
+/* Private methods */
+void ttoy_Logging_lazyInit();
+Uint32 ttoy_Logging_ticks();
+int ttoy_Logging_rateLimit(
+    ttoy_LogSite *site,
+    int level,
+    const char *file,
+    int line,
+    int message);
+void ttoy_Logging_summarize(
+    ttoy_LogSite *site,
+    int repeated,
+    int suppressed);
+void ttoy_Logging_write(
+    const char *message,
+    size_t length);
+int ttoy_Logging_enqueue(
+    const char *message,
+    size_t length);
+void ttoy_Logging_drain();
+void ttoy_Logging_summarizeSites();
+int ttoy_Logging_writerThread(
+    void *data);
+
+void ttoy_Logging_lazyInit() {
+  const char *level;
+
+  SDL_AtomicLock(&logging.initLock);
+  if (logging.initialized) {
+    SDL_AtomicUnlock(&logging.initLock);
+    return;
+  }
+  for (unsigned int i = 0; i < TTOY_LOGGING_QUEUE_SIZE; ++i) {
+    SDL_AtomicSet(&logging.entries[i].sequence, (int)i);
+  }
+  SDL_AtomicSet(&logging.level, TTOY_LOG_LEVEL_WARNING);
+  level = getenv("TTOY_LOG_LEVEL");
+  if (level != NULL) {
+    for (int i = 0; i < sizeof(levelNames) / sizeof(levelNames[0]); ++i) {
+      if (strncasecmp(level, levelNames[i], strlen(level)) == 0
+          && level[0] != '\0')
+      {
+        SDL_AtomicSet(&logging.level, i);
+        break;
+      }
+    }
+  }
+  logging.initialized = 1;
+  SDL_AtomicUnlock(&logging.initLock);
+}
+
+void ttoy_Logging_init() {
+  ttoy_Logging_lazyInit();
+  if (SDL_AtomicGet(&logging.running))
+    return;
+
+  logging.consumerLock = SDL_CreateMutex();
+  logging.wake = SDL_CreateSemaphore(0);
+  if (logging.consumerLock == NULL || logging.wake == NULL) {
+    /* Keep writing messages synchronously */
+    TTOY_LOG_ERROR("Failed to start logging thread: %s", SDL_GetError());
+    return;
+  }
+  SDL_AtomicSet(&logging.running, 1);
+  logging.thread = SDL_CreateThread(
+      ttoy_Logging_writerThread,  /* fn */
+      "ttoy logging",  /* name */
+      NULL  /* data */
+      );
+  if (logging.thread == NULL) {
+    SDL_AtomicSet(&logging.running, 0);
+    TTOY_LOG_ERROR("Failed to start logging thread: %s", SDL_GetError());
+  }
+}
+
+void ttoy_Logging_destroy() {
+  if (!SDL_AtomicGet(&logging.running))
+    return;
+
+  /* Let the writer thread write everything that is queued before it exits */
+  SDL_AtomicSet(&logging.running, 0);
+  SDL_SemPost(logging.wake);
+  SDL_WaitThread(logging.thread, NULL);
+  logging.thread = NULL;
+  /* Anything logged concurrently with our shutdown is still in the queue */
+  ttoy_Logging_drain();
+  ttoy_Logging_summarizeSites();
+}
+
+void ttoy_Logging_flush() {
+  if (!SDL_AtomicGet(&logging.running))
+    return;
+
+  SDL_LockMutex(logging.consumerLock);
+  ttoy_Logging_drain();
+  SDL_UnlockMutex(logging.consumerLock);
+}
+
+void ttoy_Logging_setLevel(
+    int level)
+{
+  ttoy_Logging_lazyInit();
+  SDL_AtomicSet(&logging.level, level);
+}
+
+Uint32 ttoy_Logging_ticks() {
+  struct timespec now;
+
+  /* NOTE: We avoid SDL_GetTicks() so that messages can be logged before SDL
+   * is initialized */
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (Uint32)now.tv_sec * 1000 + (Uint32)(now.tv_nsec / 1000000);
+}
+
+int ttoy_Logging_rateLimit(
+    ttoy_LogSite *site,
+    int level,
+    const char *file,
+    int line,
+    int message)
+{
+  Uint32 now, windowStart;
+  int repeated;
+  void *sites;
+
+  now = ttoy_Logging_ticks();
+  if (SDL_AtomicGet(&site->registered) != 2) {
+    if (SDL_AtomicCAS(&site->registered, 0, 1)) {
+      /* Add this call site to our list of sites */
+      site->file = file;
+      site->line = line;
+      site->level = level;
+      SDL_AtomicSet(&site->windowStart, (int)now);
+      SDL_AtomicSet(&site->lastMessage, message);
+      do {
+        sites = SDL_AtomicGetPtr(&logging.sites);
+        site->next = (ttoy_LogSite *)sites;
+      } while (!SDL_AtomicCASPtr(&logging.sites, sites, site));
+      SDL_AtomicSet(&site->count, 1);
+      SDL_AtomicSet(&site->registered, 2);
+      return 0;
+    } else {
+      /* Another thread is registering this site; just let the message
+       * through */
+      return 0;
+    }
+  }
+
+  windowStart = (Uint32)SDL_AtomicGet(&site->windowStart);
+  if (now - windowStart >= TTOY_LOGGING_RATE_WINDOW) {
+    /* Start a new window, reporting what was suppressed in the last one */
+    if (SDL_AtomicCAS(&site->windowStart, (int)windowStart, (int)now)) {
+      SDL_AtomicSet(&site->count, 0);
+      ttoy_Logging_summarize(site,
+          SDL_AtomicSet(&site->repeated, 0),  /* repeated */
+          SDL_AtomicSet(&site->suppressed, 0)  /* suppressed */
+          );
+    }
+  }
+  if (SDL_AtomicGet(&site->lastMessage) == message) {
+    /* Count the repeat rather than writing the same message again */
+    SDL_AtomicAdd(&site->repeated, 1);
+    return 1;
+  }
+  if (SDL_AtomicAdd(&site->count, 1) >= TTOY_LOGGING_RATE_BURST) {
+    SDL_AtomicAdd(&site->suppressed, 1);
+    return 1;
+  }
+  /* The repeats of the previous message must be reported before this
+   * message is written */
+  SDL_AtomicSet(&site->lastMessage, message);
+  repeated = SDL_AtomicSet(&site->repeated, 0);
+  ttoy_Logging_summarize(site,
+      repeated,  /* repeated */
+      0  /* suppressed */
+      );
+
+  return 0;
+}
+
+void ttoy_Logging_summarize(
+    ttoy_LogSite *site,
+    int repeated,
+    int suppressed)
+{
+  char message[TTOY_LOGGING_MESSAGE_SIZE];
+  int length;
+
+  if (repeated > 0) {
+    length = snprintf(message, sizeof(message),
+        "ttoy %s <%s:%d>: last message repeated %d times\n",
+        levelNames[site->level],
+        site->file,
+        site->line,
+        repeated);
+    if (length >= 0 && length < sizeof(message))
+      ttoy_Logging_write(message, length);
+  }
+  if (suppressed > 0) {
+    length = snprintf(message, sizeof(message),
+        "ttoy %s <%s:%d>: %d other messages suppressed\n",
+        levelNames[site->level],
+        site->file,
+        site->line,
+        suppressed);
+    if (length >= 0 && length < sizeof(message))
+      ttoy_Logging_write(message, length);
+  }
+}
+
+void ttoy_log(
+    ttoy_LogSite *site,
+    int level,
+    const char *file,
+    int line,
+    const char *format,
+    ...)
 {
   va_list args;
+
   va_start(args, format);
-  fprintf(stderr, "ttoy ERROR <%s:%d>: ",
+  ttoy_logv(site, level, file, line, format, args);
+  va_end(args);
+}
+
+void ttoy_logv(
+    ttoy_LogSite *site,
+    int level,
+    const char *file,
+    int line,
+    const char *format,
+    va_list args)
+{
+  char message[TTOY_LOGGING_MESSAGE_SIZE];
+  int prefixLength, length;
+
+  ttoy_Logging_lazyInit();
+  if (level > SDL_AtomicGet(&logging.level))
+    return;
+  if (level < 0)
+    level = 0;
+  if (level >= sizeof(levelNames) / sizeof(levelNames[0]))
+    level = sizeof(levelNames) / sizeof(levelNames[0]) - 1;
+
+  /* Format the message here, since the arguments might not outlive us. We
+   * also need the text to tell whether the message is a repeat. */
+  prefixLength = snprintf(message, sizeof(message), "ttoy %s <%s:%d>: ",
+      levelNames[level],
       file,
       line);
-  vfprintf(stderr, format, args);
-  fprintf(stderr, "\n");
-  va_end(args);
+  if (prefixLength < 0 || prefixLength >= sizeof(message) - 1)
+    return;
+  length = vsnprintf(message + prefixLength, sizeof(message) - prefixLength,
+      format, args);
+  if (length < 0)
+    return;
+  length += prefixLength;
+  if (length > sizeof(message) - 2)
+    length = sizeof(message) - 2;
+  /* End the message with exactly one newline */
+  if (length > prefixLength && message[length - 1] == '\n')
+    length -= 1;
+  message[length++] = '\n';
+  message[length] = '\0';
+
+  if (ttoy_Logging_rateLimit(site,
+        level,  /* level */
+        file,  /* file */
+        line,  /* line */
+        (int)ttoy_hash(TTOY_HASH_INIT, message, length)  /* message */
+        ))
+  {
+    return;
+  }
+  ttoy_Logging_write(message, length);
+}
+
+void ttoy_Logging_write(
+    const char *message,
+    size_t length)
+{
+  if (SDL_AtomicGet(&logging.running)) {
+    if (ttoy_Logging_enqueue(message, length)) {
+      SDL_SemPost(logging.wake);
+    } else {
+      SDL_AtomicAdd(&logging.dropped, 1);
+    }
+    return;
+  }
+
+  /* Nobody is writing messages for us */
+  fwrite(message, 1, length, stderr);
+}
+
+int ttoy_Logging_enqueue(
+    const char *message,
+    size_t length)
+{
+  ttoy_Logging_Entry *entry;
+  unsigned int position;
+  int difference;
+
+  /* Claim the entry at the head of the queue */
+  position = (unsigned int)SDL_AtomicGet(&logging.head);
+  while (1) {
+    entry = &logging.entries[position & (TTOY_LOGGING_QUEUE_SIZE - 1)];
+    difference =
+      (int)((unsigned int)SDL_AtomicGet(&entry->sequence) - position);
+    if (difference == 0) {
+      if (SDL_AtomicCAS(&logging.head, (int)position, (int)(position + 1)))
+        break;
+    } else if (difference < 0) {
+      /* The queue is full */
+      return 0;
+    }
+    position = (unsigned int)SDL_AtomicGet(&logging.head);
+  }
+
+  /* Copy our message and hand the entry to the consumer */
+  memcpy(entry->message, message, length);
+  entry->length = length;
+  SDL_MemoryBarrierRelease();
+  SDL_AtomicSet(&entry->sequence, (int)(position + 1));
+
+  return 1;
+}
+
+void ttoy_Logging_drain() {
+  ttoy_Logging_Entry *entry;
+  int dropped;
+
+  while (1) {
+    entry = &logging.entries[logging.tail & (TTOY_LOGGING_QUEUE_SIZE - 1)];
+    if ((unsigned int)SDL_AtomicGet(&entry->sequence) != logging.tail + 1)
+      break;  /* The queue is empty */
+    SDL_MemoryBarrierAcquire();
+    fwrite(entry->message, 1, entry->length, stderr);
+    /* Hand the entry back to the producers */
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&entry->sequence,
+        (int)(logging.tail + TTOY_LOGGING_QUEUE_SIZE));
+    logging.tail += 1;
+  }
+
+  dropped = SDL_AtomicSet(&logging.dropped, 0);
+  if (dropped > 0) {
+    fprintf(stderr, "ttoy WARNING: %d log messages were dropped\n", dropped);
+  }
+}
+
+void ttoy_Logging_summarizeSites() {
+  ttoy_LogSite *site;
+  Uint32 now;
+
+  /* Report messages that were suppressed at sites that have gone quiet since,
+   * which would otherwise never be reported */
+  now = ttoy_Logging_ticks();
+  for (site = (ttoy_LogSite *)SDL_AtomicGetPtr(&logging.sites);
+      site != NULL;
+      site = site->next)
+  {
+    if (SDL_AtomicGet(&site->repeated) == 0
+        && SDL_AtomicGet(&site->suppressed) == 0)
+      continue;
+    if (SDL_AtomicGet(&logging.running)
+        && now - (Uint32)SDL_AtomicGet(&site->windowStart)
+        < TTOY_LOGGING_RATE_WINDOW)
+      continue;  /* The site might still report this itself */
+    ttoy_Logging_summarize(site,
+        SDL_AtomicSet(&site->repeated, 0),  /* repeated */
+        SDL_AtomicSet(&site->suppressed, 0)  /* suppressed */
+        );
+  }
+}
+
+int ttoy_Logging_writerThread(
+    void *data)
+{
+  while (SDL_AtomicGet(&logging.running)) {
+    SDL_SemWaitTimeout(logging.wake, TTOY_LOGGING_RATE_WINDOW);
+    SDL_LockMutex(logging.consumerLock);
+    ttoy_Logging_drain();
+    ttoy_Logging_summarizeSites();
+    SDL_UnlockMutex(logging.consumerLock);
+  }
+
+  return 0;
 }
@@ -24,16 +24,66 @@
 #ifndef TTOY_LOGGING_H_
 #define TTOY_LOGGING_H_
 
+#include <SDL.h>
 #include <assert.h>
+#include <stdarg.h>
 #include <string.h>
 
 #include "error.h"
 
+#define TTOY_LOG_LEVEL_ERROR 0
+#define TTOY_LOG_LEVEL_WARNING 1
+#define TTOY_LOG_LEVEL_INFO 2
+#define TTOY_LOG_LEVEL_DEBUG 3
+
+/* Messages above this level are compiled out entirely */
+#ifndef TTOY_LOG_MAX_LEVEL
+#ifdef NDEBUG
+#define TTOY_LOG_MAX_LEVEL TTOY_LOG_LEVEL_INFO
+#else
+#define TTOY_LOG_MAX_LEVEL TTOY_LOG_LEVEL_DEBUG
+#endif
+#endif
+
 #define __FILENAME__ (strrchr(__FILE__, '/') ? strrchr(__FILE__, '/') + 1 : __FILE__ )
 
+/**
+ * The state that ttoy keeps for each place that logs messages, so that a
+ * message logged over and over (e.g. for every cell on the screen) can be
+ * collapsed into a count of repeats, and so that a call site logging many
+ * different messages can be rate limited. Each TTOY_LOG() call site gets its
+ * own static instance.
+ */
+typedef struct ttoy_LogSite_ {
+  struct ttoy_LogSite_ *next;
+  const char *file;
+  int line, level;
+  SDL_atomic_t registered, windowStart, count, suppressed;
+  /* Hash of the last message written from this site, and the number of
+   * times it has been repeated since */
+  SDL_atomic_t lastMessage, repeated;
+} ttoy_LogSite;
+
+#define TTOY_LOG(level, format, ...) \
+  do { \
+    if ((level) <= TTOY_LOG_MAX_LEVEL) { \
+      static ttoy_LogSite ttoy_logSite; \
+      ttoy_log(&ttoy_logSite, level, __FILENAME__, __LINE__, \
+          format, ##__VA_ARGS__); \
+    } \
+  } while (0)
+
 #define TTOY_LOG_ERROR(format, ...) \
-  ttoy_logError(__FILENAME__, __LINE__, \
-      format, ##__VA_ARGS__)
+  TTOY_LOG(TTOY_LOG_LEVEL_ERROR, format, ##__VA_ARGS__)
+
+#define TTOY_LOG_WARNING(format, ...) \
+  TTOY_LOG(TTOY_LOG_LEVEL_WARNING, format, ##__VA_ARGS__)
+
+#define TTOY_LOG_INFO(format, ...) \
+  TTOY_LOG(TTOY_LOG_LEVEL_INFO, format, ##__VA_ARGS__)
+
+#define TTOY_LOG_DEBUG(format, ...) \
+  TTOY_LOG(TTOY_LOG_LEVEL_DEBUG, format, ##__VA_ARGS__)
 
 #define TTOY_LOG_ERROR_CODE(error) \
   TTOY_LOG_ERROR("%s", ttoy_ErrorString(error))
@@ -42,14 +92,46 @@
   do { \
     if (error != TTOY_NO_ERROR) { \
       TTOY_LOG_ERROR("%s", ttoy_ErrorString(error)); \
+      ttoy_Logging_flush(); \
     } \
     assert(error == TTOY_NO_ERROR); \
   } while (0)
 
-void ttoy_logError(
-  const char *file,
-  int line,
-  const char *format,
-  ...);
+/**
+ * Starts the background thread that writes log messages to stderr. Until
+ * this is called, and after ttoy_Logging_destroy(), messages are written
+ * immediately by the thread that logs them.
+ *
+ * The runtime log level is read from the TTOY_LOG_LEVEL environment
+ * variable, which can be one of "error", "warning", "info" or "debug".
+ */
+void ttoy_Logging_init();
+
+void ttoy_Logging_destroy();
+
+/**
+ * Waits for all messages logged so far to be written. This should be called
+ * before aborting, since queued messages are lost otherwise.
+ */
+void ttoy_Logging_flush();
+
+void ttoy_Logging_setLevel(
+    int level);
+
+void ttoy_log(
+    ttoy_LogSite *site,
+    int level,
+    const char *file,
+    int line,
+    const char *format,
+    ...);
+
+void ttoy_logv(
+    ttoy_LogSite *site,
+    int level,
+    const char *file,
+    int line,
+    const char *format,
+    va_list args);
 
 #endif
@@ -32,16 +32,36 @@
 #include <sys/wait.h>
 
 #include <ttoy/version.h>
+#include "common/arena.h"
 #include "config.h"
+#include "fileWatcherEvents.h"
 #include "fonts.h"
+#include "glyphAtlas.h"
+#include "glyphRendererRef.h"
 #include "logging.h"
+#include "startupProfile.h"
 #include "terminal.h"
 
+/* Milliseconds to wait for events when nothing on screen is animated */
+#define TTOY_IDLE_TIMEOUT 500
+
 struct ttoy_Main {
   ttoy_Config config;
   ttoy_Terminal terminal;
+  ttoy_StartupProfile startupProfile;
 } ttoy;
 
+/* Everything that the loader thread prepares for the terminal during
+ * startup */
+typedef struct ttoy_Loader_ {
+  const char *configFilePath, *profileName, *pluginPath;
+  ttoy_Profile *profile;
+  ttoy_GlyphRendererRef *glyphRenderer;
+  ttoy_GlyphAtlasStaging stagingAtlas;
+  int stagingAtlasReady;
+  ttoy_ErrorCode error;
+} ttoy_Loader;
+
 void ttoy_initSDL() {
   SDL_Init(SDL_INIT_VIDEO);
 }
@@ -65,6 +85,26 @@ void ttoy_dispatchEvents() {
                 event.window.data2  /* height */
                 );
             break;
+          case SDL_WINDOWEVENT_FOCUS_GAINED:
+          case SDL_WINDOWEVENT_FOCUS_LOST:
+            ttoy_Terminal_windowFocusChanged(&ttoy.terminal,
+                event.window.event
+                  == SDL_WINDOWEVENT_FOCUS_GAINED  /* focused */
+                );
+            break;
+          case SDL_WINDOWEVENT_SHOWN:
+          case SDL_WINDOWEVENT_RESTORED:
+          case SDL_WINDOWEVENT_MAXIMIZED:
+            ttoy_Terminal_windowVisibilityChanged(&ttoy.terminal,
+                1  /* visible */
+                );
+            break;
+          case SDL_WINDOWEVENT_HIDDEN:
+          case SDL_WINDOWEVENT_MINIMIZED:
+            ttoy_Terminal_windowVisibilityChanged(&ttoy.terminal,
+                0  /* visible */
+                );
+            break;
         }
         break;
       case SDL_TEXTINPUT:
@@ -213,6 +253,102 @@ void ttoy_destroyTerminal() {
   ttoy_Terminal_destroy(&ttoy.terminal);
 }
 
+void ttoy_destroyStartupProfile() {
+  ttoy_StartupProfile_destroy(&ttoy.startupProfile);
+}
+
+/* This routine runs on the loader thread during startup. It loads the
+ * configuration and the fonts of the terminal profile, and renders the glyph
+ * atlas for those fonts, none of which requires the GL. Meanwhile, the main
+ * thread initializes SDL, starts the shell and creates the window. */
+int ttoy_load(ttoy_Loader *loader) {
+  ttoy_ErrorCode error;
+
+  ttoy_StartupProfile_beginStage(&ttoy.startupProfile,
+      TTOY_STARTUP_STAGE_CONFIG);
+  ttoy_Fonts_init();
+
+  /* Prepare the configuration */
+  ttoy_Config_init(&ttoy.config);
+  if (loader->pluginPath != NULL) {
+    ttoy_Config_setPluginPath(&ttoy.config, loader->pluginPath);
+  }
+  if (loader->configFilePath != NULL) {
+    /* Config file path was given; read the configuration from file */
+    error = ttoy_Config_setConfigFilePath(&ttoy.config,
+        loader->configFilePath);
+    if (error != TTOY_NO_ERROR) {
+      TTOY_LOG_ERROR_CODE(error);
+      loader->error = error;
+      return 0;
+    }
+  } else {
+    /* Config file path not given; look for the config file in the default
+     * locations */
+    error = ttoy_Config_findConfigFile(&ttoy.config);
+    if (error == TTOY_ERROR_CONFIG_FILE_NOT_FOUND) {
+      /* Could not find config file; we're using the default configuration */
+      error = ttoy_Config_createDefaultConfigFile(&ttoy.config);
+      if (error != TTOY_NO_ERROR) {
+        TTOY_LOG_ERROR_CODE(error);
+      }
+    } else if (error != TTOY_NO_ERROR) {
+      TTOY_LOG_ERROR_CODE(error);
+      loader->error = error;
+      return 0;
+    }
+  }
+
+  /* Get the terminal profile from the configuration */
+  if (loader->profileName != NULL) {
+    error = ttoy_Config_getProfile(&ttoy.config,
+        loader->profileName,  /* name */
+        &loader->profile  /* profile */
+        );
+  } else {
+    error = ttoy_Config_getDefaultProfile(&ttoy.config,
+        &loader->profile  /* profile */
+        );
+  }
+  if (error != TTOY_NO_ERROR) {
+    TTOY_LOG_ERROR_CODE(error);
+    loader->error = error;
+    return 0;
+  }
+  ttoy_StartupProfile_endStage(&ttoy.startupProfile,
+      TTOY_STARTUP_STAGE_CONFIG);
+
+  /* Load the fonts of the profile */
+  ttoy_StartupProfile_beginStage(&ttoy.startupProfile,
+      TTOY_STARTUP_STAGE_FONTS);
+  ttoy_GlyphRendererRef_init(&loader->glyphRenderer);
+  ttoy_GlyphRenderer_init(
+      ttoy_GlyphRendererRef_get(loader->glyphRenderer),
+      loader->profile  /* profile */
+      );
+  ttoy_StartupProfile_endStage(&ttoy.startupProfile,
+      TTOY_STARTUP_STAGE_FONTS);
+
+  /* Render the glyph atlas, which only needs to be sent to the GL once the
+   * main thread has created the GL context */
+  ttoy_StartupProfile_beginStage(&ttoy.startupProfile,
+      TTOY_STARTUP_STAGE_ATLAS);
+  error = ttoy_GlyphAtlasStaging_renderASCIIGlyphs(&loader->stagingAtlas,
+      ttoy_GlyphRendererRef_get(loader->glyphRenderer)  /* glyphRenderer */
+      );
+  if (error != TTOY_NO_ERROR) {
+    /* NOTE: Not a fatal error; the text renderer will try again on the main
+     * thread */
+    TTOY_LOG_ERROR_CODE(error);
+  } else {
+    loader->stagingAtlasReady = 1;
+  }
+  ttoy_StartupProfile_endStage(&ttoy.startupProfile,
+      TTOY_STARTUP_STAGE_ATLAS);
+
+  return 0;
+}
+
 void print_option(
     const char *flags,
     const char *description)
@@ -241,6 +377,8 @@ void print_help() {
       "Name of the profile to use for ttoy instance");
   print_option("--plugin-path <dir>",
       "Directory path in which ttoy will look for plugins");
+  print_option("--startup-profile",
+      "Print how long each stage of startup took");
 }
 
 void print_version() {
@@ -250,20 +388,30 @@ void print_version() {
 }
 
 /* TODO: Load 'toy' information from JSON files with '.toy' extensions */
-/* TODO: Include a small font embedded in the ttoy binary? Hmm... */
 
 int main(int argc, char** argv) {
   char *configFilePath, *profileName, *pluginPath;
   size_t len;
-  ttoy_Profile *profile;
-  ttoy_ErrorCode error;
+  ttoy_Loader loader;
+  SDL_Thread *loaderThread;
   char **shell_argv;
   int shell_argc;
   char *shell_argv_buff[4];
+  int printStartupProfile, firstFrame, settleTimeout;
+
+  /* Start the clock on startup as early as possible */
+  ttoy_StartupProfile_init(&ttoy.startupProfile);
+  atexit(ttoy_destroyStartupProfile);
+  /* Write log messages on a thread of their own, so that logging never
+   * stalls drawing. Our exit handlers run in reverse order, so anything
+   * logged by the others is still written. */
+  ttoy_Logging_init();
+  atexit(ttoy_Logging_destroy);
 
   configFilePath = NULL;
   profileName = NULL;
   pluginPath = NULL;
+  printStartupProfile = 0;
 
   /* Parse command line arguments */
   while (1) {
@@ -273,6 +421,7 @@ int main(int argc, char** argv) {
       { "help",        no_argument,          0, 'h' },
       { "profile",     required_argument,    0, 'p' },
       { "plugin-path", required_argument,    0, 0 },
+      { "startup-profile", no_argument,      0, 0 },
       { "version",     no_argument,          0, 'v' },
       { NULL,          0,                 NULL, 0 },
     };
@@ -330,6 +479,10 @@ int main(int argc, char** argv) {
           len = strlen(optarg);
           pluginPath = (char *)malloc(len + 1);
           strcpy(pluginPath, optarg);
+        } else if (strcmp(long_options[longindex].name, "startup-profile")
+            == 0)
+        {
+          printStartupProfile = 1;
         }
     }
   }
@@ -350,60 +503,34 @@ int main(int argc, char** argv) {
         );
   }
 
-  ttoy_Fonts_init();
-  atexit(ttoy_Fonts_destroy);
-
-  /* Prepare the configuration */
-  ttoy_Config_init(&ttoy.config);
-  atexit(ttoy_destroyConfig);
-  if (pluginPath != NULL) {
-    ttoy_Config_setPluginPath(&ttoy.config, pluginPath);
-  }
-  if (configFilePath != NULL) {
-    /* Config file path was given; read the configuration from file */
-    error = ttoy_Config_setConfigFilePath(&ttoy.config, configFilePath);
-    if (error != TTOY_NO_ERROR) {
-      TTOY_LOG_ERROR_CODE(error);
-      exit(EXIT_FAILURE);
-    }
-  } else {
-    /* Config file path not given; look for the config file in the default
-     * locations */
-    error = ttoy_Config_findConfigFile(&ttoy.config);
-    if (error == TTOY_ERROR_CONFIG_FILE_NOT_FOUND) {
-      /* Could not find config file; we're using the default configuration */
-      error = ttoy_Config_createDefaultConfigFile(&ttoy.config);
-      if (error != TTOY_NO_ERROR) {
-        TTOY_LOG_ERROR_CODE(error);
-      }
-    } else if (error != TTOY_NO_ERROR) {
-      TTOY_LOG_ERROR_CODE(error);
-      exit(EXIT_FAILURE);
-    }
-  }
-
-  /* Get the terminal profile from the configuration */
-  if (profileName != NULL) {
-    error = ttoy_Config_getProfile(&ttoy.config,
-        profileName,  /* name */
-        &profile  /* profile */
-        );
-    if (error != TTOY_NO_ERROR) {
-      TTOY_LOG_ERROR_CODE(error);
-      exit(EXIT_FAILURE);
-    }
-  } else {
-    error = ttoy_Config_getDefaultProfile(&ttoy.config,
-        &profile  /* profile */
-        );
-    if (error != TTOY_NO_ERROR) {
-      TTOY_LOG_ERROR_CODE(error);
-      exit(EXIT_FAILURE);
-    }
+  /* Load the configuration and fonts on a separate thread, since none of
+   * that work depends on SDL, the window, or the shell */
+  loader.configFilePath = configFilePath;
+  loader.profileName = profileName;
+  loader.pluginPath = pluginPath;
+  loader.profile = NULL;
+  loader.glyphRenderer = NULL;
+  ttoy_GlyphAtlasStaging_init(&loader.stagingAtlas);
+  loader.stagingAtlasReady = 0;
+  loader.error = TTOY_NO_ERROR;
+  loaderThread = SDL_CreateThread(
+      (SDL_ThreadFunction)ttoy_load,  /* fn */
+      "ttoy_load",  /* name */
+      &loader  /* data */
+      );
+  if (loaderThread == NULL) {
+    /* Fall back to loading on the main thread */
+    TTOY_LOG_ERROR("Failed to create loader thread: %s",
+        SDL_GetError());
+    ttoy_load(&loader);
   }
 
+  ttoy_StartupProfile_beginStage(&ttoy.startupProfile,
+      TTOY_STARTUP_STAGE_SDL);
   ttoy_initSDL();
   atexit(ttoy_quitSDL);
+  ttoy_StartupProfile_endStage(&ttoy.startupProfile,
+      TTOY_STARTUP_STAGE_SDL);
 
   if (argc - optind == 0) {
     /* No shell was given; we check the SHELL environment variable */
@@ -429,20 +556,88 @@ int main(int argc, char** argv) {
     shell_argv = &argv[optind];
   }
 
-  ttoy_Terminal_init(&ttoy.terminal,
-    profile,  /* profile */
-    shell_argc,  /* argc */
-    shell_argv  /* argv */
-    );
+  /* Start the shell right away, so that it can get to its first prompt while
+   * we are still busy with the window and fonts. Its output waits in the
+   * pseudo terminal until we start dispatching events. */
+  ttoy_Terminal_preinit(&ttoy.terminal);
+  ttoy_StartupProfile_beginStage(&ttoy.startupProfile,
+      TTOY_STARTUP_STAGE_SHELL);
+  ttoy_Terminal_startShell(&ttoy.terminal,
+      shell_argc,  /* argc */
+      shell_argv  /* argv */
+      );
+  ttoy_StartupProfile_endStage(&ttoy.startupProfile,
+      TTOY_STARTUP_STAGE_SHELL);
+
+  /* Create the window and GL context */
+  ttoy_StartupProfile_beginStage(&ttoy.startupProfile,
+      TTOY_STARTUP_STAGE_WINDOW);
+  ttoy_Terminal_createWindow(&ttoy.terminal);
+  ttoy_StartupProfile_endStage(&ttoy.startupProfile,
+      TTOY_STARTUP_STAGE_WINDOW);
+
+  /* Wait for the configuration and fonts */
+  ttoy_StartupProfile_beginStage(&ttoy.startupProfile,
+      TTOY_STARTUP_STAGE_WAIT);
+  if (loaderThread != NULL) {
+    SDL_WaitThread(loaderThread, NULL);
+  }
+  ttoy_StartupProfile_endStage(&ttoy.startupProfile,
+      TTOY_STARTUP_STAGE_WAIT);
+  atexit(ttoy_Fonts_destroy);
+  atexit(ttoy_destroyConfig);
+  if (loader.error != TTOY_NO_ERROR) {
+    exit(EXIT_FAILURE);
+  }
+
+  /* Finish initializing the terminal with the fonts and glyph atlas that the
+   * loader prepared */
+  ttoy_StartupProfile_beginStage(&ttoy.startupProfile,
+      TTOY_STARTUP_STAGE_RENDERERS);
+  ttoy_Terminal_initRenderers(&ttoy.terminal,
+      loader.profile,  /* profile */
+      loader.glyphRenderer,  /* glyphRenderer */
+      loader.stagingAtlasReady ? &loader.stagingAtlas : NULL  /* stagingAtlas */
+      );
   atexit(ttoy_destroyTerminal);
+  ttoy_GlyphRendererRef_decrement(loader.glyphRenderer);
+  ttoy_GlyphAtlasStaging_destroy(&loader.stagingAtlas);
+  ttoy_StartupProfile_endStage(&ttoy.startupProfile,
+      TTOY_STARTUP_STAGE_RENDERERS);
 
   SDL_StartTextInput();  /* Receive text input by default */
   SDL_GL_SetSwapInterval(1);  /* Wait for vsync */
+  firstFrame = 1;
+  ttoy_StartupProfile_beginStage(&ttoy.startupProfile,
+      TTOY_STARTUP_STAGE_FIRST_FRAME);
+  settleTimeout = -1;
   while (1) {
+    if (!firstFrame && !ttoy_Terminal_isAnimating(&ttoy.terminal)) {
+      /* Nothing changes on screen by itself; wait for an event, such as
+       * output from the shell, before drawing again. The timeout lets a
+       * static background toy notice changes that do not come with events,
+       * such as its shader being rebuilt, and lets us dispatch changes to
+       * watched files once they settle. */
+      SDL_WaitEventTimeout(NULL,
+          settleTimeout >= 0 && settleTimeout < TTOY_IDLE_TIMEOUT
+          ? settleTimeout : TTOY_IDLE_TIMEOUT);
+    }
     ttoy_dispatchEvents();
+    /* Tell plugins about changes to the files that they watch */
+    settleTimeout = ttoy_FileWatcher_dispatch();
+    /* FIXME: We should avoid drawing if none of the events changed the
+     * terminal window. */
     ttoy_Terminal_draw(&ttoy.terminal);
-    /* FIXME: We should avoid drawing if the terminal window has not
-     * changed. */
+    /* Anything allocated for this frame is no longer needed */
+    ttoy_Arena_reset(ttoy_Arena_frame());
+    if (firstFrame) {
+      ttoy_StartupProfile_endStage(&ttoy.startupProfile,
+          TTOY_STARTUP_STAGE_FIRST_FRAME);
+      if (printStartupProfile) {
+        ttoy_StartupProfile_print(&ttoy.startupProfile);
+      }
+      firstFrame = 0;
+    }
   }
 
   assert(0);  /* Should never reach here */
@@ -24,12 +24,16 @@
 #include <GL/glew.h>
 #include <SDL.h>
 #include <SDL_mutex.h>
+#include <assert.h>
 #include <string.h>
 
 #include <ttoy/fileWatcher.h>
 
 #include "../../common/glError.h"
+#include "../../common/renderTargetPool.h"
 #include "../../common/shader.h"
+#include "../../common/shaderCompiler.h"
+#include "../../common/textureCache.h"
 #include "../../logging.h"
 
 #include "backgroundToy.h"
@@ -41,28 +45,109 @@ TTOY_BACKGROUND_TOY_DISPATCH(
     (ttoy_BackgroundToy_Destroy)
     ttoy_Glsltoy_BackgroundToy_destroy,  /* DESTROY_CB */
     (ttoy_BackgroundToy_Draw)
-    ttoy_Glsltoy_BackgroundToy_draw  /* DRAW_CB */
+    ttoy_Glsltoy_BackgroundToy_draw,  /* DRAW_CB */
+    (ttoy_BackgroundToy_IsDirty)
+    ttoy_Glsltoy_BackgroundToy_isDirty  /* IS_DIRTY_CB */
     )
 
+#define TTOY_GLSLTOY_MAX_PASSES 5
+#define TTOY_GLSLTOY_NUM_BUFFERS 4
+#define TTOY_GLSLTOY_NUM_CHANNELS 4
+
+/* Buffers are sampled and written as floating point, so that toys can keep
+ * state such as velocities in them */
+#define TTOY_GLSLTOY_BUFFER_FORMAT GL_RGBA16F
+
+static const char *bufferNames[] = {
+  "bufferA",
+  "bufferB",
+  "bufferC",
+  "bufferD",
+};
+
+static const char *channelNames[] = {
+  "iChannel0",
+  "iChannel1",
+  "iChannel2",
+  "iChannel3",
+};
+
+typedef struct ttoy_Glsltoy_BackgroundToy_Pass_ {
+  char *shaderPath;
+  ttoy_Shader shader;
+  /* The buffer that this pass renders to, or -1 for the image drawn as the
+   * background */
+  int output;
+  /* Whether the shader file has changed, guarded by shaderChangedMutex */
+  int changed;
+  /* Whether the program is waiting to be built */
+  int pending;
+  GLint timeLocation, mouseLocation, resolutionLocation, frameLocation;
+  GLint bufferResolutionLocation;
+  GLint bufferLocations[TTOY_GLSLTOY_NUM_BUFFERS];
+  GLint channelLocations[TTOY_GLSLTOY_NUM_CHANNELS];
+} ttoy_Glsltoy_BackgroundToy_Pass;
+
+/* An image that every pass can sample */
+typedef struct ttoy_Glsltoy_BackgroundToy_Channel_ {
+  char *path;
+  /* The size of the raw pixels in the file, or zero for a PNG image */
+  int width, height;
+  ttoy_CachedTexture *texture;
+} ttoy_Glsltoy_BackgroundToy_Channel;
+
+/* Each buffer is a pair of render targets, so that passes can read the
+ * previous frame of a buffer while its next frame is being rendered */
+typedef struct ttoy_Glsltoy_BackgroundToy_Buffer_ {
+  ttoy_RenderTarget *targets[2];
+  int front;  /* The target holding the newest frame */
+  int used;
+} ttoy_Glsltoy_BackgroundToy_Buffer;
+
 /* Private methods */
 void ttoy_Glsltoy_BackgroundToy_readConfig(
     ttoy_Glsltoy_BackgroundToy *self,
     json_t *config);
 
+int ttoy_Glsltoy_BackgroundToy_readPass(
+    ttoy_Glsltoy_BackgroundToy *self,
+    json_t *pass_json);
+
+int ttoy_Glsltoy_BackgroundToy_readChannel(
+    ttoy_Glsltoy_BackgroundToy *self,
+    json_t *channel_json);
+
+void ttoy_Glsltoy_BackgroundToy_addPass(
+    ttoy_Glsltoy_BackgroundToy *self,
+    const char *shaderPath,
+    int output);
+
 float ttoy_Glsltoy_BackgroundToy_getTime(
     ttoy_Glsltoy_BackgroundToy *self);
 
-static
-ttoy_ErrorCode
-ttoy_Glsltoy_BackgroundToy_initShader(
+void ttoy_Glsltoy_BackgroundToy_initShader(
+    ttoy_Glsltoy_BackgroundToy *self);
+
+void ttoy_Glsltoy_BackgroundToy_updateShader(
     ttoy_Glsltoy_BackgroundToy *self);
 
 void ttoy_Glsltoy_BackgroundToy_initQuad(
     ttoy_Glsltoy_BackgroundToy *self);
 
-void ttoy_Glsltoy_BackgroundToy_drawShader(
+void ttoy_Glsltoy_BackgroundToy_loadChannels(
     ttoy_Glsltoy_BackgroundToy *self);
 
+void ttoy_Glsltoy_BackgroundToy_resizeBuffers(
+    ttoy_Glsltoy_BackgroundToy *self,
+    int width,
+    int height);
+
+void ttoy_Glsltoy_BackgroundToy_drawShader(
+    ttoy_Glsltoy_BackgroundToy *self,
+    ttoy_Glsltoy_BackgroundToy_Pass *pass,
+    int viewportWidth,
+    int viewportHeight);
+
 void ttoy_Glsltoy_BackgroundToy_shaderFileChanged(
     ttoy_Glsltoy_BackgroundToy *self,
     const char *filePath);
@@ -70,8 +155,7 @@ void ttoy_Glsltoy_BackgroundToy_shaderFileChanged(
 int ttoy_Glsltoy_BackgroundToy_checkShaderChanges(
     ttoy_Glsltoy_BackgroundToy *self);
 
-ttoy_ErrorCode
-ttoy_Glsltoy_BackgroundToy_recompileShader(
+void ttoy_Glsltoy_BackgroundToy_compileShader(
     ttoy_Glsltoy_BackgroundToy *self);
 
 typedef struct ttoy_Glsltoy_BackgroundToy_QuadVertex_ {
@@ -80,13 +164,23 @@ typedef struct ttoy_Glsltoy_BackgroundToy_QuadVertex_ {
 
 struct ttoy_Glsltoy_BackgroundToy_Internal_ {
   ttoy_FileWatcher shaderWatcher;
-  ttoy_Shader shader;
+  ttoy_ShaderCompiler shaderCompiler;
   SDL_mutex *shaderChangedMutex;
-  uint32_t shaderChanged, shaderChangedThreshold;
-  char *shaderPath;
+  /* Whether any of our shader files have changed */
+  int shaderChanged;
+  /* Passes are drawn in order each frame; the last pass draws the image */
+  ttoy_Glsltoy_BackgroundToy_Pass passes[TTOY_GLSLTOY_MAX_PASSES];
+  int numPasses;
+  int building;  /* The pass whose program is being built, or -1 */
+  ttoy_Glsltoy_BackgroundToy_Buffer buffers[TTOY_GLSLTOY_NUM_BUFFERS];
+  ttoy_RenderTargetPool renderTargetPool;
+  ttoy_Glsltoy_BackgroundToy_Channel channels[TTOY_GLSLTOY_NUM_CHANNELS];
+  int numChannels;
   GLuint quadVertexBuffer, quadIndexBuffer, vao;
-  GLuint timeLocation, mouseLocation, resolutionLocation;
   int initializedDrawObjects;
+  /* Non-zero when a new program has been swapped in but not yet drawn */
+  int programChanged;
+  int frame;
   uint32_t startTicks;
 };
 
@@ -99,16 +193,18 @@ void ttoy_Glsltoy_BackgroundToy_init(
   self->internal = (ttoy_Glsltoy_BackgroundToy_Internal *)malloc(
       sizeof(ttoy_Glsltoy_BackgroundToy_Internal));
   self->internal->initializedDrawObjects = 0;
+  self->internal->programChanged = 0;
+  self->internal->frame = 0;
   self->internal->startTicks = SDL_GetTicks();
-  self->internal->shaderPath = NULL;
-  /* Initialize timestamp and mutex for signaling shader file changes to the
-   * main thread */
+  self->internal->numPasses = 0;
+  self->internal->building = -1;
+  self->internal->numChannels = 0;
+  memset(self->internal->buffers, 0, sizeof(self->internal->buffers));
+  /* Initialize the flag and mutex for signaling shader file changes from
+   * the main thread to the thread that draws the toy */
   self->internal->shaderChanged = 0;
   self->internal->shaderChangedMutex = SDL_CreateMutex();
-  /* TODO: Allow the user to specify the shader changed threshold (in
-   * milliseconds) */
-  self->internal->shaderChangedThreshold = 500;
-  /* Watch for changes to our fragment shader source file */
+  /* Watch for changes to our fragment shader source files */
   ttoy_FileWatcher_init(
       &self->internal->shaderWatcher);
   ttoy_FileWatcher_setCallback(&self->internal->shaderWatcher,
@@ -116,7 +212,6 @@ void ttoy_Glsltoy_BackgroundToy_init(
       ttoy_Glsltoy_BackgroundToy_shaderFileChanged,  /* callback */
       self  /* data */
       );
-  /* TODO: Read the config */
   /* FIXME: We might want to move the readConfig method outside of init, for
    * better handling of error codes. */
   ttoy_Glsltoy_BackgroundToy_readConfig(self, config);
@@ -126,13 +221,64 @@ void ttoy_Glsltoy_BackgroundToy_readConfig(
     ttoy_Glsltoy_BackgroundToy *self,
     json_t *config)
 {
-  json_t *shaderPath_json;
+  json_t *shaderPath_json, *passes_json, *channels_json;
+  size_t numPasses, numChannels;
 
   /* Traverse the config, which is represented as a JSON object */
   if (config == NULL || !json_is_object(config)) {
     fprintf(stderr, "glsltoy background config must be a JSON object\n");
     return;
   }
+  channels_json = json_object_get(config, "channels");
+  if (channels_json != NULL) {
+    /* Read the images that the passes can sample */
+    if (!json_is_array(channels_json)) {
+      fprintf(stderr, "glsltoy background channels must be a JSON array\n");
+      return;
+    }
+    numChannels = json_array_size(channels_json);
+    if (numChannels > TTOY_GLSLTOY_NUM_CHANNELS) {
+      fprintf(stderr, "glsltoy background can have at most %d channels\n",
+          TTOY_GLSLTOY_NUM_CHANNELS);
+      return;
+    }
+    for (size_t i = 0; i < numChannels; ++i) {
+      if (!ttoy_Glsltoy_BackgroundToy_readChannel(self,
+            json_array_get(channels_json, i)  /* channel_json */
+            ))
+      {
+        return;
+      }
+    }
+  }
+  passes_json = json_object_get(config, "passes");
+  if (passes_json != NULL) {
+    /* Read the passes, which render to buffers before the last pass draws
+     * the image */
+    if (!json_is_array(passes_json)) {
+      fprintf(stderr, "glsltoy background passes must be a JSON array\n");
+      return;
+    }
+    numPasses = json_array_size(passes_json);
+    if (numPasses == 0 || numPasses > TTOY_GLSLTOY_MAX_PASSES) {
+      fprintf(stderr, "glsltoy background must have 1 to %d passes\n",
+          TTOY_GLSLTOY_MAX_PASSES);
+      return;
+    }
+    for (size_t i = 0; i < numPasses; ++i) {
+      if (!ttoy_Glsltoy_BackgroundToy_readPass(self,
+            json_array_get(passes_json, i)  /* pass_json */
+            ))
+      {
+        return;
+      }
+    }
+    if (self->internal->passes[numPasses - 1].output != -1) {
+      fprintf(stderr, "glsltoy background last pass must output image\n");
+      return;
+    }
+    return;
+  }
   /* Store the shader path */
   shaderPath_json = json_object_get(config, "shaderPath");
   if (shaderPath_json == NULL) {
@@ -142,15 +288,134 @@ void ttoy_Glsltoy_BackgroundToy_readConfig(
     fprintf(stderr, "glsltoy background shaderPath must be a JSON string\n");
     return;
   }
-  free(self->internal->shaderPath);
-  self->internal->shaderPath = (char *)malloc(
-      strlen(json_string_value(shaderPath_json)) + 1);
-  strcpy(self->internal->shaderPath, json_string_value(shaderPath_json));
+  ttoy_Glsltoy_BackgroundToy_addPass(self,
+      json_string_value(shaderPath_json),  /* shaderPath */
+      -1  /* output */
+      );
+}
+
+int ttoy_Glsltoy_BackgroundToy_readPass(
+    ttoy_Glsltoy_BackgroundToy *self,
+    json_t *pass_json)
+{
+  json_t *shaderPath_json, *output_json;
+  const char *output;
+  int buffer;
+
+  if (!json_is_object(pass_json)) {
+    fprintf(stderr, "glsltoy background pass must be a JSON object\n");
+    return 0;
+  }
+  shaderPath_json = json_object_get(pass_json, "shaderPath");
+  if (shaderPath_json == NULL) {
+    fprintf(stderr, "glsltoy background pass missing shaderPath\n");
+    return 0;
+  } else if (!json_is_string(shaderPath_json)) {
+    fprintf(stderr, "glsltoy background shaderPath must be a JSON string\n");
+    return 0;
+  }
+  /* Passes draw the image unless they name a buffer to output to */
+  buffer = -1;
+  output_json = json_object_get(pass_json, "output");
+  if (output_json != NULL) {
+    if (!json_is_string(output_json)) {
+      fprintf(stderr, "glsltoy background output must be a JSON string\n");
+      return 0;
+    }
+    output = json_string_value(output_json);
+    for (int i = 0; i < TTOY_GLSLTOY_NUM_BUFFERS; ++i) {
+      if (strcmp(output, bufferNames[i]) == 0) {
+        buffer = i;
+        break;
+      }
+    }
+    if (buffer == -1 && strcmp(output, "image") != 0) {
+      fprintf(stderr, "glsltoy background has unknown output: '%s'\n",
+          output);
+      return 0;
+    }
+  }
+  if (buffer == -1
+      && self->internal->numPasses > 0
+      && self->internal->passes[self->internal->numPasses - 1].output == -1)
+  {
+    fprintf(stderr, "glsltoy background can only output one image\n");
+    return 0;
+  }
+  ttoy_Glsltoy_BackgroundToy_addPass(self,
+      json_string_value(shaderPath_json),  /* shaderPath */
+      buffer  /* output */
+      );
+  return 1;
+}
+
+int ttoy_Glsltoy_BackgroundToy_readChannel(
+    ttoy_Glsltoy_BackgroundToy *self,
+    json_t *channel_json)
+{
+  ttoy_Glsltoy_BackgroundToy_Channel *channel;
+  json_t *path_json, *width_json, *height_json;
+
+  /* Channels are either the path to a PNG image, or an object giving the
+   * path to raw RGBA pixels along with their size */
+  width_json = NULL;
+  height_json = NULL;
+  if (json_is_string(channel_json)) {
+    path_json = channel_json;
+  } else if (json_is_object(channel_json)) {
+    path_json = json_object_get(channel_json, "path");
+    if (path_json == NULL || !json_is_string(path_json)) {
+      fprintf(stderr,
+          "glsltoy background channel path must be a JSON string\n");
+      return 0;
+    }
+    width_json = json_object_get(channel_json, "width");
+    height_json = json_object_get(channel_json, "height");
+    if (width_json == NULL || !json_is_integer(width_json)
+        || height_json == NULL || !json_is_integer(height_json)
+        || json_integer_value(width_json) <= 0
+        || json_integer_value(height_json) <= 0)
+    {
+      fprintf(stderr,
+          "glsltoy background raw channel needs a positive width and height\n");
+      return 0;
+    }
+  } else {
+    fprintf(stderr,
+        "glsltoy background channel must be a JSON string or object\n");
+    return 0;
+  }
+  channel = &self->internal->channels[self->internal->numChannels++];
+  channel->path = (char *)malloc(strlen(json_string_value(path_json)) + 1);
+  strcpy(channel->path, json_string_value(path_json));
+  channel->width = width_json != NULL ? json_integer_value(width_json) : 0;
+  channel->height = height_json != NULL ? json_integer_value(height_json) : 0;
+  channel->texture = NULL;
+  return 1;
+}
+
+void ttoy_Glsltoy_BackgroundToy_addPass(
+    ttoy_Glsltoy_BackgroundToy *self,
+    const char *shaderPath,
+    int output)
+{
+  ttoy_Glsltoy_BackgroundToy_Pass *pass;
+
+  assert(self->internal->numPasses < TTOY_GLSLTOY_MAX_PASSES);
+  pass = &self->internal->passes[self->internal->numPasses++];
+  pass->shaderPath = (char *)malloc(strlen(shaderPath) + 1);
+  strcpy(pass->shaderPath, shaderPath);
+  pass->output = output;
+  pass->changed = 0;
+  pass->pending = 0;
+  if (output != -1) {
+    self->internal->buffers[output].used = 1;
+  }
   /* XXX: Register the shader file with our file watcher */
   fprintf(stderr, "glsltoy registering file to watch: '%s'\n",
-      self->internal->shaderPath);
+      pass->shaderPath);
   ttoy_FileWatcher_watchFile(&self->internal->shaderWatcher,
-      self->internal->shaderPath  /* filePath */
+      pass->shaderPath  /* filePath */
       );
 }
 
@@ -158,12 +423,29 @@ void ttoy_Glsltoy_BackgroundToy_destroy(
     ttoy_Glsltoy_BackgroundToy *self)
 {
   if (self->internal->initializedDrawObjects) {
-    /* TODO: Clean up the GL objects that we initialized */
+    ttoy_ShaderCompiler_destroy(&self->internal->shaderCompiler);
+    for (int i = 0; i < self->internal->numPasses; ++i) {
+      ttoy_Shader_destroy(&self->internal->passes[i].shader);
+    }
+    /* This deletes the render targets of our buffers */
+    ttoy_RenderTargetPool_destroy(&self->internal->renderTargetPool);
+    for (int i = 0; i < self->internal->numChannels; ++i) {
+      if (self->internal->channels[i].texture != NULL) {
+        ttoy_TextureCache_release(self->internal->channels[i].texture);
+      }
+    }
+    /* TODO: Clean up the other GL objects that we initialized */
   }
+  ttoy_FileWatcher_destroy(&self->internal->shaderWatcher);
   /* Destroy and free our mutex */
   SDL_DestroyMutex(self->internal->shaderChangedMutex);
   /* Free allocated memory */
-  free(self->internal->shaderPath);
+  for (int i = 0; i < self->internal->numPasses; ++i) {
+    free(self->internal->passes[i].shaderPath);
+  }
+  for (int i = 0; i < self->internal->numChannels; ++i) {
+    free(self->internal->channels[i].path);
+  }
   free(self->internal);
 }
 
@@ -188,75 +470,114 @@ static const char *vert =
   "  gl_Position = vec4(vertPos, 1.0);\n"
   "}\n";
 
-ttoy_ErrorCode
-ttoy_Glsltoy_BackgroundToy_initShader(
+void ttoy_Glsltoy_BackgroundToy_initShader(
     ttoy_Glsltoy_BackgroundToy *self)
 {
   ttoy_ErrorCode error;
-  /* XXX: Initialize our shader with the test shader program */
-  ttoy_Shader_init(&self->internal->shader);
-
-  /* Compile our internal vertex shader */
-  error = ttoy_Shader_compileShaderFromString(&self->internal->shader,
-      vert,  /* code */
-      strlen(vert),  /* length */
-      GL_VERTEX_SHADER  /* type */
-      );
-  if (error == TTOY_ERROR_SHADER_COMPILATION_FAILED) {
-    /* TODO: Pass the compilation log up to ttoy_Terminal and display it to the
-     * user. It is probably best to use the TTOY_LOG_ERROR facility. */
-    /* NOTE: This is a fatal error, since the user has no hope of editing the
-     * vertex shader. */
-    return error;
-  } else if (error != TTOY_NO_ERROR) {
+
+  /* We draw nothing until the first programs have been built */
+  for (int i = 0; i < self->internal->numPasses; ++i) {
+    ttoy_Shader_init(&self->internal->passes[i].shader);
+    self->internal->passes[i].pending = 1;
+  }
+
+  /* Shaders are built off of the draw path, so that a heavy shader does not
+   * freeze the terminal */
+  error = ttoy_ShaderCompiler_init(&self->internal->shaderCompiler);
+  if (error != TTOY_NO_ERROR) {
     TTOY_LOG_ERROR_CODE(error);
-    return error;
   }
-  /* Compile the user-provided fragment shader */
-  error = ttoy_Shader_compileShaderFromFile(&self->internal->shader,
-      self->internal->shaderPath,  /* filePath */
-      GL_FRAGMENT_SHADER  /* type */
+  ttoy_Glsltoy_BackgroundToy_compileShader(self);
+}
+
+void ttoy_Glsltoy_BackgroundToy_compileShader(
+    ttoy_Glsltoy_BackgroundToy *self)
+{
+  ttoy_Glsltoy_BackgroundToy_Pass *pass;
+
+  if (self->internal->building != -1) {
+    /* NOTE: The compiler builds one program at a time, so the remaining
+     * passes are built once the current build has been polled */
+    return;
+  }
+  for (int i = 0; i < self->internal->numPasses; ++i) {
+    pass = &self->internal->passes[i];
+    if (!pass->pending) {
+      continue;
+    }
+    pass->pending = 0;
+    self->internal->building = i;
+    ttoy_ShaderCompiler_compileProgram(&self->internal->shaderCompiler,
+        vert,  /* vertSource */
+        pass->shaderPath  /* fragPath */
+        );
+    return;
+  }
+}
+
+void ttoy_Glsltoy_BackgroundToy_updateShader(
+    ttoy_Glsltoy_BackgroundToy *self)
+{
+  ttoy_Glsltoy_BackgroundToy_Pass *pass;
+  ttoy_Shader shader;
+  ttoy_ErrorCode error;
+  int ready;
+
+  if (self->internal->building == -1) {
+    return;
+  }
+  error = ttoy_ShaderCompiler_poll(&self->internal->shaderCompiler,
+      &shader,  /* shader */
+      &ready  /* ready */
       );
-  if (error == TTOY_ERROR_SHADER_COMPILATION_FAILED) {
+  if (!ready) {
+    return;
+  }
+  pass = &self->internal->passes[self->internal->building];
+  self->internal->building = -1;
+  /* Start building the next pass that is waiting */
+  ttoy_Glsltoy_BackgroundToy_compileShader(self);
+  if (error != TTOY_NO_ERROR) {
     /* TODO: Pass the compilation log up to ttoy_Terminal and display it to the
-     * user. It is probably best to use the TTOY_LOG_ERROR facility. */
-    return error;
-  } else if (error == TTOY_ERROR_SHADER_FILE_NOT_FOUND) {
-    /* TODO: Pass this error up to the ttoy_Terminal and display it to the user
-     * through the GUI. */
-    return error;
-  } else if (error != TTOY_NO_ERROR) {
+     * user. */
+    /* NOTE: The previous program, if any, keeps drawing until the user fixes
+     * their shader. */
     TTOY_LOG_ERROR_CODE(error);
-    return error;
-  }
-  /* Link the shader program */
-  error = ttoy_Shader_linkProgram(&self->internal->shader);
-  if (error == TTOY_ERROR_SHADER_LINKING_FAILED) {
-    /* TODO: Pass the linking log up to ttoy_Terminal and display it to the user.
-     * It is probably best to use the TTOY_LOG_ERROR facility. */
-    return error;
-  } else if (error != TTOY_NO_ERROR) {
-    TTOY_LOG_ERROR_CODE(error);
-    return error;
+    return;
   }
 
-  /* FIXME: If the user provided shader is invalid, we need to provide a dummy
-   * shader? Or perhaps inform ttoy that we do not need to render a
-   * background toy texture? */
+  /* Swap in the new program */
+  ttoy_Shader_destroy(&pass->shader);
+  pass->shader = shader;
+  self->internal->programChanged = 1;
 
   /* Get the uniform locations we are interested in */
 #define GET_UNIFORM(NAME) \
-  self->internal->NAME ## Location = \
+  pass->NAME ## Location = \
     glGetUniformLocation( \
-        self->internal->shader.program,  /* program */ \
+        pass->shader.program,  /* program */ \
         #NAME  /* name */ \
         ); \
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   GET_UNIFORM(time)
   GET_UNIFORM(mouse)
   GET_UNIFORM(resolution)
-
-  return TTOY_NO_ERROR;
+  GET_UNIFORM(frame)
+  GET_UNIFORM(bufferResolution)
+  for (int i = 0; i < TTOY_GLSLTOY_NUM_BUFFERS; ++i) {
+    pass->bufferLocations[i] = glGetUniformLocation(
+        pass->shader.program,  /* program */
+        bufferNames[i]  /* name */
+        );
+    ASSERT_GL_ERROR();
+  }
+  for (int i = 0; i < TTOY_GLSLTOY_NUM_CHANNELS; ++i) {
+    pass->channelLocations[i] = glGetUniformLocation(
+        pass->shader.program,  /* program */
+        channelNames[i]  /* name */
+        );
+    ASSERT_GL_ERROR();
+  }
 }
 
 void ttoy_Glsltoy_BackgroundToy_initQuad(
@@ -290,54 +611,54 @@ void ttoy_Glsltoy_BackgroundToy_initQuad(
       1,  /* n */
       &self->internal->quadVertexBuffer  /* buffers */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glBindBuffer(
       GL_ARRAY_BUFFER,  /* target */
       self->internal->quadVertexBuffer  /* buffer */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glBufferData(
       GL_ARRAY_BUFFER,  /* target */
       sizeof(vertices),  /* size */
       vertices,  /* data */
       GL_STATIC_DRAW  /* usage */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
 
   /* Prepare the buffer for quad indices */
   glGenBuffers(
       1,  /* n */
       &self->internal->quadIndexBuffer  /* buffers */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glBindBuffer(
       GL_ELEMENT_ARRAY_BUFFER,  /* target */
       self->internal->quadIndexBuffer  /* buffer */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glBufferData(
       GL_ELEMENT_ARRAY_BUFFER,  /* target */
       sizeof(indices),  /* size */
       indices,  /* data */
       GL_STATIC_DRAW  /* usage */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
 
   /* Prepare the vertex array object */
   glGenVertexArrays(
       1,  /* n */
       &self->internal->vao  /* arrays */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glBindVertexArray(
       self->internal->vao  /* array */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   /* Prepare the pos vertex attribute */
   glEnableVertexAttribArray(
       0  /* index */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glVertexAttribPointer(
       0,  /* index */
       3,  /* size */
@@ -346,12 +667,12 @@ void ttoy_Glsltoy_BackgroundToy_initQuad(
       sizeof(ttoy_Glsltoy_BackgroundToy_QuadVertex),  /* stride */
       (GLvoid *)offsetof(ttoy_Glsltoy_BackgroundToy_QuadVertex, pos)  /* pointer */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   /* Prepare the texCoord vertex attribute */
   glEnableVertexAttribArray(
       1  /* index */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glVertexAttribPointer(
       1,  /* index */
       2,  /* size */
@@ -360,70 +681,202 @@ void ttoy_Glsltoy_BackgroundToy_initQuad(
       sizeof(ttoy_Glsltoy_BackgroundToy_QuadVertex),  /* stride */
       (GLvoid *)offsetof(ttoy_Glsltoy_BackgroundToy_QuadVertex, texCoord)  /* pointer */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   /* Clear the vertex array object binding */
   glBindVertexArray(
       0  /* array */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
 }
 
-void ttoy_Glsltoy_BackgroundToy_drawShader(
+void ttoy_Glsltoy_BackgroundToy_loadChannels(
     ttoy_Glsltoy_BackgroundToy *self)
 {
+  ttoy_Glsltoy_BackgroundToy_Channel *channel;
+
+  /* NOTE: Images are decoded on a worker thread; until they are uploaded,
+   * the channels sample as black */
+  for (int i = 0; i < self->internal->numChannels; ++i) {
+    channel = &self->internal->channels[i];
+    channel->texture = ttoy_TextureCache_load(
+        channel->path,  /* path */
+        channel->width,  /* width */
+        channel->height  /* height */
+        );
+    if (channel->texture == NULL) {
+      TTOY_LOG_ERROR_CODE(TTOY_ERROR_OUT_OF_MEMORY);
+    }
+  }
+}
+
+void ttoy_Glsltoy_BackgroundToy_resizeBuffers(
+    ttoy_Glsltoy_BackgroundToy *self,
+    int width,
+    int height)
+{
+  ttoy_Glsltoy_BackgroundToy_Buffer *buffer;
+  ttoy_RenderTarget *previous;
+  ttoy_ErrorCode error;
+
+  for (int i = 0; i < TTOY_GLSLTOY_NUM_BUFFERS; ++i) {
+    buffer = &self->internal->buffers[i];
+    if (!buffer->used) {
+      continue;
+    }
+    for (int j = 0; j < 2; ++j) {
+      previous = buffer->targets[j];
+      error = ttoy_RenderTargetPool_resize(&self->internal->renderTargetPool,
+          &buffer->targets[j],  /* target */
+          width,  /* width */
+          height,  /* height */
+          TTOY_GLSLTOY_BUFFER_FORMAT  /* internalFormat */
+          );
+      if (error != TTOY_NO_ERROR) {
+        TTOY_LOG_ERROR_CODE(error);
+        /* FIXME: Fail gracefully here */
+        assert(0);
+      }
+      if (buffer->targets[j] == previous) {
+        continue;
+      }
+      /* Passes that read the previous frame of this buffer start over from
+       * a cleared buffer */
+      glBindFramebuffer(
+          GL_DRAW_FRAMEBUFFER,  /* target */
+          buffer->targets[j]->framebuffer  /* framebuffer */
+          );
+      ASSERT_GL_ERROR();
+      glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+      ASSERT_GL_ERROR();
+      glClear(GL_COLOR_BUFFER_BIT);
+      ASSERT_GL_ERROR();
+    }
+  }
+}
+
+void ttoy_Glsltoy_BackgroundToy_drawShader(
+    ttoy_Glsltoy_BackgroundToy *self,
+    ttoy_Glsltoy_BackgroundToy_Pass *pass,
+    int viewportWidth,
+    int viewportHeight)
+{
+  ttoy_Glsltoy_BackgroundToy_Buffer *buffer;
+  ttoy_Glsltoy_BackgroundToy_Channel *channel;
+  ttoy_RenderTarget *front;
+
   /* Prepare the shader for drawing */
   glUseProgram(
-      self->internal->shader.program  /* program */
+      pass->shader.program  /* program */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glBindBuffer(
       GL_ARRAY_BUFFER,  /* target */
       self->internal->quadVertexBuffer  /* buffer */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glBindVertexArray(
       self->internal->vao  /* array */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glUniform1f(
-      self->internal->timeLocation,  /* location */
+      pass->timeLocation,  /* location */
       ttoy_Glsltoy_BackgroundToy_getTime(self)  /* v0 */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glUniform2f(
-      self->internal->mouseLocation,  /* location */
+      pass->mouseLocation,  /* location */
       /* FIXME: Implement mouse */
       50.0f,  /* v0 */
       50.0f  /* v1 */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glUniform2f(
-      self->internal->resolutionLocation,  /* location */
-      /* FIXME: Implement resolution */
-      640.0f,  /* v0 */
-      480.0f  /* v1 */
+      pass->resolutionLocation,  /* location */
+      (float)viewportWidth,  /* v0 */
+      (float)viewportHeight  /* v1 */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
+  glUniform1i(
+      pass->frameLocation,  /* location */
+      self->internal->frame  /* v0 */
+      );
+  ASSERT_GL_ERROR();
+
+  /* Bind the newest frame of each buffer. Buffers that were rendered by an
+   * earlier pass hold this frame; the others, including the buffer that this
+   * pass renders to, hold the previous frame. */
+  for (int i = 0; i < TTOY_GLSLTOY_NUM_BUFFERS; ++i) {
+    buffer = &self->internal->buffers[i];
+    if (!buffer->used || pass->bufferLocations[i] == -1) {
+      continue;
+    }
+    front = buffer->targets[buffer->front];
+    glActiveTexture(GL_TEXTURE0 + i);
+    ASSERT_GL_ERROR();
+    glBindTexture(
+        GL_TEXTURE_2D,  /* target */
+        front->texture  /* texture */
+        );
+    ASSERT_GL_ERROR();
+    glUniform1i(
+        pass->bufferLocations[i],  /* location */
+        i  /* v0 */
+        );
+    ASSERT_GL_ERROR();
+    /* NOTE: Buffer textures can be larger than the viewport, so shaders
+     * sample them with gl_FragCoord.xy / bufferResolution */
+    glUniform2f(
+        pass->bufferResolutionLocation,  /* location */
+        (float)front->textureWidth,  /* v0 */
+        (float)front->textureHeight  /* v1 */
+        );
+    ASSERT_GL_ERROR();
+  }
+  /* Bind the channels to the texture units after those of the buffers.
+   * Channels without an image sample as black. */
+  for (int i = 0; i < TTOY_GLSLTOY_NUM_CHANNELS; ++i) {
+    if (pass->channelLocations[i] == -1) {
+      continue;
+    }
+    channel = i < self->internal->numChannels
+      ? &self->internal->channels[i] : NULL;
+    glActiveTexture(GL_TEXTURE0 + TTOY_GLSLTOY_NUM_BUFFERS + i);
+    ASSERT_GL_ERROR();
+    glBindTexture(
+        GL_TEXTURE_2D,  /* target */
+        channel != NULL && channel->texture != NULL
+        ? ttoy_TextureCache_getTexture(channel->texture)
+        : 0  /* texture */
+        );
+    ASSERT_GL_ERROR();
+    glUniform1i(
+        pass->channelLocations[i],  /* location */
+        TTOY_GLSLTOY_NUM_BUFFERS + i  /* v0 */
+        );
+    ASSERT_GL_ERROR();
+  }
+  glActiveTexture(GL_TEXTURE0);
+  ASSERT_GL_ERROR();
 
   /* Draw the shader on a quad to fill the current framebuffer */
   glBindBuffer(
       GL_ELEMENT_ARRAY_BUFFER,  /* target */
       self->internal->quadIndexBuffer  /* buffer */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glDrawElements(
       GL_TRIANGLES,  /* mode */
       6,  /* count */
       GL_UNSIGNED_INT,  /* type */
       0  /* indices */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
 
   /* Clear the vertex array object binding */
   glBindVertexArray(
       0  /* array */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
 }
 
 void ttoy_Glsltoy_BackgroundToy_draw(
@@ -431,38 +884,161 @@ void ttoy_Glsltoy_BackgroundToy_draw(
     int viewportWidth,
     int viewportHeight)
 {
+  ttoy_Glsltoy_BackgroundToy_Pass *pass, *image;
+  ttoy_Glsltoy_BackgroundToy_Buffer *buffer;
+  GLint framebuffer;
+
   if (!self->internal->initializedDrawObjects) {
     /* Initialize our GL objects on the first frame */
     ttoy_Glsltoy_BackgroundToy_initShader(self);
     ttoy_Glsltoy_BackgroundToy_initQuad(self);
+    ttoy_RenderTargetPool_init(&self->internal->renderTargetPool);
+    ttoy_Glsltoy_BackgroundToy_loadChannels(self);
     self->internal->initializedDrawObjects = 1;
   }
+  /* Upload any images that have finished decoding */
+  ttoy_TextureCache_update();
 
   /* Check for pending shader changes */
   if (ttoy_Glsltoy_BackgroundToy_checkShaderChanges(self)) {
     fprintf(stderr, "\033[1mRecompiling shader...\033[0m\n");
-    ttoy_Glsltoy_BackgroundToy_recompileShader(self);
+    ttoy_Glsltoy_BackgroundToy_compileShader(self);
   }
+  /* Swap in a newly built program, if there is one */
+  ttoy_Glsltoy_BackgroundToy_updateShader(self);
 
-  /* Render our shader to the current framebuffer */
-  ttoy_Glsltoy_BackgroundToy_drawShader(self);
+  image = self->internal->numPasses > 0
+    ? &self->internal->passes[self->internal->numPasses - 1] : NULL;
+  if (image == NULL || image->shader.program == 0) {
+    /* Our first program is still being built */
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    ASSERT_GL_ERROR();
+    glClear(GL_COLOR_BUFFER_BIT);
+    ASSERT_GL_ERROR();
+    return;
+  }
+
+  /* Remember the framebuffer we were asked to draw the image to, since the
+   * passes before the image render to our buffers */
+  glGetIntegerv(
+      GL_DRAW_FRAMEBUFFER_BINDING,  /* pname */
+      &framebuffer  /* data */
+      );
+  ASSERT_GL_ERROR();
+  ttoy_RenderTargetPool_collect(&self->internal->renderTargetPool);
+  ttoy_Glsltoy_BackgroundToy_resizeBuffers(self,
+      viewportWidth,  /* width */
+      viewportHeight  /* height */
+      );
+
+  /* Render each pass in order */
+  for (int i = 0; i < self->internal->numPasses; ++i) {
+    pass = &self->internal->passes[i];
+    if (pass->shader.program == 0) {
+      /* NOTE: A buffer whose program failed to build keeps its contents */
+      continue;
+    }
+    buffer = pass->output != -1 ? &self->internal->buffers[pass->output] : NULL;
+    glBindFramebuffer(
+        GL_DRAW_FRAMEBUFFER,  /* target */
+        buffer != NULL
+        ? buffer->targets[!buffer->front]->framebuffer
+        : (GLuint)framebuffer  /* framebuffer */
+        );
+    ASSERT_GL_ERROR();
+    ttoy_Glsltoy_BackgroundToy_drawShader(self,
+        pass,  /* pass */
+        viewportWidth,  /* viewportWidth */
+        viewportHeight  /* viewportHeight */
+        );
+    if (buffer != NULL) {
+      /* Later passes read the frame that we just rendered */
+      buffer->front = !buffer->front;
+    }
+  }
+  self->internal->programChanged = 0;
+  self->internal->frame += 1;
+}
+
+int ttoy_Glsltoy_BackgroundToy_isDirty(
+    ttoy_Glsltoy_BackgroundToy *self)
+{
+  ttoy_Glsltoy_BackgroundToy_Pass *pass;
+  int shaderChanged;
+
+  if (!self->internal->initializedDrawObjects) {
+    /* We have yet to draw anything */
+    return 1;
+  }
+
+  /* Keep drawing while a shader is being rebuilt, so that the new program is
+   * swapped in and drawn as soon as it is ready */
+  SDL_LockMutex(self->internal->shaderChangedMutex);
+  shaderChanged = self->internal->shaderChanged;
+  SDL_UnlockMutex(self->internal->shaderChangedMutex);
+  if (shaderChanged
+      || self->internal->programChanged
+      || self->internal->building != -1
+      || ttoy_ShaderCompiler_isBusy(&self->internal->shaderCompiler))
+  {
+    return 1;
+  }
+  /* Likewise, keep drawing until our images are uploaded */
+  for (int i = 0; i < self->internal->numChannels; ++i) {
+    if (self->internal->channels[i].texture != NULL
+        && ttoy_TextureCache_isPending(self->internal->channels[i].texture))
+    {
+      return 1;
+    }
+  }
+
+  if (self->internal->numPasses == 0
+      || self->internal->passes[self->internal->numPasses - 1].shader.program
+      == 0)
+  {
+    /* The shader failed to build; we keep showing the cleared frame until the
+     * user fixes it */
+    return 0;
+  }
+
+  for (int i = 0; i < self->internal->numPasses; ++i) {
+    pass = &self->internal->passes[i];
+    if (pass->shader.program == 0) {
+      continue;
+    }
+    /* A buffer pass feeds its previous frame into the next, so its output
+     * keeps changing even without the time */
+    if (pass->output != -1) {
+      return 1;
+    }
+    /* A shader that reads neither the time nor the mouse position draws the
+     * same image every frame. The driver removes uniforms that do not affect
+     * the output, so this also catches shaders that declare them and never
+     * use them. */
+    if (pass->timeLocation != -1
+        || pass->mouseLocation != -1
+        || pass->frameLocation != -1)
+    {
+      return 1;
+    }
+  }
+  return 0;
 }
 
 void ttoy_Glsltoy_BackgroundToy_shaderFileChanged(
     ttoy_Glsltoy_BackgroundToy *self,
     const char *filePath)
 {
-  /* TODO: Attempt to re-compile the shader? We actually need to notify the
-   * main thread, since we cannot compile shaders outside of the GL thread. */
   fprintf(stderr, "ttoy_Glsltoy_BackgroundToy_shaderFileChanged\n");
-  /* TODO: Flag the main thread to re-compile the shader */
-  /* NOTE: Since shaders must be compiled on the main graphics thread with
-   * OpenGL, we use a timestamp to limit the adverse effect on terminal
-   * interactivity. */
-  assert(strcmp(filePath, self->internal->shaderPath) == 0);
+  /* NOTE: The file watcher waits for the file to settle before calling us,
+   * since editors tend to write a file several times when saving */
   SDL_LockMutex(self->internal->shaderChangedMutex);
-  /* FIXME: The value of shaderChanged will wrap after ~49 days of uptime. */
-  self->internal->shaderChanged= SDL_GetTicks();
+  for (int i = 0; i < self->internal->numPasses; ++i) {
+    if (strcmp(filePath, self->internal->passes[i].shaderPath) == 0) {
+      self->internal->passes[i].changed = 1;
+    }
+  }
+  self->internal->shaderChanged = 1;
   SDL_UnlockMutex(self->internal->shaderChangedMutex);
 }
 
@@ -472,56 +1048,15 @@ int ttoy_Glsltoy_BackgroundToy_checkShaderChanges(
   int result;
 
   SDL_LockMutex(self->internal->shaderChangedMutex);
-  if (self->internal->shaderChanged == 0) {
-    result = 0;
-  } else {
-    uint32_t delta;
-    delta = SDL_GetTicks() - self->internal->shaderChanged;
-    if (delta >= self->internal->shaderChangedThreshold) {
-      result = 1;
-      self->internal->shaderChanged = 0;
-    } else {
-      result = 0;
+  result = self->internal->shaderChanged;
+  self->internal->shaderChanged = 0;
+  /* Queue the passes whose files changed to be rebuilt */
+  for (int i = 0; i < self->internal->numPasses; ++i) {
+    if (self->internal->passes[i].changed) {
+      self->internal->passes[i].changed = 0;
+      self->internal->passes[i].pending = 1;
     }
   }
   SDL_UnlockMutex(self->internal->shaderChangedMutex);
   return result;
 }
-
-ttoy_ErrorCode
-ttoy_Glsltoy_BackgroundToy_recompileShader(
-    ttoy_Glsltoy_BackgroundToy *self)
-{
-  ttoy_ErrorCode error;
-
-  /* Compile the user-provided fragment shader */
-  error = ttoy_Shader_compileShaderFromFile(&self->internal->shader,
-      self->internal->shaderPath,  /* filePath */
-      GL_FRAGMENT_SHADER  /* type */
-      );
-  if (error == TTOY_ERROR_SHADER_COMPILATION_FAILED) {
-    /* TODO: Pass the compilation log up to ttoy_Terminal and display it to the
-     * user. It is probably best to use the TTOY_LOG_ERROR facility. */
-    return error;
-  } else if (error == TTOY_ERROR_SHADER_FILE_NOT_FOUND) {
-    /* TODO: Pass this error up to the ttoy_Terminal and display it to the user
-     * through the GUI. */
-    return error;
-  } else if (error != TTOY_NO_ERROR) {
-    TTOY_LOG_ERROR_CODE(error);
-    return error;
-  }
-
-  /* Link the shader program */
-  error = ttoy_Shader_linkProgram(&self->internal->shader);
-  if (error == TTOY_ERROR_SHADER_LINKING_FAILED) {
-    /* TODO: Pass the linking log up to ttoy_Terminal and display it to the user.
-     * It is probably best to use the TTOY_LOG_ERROR facility. */
-    return error;
-  } else if (error != TTOY_NO_ERROR) {
-    TTOY_LOG_ERROR_CODE(error);
-    return error;
-  }
-
-  return TTOY_NO_ERROR;
-}
@@ -49,4 +49,7 @@ void ttoy_Glsltoy_BackgroundToy_draw(
     int viewportWidth,
     int viewportHeight);
 
+int ttoy_Glsltoy_BackgroundToy_isDirty(
+    ttoy_Glsltoy_BackgroundToy *self);
+
 #endif
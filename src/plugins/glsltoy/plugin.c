@@ -41,7 +41,7 @@ void ttoy_Glsltoy_Plugin_init(
   /* TODO */
   /* XXX: Test OpenGL */
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
 }
 
 void ttoy_Glsltoy_Plugin_destroy(
@@ -22,7 +22,6 @@
  */
 
 #include <assert.h>
-#include <fontconfig/fontconfig.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -54,6 +53,9 @@ void ttoy_Profile_init(
     const char *name)
 {
   self->fontSize = 0.0f;
+  self->backgroundBudget = TTOY_PROFILE_DEFAULT_BACKGROUND_BUDGET;
+  self->scrollbackLimit = TTOY_PROFILE_DEFAULT_SCROLLBACK_LIMIT;
+  self->scrollbackSpillLimit = TTOY_PROFILE_DEFAULT_SCROLLBACK_SPILL_LIMIT;
   /* Allocate memory for internal structures */
   self->internal = (ttoy_Profile_Internal *)malloc(sizeof(ttoy_Profile_Internal));
   ttoy_FontRefArray_init(&self->internal->fonts);
@@ -79,7 +81,7 @@ void ttoy_Profile_destroy(
       ++i) \
   { \
     ttoy_FontRef *fontRef; \
-    fontRef = ttoy_FontRefArray_get(&self->internal->ARRAY, i); \
+    fontRef = *ttoy_FontRefArray_get(&self->internal->ARRAY, i); \
     ttoy_FontRef_decrement(fontRef); \
   }
   DEC_FONT_REFS(fonts)
@@ -120,7 +122,7 @@ ttoy_Profile_getPrimaryFont(
 {
   if (ttoy_FontRefArray_size(&self->internal->fonts) <= 0)
     return NULL;
-  return ttoy_FontRef_get(ttoy_FontRefArray_get(&self->internal->fonts, 0));
+  return ttoy_FontRef_get(*ttoy_FontRefArray_get(&self->internal->fonts, 0));
 }
 
 ttoy_ErrorCode
@@ -129,84 +131,30 @@ ttoy_Profile_setPrimaryFont(
     const char *fontFace,
     float fontSize)
 {
-  FcConfig *fc;
-  FcPattern *pattern;
-  FcFontSet *sourceFontSets[2];
-  FcFontSet *resultFontSet;
-  FcPattern *matchingFont;
-  FcResult fcResult;
-  FcValue fcValue;
-  const char *fontPath;
+  char *fontPath;
   ttoy_FontRef *fontRef;
+  ttoy_Font *primaryFont;
   ttoy_ErrorCode error;
 
-  /* Use fontconfig to look for a font with this face and font size */
-  fc = ttoy_Fonts_getFontconfigInstance();
-
-  /* Build a Fontconfig pattern describing our font criteria */
-  pattern = FcPatternBuild(
-      NULL,  /* pattern */
-      FC_SPACING, FcTypeInteger, FC_MONO,  /* Look for monospace fonts... */
-      FC_FULLNAME, FcTypeString, fontFace,  /* ...with this font face. */
-//      FC_PIXEL_SIZE, FcTypeDouble, fontSize,  /* ...with this pixel size... */
-//      FC_WEIGHT,  FcTypeInteger, FC_WEIGHT_REGULAR,  /* ...and this weight. */
-      (char *) NULL  /* terminator */
-      );
-  if (pattern == NULL) {
-    error = TTOY_ERROR_FONTCONFIG_ERROR;
-    goto setPrimaryFont_cleanup1;
-  }
-
-  /* Look for fonts matching our criteria */
-  sourceFontSets[0] = FcConfigGetFonts(fc, FcSetSystem);
-  sourceFontSets[1] = FcConfigGetFonts(fc, FcSetApplication);
-  resultFontSet = FcFontSetList(
-      fc,  /* config */
-      sourceFontSets,  /* sets */
-      2,  /* nsets */
-      pattern,  /* pattern */
-      /* FIXME: Fontconfig documentation is not clear on the utility of
-       * object_set */
-      NULL  /* object_set */
-      );
-  if (resultFontSet == NULL) {
-    error = TTOY_ERROR_FONTCONFIG_ERROR;
-    goto setPrimaryFont_cleanup2;
-  }
-
-//  /* XXX: Print out all of the matching fonts */
-//  for (int i = 0; i < resultFontSet->nfont; ++i) {
-//    FcPattern *font;
-//    font = resultFontSet->fonts[i];
-//    FcPatternPrint(font);
-//  }
-
-  /* Select the first font matching our criteria */
-  if (resultFontSet->nfont > 0) {
-    matchingFont = resultFontSet->fonts[0];
-  } else {
-    TTOY_LOG_ERROR(
-        "Fontconfig could not find any suitable fonts for face '%s'",
-        fontFace);
-    error = TTOY_ERROR_MISSING_FONT;
-    goto setPrimaryFont_cleanup3;
+  /* Nothing needs to be loaded if this is already our primary font; any
+   * fallback fonts were sized for this same primary font */
+  if (ttoy_FontRefArray_size(&self->internal->fonts) > 0) {
+    primaryFont = ttoy_FontRef_get(
+        *ttoy_FontRefArray_get(&self->internal->fonts, 0));
+    if (strcmp(ttoy_Font_getFaceName(primaryFont), fontFace) == 0
+        && ttoy_Font_getSize(primaryFont) == fontSize)
+    {
+      return TTOY_NO_ERROR;
+    }
   }
 
-  /* Get the file path of the matching font */
-  fcResult = FcPatternGet(
-      matchingFont,  /* pattern */
-      FC_FILE,  /* object */
-      0,  /* id */
-      &fcValue  /* value */
+  /* Look for the font file providing this face */
+  error = ttoy_Fonts_findFont(
+      fontFace,  /* faceName */
+      &fontPath  /* fontPath */
       );
-  if (fcResult != FcResultMatch) {
-    error = TTOY_ERROR_FONTCONFIG_ERROR;
-    goto setPrimaryFont_cleanup3;
-  }
-  fontPath = (const char *)fcValue.u.s;
-  if (fontPath == NULL) {
-    error = TTOY_ERROR_FONTCONFIG_ERROR;
-    goto setPrimaryFont_cleanup3;
+  if (error != TTOY_NO_ERROR) {
+    goto setPrimaryFont_cleanup1;
   }
 
   /* Load the font with FreeType */
@@ -221,7 +169,7 @@ ttoy_Profile_setPrimaryFont(
       );
   if (error != TTOY_NO_ERROR) {
     ttoy_FontRef_decrement(fontRef);
-    goto setPrimaryFont_cleanup3;
+    goto setPrimaryFont_cleanup2;
   }
 
   /* TODO: Clear the list of fonts if we have not done so already */
@@ -231,14 +179,15 @@ ttoy_Profile_setPrimaryFont(
   ttoy_Profile_clearFonts(self);
 
   /* Add the font to the beginning of our array of fonts */
-  ttoy_FontRefArray_append(&self->internal->fonts, fontRef);
+  error = ttoy_FontRefArray_append(&self->internal->fonts, &fontRef);
+  if (error != TTOY_NO_ERROR) {
+    ttoy_FontRef_decrement(fontRef);
+  }
 
   /* TODO: Look for the corresponding bold font? */
 
-setPrimaryFont_cleanup3:
-  FcFontSetDestroy(resultFontSet);
 setPrimaryFont_cleanup2:
-  FcPatternDestroy(pattern);
+  free(fontPath);
 setPrimaryFont_cleanup1:
 
   return error;
@@ -291,7 +240,8 @@ ttoy_Profile_setFontSize(
       ++i)
   {
     ttoy_Font *font;
-    font = ttoy_FontRef_get(ttoy_FontRefArray_get(&self->internal->fonts, i));
+    font = ttoy_FontRef_get(
+        *ttoy_FontRefArray_get(&self->internal->fonts, i));
     error = ttoy_Profile_adjustFallbackFontSize(self, font);
     if (error != TTOY_NO_ERROR) {
       TTOY_LOG_ERROR(
@@ -309,7 +259,8 @@ ttoy_Profile_setFontSize(
     ttoy_Font *font;
     /* FIXME: Shouldn't we just set the bold font to the same size as the
      * normal font? */
-    font = ttoy_FontRef_get(ttoy_FontRefArray_get(&self->internal->fonts, i));
+    font = ttoy_FontRef_get(
+        *ttoy_FontRefArray_get(&self->internal->fonts, i));
     ttoy_Profile_adjustFallbackFontSize(self, font);
   }
 
@@ -340,9 +291,9 @@ ttoy_Profile_getFonts(
       ++i) \
   { \
     ttoy_FontRef *fontRef; \
-    fontRef = ttoy_FontRefArray_get(&self->internal->ARRAY, i); \
-    ttoy_FontRefArray_append(ARRAY, fontRef); \
-    ttoy_FontRef_increment(fontRef); \
+    fontRef = *ttoy_FontRefArray_get(&self->internal->ARRAY, i); \
+    if (ttoy_FontRefArray_append(ARRAY, &fontRef) == TTOY_NO_ERROR) \
+      ttoy_FontRef_increment(fontRef); \
   }
   COPY_FONT_REFS(fonts)
   COPY_FONT_REFS(boldFonts)
@@ -33,17 +33,31 @@
 #include "color.h"
 #include "fontRefArray.h"
 
+/* GPU time in milliseconds that a background toy may take per frame, unless
+ * the profile says otherwise */
+#define TTOY_PROFILE_DEFAULT_BACKGROUND_BUDGET 4.0f
+/* Bytes of memory that the scrollback may use, unless the profile says
+ * otherwise */
+#define TTOY_PROFILE_DEFAULT_SCROLLBACK_LIMIT (16 * 1024 * 1024)
+/* Bytes of disk that spilled scrollback may use, unless the profile says
+ * otherwise */
+#define TTOY_PROFILE_DEFAULT_SCROLLBACK_SPILL_LIMIT (256 * 1024 * 1024)
+
 struct ttoy_Profile_Internal_;
 typedef struct ttoy_Profile_Internal_ ttoy_Profile_Internal;
 
 typedef enum ttoy_Profile_Flag_ {
   TTOY_PROFILE_ANTIALIAS_FONT = 1 << 0,
   TTOY_PROFILE_BRIGHT_IS_BOLD = 1 << 1,
+  TTOY_PROFILE_DIRECT_BACKGROUND = 1 << 2,
+  TTOY_PROFILE_SPILL_SCROLLBACK = 1 << 3,
 } ttoy_Profile_Flag;
 
 typedef struct ttoy_Profile_ {
   char *name;
   float fontSize;
+  float backgroundBudget;
+  size_t scrollbackLimit, scrollbackSpillLimit;
   uint32_t flags;
   ttoy_ColorScheme colorScheme;
   ttoy_Profile_Internal *internal;
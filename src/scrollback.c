@@ -0,0 +1,1240 @@
+/*
+ * Copyright (c) 2016-2017 Jonathan Glines
+ * Jonathan Glines <jonathan@glines.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#ifdef TTOY_HAVE_LZ4
+#include <lz4.h>
+#endif
+
+#include "logging.h"
+
+#include "scrollback.h"
+
+/* The default colors of libtsm, which are also what trimmed cells decode
+ * to */
+#define TTOY_SCROLLBACK_DEFAULT_FOREGROUND 16
+#define TTOY_SCROLLBACK_DEFAULT_BACKGROUND 17
+
+#define TTOY_SCROLLBACK_FLAG_BOLD (1 << 0)
+#define TTOY_SCROLLBACK_FLAG_UNDERLINE (1 << 1)
+#define TTOY_SCROLLBACK_FLAG_INVERSE (1 << 2)
+#define TTOY_SCROLLBACK_FLAG_PROTECT (1 << 3)
+#define TTOY_SCROLLBACK_FLAG_BLINK (1 << 4)
+#define TTOY_SCROLLBACK_WIDTH_SHIFT 5
+#define TTOY_SCROLLBACK_FLAG_COMBINING (1 << 7)
+
+/* Bounds on the encoded size of each part of a line record */
+#define TTOY_SCROLLBACK_MAX_VARINT_SIZE 10
+#define TTOY_SCROLLBACK_MAX_RUN_SIZE (TTOY_SCROLLBACK_MAX_VARINT_SIZE + 9)
+#define TTOY_SCROLLBACK_MAX_CHAR_SIZE 4
+#define TTOY_SCROLLBACK_MAX_CELL_TEXT_SIZE \
+  (1 + TTOY_SCROLLBACK_MAX_CELL_CHARS * TTOY_SCROLLBACK_MAX_CHAR_SIZE)
+#define TTOY_SCROLLBACK_MAX_HEADER_SIZE (3 * TTOY_SCROLLBACK_MAX_VARINT_SIZE)
+
+#define TTOY_SCROLLBACK_NO_BLOCK ((size_t)-1)
+
+/*
+ * Each line is stored as a record:
+ *
+ *   varint  length of the rest of the record in bytes
+ *   varint  number of cells
+ *   varint  number of attribute runs
+ *   runs    varint cell count, flags and width byte, foreground and
+ *           background color codes, followed by RGB values for each color
+ *           code that is negative
+ *   text    UTF-8, one character for each cell that is not the trailing half
+ *           of a wide character; in runs flagged as combining, each of
+ *           those characters is preceded by a byte counting the combining
+ *           characters that follow it
+ */
+typedef struct ttoy_Scrollback_Block_ {
+  uint8_t *data;
+  /* The number of bytes of line records, and the number of bytes allocated
+   * for data, which is smaller when the block is compressed */
+  size_t size, storedSize;
+  size_t firstLine, numLines;
+  int sealed, compressed;
+} ttoy_Scrollback_Block;
+
+/*
+ * A segment file is laid out as:
+ *
+ *   index   TTOY_SCROLLBACK_SEGMENT_LINES line entries, so that any line can
+ *           be found without searching
+ *   blocks  spilled blocks, each a block header followed by the block data
+ *           as it was held in memory
+ *
+ * The whole segment is mapped once, when the file is created. The file only
+ * grows as blocks are written to it, and the part of the index for lines not
+ * yet written stays a hole in the file. A segment that could not be written
+ * has no file, and only keeps the numbers of the lines that were lost.
+ */
+typedef struct ttoy_Scrollback_LineEntry_ {
+  /* The offset of the block header from the start of the blocks, and the
+   * offset of the line record within the decoded block */
+  uint32_t block, record;
+} ttoy_Scrollback_LineEntry;
+
+typedef struct ttoy_Scrollback_BlockHeader_ {
+  uint64_t firstLine;
+  uint32_t size, storedSize;
+  uint32_t compressed, reserved;
+} ttoy_Scrollback_BlockHeader;
+
+#define TTOY_SCROLLBACK_SEGMENT_INDEX_SIZE \
+  (TTOY_SCROLLBACK_SEGMENT_LINES * sizeof(ttoy_Scrollback_LineEntry))
+#define TTOY_SCROLLBACK_SEGMENT_SIZE \
+  (TTOY_SCROLLBACK_SEGMENT_INDEX_SIZE + TTOY_SCROLLBACK_SEGMENT_DATA_SIZE)
+/* Blocks are padded so that every header in the mapping stays aligned */
+#define TTOY_SCROLLBACK_SPILLED_BLOCK_SIZE(storedSize) \
+  ((sizeof(ttoy_Scrollback_BlockHeader) + (storedSize) + 7) & ~(size_t)7)
+
+typedef struct ttoy_Scrollback_Segment_ {
+  /* Both are -1 and NULL once the segment is lost */
+  int fd;
+  const uint8_t *map;
+  size_t firstLine, numLines;
+  /* Bytes of blocks written after the index */
+  size_t dataSize;
+} ttoy_Scrollback_Segment;
+
+/* Private methods */
+size_t ttoy_Scrollback_writeVarint(
+    uint8_t *buffer,
+    size_t value);
+int ttoy_Scrollback_readVarint(
+    const uint8_t **buffer,
+    const uint8_t *end,
+    size_t *value);
+size_t ttoy_Scrollback_writeUTF8(
+    uint8_t *buffer,
+    uint32_t ch);
+int ttoy_Scrollback_readUTF8(
+    const uint8_t **buffer,
+    const uint8_t *end,
+    uint32_t *ch);
+int ttoy_Scrollback_isBlank(
+    const ttoy_ScrollbackCell *cell);
+int ttoy_Scrollback_sameRun(
+    const ttoy_ScrollbackCell *a,
+    const ttoy_ScrollbackCell *b);
+size_t ttoy_Scrollback_encodeLine(
+    ttoy_Scrollback *self,
+    const ttoy_ScrollbackCell *cells,
+    size_t numCells);
+ttoy_ErrorCode ttoy_Scrollback_decodeLine(
+    const uint8_t *record,
+    const uint8_t *end,
+    ttoy_ScrollbackCell *cells,
+    size_t maxCells,
+    size_t *numCells);
+ttoy_Scrollback_Block *ttoy_Scrollback_newBlock(
+    ttoy_Scrollback *self,
+    size_t size);
+void ttoy_Scrollback_sealBlock(
+    ttoy_Scrollback *self,
+    ttoy_Scrollback_Block *block);
+void ttoy_Scrollback_compressBlock(
+    ttoy_Scrollback *self,
+    ttoy_Scrollback_Block *block);
+void ttoy_Scrollback_dropOldestBlock(
+    ttoy_Scrollback *self);
+ttoy_Scrollback_Segment *ttoy_Scrollback_newSegment(
+    ttoy_Scrollback *self);
+ttoy_Scrollback_Segment *ttoy_Scrollback_loseSegment(
+    ttoy_Scrollback *self,
+    ttoy_Scrollback_Segment *segment);
+void ttoy_Scrollback_dropOldestSegment(
+    ttoy_Scrollback *self);
+void ttoy_Scrollback_dropSegments(
+    ttoy_Scrollback *self);
+ttoy_ErrorCode ttoy_Scrollback_writeBlock(
+    ttoy_Scrollback *self,
+    ttoy_Scrollback_Segment *segment,
+    const ttoy_Scrollback_Block *block);
+ttoy_ErrorCode ttoy_Scrollback_spillOldestBlock(
+    ttoy_Scrollback *self);
+const ttoy_Scrollback_Block *ttoy_Scrollback_findBlock(
+    const ttoy_Scrollback *self,
+    size_t line);
+const ttoy_Scrollback_Segment *ttoy_Scrollback_findSegment(
+    const ttoy_Scrollback *self,
+    size_t line);
+const uint8_t *ttoy_Scrollback_decompress(
+    ttoy_Scrollback *self,
+    size_t firstLine,
+    const uint8_t *data,
+    size_t size,
+    size_t storedSize);
+const uint8_t *ttoy_Scrollback_blockData(
+    ttoy_Scrollback *self,
+    const ttoy_Scrollback_Block *block);
+const uint8_t *ttoy_Scrollback_spilledRecord(
+    ttoy_Scrollback *self,
+    const ttoy_Scrollback_Segment *segment,
+    size_t line,
+    const uint8_t **end);
+
+void ttoy_Scrollback_init(
+    ttoy_Scrollback *self,
+    size_t maxBytes)
+{
+  self->blocks = NULL;
+  self->numBlocks = 0;
+  self->blocksSize = 0;
+  self->segments = NULL;
+  self->numSegments = 0;
+  self->segmentsSize = 0;
+  self->spillDirectory = NULL;
+  self->maxDiskBytes = 0;
+  self->numLines = 0;
+  self->droppedLines = 0;
+  self->spilledLines = 0;
+  self->maxBytes = maxBytes;
+  self->bytes = 0;
+  self->line = NULL;
+  self->lineSize = 0;
+  self->decoded = NULL;
+  self->decodedSize = 0;
+  self->decodedBlockLine = TTOY_SCROLLBACK_NO_BLOCK;
+}
+
+void ttoy_Scrollback_destroy(
+    ttoy_Scrollback *self)
+{
+  for (size_t i = 0; i < self->numBlocks; ++i) {
+    free(self->blocks[i].data);
+  }
+  free(self->blocks);
+  ttoy_Scrollback_dropSegments(self);
+  free(self->segments);
+  free(self->spillDirectory);
+  free(self->line);
+  free(self->decoded);
+}
+
+ttoy_ErrorCode ttoy_Scrollback_setSpillDirectory(
+    ttoy_Scrollback *self,
+    const char *path,
+    size_t maxDiskBytes)
+{
+  char *spillDirectory;
+
+  spillDirectory = (char *)malloc(strlen(path) + 1);
+  if (spillDirectory == NULL)
+    return TTOY_ERROR_OUT_OF_MEMORY;
+  strcpy(spillDirectory, path);
+  free(self->spillDirectory);
+  self->spillDirectory = spillDirectory;
+  self->maxDiskBytes = maxDiskBytes;
+
+  return TTOY_NO_ERROR;
+}
+
+size_t ttoy_Scrollback_writeVarint(
+    uint8_t *buffer,
+    size_t value)
+{
+  size_t size = 0;
+
+  while (value >= 0x80) {
+    buffer[size++] = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  buffer[size++] = (uint8_t)value;
+
+  return size;
+}
+
+int ttoy_Scrollback_readVarint(
+    const uint8_t **buffer,
+    const uint8_t *end,
+    size_t *value)
+{
+  const uint8_t *p = *buffer;
+  size_t result = 0;
+  int shift = 0;
+
+  while (p < end && shift < 64) {
+    result |= (size_t)(*p & 0x7f) << shift;
+    if (!(*p++ & 0x80)) {
+      *buffer = p;
+      *value = result;
+      return 1;
+    }
+    shift += 7;
+  }
+
+  return 0;
+}
+
+size_t ttoy_Scrollback_writeUTF8(
+    uint8_t *buffer,
+    uint32_t ch)
+{
+  if (ch < 0x80) {
+    buffer[0] = (uint8_t)ch;
+    return 1;
+  } else if (ch < 0x800) {
+    buffer[0] = (uint8_t)(0xc0 | (ch >> 6));
+    buffer[1] = (uint8_t)(0x80 | (ch & 0x3f));
+    return 2;
+  } else if (ch < 0x10000) {
+    buffer[0] = (uint8_t)(0xe0 | (ch >> 12));
+    buffer[1] = (uint8_t)(0x80 | ((ch >> 6) & 0x3f));
+    buffer[2] = (uint8_t)(0x80 | (ch & 0x3f));
+    return 3;
+  }
+  /* NOTE: libtsm never gives us characters above U+10FFFF, so this always
+   * fits in four bytes */
+  buffer[0] = (uint8_t)(0xf0 | ((ch >> 18) & 0x07));
+  buffer[1] = (uint8_t)(0x80 | ((ch >> 12) & 0x3f));
+  buffer[2] = (uint8_t)(0x80 | ((ch >> 6) & 0x3f));
+  buffer[3] = (uint8_t)(0x80 | (ch & 0x3f));
+  return 4;
+}
+
+int ttoy_Scrollback_readUTF8(
+    const uint8_t **buffer,
+    const uint8_t *end,
+    uint32_t *ch)
+{
+  const uint8_t *p = *buffer;
+  size_t size;
+  uint32_t result;
+
+  if (p >= end)
+    return 0;
+  if (p[0] < 0x80) {
+    size = 1;
+    result = p[0];
+  } else if ((p[0] & 0xe0) == 0xc0) {
+    size = 2;
+    result = p[0] & 0x1f;
+  } else if ((p[0] & 0xf0) == 0xe0) {
+    size = 3;
+    result = p[0] & 0x0f;
+  } else {
+    size = 4;
+    result = p[0] & 0x07;
+  }
+  if ((size_t)(end - p) < size)
+    return 0;
+  for (size_t i = 1; i < size; ++i) {
+    result = (result << 6) | (p[i] & 0x3f);
+  }
+  *buffer = p + size;
+  *ch = result;
+
+  return 1;
+}
+
+void ttoy_ScrollbackCell_clear(
+    ttoy_ScrollbackCell *cell)
+{
+  memset(cell, 0, sizeof(*cell));
+  cell->width = 1;
+  cell->attr.fccode = TTOY_SCROLLBACK_DEFAULT_FOREGROUND;
+  cell->attr.bccode = TTOY_SCROLLBACK_DEFAULT_BACKGROUND;
+}
+
+int ttoy_Scrollback_isBlank(
+    const ttoy_ScrollbackCell *cell)
+{
+  /* A cell is blank if it would draw nothing at all, in which case it can
+   * be trimmed from the end of the line */
+  return (cell->len == 0 || (cell->len == 1 && cell->ch[0] == ' '))
+    && cell->width == 1
+    && cell->attr.bccode == TTOY_SCROLLBACK_DEFAULT_BACKGROUND
+    && !cell->attr.inverse
+    && !cell->attr.underline;
+}
+
+int ttoy_Scrollback_sameRun(
+    const ttoy_ScrollbackCell *a,
+    const ttoy_ScrollbackCell *b)
+{
+  /* Cells with combining characters are kept in runs of their own, so that
+   * the rest of the text needs no lengths */
+  if (a->width != b->width
+      || (a->len > 1) != (b->len > 1)
+      || a->attr.fccode != b->attr.fccode
+      || a->attr.bccode != b->attr.bccode
+      || a->attr.bold != b->attr.bold
+      || a->attr.underline != b->attr.underline
+      || a->attr.inverse != b->attr.inverse
+      || a->attr.protect != b->attr.protect
+      || a->attr.blink != b->attr.blink)
+  {
+    return 0;
+  }
+  /* RGB values are only stored for colors without a color code */
+  if (a->attr.fccode < 0
+      && (a->attr.fr != b->attr.fr
+        || a->attr.fg != b->attr.fg
+        || a->attr.fb != b->attr.fb))
+  {
+    return 0;
+  }
+  if (a->attr.bccode < 0
+      && (a->attr.br != b->attr.br
+        || a->attr.bg != b->attr.bg
+        || a->attr.bb != b->attr.bb))
+  {
+    return 0;
+  }
+  return 1;
+}
+
+size_t ttoy_Scrollback_encodeLine(
+    ttoy_Scrollback *self,
+    const ttoy_ScrollbackCell *cells,
+    size_t numCells)
+{
+  uint8_t header[TTOY_SCROLLBACK_MAX_HEADER_SIZE];
+  uint8_t *body, *p;
+  size_t bound, numRuns, runStart, headerSize, bodySize;
+
+  /* Trim blank cells from the end of the line */
+  while (numCells > 0 && ttoy_Scrollback_isBlank(&cells[numCells - 1]))
+    numCells -= 1;
+
+  /* Make sure our scratch buffer can hold the worst case */
+  bound = TTOY_SCROLLBACK_MAX_HEADER_SIZE + numCells
+    * (TTOY_SCROLLBACK_MAX_RUN_SIZE + TTOY_SCROLLBACK_MAX_CELL_TEXT_SIZE);
+  if (bound > self->lineSize) {
+    p = (uint8_t *)realloc(self->line, bound);
+    if (p == NULL)
+      return 0;
+    self->line = p;
+    self->lineSize = bound;
+  }
+
+  /* The header depends on the size of the body, so we write the body first
+   * and move it into place afterwards */
+  body = self->line + TTOY_SCROLLBACK_MAX_HEADER_SIZE;
+  p = body;
+
+  /* Write the attribute runs */
+  numRuns = 0;
+  runStart = 0;
+  for (size_t i = 1; i <= numCells; ++i) {
+    const ttoy_ScrollbackCell *cell;
+    if (i < numCells && ttoy_Scrollback_sameRun(&cells[runStart], &cells[i]))
+      continue;
+    cell = &cells[runStart];
+    p += ttoy_Scrollback_writeVarint(p, i - runStart);
+    *p++ = (uint8_t)(
+        (cell->attr.bold ? TTOY_SCROLLBACK_FLAG_BOLD : 0)
+        | (cell->attr.underline ? TTOY_SCROLLBACK_FLAG_UNDERLINE : 0)
+        | (cell->attr.inverse ? TTOY_SCROLLBACK_FLAG_INVERSE : 0)
+        | (cell->attr.protect ? TTOY_SCROLLBACK_FLAG_PROTECT : 0)
+        | (cell->attr.blink ? TTOY_SCROLLBACK_FLAG_BLINK : 0)
+        | (cell->len > 1 ? TTOY_SCROLLBACK_FLAG_COMBINING : 0)
+        | ((cell->width & 0x3) << TTOY_SCROLLBACK_WIDTH_SHIFT));
+    *p++ = (uint8_t)cell->attr.fccode;
+    *p++ = (uint8_t)cell->attr.bccode;
+    if (cell->attr.fccode < 0) {
+      *p++ = cell->attr.fr;
+      *p++ = cell->attr.fg;
+      *p++ = cell->attr.fb;
+    }
+    if (cell->attr.bccode < 0) {
+      *p++ = cell->attr.br;
+      *p++ = cell->attr.bg;
+      *p++ = cell->attr.bb;
+    }
+    numRuns += 1;
+    runStart = i;
+  }
+
+  /* Write the text */
+  for (size_t i = 0; i < numCells; ++i) {
+    size_t len;
+    if (cells[i].width == 0)
+      continue;  /* The trailing half of a wide character */
+    len = cells[i].len < TTOY_SCROLLBACK_MAX_CELL_CHARS
+      ? cells[i].len : TTOY_SCROLLBACK_MAX_CELL_CHARS;
+    if (len > 1)
+      *p++ = (uint8_t)(len - 1);
+    p += ttoy_Scrollback_writeUTF8(p, len > 0 ? cells[i].ch[0] : 0);
+    for (size_t j = 1; j < len; ++j) {
+      p += ttoy_Scrollback_writeUTF8(p, cells[i].ch[j]);
+    }
+  }
+  bodySize = p - body;
+
+  /* Write the header and move the body up behind it */
+  headerSize = ttoy_Scrollback_writeVarint(header, numCells);
+  headerSize += ttoy_Scrollback_writeVarint(header + headerSize, numRuns);
+  p = self->line;
+  p += ttoy_Scrollback_writeVarint(p, headerSize + bodySize);
+  memcpy(p, header, headerSize);
+  p += headerSize;
+  memmove(p, body, bodySize);
+
+  return (p - self->line) + bodySize;
+}
+
+ttoy_ErrorCode ttoy_Scrollback_decodeLine(
+    const uint8_t *record,
+    const uint8_t *end,
+    ttoy_ScrollbackCell *cells,
+    size_t maxCells,
+    size_t *numCells)
+{
+  const uint8_t *runs, *text;
+  size_t storedCells, numRuns, runLength, cell;
+
+  if (!ttoy_Scrollback_readVarint(&record, end, &storedCells)
+      || !ttoy_Scrollback_readVarint(&record, end, &numRuns))
+  {
+    return TTOY_ERROR_SCROLLBACK_CORRUPT;
+  }
+
+  /* Find the start of the text by skipping over the runs */
+  runs = record;
+  text = record;
+  for (size_t i = 0; i < numRuns; ++i) {
+    if (!ttoy_Scrollback_readVarint(&text, end, &runLength)
+        || end - text < 3)
+    {
+      return TTOY_ERROR_SCROLLBACK_CORRUPT;
+    }
+    text += 3
+      + ((int8_t)text[1] < 0 ? 3 : 0)
+      + ((int8_t)text[2] < 0 ? 3 : 0);
+  }
+
+  /* Expand each run into cells */
+  cell = 0;
+  for (size_t i = 0; i < numRuns; ++i) {
+    struct tsm_screen_attr attr;
+    unsigned int width;
+    uint8_t flags;
+    int combining;
+
+    ttoy_Scrollback_readVarint(&runs, text, &runLength);
+    memset(&attr, 0, sizeof(attr));
+    flags = *runs++;
+    attr.bold = !!(flags & TTOY_SCROLLBACK_FLAG_BOLD);
+    attr.underline = !!(flags & TTOY_SCROLLBACK_FLAG_UNDERLINE);
+    attr.inverse = !!(flags & TTOY_SCROLLBACK_FLAG_INVERSE);
+    attr.protect = !!(flags & TTOY_SCROLLBACK_FLAG_PROTECT);
+    attr.blink = !!(flags & TTOY_SCROLLBACK_FLAG_BLINK);
+    width = (flags >> TTOY_SCROLLBACK_WIDTH_SHIFT) & 0x3;
+    combining = !!(flags & TTOY_SCROLLBACK_FLAG_COMBINING);
+    attr.fccode = (int8_t)*runs++;
+    attr.bccode = (int8_t)*runs++;
+    if (attr.fccode < 0) {
+      attr.fr = *runs++;
+      attr.fg = *runs++;
+      attr.fb = *runs++;
+    }
+    if (attr.bccode < 0) {
+      attr.br = *runs++;
+      attr.bg = *runs++;
+      attr.bb = *runs++;
+    }
+    for (size_t j = 0; j < runLength; ++j, ++cell) {
+      uint32_t ch[TTOY_SCROLLBACK_MAX_CELL_CHARS];
+      size_t len = 0;
+      ch[0] = 0;
+      if (width != 0) {
+        len = 1;
+        if (combining) {
+          if (text >= end || *text >= TTOY_SCROLLBACK_MAX_CELL_CHARS)
+            return TTOY_ERROR_SCROLLBACK_CORRUPT;
+          len += *text++;
+        }
+        for (size_t k = 0; k < len; ++k) {
+          if (!ttoy_Scrollback_readUTF8(&text, end, &ch[k]))
+            return TTOY_ERROR_SCROLLBACK_CORRUPT;
+        }
+        if (len == 1 && ch[0] == 0)
+          len = 0;
+      }
+      if (cell < maxCells) {
+        memcpy(cells[cell].ch, ch, len > 0 ? len * sizeof(uint32_t)
+            : sizeof(uint32_t));
+        cells[cell].len = len;
+        cells[cell].width = width;
+        cells[cell].attr = attr;
+      }
+    }
+  }
+
+  /* Fill the rest of the line with blanks */
+  for (; cell < maxCells; ++cell) {
+    ttoy_ScrollbackCell_clear(&cells[cell]);
+  }
+
+  if (numCells != NULL)
+    *numCells = storedCells;
+
+  return TTOY_NO_ERROR;
+}
+
+ttoy_Scrollback_Block *ttoy_Scrollback_newBlock(
+    ttoy_Scrollback *self,
+    size_t size)
+{
+  ttoy_Scrollback_Block *block;
+
+  if (self->numBlocks == self->blocksSize) {
+    size_t blocksSize = self->blocksSize ? self->blocksSize * 2 : 16;
+    block = (ttoy_Scrollback_Block *)realloc(self->blocks,
+        blocksSize * sizeof(ttoy_Scrollback_Block));
+    if (block == NULL)
+      return NULL;
+    self->blocks = block;
+    self->blocksSize = blocksSize;
+  }
+
+  block = &self->blocks[self->numBlocks];
+  block->data = (uint8_t *)malloc(size);
+  if (block->data == NULL)
+    return NULL;
+  block->size = 0;
+  block->storedSize = size;
+  block->firstLine = self->droppedLines + self->numLines;
+  block->numLines = 0;
+  block->sealed = 0;
+  block->compressed = 0;
+  self->numBlocks += 1;
+  self->bytes += size;
+
+  return block;
+}
+
+void ttoy_Scrollback_sealBlock(
+    ttoy_Scrollback *self,
+    ttoy_Scrollback_Block *block)
+{
+  uint8_t *data;
+
+  if (block->sealed)
+    return;
+
+  /* Give back the unused end of the block */
+  data = (uint8_t *)realloc(block->data, block->size);
+  if (data != NULL) {
+    block->data = data;
+    self->bytes -= block->storedSize - block->size;
+    block->storedSize = block->size;
+  }
+  block->sealed = 1;
+}
+
+void ttoy_Scrollback_compressBlock(
+    ttoy_Scrollback *self,
+    ttoy_Scrollback_Block *block)
+{
+#ifdef TTOY_HAVE_LZ4
+  uint8_t *compressed, *data;
+  int bound, size;
+
+  if (block->compressed)
+    return;
+
+  bound = LZ4_compressBound((int)block->size);
+  compressed = (uint8_t *)malloc(bound);
+  if (compressed == NULL)
+    return;
+  size = LZ4_compress_default(
+      (const char *)block->data,  /* src */
+      (char *)compressed,  /* dst */
+      (int)block->size,  /* srcSize */
+      bound  /* dstCapacity */
+      );
+  if (size <= 0 || (size_t)size >= block->size) {
+    /* Not worth it */
+    free(compressed);
+    return;
+  }
+  data = (uint8_t *)realloc(compressed, size);
+  if (data != NULL)
+    compressed = data;
+  free(block->data);
+  block->data = compressed;
+  self->bytes -= block->storedSize - (size_t)size;
+  block->storedSize = (size_t)size;
+  block->compressed = 1;
+#endif
+}
+
+void ttoy_Scrollback_dropOldestBlock(
+    ttoy_Scrollback *self)
+{
+  ttoy_Scrollback_Block *block;
+
+  block = &self->blocks[0];
+  if (block->firstLine == self->decodedBlockLine)
+    self->decodedBlockLine = TTOY_SCROLLBACK_NO_BLOCK;
+  free(block->data);
+  self->bytes -= block->storedSize;
+  self->numLines -= block->numLines;
+  self->droppedLines += block->numLines;
+  self->numBlocks -= 1;
+  memmove(&self->blocks[0], &self->blocks[1],
+      self->numBlocks * sizeof(ttoy_Scrollback_Block));
+}
+
+ttoy_Scrollback_Segment *ttoy_Scrollback_newSegment(
+    ttoy_Scrollback *self)
+{
+  ttoy_Scrollback_Segment *segment;
+  char *path;
+  void *map;
+  int fd, len;
+
+  if (self->numSegments == self->segmentsSize) {
+    size_t segmentsSize = self->segmentsSize ? self->segmentsSize * 2 : 16;
+    segment = (ttoy_Scrollback_Segment *)realloc(self->segments,
+        segmentsSize * sizeof(ttoy_Scrollback_Segment));
+    if (segment == NULL)
+      return NULL;
+    self->segments = segment;
+    self->segmentsSize = segmentsSize;
+  }
+
+  /* Create an anonymous segment file in the spill directory */
+  len = snprintf(NULL, 0, "%s/ttoy-scrollback-XXXXXX", self->spillDirectory);
+  path = (char *)malloc(len + 1);
+  if (path == NULL)
+    return NULL;
+  sprintf(path, "%s/ttoy-scrollback-XXXXXX", self->spillDirectory);
+  fd = mkstemp(path);
+  if (fd < 0) {
+    TTOY_LOG_ERROR("Could not create scrollback segment '%s': %s",
+        path,
+        strerror(errno));
+    free(path);
+    return NULL;
+  }
+  unlink(path);
+  free(path);
+
+  /* Map all of the segment, so that we never need to map it again as it
+   * fills up. Only the parts that have been written are ever read. */
+  map = mmap(
+      NULL,  /* addr */
+      TTOY_SCROLLBACK_SEGMENT_SIZE,  /* length */
+      PROT_READ,  /* prot */
+      MAP_SHARED,  /* flags */
+      fd,  /* fd */
+      0  /* offset */
+      );
+  if (map == MAP_FAILED) {
+    TTOY_LOG_ERROR("Could not map scrollback segment: %s",
+        strerror(errno));
+    close(fd);
+    return NULL;
+  }
+
+  segment = &self->segments[self->numSegments];
+  segment->fd = fd;
+  segment->map = (const uint8_t *)map;
+  segment->firstLine = self->droppedLines + self->spilledLines;
+  segment->numLines = 0;
+  segment->dataSize = 0;
+  self->numSegments += 1;
+
+  return segment;
+}
+
+ttoy_Scrollback_Segment *ttoy_Scrollback_loseSegment(
+    ttoy_Scrollback *self,
+    ttoy_Scrollback_Segment *segment)
+{
+  if (segment == NULL) {
+    /* Lines that never made it into a segment are lost in a segment of
+     * their own, or with the lost segment before them */
+    segment = self->numSegments > 0
+      ? &self->segments[self->numSegments - 1] : NULL;
+    if (segment != NULL && segment->map == NULL)
+      return segment;
+    if (self->numSegments < self->segmentsSize) {
+      segment = &self->segments[self->numSegments];
+      segment->fd = -1;
+      segment->map = NULL;
+      segment->firstLine = self->droppedLines + self->spilledLines;
+      segment->numLines = 0;
+      segment->dataSize = 0;
+      self->numSegments += 1;
+      return segment;
+    }
+    /* Without room for another segment, the newest segment goes, unless
+     * there is none and the lines can simply be dropped */
+    if (segment == NULL)
+      return NULL;
+  }
+
+  if (segment->map != NULL) {
+    TTOY_LOG_ERROR("Dropping scrollback segment of %zu lines",
+        segment->numLines);
+    munmap((void *)segment->map, TTOY_SCROLLBACK_SEGMENT_SIZE);
+    close(segment->fd);
+  }
+  segment->fd = -1;
+  segment->map = NULL;
+  segment->dataSize = 0;
+
+  return segment;
+}
+
+void ttoy_Scrollback_dropOldestSegment(
+    ttoy_Scrollback *self)
+{
+  ttoy_Scrollback_Segment *segment;
+
+  segment = &self->segments[0];
+  if (segment->map != NULL) {
+    munmap((void *)segment->map, TTOY_SCROLLBACK_SEGMENT_SIZE);
+    close(segment->fd);
+  }
+  self->numLines -= segment->numLines;
+  self->droppedLines += segment->numLines;
+  self->spilledLines -= segment->numLines;
+  self->numSegments -= 1;
+  memmove(&self->segments[0], &self->segments[1],
+      self->numSegments * sizeof(ttoy_Scrollback_Segment));
+}
+
+void ttoy_Scrollback_dropSegments(
+    ttoy_Scrollback *self)
+{
+  while (self->numSegments > 0) {
+    ttoy_Scrollback_dropOldestSegment(self);
+  }
+}
+
+ttoy_ErrorCode ttoy_Scrollback_writeBlock(
+    ttoy_Scrollback *self,
+    ttoy_Scrollback_Segment *segment,
+    const ttoy_Scrollback_Block *block)
+{
+  ttoy_Scrollback_LineEntry *entries;
+  ttoy_Scrollback_BlockHeader header;
+  const uint8_t *data, *p;
+  size_t length, blockOffset;
+
+  /* Index the offset of each line record in the block */
+  data = ttoy_Scrollback_blockData(self, block);
+  if (data == NULL)
+    return TTOY_ERROR_SCROLLBACK_CORRUPT;
+  entries = (ttoy_Scrollback_LineEntry *)malloc(
+      block->numLines * sizeof(ttoy_Scrollback_LineEntry));
+  if (entries == NULL)
+    return TTOY_ERROR_OUT_OF_MEMORY;
+  blockOffset = segment->dataSize;
+  p = data;
+  for (size_t i = 0; i < block->numLines; ++i) {
+    entries[i].block = (uint32_t)blockOffset;
+    entries[i].record = (uint32_t)(p - data);
+    ttoy_Scrollback_readVarint(&p, data + block->size, &length);
+    p += length;
+  }
+
+  /* Write the block, followed by its index entries, so that the index never
+   * refers to a block that isn't there */
+  memset(&header, 0, sizeof(header));
+  header.firstLine = block->firstLine;
+  header.size = (uint32_t)block->size;
+  header.storedSize = (uint32_t)block->storedSize;
+  header.compressed = (uint32_t)block->compressed;
+  if (pwrite(segment->fd, &header, sizeof(header),
+        TTOY_SCROLLBACK_SEGMENT_INDEX_SIZE + blockOffset) != sizeof(header)
+      || pwrite(segment->fd, block->data, block->storedSize,
+        TTOY_SCROLLBACK_SEGMENT_INDEX_SIZE + blockOffset + sizeof(header))
+        != (ssize_t)block->storedSize
+      || pwrite(segment->fd, entries,
+        block->numLines * sizeof(ttoy_Scrollback_LineEntry),
+        segment->numLines * sizeof(ttoy_Scrollback_LineEntry))
+        != (ssize_t)(block->numLines * sizeof(ttoy_Scrollback_LineEntry)))
+  {
+    TTOY_LOG_ERROR("Could not write scrollback segment: %s",
+        strerror(errno));
+    free(entries);
+    return TTOY_ERROR_SCROLLBACK_SPILL_FAILED;
+  }
+  free(entries);
+  segment->dataSize += TTOY_SCROLLBACK_SPILLED_BLOCK_SIZE(block->storedSize);
+
+  return TTOY_NO_ERROR;
+}
+
+ttoy_ErrorCode ttoy_Scrollback_spillOldestBlock(
+    ttoy_Scrollback *self)
+{
+  ttoy_Scrollback_Segment *segment;
+  ttoy_Scrollback_Block *block;
+  ttoy_ErrorCode error;
+
+  block = &self->blocks[0];
+  if (TTOY_SCROLLBACK_SPILLED_BLOCK_SIZE(block->storedSize)
+      > TTOY_SCROLLBACK_SEGMENT_DATA_SIZE)
+  {
+    /* Absurdly long lines */
+    segment = NULL;
+    error = TTOY_ERROR_SCROLLBACK_SPILL_FAILED;
+  } else {
+    /* Append to the newest segment, unless it is full or lost */
+    segment = self->numSegments > 0
+      ? &self->segments[self->numSegments - 1] : NULL;
+    if (segment == NULL
+        || segment->map == NULL
+        || segment->numLines + block->numLines
+          > TTOY_SCROLLBACK_SEGMENT_LINES
+        || segment->dataSize
+          + TTOY_SCROLLBACK_SPILLED_BLOCK_SIZE(block->storedSize)
+          > TTOY_SCROLLBACK_SEGMENT_DATA_SIZE)
+    {
+      segment = ttoy_Scrollback_newSegment(self);
+    }
+    error = segment != NULL
+      ? ttoy_Scrollback_writeBlock(self, segment, block)
+      : TTOY_ERROR_SCROLLBACK_SPILL_FAILED;
+  }
+
+  if (error != TTOY_NO_ERROR) {
+    /* Give up on the segment we could not write, if that was the problem,
+     * and on the lines of the block. The lines keep their place, so that
+     * the other segments can still be read. */
+    segment = ttoy_Scrollback_loseSegment(self,
+        error == TTOY_ERROR_SCROLLBACK_SPILL_FAILED
+          ? segment : NULL  /* segment */
+        );
+    if (segment == NULL) {
+      /* Nothing is on disk, so these are simply the oldest lines */
+      ttoy_Scrollback_dropOldestBlock(self);
+      return error;
+    }
+  }
+  segment->numLines += block->numLines;
+
+  /* The block lives on disk now, or is lost with its segment */
+  free(block->data);
+  self->bytes -= block->storedSize;
+  self->spilledLines += block->numLines;
+  self->numBlocks -= 1;
+  memmove(&self->blocks[0], &self->blocks[1],
+      self->numBlocks * sizeof(ttoy_Scrollback_Block));
+
+  return error;
+}
+
+ttoy_ErrorCode ttoy_Scrollback_pushLine(
+    ttoy_Scrollback *self,
+    const ttoy_ScrollbackCell *cells,
+    size_t numCells)
+{
+  ttoy_Scrollback_Block *block;
+  size_t size;
+
+  if (self->maxBytes == 0)
+    return TTOY_NO_ERROR;  /* Scrollback is disabled */
+
+  size = ttoy_Scrollback_encodeLine(self, cells, numCells);
+  if (size == 0)
+    return TTOY_ERROR_OUT_OF_MEMORY;
+
+  /* Append the record to the newest block, starting a new block if it
+   * doesn't fit */
+  block = self->numBlocks > 0 ? &self->blocks[self->numBlocks - 1] : NULL;
+  if (block == NULL || block->size + size > block->storedSize) {
+    if (block != NULL) {
+      ttoy_Scrollback_sealBlock(self, block);
+      if (self->numBlocks > TTOY_SCROLLBACK_HOT_BLOCKS) {
+        ttoy_Scrollback_compressBlock(self,
+            &self->blocks[self->numBlocks - 1 - TTOY_SCROLLBACK_HOT_BLOCKS]);
+      }
+    }
+    block = ttoy_Scrollback_newBlock(self,
+        size > TTOY_SCROLLBACK_BLOCK_SIZE
+        ? size : TTOY_SCROLLBACK_BLOCK_SIZE  /* size */
+        );
+    if (block == NULL)
+      return TTOY_ERROR_OUT_OF_MEMORY;
+  }
+  memcpy(block->data + block->size, self->line, size);
+  block->size += size;
+  block->numLines += 1;
+  self->numLines += 1;
+
+  /* Make room by spilling or discarding the oldest lines, but always keep
+   * the block we are writing to */
+  while (self->bytes > self->maxBytes && self->numBlocks > 1) {
+    ttoy_ErrorCode error;
+    if (self->spillDirectory == NULL) {
+      ttoy_Scrollback_dropOldestBlock(self);
+      continue;
+    }
+    error = ttoy_Scrollback_spillOldestBlock(self);
+    if (error != TTOY_NO_ERROR) {
+      /* The lines of the block were lost, but we keep spilling the lines
+       * after them */
+      TTOY_LOG_ERROR_CODE(error);
+    }
+    /* Keep the segment files within their own limit */
+    while (self->numSegments > 0
+        && ttoy_Scrollback_diskUsage(self) > self->maxDiskBytes)
+    {
+      ttoy_Scrollback_dropOldestSegment(self);
+    }
+  }
+
+  return TTOY_NO_ERROR;
+}
+
+size_t ttoy_Scrollback_numLines(
+    const ttoy_Scrollback *self)
+{
+  return self->numLines;
+}
+
+size_t ttoy_Scrollback_memoryUsage(
+    const ttoy_Scrollback *self)
+{
+  return self->bytes
+    + self->blocksSize * sizeof(ttoy_Scrollback_Block)
+    + self->segmentsSize * sizeof(ttoy_Scrollback_Segment)
+    + self->lineSize
+    + self->decodedSize;
+}
+
+size_t ttoy_Scrollback_diskUsage(
+    const ttoy_Scrollback *self)
+{
+  size_t bytes = 0;
+
+  for (size_t i = 0; i < self->numSegments; ++i) {
+    if (self->segments[i].map == NULL)
+      continue;  /* Lost segments have no file */
+    bytes += self->segments[i].numLines * sizeof(ttoy_Scrollback_LineEntry)
+      + self->segments[i].dataSize;
+  }
+
+  return bytes;
+}
+
+const ttoy_Scrollback_Block *ttoy_Scrollback_findBlock(
+    const ttoy_Scrollback *self,
+    size_t line)
+{
+  size_t low, high, mid;
+
+  /* Binary search for the last block starting at or before the line */
+  low = 0;
+  high = self->numBlocks;
+  while (high - low > 1) {
+    mid = low + (high - low) / 2;
+    if (self->blocks[mid].firstLine <= line)
+      low = mid;
+    else
+      high = mid;
+  }
+
+  return &self->blocks[low];
+}
+
+const ttoy_Scrollback_Segment *ttoy_Scrollback_findSegment(
+    const ttoy_Scrollback *self,
+    size_t line)
+{
+  size_t low, high, mid;
+
+  /* There are few segments, but they are sorted all the same */
+  low = 0;
+  high = self->numSegments;
+  while (high - low > 1) {
+    mid = low + (high - low) / 2;
+    if (self->segments[mid].firstLine <= line)
+      low = mid;
+    else
+      high = mid;
+  }
+
+  return &self->segments[low];
+}
+
+const uint8_t *ttoy_Scrollback_decompress(
+    ttoy_Scrollback *self,
+    size_t firstLine,
+    const uint8_t *data,
+    size_t size,
+    size_t storedSize)
+{
+  if (firstLine == self->decodedBlockLine)
+    return self->decoded;
+
+#ifdef TTOY_HAVE_LZ4
+  if (size > self->decodedSize) {
+    uint8_t *decoded = (uint8_t *)realloc(self->decoded, size);
+    if (decoded == NULL)
+      return NULL;
+    self->decoded = decoded;
+    self->decodedSize = size;
+  }
+  if (LZ4_decompress_safe(
+        (const char *)data,  /* src */
+        (char *)self->decoded,  /* dst */
+        (int)storedSize,  /* compressedSize */
+        (int)size  /* dstCapacity */
+        ) != (int)size)
+  {
+    self->decodedBlockLine = TTOY_SCROLLBACK_NO_BLOCK;
+    return NULL;
+  }
+  self->decodedBlockLine = firstLine;
+
+  return self->decoded;
+#else
+  /* Blocks are never compressed without LZ4 */
+  assert(0);
+  return NULL;
+#endif
+}
+
+const uint8_t *ttoy_Scrollback_blockData(
+    ttoy_Scrollback *self,
+    const ttoy_Scrollback_Block *block)
+{
+  if (!block->compressed)
+    return block->data;
+
+  return ttoy_Scrollback_decompress(self,
+      block->firstLine,  /* firstLine */
+      block->data,  /* data */
+      block->size,  /* size */
+      block->storedSize  /* storedSize */
+      );
+}
+
+const uint8_t *ttoy_Scrollback_spilledRecord(
+    ttoy_Scrollback *self,
+    const ttoy_Scrollback_Segment *segment,
+    size_t line,
+    const uint8_t **end)
+{
+  const ttoy_Scrollback_BlockHeader *header;
+  const ttoy_Scrollback_LineEntry *entry;
+  const uint8_t *data;
+
+  /* Look up the line in the index at the start of its segment */
+  entry = &((const ttoy_Scrollback_LineEntry *)segment->map)[
+    line - segment->firstLine];
+  if (entry->block >= segment->dataSize)
+    return NULL;
+  header = (const ttoy_Scrollback_BlockHeader *)(segment->map
+      + TTOY_SCROLLBACK_SEGMENT_INDEX_SIZE + entry->block);
+  data = (const uint8_t *)(header + 1);
+
+  /* Uncompressed blocks are read straight from the mapping */
+  if (header->compressed) {
+    data = ttoy_Scrollback_decompress(self,
+        header->firstLine,  /* firstLine */
+        data,  /* data */
+        header->size,  /* size */
+        header->storedSize  /* storedSize */
+        );
+    if (data == NULL)
+      return NULL;
+  }
+  if (entry->record >= header->size)
+    return NULL;
+  *end = data + header->size;
+
+  return data + entry->record;
+}
+
+ttoy_ErrorCode ttoy_Scrollback_getLine(
+    ttoy_Scrollback *self,
+    size_t index,
+    ttoy_ScrollbackCell *cells,
+    size_t maxCells,
+    size_t *numCells)
+{
+  const ttoy_Scrollback_Segment *segment;
+  const ttoy_Scrollback_Block *block;
+  const uint8_t *p, *end;
+  size_t line, length;
+
+  if (index >= self->numLines)
+    return TTOY_ERROR_SCROLLBACK_LINE_NOT_FOUND;
+
+  line = self->droppedLines + index;
+  if (index < self->spilledLines) {
+    segment = ttoy_Scrollback_findSegment(self, line);
+    if (segment->map == NULL) {
+      /* The line was lost with its segment, and reads as a blank line */
+      for (size_t i = 0; i < maxCells; ++i) {
+        ttoy_ScrollbackCell_clear(&cells[i]);
+      }
+      if (numCells != NULL)
+        *numCells = 0;
+      return TTOY_NO_ERROR;
+    }
+    p = ttoy_Scrollback_spilledRecord(self, segment, line, &end);
+    if (p == NULL
+        || !ttoy_Scrollback_readVarint(&p, end, &length)
+        || (size_t)(end - p) < length)
+    {
+      return TTOY_ERROR_SCROLLBACK_CORRUPT;
+    }
+  } else {
+    block = ttoy_Scrollback_findBlock(self, line);
+    p = ttoy_Scrollback_blockData(self, block);
+    if (p == NULL)
+      return TTOY_ERROR_SCROLLBACK_CORRUPT;
+    end = p + block->size;
+
+    /* Skip over the records of the lines before ours */
+    for (size_t i = block->firstLine; ; ++i) {
+      if (!ttoy_Scrollback_readVarint(&p, end, &length)
+          || (size_t)(end - p) < length)
+      {
+        return TTOY_ERROR_SCROLLBACK_CORRUPT;
+      }
+      if (i == line)
+        break;
+      p += length;
+    }
+  }
+
+  return ttoy_Scrollback_decodeLine(
+      p,  /* record */
+      p + length,  /* end */
+      cells,  /* cells */
+      maxCells,  /* maxCells */
+      numCells  /* numCells */
+      );
+}
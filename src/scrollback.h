@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2016-2017 Jonathan Glines
+ * Jonathan Glines <jonathan@glines.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef TTOY_SCROLLBACK_H_
+#define TTOY_SCROLLBACK_H_
+
+#include <libtsm.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <ttoy/error.h>
+
+/* Lines are packed into blocks of about this many bytes */
+#define TTOY_SCROLLBACK_BLOCK_SIZE (16 * 1024)
+/* The newest blocks stay uncompressed, since they are the most likely to be
+ * scrolled back to */
+#define TTOY_SCROLLBACK_HOT_BLOCKS 2
+/* Each segment file holds at most this many lines, and this many bytes of
+ * blocks after its line index */
+#define TTOY_SCROLLBACK_SEGMENT_LINES (64 * 1024)
+#define TTOY_SCROLLBACK_SEGMENT_DATA_SIZE (32 * 1024 * 1024)
+
+struct ttoy_Scrollback_Block_;
+struct ttoy_Scrollback_Segment_;
+
+/* The most characters that libtsm combines into one cell (its
+ * TSM_UCS4_MAXLEN); any more are dropped */
+#define TTOY_SCROLLBACK_MAX_CELL_CHARS 10
+
+/**
+ * A single decoded scrollback cell, in the same terms that libtsm uses to
+ * draw the screen. The len characters in ch are the character in the cell
+ * followed by any combining characters; len is zero for an empty cell.
+ */
+typedef struct ttoy_ScrollbackCell_ {
+  uint32_t ch[TTOY_SCROLLBACK_MAX_CELL_CHARS];
+  size_t len;
+  unsigned int width;
+  struct tsm_screen_attr attr;
+} ttoy_ScrollbackCell;
+
+/**
+ * Stores the lines that scrolled off the top of the terminal screen.
+ *
+ * Rather than keeping a full cell structure for every column, each line is
+ * stored as UTF-8 text followed by run-length encoded attributes, with
+ * trailing blank cells trimmed. Lines are packed into fixed-size blocks;
+ * blocks that are no longer among the newest few are compressed with LZ4
+ * when ttoy is built with it. When the store grows past its byte limit, the
+ * oldest blocks are discarded, or spilled to disk if a spill directory was
+ * given.
+ *
+ * Spilled blocks are appended to segment files, which start with an index of
+ * the offset of each line they hold, and are read back through mmap(). The
+ * files are unlinked as soon as they are created, so they never outlive us.
+ * Once the segment files grow past their own byte limit, the oldest segments
+ * are discarded. A segment that cannot be written is given up on by itself;
+ * its lines read back as blank lines, so that the lines after it keep their
+ * place.
+ *
+ * Lines are only decoded when they are asked for, which normally means the
+ * handful of lines in the viewport.
+ */
+typedef struct ttoy_Scrollback_ {
+  struct ttoy_Scrollback_Block_ *blocks;
+  size_t numBlocks, blocksSize;
+  struct ttoy_Scrollback_Segment_ *segments;
+  size_t numSegments, segmentsSize;
+  char *spillDirectory;
+  size_t maxDiskBytes;
+  /* Lines are numbered from the first line ever pushed, so that a block can
+   * be identified by the number of its first line. The oldest spilledLines
+   * of the numLines lines are on disk, or were lost with their segment. */
+  size_t numLines, droppedLines, spilledLines;
+  size_t maxBytes, bytes;
+  uint8_t *line;
+  size_t lineSize;
+  /* The most recently decompressed block */
+  uint8_t *decoded;
+  size_t decodedSize, decodedBlockLine;
+} ttoy_Scrollback;
+
+/**
+ * Initializes an empty scrollback store that keeps at most about maxBytes
+ * bytes of lines. A maxBytes of zero disables the scrollback.
+ */
+void ttoy_Scrollback_init(
+    ttoy_Scrollback *self,
+    size_t maxBytes);
+
+void ttoy_Scrollback_destroy(
+    ttoy_Scrollback *self);
+
+/**
+ * Makes the scrollback spill its oldest lines to segment files in the given
+ * directory, rather than discard them, once its byte limit is reached. The
+ * oldest segments are discarded to keep the files within about maxDiskBytes
+ * bytes.
+ */
+ttoy_ErrorCode ttoy_Scrollback_setSpillDirectory(
+    ttoy_Scrollback *self,
+    const char *path,
+    size_t maxDiskBytes);
+
+/**
+ * Appends a line of cells to the scrollback, discarding the oldest lines if
+ * the byte limit is reached.
+ */
+ttoy_ErrorCode ttoy_Scrollback_pushLine(
+    ttoy_Scrollback *self,
+    const ttoy_ScrollbackCell *cells,
+    size_t numCells);
+
+/**
+ * Returns the number of lines currently held, which can shrink as old lines
+ * are discarded.
+ */
+size_t ttoy_Scrollback_numLines(
+    const ttoy_Scrollback *self);
+
+/**
+ * Returns the number of bytes of memory held by the scrollback, not counting
+ * the segment files that are mapped into memory.
+ */
+size_t ttoy_Scrollback_memoryUsage(
+    const ttoy_Scrollback *self);
+
+/**
+ * Returns the number of bytes written to segment files.
+ */
+size_t ttoy_Scrollback_diskUsage(
+    const ttoy_Scrollback *self);
+
+/**
+ * Decodes the line at the given index, where index zero is the oldest line,
+ * into at most maxCells cells. Cells beyond the end of the stored line are
+ * filled with blanks. The number of cells that were stored for the line is
+ * written to numCells, if it is not NULL.
+ */
+ttoy_ErrorCode ttoy_Scrollback_getLine(
+    ttoy_Scrollback *self,
+    size_t index,
+    ttoy_ScrollbackCell *cells,
+    size_t maxCells,
+    size_t *numCells);
+
+/**
+ * Sets a cell to the blank cell that trimmed cells decode to.
+ */
+void ttoy_ScrollbackCell_clear(
+    ttoy_ScrollbackCell *cell);
+
+#endif
@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2016-2017 Jonathan Glines
+ * Jonathan Glines <jonathan@glines.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "startupProfile.h"
+
+typedef struct ttoy_StartupProfile_Stage_ {
+  Uint64 begin, end;
+  SDL_threadID thread;
+  int recorded;
+} ttoy_StartupProfile_Stage;
+
+struct ttoy_StartupProfile_Internal_ {
+  ttoy_StartupProfile_Stage stages[TTOY_STARTUP_NUM_STAGES];
+  Uint64 start, frequency;
+  SDL_threadID mainThread;
+};
+
+static const char *ttoy_StartupProfile_stageNames[] = {
+  "sdl",
+  "shell",
+  "window",
+  "config",
+  "fonts",
+  "atlas",
+  "wait for fonts",
+  "renderers",
+  "first frame",
+};
+
+/* Private methods */
+double
+ttoy_StartupProfile_toMilliseconds(
+    const ttoy_StartupProfile *self,
+    Uint64 counter);
+
+void
+ttoy_StartupProfile_init(
+    ttoy_StartupProfile *self)
+{
+  /* Allocate memory for internal structures */
+  self->internal = (ttoy_StartupProfile_Internal *)malloc(
+      sizeof(ttoy_StartupProfile_Internal));
+  for (int i = 0; i < TTOY_STARTUP_NUM_STAGES; ++i) {
+    self->internal->stages[i].recorded = 0;
+  }
+  self->internal->frequency = SDL_GetPerformanceFrequency();
+  self->internal->start = SDL_GetPerformanceCounter();
+  self->internal->mainThread = SDL_ThreadID();
+}
+
+void
+ttoy_StartupProfile_destroy(
+    ttoy_StartupProfile *self)
+{
+  free(self->internal);
+}
+
+void
+ttoy_StartupProfile_beginStage(
+    ttoy_StartupProfile *self,
+    ttoy_StartupStage stage)
+{
+  ttoy_StartupProfile_Stage *s;
+
+  s = &self->internal->stages[stage];
+  s->begin = SDL_GetPerformanceCounter();
+  s->end = s->begin;
+  s->thread = SDL_ThreadID();
+}
+
+void
+ttoy_StartupProfile_endStage(
+    ttoy_StartupProfile *self,
+    ttoy_StartupStage stage)
+{
+  ttoy_StartupProfile_Stage *s;
+
+  s = &self->internal->stages[stage];
+  s->end = SDL_GetPerformanceCounter();
+  s->recorded = 1;
+}
+
+double
+ttoy_StartupProfile_toMilliseconds(
+    const ttoy_StartupProfile *self,
+    Uint64 counter)
+{
+  return (double)(counter - self->internal->start) * 1000.0
+    / (double)self->internal->frequency;
+}
+
+void
+ttoy_StartupProfile_print(
+    const ttoy_StartupProfile *self)
+{
+  const ttoy_StartupProfile_Stage *s;
+  double begin, end, total;
+
+  fprintf(stderr, "ttoy startup profile:\n");
+  fprintf(stderr, "  %-16s%-8s%12s%12s\n",
+      "stage", "thread", "start (ms)", "time (ms)");
+  total = 0.0;
+  for (int i = 0; i < TTOY_STARTUP_NUM_STAGES; ++i) {
+    s = &self->internal->stages[i];
+    if (!s->recorded)
+      continue;
+    begin = ttoy_StartupProfile_toMilliseconds(self, s->begin);
+    end = ttoy_StartupProfile_toMilliseconds(self, s->end);
+    fprintf(stderr, "  %-16s%-8s%12.2f%12.2f\n",
+        ttoy_StartupProfile_stageNames[i],
+        s->thread == self->internal->mainThread ? "main" : "worker",
+        begin,
+        end - begin);
+    total = end > total ? end : total;
+  }
+  fprintf(stderr, "  %-24s%24.2f\n", "total", total);
+}
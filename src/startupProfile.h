@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2016-2017 Jonathan Glines
+ * Jonathan Glines <jonathan@glines.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef TTOY_STARTUP_PROFILE_H_
+#define TTOY_STARTUP_PROFILE_H_
+
+#include <SDL.h>
+
+/**
+ * The stages of ttoy startup. Some of these run concurrently on different
+ * threads; see main().
+ */
+typedef enum ttoy_StartupStage_ {
+  TTOY_STARTUP_STAGE_SDL,
+  TTOY_STARTUP_STAGE_SHELL,
+  TTOY_STARTUP_STAGE_WINDOW,
+  TTOY_STARTUP_STAGE_CONFIG,
+  TTOY_STARTUP_STAGE_FONTS,
+  TTOY_STARTUP_STAGE_ATLAS,
+  TTOY_STARTUP_STAGE_WAIT,
+  TTOY_STARTUP_STAGE_RENDERERS,
+  TTOY_STARTUP_STAGE_FIRST_FRAME,
+  TTOY_STARTUP_NUM_STAGES,
+} ttoy_StartupStage;
+
+struct ttoy_StartupProfile_Internal_;
+typedef struct ttoy_StartupProfile_Internal_ ttoy_StartupProfile_Internal;
+
+/**
+ * Records when each stage of ttoy startup began and ended, and on which
+ * thread, so that the time it takes to get to the first prompt can be broken
+ * down by stage.
+ *
+ * Each stage must be begun and ended by a single thread. The profile is only
+ * read once all of the threads involved in startup have been joined.
+ */
+typedef struct ttoy_StartupProfile_ {
+  ttoy_StartupProfile_Internal *internal;
+} ttoy_StartupProfile;
+
+/**
+ * Initializes the given startup profile. Times are measured relative to when
+ * this is called, from the thread that is considered the main thread.
+ */
+void
+ttoy_StartupProfile_init(
+    ttoy_StartupProfile *self);
+
+void
+ttoy_StartupProfile_destroy(
+    ttoy_StartupProfile *self);
+
+void
+ttoy_StartupProfile_beginStage(
+    ttoy_StartupProfile *self,
+    ttoy_StartupStage stage);
+
+void
+ttoy_StartupProfile_endStage(
+    ttoy_StartupProfile *self,
+    ttoy_StartupStage stage);
+
+/**
+ * Prints the timing breakdown of all of the stages that were recorded to
+ * stderr.
+ */
+void
+ttoy_StartupProfile_print(
+    const ttoy_StartupProfile *self);
+
+#endif
@@ -24,19 +24,33 @@
 #include <SDL_syswm.h>
 #include <X11/Xlib.h>
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
 
+#include "../extern/tsm_screen_sb_pop.h"
 #include "../extern/xkbcommon-keysyms.h"
 
 #include "backgroundRenderer.h"
+#include "common/cacheDir.h"
 #include "common/glError.h"
 #include "glyphRendererRef.h"
 #include "logging.h"
 #include "profile.h"
+#include "scrollback.h"
 #include "textRenderer.h"
 
 #include "terminal.h"
 
 #define MAX(a,b) ((a) > (b) ? (a) : (b))
+#define MIN(a,b) ((a) < (b) ? (a) : (b))
+
+/* The size of the window before the fonts are loaded, while it is hidden */
+#define TTOY_TERMINAL_PROVISIONAL_WIDTH 640
+#define TTOY_TERMINAL_PROVISIONAL_HEIGHT 480
+
+/* The number of lines libtsm may hold in its own scrollback until we move
+ * them into ours, which we do after every read from the pseudo terminal */
+#define TTOY_TERMINAL_SCROLLBACK_STAGING_LINES 4096
 
 typedef enum ttoy_Terminal_SelectionState_ {
   TTOY_TERMINAL_NO_SELECTION,
@@ -53,6 +67,13 @@ struct ttoy_Terminal_Internal {
   int beginSelection[2];
   int selectionTargetCell[2];
   ttoy_Terminal_SelectionState selectionState;
+  int focused, visible;
+  ttoy_Scrollback scrollback;
+  /* The number of scrollback lines scrolled into view */
+  size_t scrollOffset;
+  /* The line being moved from the libtsm scrollback into ours */
+  ttoy_ScrollbackCell *scrollbackLine;
+  size_t scrollbackLineSize, scrollbackLineCells;
 };
 
 /* Private methods */
@@ -75,6 +96,22 @@ void ttoy_Terminal_oscCallback(
     ttoy_Terminal *self);
 void ttoy_Terminal_initWindow(ttoy_Terminal *self);
 void ttoy_Terminal_initTSM(ttoy_Terminal *self);
+int ttoy_Terminal_scrollbackLineCallback(
+    struct tsm_screen *con,
+    uint32_t id,
+    const uint32_t *ch,
+    size_t len,
+    unsigned int width,
+    unsigned int posx,
+    unsigned int posy,
+    const struct tsm_screen_attr *attr,
+    tsm_age_t age,
+    ttoy_Terminal *self);
+void ttoy_Terminal_drainScrollback(ttoy_Terminal *self);
+void ttoy_Terminal_scroll(
+    ttoy_Terminal *self,
+    int lines);
+void ttoy_Terminal_scrollToBottom(ttoy_Terminal *self);
 void ttoy_Terminal_updateScreenSize(ttoy_Terminal *self);
 void ttoy_Terminal_calculateScreenSize(
     ttoy_Terminal *self,
@@ -101,8 +138,28 @@ void ttoy_Terminal_tsmLogCallback(
     const char *format,
     va_list args)
 {
-  /* TODO: Do something with this data */
-  fprintf(stderr, "ttoy_Terminal_tsmLogCallback() called\n");
+  static ttoy_LogSite site;
+  int level;
+
+  /* libtsm uses syslog severities */
+  if (sev <= 3) {
+    level = TTOY_LOG_LEVEL_ERROR;
+  } else if (sev == 4) {
+    level = TTOY_LOG_LEVEL_WARNING;
+  } else if (sev <= 6) {
+    level = TTOY_LOG_LEVEL_INFO;
+  } else {
+    level = TTOY_LOG_LEVEL_DEBUG;
+  }
+  /* NOTE: All of the messages from libtsm share one call site, so that a
+   * flood of bad escape sequences is rate limited as a whole */
+  ttoy_logv(&site,
+      level,  /* level */
+      file != NULL ? file : "libtsm",  /* file */
+      line,  /* line */
+      format,  /* format */
+      args  /* args */
+      );
 }
 
 void ttoy_Terminal_tsmWriteCallback(
@@ -151,25 +208,25 @@ void ttoy_Terminal_ptyReadCallback(
       u8,  /* u8 */
       len  /* len */
       );
+  /* Keep the lines that scrolled off the screen */
+  ttoy_Terminal_drainScrollback(self);
   /* Update the terminal screen display */
   ttoy_Terminal_updateScreen(self);
 }
 
-void ttoy_Terminal_initWindow(ttoy_Terminal *self) {
-  /* Calculate the window size based on the desired screen size */
-  ttoy_Terminal_calculateWindowSize(self,
-      &self->width,  /* columns */
-      &self->height  /* rows */
-      );
-  /* Create the SDL window */
+void ttoy_Terminal_createWindow(ttoy_Terminal *self) {
+  /* Create the SDL window. The window stays hidden until we know its real
+   * size, which depends on the cell size of the fonts that might still be
+   * loading. */
   self->window = SDL_CreateWindow(
       "TToY Graphical Terminal Emulator",  /* title */
       SDL_WINDOWPOS_UNDEFINED,  /* x */
       SDL_WINDOWPOS_UNDEFINED,  /* y */
-      self->width,  /* w */
-      self->height,  /* h */
+      TTOY_TERMINAL_PROVISIONAL_WIDTH,  /* w */
+      TTOY_TERMINAL_PROVISIONAL_HEIGHT,  /* h */
       SDL_WINDOW_OPENGL
-      | SDL_WINDOW_RESIZABLE  /* flags */
+      | SDL_WINDOW_RESIZABLE
+      | SDL_WINDOW_HIDDEN  /* flags */
       );
   if (self->window == NULL) {
     fprintf(stderr, "Failed to create SDL window: %s\n",
@@ -185,6 +242,10 @@ void ttoy_Terminal_initWindow(ttoy_Terminal *self) {
   /* Create an OpenGL context for our window */
   SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
   SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+#if TTOY_CHECK_GL_ERRORS
+  /* Debug contexts report more problems through KHR_debug */
+  SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_DEBUG_FLAG);
+#endif
   self->glContext = SDL_GL_CreateContext(self->window);
   if (self->glContext == NULL) {
     fprintf(stderr, "Failed to initialize OpenGL context: %s\n",
@@ -207,6 +268,21 @@ void ttoy_Terminal_initWindow(ttoy_Terminal *self) {
    * <http://stackoverflow.com/a/20035078> */
   /* FIXME: This is a hack for an unfortunate bug in GLEW */
   while (glGetError() != GL_NO_ERROR);
+  /* Have the GL report errors to us instead of polling glGetError() */
+  ttoy_initGLDebugOutput();
+}
+
+void ttoy_Terminal_initWindow(ttoy_Terminal *self) {
+  /* Calculate the window size based on the desired screen size */
+  ttoy_Terminal_calculateWindowSize(self,
+      &self->width,  /* columns */
+      &self->height  /* rows */
+      );
+  SDL_SetWindowSize(self->window,
+      self->width,  /* w */
+      self->height  /* h */
+      );
+  SDL_ShowWindow(self->window);
 
   /* Configure the GL */
   ttoy_Color *bgColor =
@@ -216,21 +292,21 @@ void ttoy_Terminal_initWindow(ttoy_Terminal *self) {
       (float)bgColor->rgb[1] / 255.0f,
       (float)bgColor->rgb[2] / 255.0f,
       0.0f);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glClearDepth(1.0);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glEnable(GL_DEPTH_TEST);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glDepthFunc(GL_LESS);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glDisable(GL_CULL_FACE);  /* XXX */
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glFrontFace(GL_CCW);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glViewport(0, 0, self->width, self->height);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   SDL_GL_SwapWindow(self->window);
 }
 
@@ -266,6 +342,44 @@ void ttoy_Terminal_initTSM(ttoy_Terminal *self) {
     /* TODO: Fail gracefully */
     assert(0);
   }
+  /* Lines that scroll off the screen are kept by libtsm only until we move
+   * them into our own, more compact scrollback */
+  ttoy_Scrollback_init(&self->internal->scrollback,
+      self->internal->profile->scrollbackLimit  /* maxBytes */
+      );
+  if (self->internal->profile->scrollbackLimit > 0
+      && self->internal->profile->scrollbackSpillLimit > 0
+      && (self->internal->profile->flags & TTOY_PROFILE_SPILL_SCROLLBACK))
+  {
+    ttoy_ErrorCode error;
+    char *spillDir;
+    /* Lines past the memory limit go to disk rather than to memory-backed
+     * runtime directories; the segment files are unlinked as soon as they
+     * are created, so nothing is left behind in the cache */
+    error = ttoy_getCacheDir("scrollback", &spillDir);
+    if (error != TTOY_NO_ERROR) {
+      TTOY_LOG_ERROR_CODE(error);
+      TTOY_LOG_WARNING("%s",
+          "No cache directory for scrollback; old scrollback will be "
+          "discarded");
+    } else {
+      error = ttoy_Scrollback_setSpillDirectory(
+          &self->internal->scrollback,
+          spillDir,  /* path */
+          self->internal->profile->scrollbackSpillLimit  /* maxDiskBytes */
+          );
+      if (error != TTOY_NO_ERROR) {
+        TTOY_LOG_ERROR_CODE(error);
+      }
+      free(spillDir);
+    }
+  }
+  if (self->internal->profile->scrollbackLimit > 0) {
+    tsm_screen_set_max_sb(
+        self->screen,  /* con */
+        TTOY_TERMINAL_SCROLLBACK_STAGING_LINES  /* max */
+        );
+  }
 }
 
 void ttoy_Terminal_calculateScreenSize(
@@ -309,33 +423,100 @@ void ttoy_Terminal_init(
     ttoy_Profile *profile,
     int argc,
     char **argv)
+{
+  ttoy_GlyphRendererRef *glyphRenderer;
+
+  ttoy_Terminal_preinit(self);
+  /* Initialize the glyph renderer */
+  ttoy_GlyphRendererRef_init(&glyphRenderer);
+  ttoy_GlyphRenderer_init(
+      ttoy_GlyphRendererRef_get(glyphRenderer),
+      profile  /* profile */
+      );
+  /* Initialize the SDL window */
+  ttoy_Terminal_createWindow(self);
+  /* Initialize our renderers with the glyph renderer, which we take
+   * ownership of */
+  ttoy_Terminal_initRenderers(self,
+      profile,  /* profile */
+      glyphRenderer,  /* glyphRenderer */
+      NULL  /* stagingAtlas */
+      );
+  ttoy_GlyphRendererRef_decrement(glyphRenderer);
+  /* Initialize the pseudo terminal and corresponding child process */
+  ttoy_Terminal_startShell(self,
+      argc,  /* argc */
+      argv  /* argv */
+      );
+}
+
+void ttoy_Terminal_preinit(
+    ttoy_Terminal *self)
 {
   /* Allocate memory for internal data structures */
   self->internal = (struct ttoy_Terminal_Internal *)malloc(
       sizeof(struct ttoy_Terminal_Internal));
   self->internal->selectionState = TTOY_TERMINAL_NO_SELECTION;
-  self->internal->profile = profile;
+  self->internal->profile = NULL;
+  self->internal->glyphRenderer = NULL;
+  self->internal->focused = 1;
+  self->internal->visible = 1;
+  self->internal->scrollOffset = 0;
+  self->internal->scrollbackLine = NULL;
+  self->internal->scrollbackLineSize = 0;
+  self->internal->scrollbackLineCells = 0;
   /* TODO: The default columns and rows should be configurable */
   self->columns = 80;
   self->rows = 25;
-  /* Initialize the glyph renderer */
-  ttoy_GlyphRendererRef_init(&self->internal->glyphRenderer);
-  ttoy_GlyphRenderer_init(
-      ttoy_GlyphRendererRef_get(self->internal->glyphRenderer),
-      profile  /* profile */
+}
+
+void ttoy_Terminal_startShell(
+    ttoy_Terminal *self,
+    int argc,
+    char **argv)
+{
+  /* NOTE: The screen size does not depend on the fonts, so the shell can start
+   * before the fonts are loaded */
+  ttoy_PTY_init(&self->pty,
+      self->columns,  /* width */
+      self->rows  /* height */
       );
+  /* TODO: Construct a ttoy_MonospaceFont object that combines multiple font
+   * faces into one font that supports normal, bold, and wide glyphs */
+  /* TODO: Calculate terminal width and height */
+  ttoy_PTY_startChild(&self->pty,
+      argv[0],  /* path */
+      argv,  /* argv */
+      (ttoy_PTY_readCallback_t)ttoy_Terminal_ptyReadCallback,  /* callback */
+      self  /* callback_data */
+      );
+  /* TODO: Start sending input from the child process to tsm_vte_input()? */
+  /* TODO: Start sending keyboard input to tsm_vte_handle_keyboard()? */
+}
+
+void ttoy_Terminal_initRenderers(
+    ttoy_Terminal *self,
+    ttoy_Profile *profile,
+    ttoy_GlyphRendererRef *glyphRenderer,
+    const ttoy_GlyphAtlasStaging *stagingAtlas)
+{
+  self->internal->profile = profile;
+  /* Store a reference to the glyph renderer */
+  self->internal->glyphRenderer = glyphRenderer;
+  ttoy_GlyphRendererRef_increment(glyphRenderer);
   /* Store the cell size as calculated by the glyph renderer */
   ttoy_GlyphRenderer_getCellSize(
       ttoy_GlyphRendererRef_get(self->internal->glyphRenderer),
       &self->cellWidth,  /* width */
       &self->cellHeight  /* height */
       );
-  /* Initialize the SDL window */
+  /* Size and show the SDL window */
   ttoy_Terminal_initWindow(self);
   /* Initialize the text renderer */
   ttoy_TextRenderer_init(&self->internal->textRenderer,
       self->internal->glyphRenderer,  /* glyphRenderer */
-      profile  /* profile */
+      profile,  /* profile */
+      stagingAtlas  /* stagingAtlas */
       );
   /* Initialize the background renderer */
   ttoy_BackgroundRenderer_init(
@@ -344,22 +525,6 @@ void ttoy_Terminal_init(
       );
   /* Initialize the terminal state machine */
   ttoy_Terminal_initTSM(self);
-  /* Initialize the pseudo terminal and corresponding child process */
-  ttoy_PTY_init(&self->pty,
-      self->columns,  /* width */
-      self->rows  /* height */
-      );
-  /* TODO: Construct a ttoy_MonospaceFont object that combines multiple font
-   * faces into one font that supports normal, bold, and wide glyphs */
-  /* TODO: Calculate terminal width and height */
-  ttoy_PTY_startChild(&self->pty,
-      argv[0],  /* path */
-      argv,  /* argv */
-      (ttoy_PTY_readCallback_t)ttoy_Terminal_ptyReadCallback,  /* callback */
-      self  /* callback_data */
-      );
-  /* TODO: Start sending input from the child process to tsm_vte_input()? */
-  /* TODO: Start sending keyboard input to tsm_vte_handle_keyboard()? */
 }
 
 void ttoy_Terminal_destroy(ttoy_Terminal *self) {
@@ -367,6 +532,8 @@ void ttoy_Terminal_destroy(ttoy_Terminal *self) {
   ttoy_BackgroundRenderer_destroy(&self->internal->backgroundRenderer);
   ttoy_TextRenderer_destroy(&self->internal->textRenderer);
   ttoy_GlyphRendererRef_decrement(self->internal->glyphRenderer);
+  ttoy_Scrollback_destroy(&self->internal->scrollback);
+  free(self->internal->scrollbackLine);
   /* FIXME: Destroy the libtsm state machine */
   /* FIXME: Destroy the libtsm screen */
   ttoy_PTY_destroy(&self->pty);
@@ -387,7 +554,36 @@ void ttoy_Terminal_windowSizeChanged(
   ttoy_Terminal_updateScreenSize(self);
   /* Update the GL viewport size */
   glViewport(0, 0, width, height);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
+}
+
+void ttoy_Terminal_windowFocusChanged(
+    ttoy_Terminal *self,
+    int focused)
+{
+  self->internal->focused = focused;
+  /* Nobody is watching the background toy animate unless our window is both
+   * visible and focused */
+  ttoy_BackgroundRenderer_setPaused(&self->internal->backgroundRenderer,
+      !(self->internal->focused && self->internal->visible)  /* paused */
+      );
+}
+
+void ttoy_Terminal_windowVisibilityChanged(
+    ttoy_Terminal *self,
+    int visible)
+{
+  self->internal->visible = visible;
+  ttoy_BackgroundRenderer_setPaused(&self->internal->backgroundRenderer,
+      !(self->internal->focused && self->internal->visible)  /* paused */
+      );
+}
+
+int ttoy_Terminal_isAnimating(
+    ttoy_Terminal *self)
+{
+  return ttoy_BackgroundRenderer_isAnimating(
+      &self->internal->backgroundRenderer);
 }
 
 void ttoy_Terminal_updateScreenSize(ttoy_Terminal *self) {
@@ -419,27 +615,142 @@ void ttoy_Terminal_updateScreenSize(ttoy_Terminal *self) {
         self->columns,  /* width */
         self->rows  /* height */
         );
+    /* libtsm pushes lines off the top of the screen when it shrinks */
+    ttoy_Terminal_drainScrollback(self);
     /* Update the screen */
-    ttoy_TextRenderer_updateScreen(&self->internal->textRenderer,
-        self->screen,  /* screen */
-        self->cellWidth,  /* cellWidth */
-        self->cellHeight  /* cellHeight */
-        );
+    ttoy_Terminal_updateScreen(self);
   }
 }
 
 void ttoy_Terminal_updateScreen(ttoy_Terminal *self) {
   ttoy_TextRenderer_updateScreen(&self->internal->textRenderer,
       self->screen,  /* screen */
+      &self->internal->scrollback,  /* scrollback */
+      self->internal->scrollOffset,  /* scrollOffset */
       self->cellWidth,  /* cellWidth */
       self->cellHeight  /* cellHeight */
       );
 }
 
+int ttoy_Terminal_scrollbackLineCallback(
+    struct tsm_screen *con,
+    uint32_t id,
+    const uint32_t *ch,
+    size_t len,
+    unsigned int width,
+    unsigned int posx,
+    unsigned int posy,
+    const struct tsm_screen_attr *attr,
+    tsm_age_t age,
+    ttoy_Terminal *self)
+{
+  ttoy_ScrollbackCell *cells;
+  size_t size;
+
+  /* Lines in the libtsm scrollback keep the width they had when they
+   * scrolled off, which might be wider than the screen is now */
+  if (posx >= self->internal->scrollbackLineSize) {
+    size = MAX(posx + 1, 2 * self->internal->scrollbackLineSize);
+    cells = (ttoy_ScrollbackCell *)realloc(self->internal->scrollbackLine,
+        size * sizeof(ttoy_ScrollbackCell));
+    if (cells == NULL)
+      return -1;
+    for (size_t i = self->internal->scrollbackLineSize; i < size; ++i) {
+      ttoy_ScrollbackCell_clear(&cells[i]);
+    }
+    self->internal->scrollbackLine = cells;
+    self->internal->scrollbackLineSize = size;
+  }
+  cells = self->internal->scrollbackLine;
+  /* Keep the combining characters along with the character they follow */
+  cells[posx].len = MIN(len, TTOY_SCROLLBACK_MAX_CELL_CHARS);
+  memcpy(cells[posx].ch, ch, cells[posx].len * sizeof(uint32_t));
+  cells[posx].width = width;
+  cells[posx].attr = *attr;
+  if (width == 2 && posx + 1 < self->internal->scrollbackLineSize) {
+    cells[posx + 1].width = 0;
+  }
+  /* Remember which cells to clear before the next line */
+  size = MIN(posx + MAX(width, 1), self->internal->scrollbackLineSize);
+  if (size > self->internal->scrollbackLineCells)
+    self->internal->scrollbackLineCells = size;
+
+  return 0;
+}
+
+void ttoy_Terminal_drainScrollback(ttoy_Terminal *self) {
+  size_t numLines;
+  ttoy_ErrorCode error;
+
+  if (self->internal->profile->scrollbackLimit == 0)
+    return;
+
+  /* Move the lines that libtsm has collected into our scrollback, one line
+   * at a time */
+  numLines = 0;
+  for (;;) {
+    for (size_t i = 0; i < self->internal->scrollbackLineCells; ++i) {
+      ttoy_ScrollbackCell_clear(&self->internal->scrollbackLine[i]);
+    }
+    self->internal->scrollbackLineCells = 0;
+    if (tsm_screen_sb_pop(
+          self->screen,  /* con */
+          (tsm_screen_draw_cb)ttoy_Terminal_scrollbackLineCallback,  /* draw_cb */
+          self  /* data */
+          ) < 0)
+    {
+      break;
+    }
+    error = ttoy_Scrollback_pushLine(&self->internal->scrollback,
+        self->internal->scrollbackLine,  /* cells */
+        self->internal->scrollbackLineCells  /* numCells */
+        );
+    if (error != TTOY_NO_ERROR) {
+      TTOY_LOG_ERROR_CODE(error);
+    }
+    numLines += 1;
+  }
+
+  if (self->internal->scrollOffset > 0) {
+    /* Keep the lines the user is looking at in view, as far as the
+     * scrollback still has them */
+    self->internal->scrollOffset = MIN(
+        self->internal->scrollOffset + numLines,
+        ttoy_Scrollback_numLines(&self->internal->scrollback));
+  }
+}
+
+void ttoy_Terminal_scroll(
+    ttoy_Terminal *self,
+    int lines)
+{
+  size_t scrollOffset, numLines;
+
+  numLines = ttoy_Scrollback_numLines(&self->internal->scrollback);
+  scrollOffset = self->internal->scrollOffset;
+  if (lines < 0) {
+    scrollOffset = (size_t)-lines < scrollOffset
+      ? scrollOffset - (size_t)-lines : 0;
+  } else {
+    scrollOffset = MIN(scrollOffset + (size_t)lines, numLines);
+  }
+  if (scrollOffset != self->internal->scrollOffset) {
+    self->internal->scrollOffset = scrollOffset;
+    ttoy_Terminal_updateScreen(self);
+  }
+}
+
+void ttoy_Terminal_scrollToBottom(ttoy_Terminal *self) {
+  if (self->internal->scrollOffset > 0) {
+    self->internal->scrollOffset = 0;
+    ttoy_Terminal_updateScreen(self);
+  }
+}
+
 void ttoy_Terminal_draw(ttoy_Terminal *self) {
   /* Clear the screen */
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
 
   /* Draw the background */
   ttoy_BackgroundRenderer_draw(&self->internal->backgroundRenderer,
@@ -455,6 +766,8 @@ void ttoy_Terminal_draw(ttoy_Terminal *self) {
       self->height  /* viewportHeight */
       );
 
+  ttoy_checkGLFrameErrors();
+
   SDL_GL_SwapWindow(self->window);
 }
 
@@ -484,6 +797,8 @@ void ttoy_Terminal_textInput(
       /* FIXME: It's not clear what result signifies or what
        * tsm_screen_sb_reset() actually does. */
       tsm_screen_sb_reset(self->screen);
+      /* Typing returns the view to the bottom of the screen */
+      ttoy_Terminal_scrollToBottom(self);
     }
   }
 }
@@ -515,7 +830,18 @@ void ttoy_Terminal_keyInput(
   if (modifiers & KMOD_GUI)
     modifiers_tsm |= TSM_LOGO_MASK;
 
-  /* TODO: Handle shift+pgup events to scroll through back buffer */
+  /* Scroll through the scrollback a page at a time with shift+pgup and
+   * shift+pgdown */
+  if ((modifiers & KMOD_SHIFT) && !(modifiers & (KMOD_CTRL | KMOD_ALT))) {
+    switch (keycode) {
+      case SDLK_PAGEUP:
+        ttoy_Terminal_scroll(self, self->rows);
+        return;
+      case SDLK_PAGEDOWN:
+        ttoy_Terminal_scroll(self, -self->rows);
+        return;
+    }
+  }
 
   /* Handle control key sequences */
   if (modifiers & KMOD_CTRL) {
@@ -638,6 +964,8 @@ void ttoy_Terminal_keyInput(
     /* FIXME: It's not clear what result signifies or what
      * tsm_screen_sb_reset() actually does. */
     tsm_screen_sb_reset(self->screen);
+    /* Typing returns the view to the bottom of the screen */
+    ttoy_Terminal_scrollToBottom(self);
   }
 }
 
@@ -649,14 +977,13 @@ void ttoy_Terminal_mouseButton(
     case SDL_BUTTON_LEFT:
       if (event->state == SDL_PRESSED) {
         if (event->clicks == 1) {
+          /* TODO: Select text in the scrollback. Until then, selections are
+           * made on the screen as it is when not scrolled. */
+          ttoy_Terminal_scrollToBottom(self);
           /* Clear the old selection */
           tsm_screen_selection_reset(self->screen);
           /* Update the screen */
-          ttoy_TextRenderer_updateScreen(&self->internal->textRenderer,
-              self->screen,  /* screen */
-              self->cellWidth,  /* cellWidth */
-              self->cellHeight  /* cellHeight */
-              );
+          ttoy_Terminal_updateScreen(self);
           /* Begin the selection (no cells are selected until dragging starts) */
           self->internal->beginSelection[0] = event->x;
           self->internal->beginSelection[1] = event->y;
@@ -819,11 +1146,7 @@ void ttoy_Terminal_mouseMotion(
               /* The selection is between cells; nothing is selected */
               tsm_screen_selection_reset(self->screen);
               /* Update the screen */
-              ttoy_TextRenderer_updateScreen(&self->internal->textRenderer,
-                  self->screen,  /* screen */
-                  self->cellWidth,  /* cellWidth */
-                  self->cellHeight  /* cellHeight */
-                  );
+              ttoy_Terminal_updateScreen(self);
               self->internal->selectionState =
                 TTOY_TERMINAL_SELECTION_BETWEEN_CELLS;
               break;
@@ -869,11 +1192,7 @@ void ttoy_Terminal_mouseMotion(
             self->internal->selectionTargetCell[0] = newSelectionTarget[0];
             self->internal->selectionTargetCell[1] = newSelectionTarget[1];
             /* Update the screen */
-            ttoy_TextRenderer_updateScreen(&self->internal->textRenderer,
-                self->screen,  /* screen */
-                self->cellWidth,  /* cellWidth */
-                self->cellHeight  /* cellHeight */
-                );
+            ttoy_Terminal_updateScreen(self);
           }
         }
         break;
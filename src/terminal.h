@@ -27,6 +27,8 @@
 #include <SDL.h>
 #include <libtsm.h>
 
+#include "glyphAtlas.h"
+#include "glyphRendererRef.h"
 #include "profile.h"
 #include "pty.h"
 
@@ -52,13 +54,52 @@ void ttoy_Terminal_init(
     char **argv);
 void ttoy_Terminal_destroy(ttoy_Terminal *self);
 
+/**
+ * Phased initialization of a terminal, which lets the stages of ttoy startup
+ * that do not depend on each other overlap. ttoy_Terminal_preinit() must be
+ * called first. The shell can then be started and the window and GL context
+ * created, in any order, while the profile and fonts are loaded on another
+ * thread. ttoy_Terminal_initRenderers() completes initialization once the
+ * fonts are ready.
+ *
+ * Note that SDL must be initialized before the shell is started, since the
+ * pseudo terminal pushes its events to the SDL event queue.
+ */
+void ttoy_Terminal_preinit(
+    ttoy_Terminal *self);
+void ttoy_Terminal_startShell(
+    ttoy_Terminal *self,
+    int argc,
+    char **argv);
+void ttoy_Terminal_createWindow(
+    ttoy_Terminal *self);
+void ttoy_Terminal_initRenderers(
+    ttoy_Terminal *self,
+    ttoy_Profile *profile,
+    ttoy_GlyphRendererRef *glyphRenderer,
+    const ttoy_GlyphAtlasStaging *stagingAtlas);
+
 void ttoy_Terminal_windowSizeChanged(
     ttoy_Terminal *self,
     int width,
     int height);
+void ttoy_Terminal_windowFocusChanged(
+    ttoy_Terminal *self,
+    int focused);
+void ttoy_Terminal_windowVisibilityChanged(
+    ttoy_Terminal *self,
+    int visible);
 
 void ttoy_Terminal_updateScreen(ttoy_Terminal *self);
 
+/**
+ * Returns non-zero if the terminal must be drawn every frame, i.e. if its
+ * background is animated. Otherwise, the terminal only needs to be drawn
+ * after events arrive.
+ */
+int ttoy_Terminal_isAnimating(
+    ttoy_Terminal *self);
+
 void ttoy_Terminal_draw(ttoy_Terminal *self);
 
 void ttoy_Terminal_textInput(
@@ -21,9 +21,13 @@
  * IN THE SOFTWARE.
  */
 
+#include <assert.h>
+
 #include "boundingBox.h"
+#include "common/arena.h"
 #include "common/glError.h"
 #include "common/shaders.h"
+#include "common/vector.h"
 #include "logging.h"
 
 #include "textRenderer.h"
@@ -56,9 +60,15 @@ typedef struct ttoy_TextRenderer_UnderlineInstance_ {
   uint8_t fgColor[3];
 } ttoy_TextRenderer_UnderlineInstance;
 
+TTOY_DECLARE_VECTOR(ttoy_TextRenderer_GlyphInstance)
+TTOY_DECLARE_VECTOR(ttoy_TextRenderer_BackgroundInstance)
+TTOY_DECLARE_VECTOR(ttoy_TextRenderer_UnderlineInstance)
+
 typedef struct ttoy_TextRenderer_ScreenDrawCallbackData_ {
   ttoy_TextRenderer *self;
   int cellWidth, cellHeight;
+  /* Screen rows are pushed down by the scrollback rows above them */
+  unsigned int rowOffset, rows;
 } ttoy_TextRenderer_ScreenDrawCallbackData;
 
 struct ttoy_TextRenderer_Internal {
@@ -66,12 +76,11 @@ struct ttoy_TextRenderer_Internal {
   ttoy_GlyphRendererRef *glyphRenderer;
   ttoy_GlyphAtlas *atlas;
   ttoy_Profile *profile;
-  ttoy_TextRenderer_GlyphInstance *glyphs;
-  size_t numGlyphs, sizeGlyphs;
-  ttoy_TextRenderer_BackgroundInstance *backgroundCells;
-  size_t numBackgroundCells, sizeBackgroundCells;
-  ttoy_TextRenderer_UnderlineInstance *underlines;
-  size_t numUnderlines, sizeUnderlines;
+  /* The instance vectors are cleared rather than freed every frame, so they
+   * stop allocating once they have grown to fit the screen */
+  ttoy_TextRenderer_GlyphInstanceVector glyphs;
+  ttoy_TextRenderer_BackgroundInstanceVector backgroundCells;
+  ttoy_TextRenderer_UnderlineInstanceVector underlines;
   GLuint quadVertexBuffer, quadIndexBuffer;
   GLuint glyphInstanceBuffer, glyphInstanceVAO;
   GLuint backgroundInstanceBuffer, backgroundInstanceVAO;
@@ -104,6 +113,12 @@ void ttoy_TextRenderer_screenDrawCallback(
     const struct tsm_screen_attr *attr,
     tsm_age_t age,
     ttoy_TextRenderer_ScreenDrawCallbackData *data);
+void ttoy_TextRenderer_drawScrollback(
+    ttoy_TextRenderer *self,
+    struct tsm_screen *screen,
+    ttoy_Scrollback *scrollback,
+    size_t scrollOffset,
+    ttoy_TextRenderer_ScreenDrawCallbackData *data);
 void ttoy_TextRenderer_addBackgroundCellInstance(
     ttoy_TextRenderer *self,
     int posx,
@@ -145,27 +160,28 @@ void ttoy_TextRenderer_drawGlyphs(
 void ttoy_TextRenderer_init(
     ttoy_TextRenderer *self,
     ttoy_GlyphRendererRef *glyphRenderer,
-    ttoy_Profile *profile)
+    ttoy_Profile *profile,
+    const ttoy_GlyphAtlasStaging *stagingAtlas)
 {
   /* Allocate memory for internal data structures */
   self->internal = (struct ttoy_TextRenderer_Internal*)malloc(
       sizeof(struct ttoy_TextRenderer_Internal));
-  /* TODO: Consolidate initialization of these dynamic arrays */
-  self->internal->sizeGlyphs = TTOY_TEXT_RENDERER_INIT_SIZE_GLYPHS;
-  self->internal->glyphs = (ttoy_TextRenderer_GlyphInstance *)malloc(
-      sizeof(ttoy_TextRenderer_GlyphInstance) * self->internal->sizeGlyphs);
-  self->internal->numGlyphs = 0;
-  self->internal->sizeBackgroundCells =
-    TTOY_TEXT_RENDERER_INIT_SIZE_BACKGROUND_CELLS;
-  self->internal->backgroundCells =
-    (ttoy_TextRenderer_BackgroundInstance*)malloc(
-      sizeof(ttoy_TextRenderer_BackgroundInstance)
-      * self->internal->sizeBackgroundCells);
-  self->internal->numBackgroundCells = 0;
-  self->internal->sizeUnderlines = TTOY_TEXT_RENDERER_INIT_SIZE_UNDERLINES;
-  self->internal->underlines = (ttoy_TextRenderer_UnderlineInstance *)malloc(
-      sizeof(ttoy_TextRenderer_UnderlineInstance) * self->internal->sizeUnderlines);
-  self->internal->numUnderlines = 0;
+  /* Reserve enough instances for a typical terminal up front */
+  ttoy_TextRenderer_GlyphInstanceVector_init(&self->internal->glyphs);
+  ttoy_TextRenderer_GlyphInstanceVector_reserve(&self->internal->glyphs,
+      TTOY_TEXT_RENDERER_INIT_SIZE_GLYPHS  /* capacity */
+      );
+  ttoy_TextRenderer_BackgroundInstanceVector_init(
+      &self->internal->backgroundCells);
+  ttoy_TextRenderer_BackgroundInstanceVector_reserve(
+      &self->internal->backgroundCells,
+      TTOY_TEXT_RENDERER_INIT_SIZE_BACKGROUND_CELLS  /* capacity */
+      );
+  ttoy_TextRenderer_UnderlineInstanceVector_init(&self->internal->underlines);
+  ttoy_TextRenderer_UnderlineInstanceVector_reserve(
+      &self->internal->underlines,
+      TTOY_TEXT_RENDERER_INIT_SIZE_UNDERLINES  /* capacity */
+      );
   /* Store a reference to the glyph renderer */
   self->internal->glyphRenderer = glyphRenderer;
   ttoy_GlyphRendererRef_increment(glyphRenderer);
@@ -180,11 +196,19 @@ void ttoy_TextRenderer_init(
   /* Initialize the glyph atlas */
   self->internal->atlas = (ttoy_GlyphAtlas *)malloc(sizeof(ttoy_GlyphAtlas));
   ttoy_GlyphAtlas_init(self->internal->atlas);
-  /* Render glyphs to the atlas representative of ASCII terminals */
-  ttoy_GlyphAtlas_renderASCIIGlyphs(self->internal->atlas,
-      ttoy_GlyphRendererRef_get(
-        self->internal->glyphRenderer)  /* glyphRenderer */
-      );
+  if (stagingAtlas != NULL) {
+    /* The ASCII glyphs were already rendered for us, e.g. by a worker thread
+     * during startup */
+    ttoy_GlyphAtlas_uploadStaging(self->internal->atlas,
+        stagingAtlas  /* staging */
+        );
+  } else {
+    /* Render glyphs to the atlas representative of ASCII terminals */
+    ttoy_GlyphAtlas_renderASCIIGlyphs(self->internal->atlas,
+        ttoy_GlyphRendererRef_get(
+          self->internal->glyphRenderer)  /* glyphRenderer */
+        );
+  }
 }
 
 void ttoy_TextRenderer_initShaders(
@@ -211,40 +235,40 @@ void ttoy_TextRenderer_initBuffers(
 
   /* Initialize the quad buffers */
   glGenBuffers(1, &self->internal->quadVertexBuffer);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glGenBuffers(1, &self->internal->quadIndexBuffer);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   /* Send quad buffer data to the GL */
   glBindBuffer(GL_ARRAY_BUFFER, self->internal->quadVertexBuffer);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glBufferData(
       GL_ARRAY_BUFFER,  /* target */
       sizeof(quadVertices),  /* size */
       quadVertices,  /* data */
       GL_STATIC_DRAW  /* usage */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, self->internal->quadIndexBuffer);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glBufferData(
       GL_ELEMENT_ARRAY_BUFFER,  /* target */
       sizeof(quadIndices),  /* size */
       quadIndices,  /* data */
       GL_STATIC_DRAW  /* usage */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
 
   /* Initialize the glyph instance buffer */
   glGenBuffers(1, &self->internal->glyphInstanceBuffer);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
 
   /* Initialize the background instance buffer */
   glGenBuffers(1, &self->internal->backgroundInstanceBuffer);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
 
   /* Initialize the underline instance buffer */
   glGenBuffers(1, &self->internal->underlineInstanceBuffer);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
 }
 
 void ttoy_TextRenderer_initVAO(
@@ -262,20 +286,20 @@ void ttoy_TextRenderer_initGlyphInstanceVAO(
          glyphSizeLocation, offsetLocation, cellLocation, fgColorLocation;
 
   glGenVertexArrays(1, &self->internal->glyphInstanceVAO);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glBindVertexArray(self->internal->glyphInstanceVAO);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
 
   /* Configure the vertex attributes from the quad buffer */
   glBindBuffer(GL_ARRAY_BUFFER, self->internal->quadVertexBuffer);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   /* Configure vertPos */
   vertPosLocation = glGetAttribLocation(
       self->internal->glyphShader,
       "vertPos");
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glEnableVertexAttribArray(vertPosLocation);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glVertexAttribPointer(
       vertPosLocation,  /* index */
       2,  /* size */
@@ -284,18 +308,18 @@ void ttoy_TextRenderer_initGlyphInstanceVAO(
       sizeof(ttoy_TextRenderer_QuadVertex),  /* stride */
       (void *)offsetof(ttoy_TextRenderer_QuadVertex, pos)  /* pointer */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
 
   /* Configure the vertex attributes from the glyph instance buffer */
   glBindBuffer(GL_ARRAY_BUFFER, self->internal->glyphInstanceBuffer);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   /* Configure atlasPos */
   atlasPosLocation = glGetAttribLocation(
       self->internal->glyphShader,
       "atlasPos");
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glEnableVertexAttribArray(atlasPosLocation);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glVertexAttribPointer(
       atlasPosLocation,  /* index */
       2,  /* size */
@@ -304,16 +328,16 @@ void ttoy_TextRenderer_initGlyphInstanceVAO(
       sizeof(ttoy_TextRenderer_GlyphInstance),  /* stride */
       (void *)offsetof(ttoy_TextRenderer_GlyphInstance, atlasPos)  /* pointer */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glVertexAttribDivisor(atlasPosLocation, 1);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   /* Configure atlasGlyphSize */
   atlasGlyphSizeLocation = glGetAttribLocation(
       self->internal->glyphShader,
       "atlasGlyphSize");
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glEnableVertexAttribArray(atlasGlyphSizeLocation);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glVertexAttribPointer(
       atlasGlyphSizeLocation,  /* index */
       2,  /* size */
@@ -322,16 +346,16 @@ void ttoy_TextRenderer_initGlyphInstanceVAO(
       sizeof(ttoy_TextRenderer_GlyphInstance),  /* stride */
       (void *)offsetof(ttoy_TextRenderer_GlyphInstance, atlasGlyphSize)  /* pointer */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glVertexAttribDivisor(atlasGlyphSizeLocation, 1);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   /* Configure glyphSize */
   glyphSizeLocation = glGetAttribLocation(
       self->internal->glyphShader,
       "glyphSize");
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glEnableVertexAttribArray(glyphSizeLocation);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glVertexAttribPointer(
       glyphSizeLocation,  /* index */
       2,  /* size */
@@ -340,16 +364,16 @@ void ttoy_TextRenderer_initGlyphInstanceVAO(
       sizeof(ttoy_TextRenderer_GlyphInstance),  /* stride */
       (void *)offsetof(ttoy_TextRenderer_GlyphInstance, glyphSize)  /* pointer */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glVertexAttribDivisor(glyphSizeLocation, 1);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   /* Configure glyphOffset */
   offsetLocation = glGetAttribLocation(
       self->internal->glyphShader,
       "offset");
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glEnableVertexAttribArray(offsetLocation);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glVertexAttribPointer(
       offsetLocation,  /* index */
       2,  /* size */
@@ -358,16 +382,16 @@ void ttoy_TextRenderer_initGlyphInstanceVAO(
       sizeof(ttoy_TextRenderer_GlyphInstance),  /* stride */
       (void *)offsetof(ttoy_TextRenderer_GlyphInstance, offset)  /* pointer */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glVertexAttribDivisor(offsetLocation, 1);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   /* Configure cell */
   cellLocation = glGetAttribLocation(
       self->internal->glyphShader,
       "cell");
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glEnableVertexAttribArray(cellLocation);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glVertexAttribIPointer(
       cellLocation,  /* index */
       2,  /* size */
@@ -375,16 +399,16 @@ void ttoy_TextRenderer_initGlyphInstanceVAO(
       sizeof(ttoy_TextRenderer_GlyphInstance),  /* stride */
       (void *)offsetof(ttoy_TextRenderer_GlyphInstance, cell)  /* pointer */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glVertexAttribDivisor(cellLocation, 1);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   /* Configure fgColor */
   fgColorLocation = glGetAttribLocation(
       self->internal->glyphShader,
       "fgColor");
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glEnableVertexAttribArray(fgColorLocation);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glVertexAttribPointer(
       fgColorLocation,  /* index */
       3,  /* size */
@@ -393,16 +417,16 @@ void ttoy_TextRenderer_initGlyphInstanceVAO(
       sizeof(ttoy_TextRenderer_GlyphInstance),  /* stride */
       (void *)offsetof(ttoy_TextRenderer_GlyphInstance, fgColor)  /* pointer */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glVertexAttribDivisor(fgColorLocation, 1);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
 
   /* Configure the IBO for drawing glyph quads */
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, self->internal->quadIndexBuffer);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
 
   glBindVertexArray(0);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
 }
 
 void ttoy_TextRenderer_initBackgroundInstanceVAO(
@@ -411,20 +435,20 @@ void ttoy_TextRenderer_initBackgroundInstanceVAO(
   GLuint vertPosLocation, cellLocation, bgColorLocation;
 
   glGenVertexArrays(1, &self->internal->backgroundInstanceVAO);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glBindVertexArray(self->internal->backgroundInstanceVAO);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
 
   /* Configure the vertex attributes from the quad buffer */
   glBindBuffer(GL_ARRAY_BUFFER, self->internal->quadVertexBuffer);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   /* Configure vertPos */
   vertPosLocation = glGetAttribLocation(
       self->internal->backgroundShader,
       "vertPos");
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glEnableVertexAttribArray(vertPosLocation);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glVertexAttribPointer(
       vertPosLocation,  /* index */
       2,  /* size */
@@ -433,18 +457,18 @@ void ttoy_TextRenderer_initBackgroundInstanceVAO(
       sizeof(ttoy_TextRenderer_QuadVertex),  /* stride */
       (void *)offsetof(ttoy_TextRenderer_QuadVertex, pos)  /* pointer */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
 
   /* Configure the vertex attributes from the background instance buffer */
   glBindBuffer(GL_ARRAY_BUFFER, self->internal->backgroundInstanceBuffer);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   /* Configure cell */
   cellLocation = glGetAttribLocation(
       self->internal->backgroundShader,
       "cell");
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glEnableVertexAttribArray(cellLocation);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glVertexAttribIPointer(
       cellLocation,  /* index */
       2,  /* size */
@@ -452,16 +476,16 @@ void ttoy_TextRenderer_initBackgroundInstanceVAO(
       sizeof(ttoy_TextRenderer_BackgroundInstance),  /* stride */
       (void *)offsetof(ttoy_TextRenderer_BackgroundInstance, cell)  /* pointer */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glVertexAttribDivisor(cellLocation, 1);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   /* Configure bgColor */
   bgColorLocation = glGetAttribLocation(
       self->internal->backgroundShader,
       "bgColor");
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glEnableVertexAttribArray(bgColorLocation);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glVertexAttribPointer(
       bgColorLocation,  /* index */
       4,  /* size */
@@ -470,16 +494,16 @@ void ttoy_TextRenderer_initBackgroundInstanceVAO(
       sizeof(ttoy_TextRenderer_BackgroundInstance),  /* stride */
       (void *)offsetof(ttoy_TextRenderer_BackgroundInstance, bgColor)  /* pointer */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glVertexAttribDivisor(bgColorLocation, 1);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
 
   /* Configure the IBO for drawing background cell quads */
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, self->internal->quadIndexBuffer);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
 
   glBindVertexArray(0);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
 }
 
 void ttoy_TextRenderer_initUnderlineInstanceVAO(
@@ -488,20 +512,20 @@ void ttoy_TextRenderer_initUnderlineInstanceVAO(
   GLuint vertPosLocation, cellLocation, fgColorLocation;
 
   glGenVertexArrays(1, &self->internal->underlineInstanceVAO);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glBindVertexArray(self->internal->underlineInstanceVAO);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
 
   /* Configure the vertex attributes from the quad buffer */
   glBindBuffer(GL_ARRAY_BUFFER, self->internal->quadVertexBuffer);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   /* Configure vertPos */
   vertPosLocation = glGetAttribLocation(
       self->internal->underlineShader,
       "vertPos");
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glEnableVertexAttribArray(vertPosLocation);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glVertexAttribPointer(
       vertPosLocation,  /* index */
       2,  /* size */
@@ -510,18 +534,18 @@ void ttoy_TextRenderer_initUnderlineInstanceVAO(
       sizeof(ttoy_TextRenderer_QuadVertex),  /* stride */
       (void *)offsetof(ttoy_TextRenderer_QuadVertex, pos)  /* pointer */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
 
   /* Configure the vertex attributes from the underline instance buffer */
   glBindBuffer(GL_ARRAY_BUFFER, self->internal->underlineInstanceBuffer);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   /* Configure cell */
   cellLocation = glGetAttribLocation(
       self->internal->underlineShader,
       "cell");
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glEnableVertexAttribArray(cellLocation);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glVertexAttribIPointer(
       cellLocation,  /* index */
       2,  /* size */
@@ -529,16 +553,16 @@ void ttoy_TextRenderer_initUnderlineInstanceVAO(
       sizeof(ttoy_TextRenderer_UnderlineInstance),  /* stride */
       (void *)offsetof(ttoy_TextRenderer_UnderlineInstance, cell)  /* pointer */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glVertexAttribDivisor(cellLocation, 1);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   /* Configure fgColor */
   fgColorLocation = glGetAttribLocation(
       self->internal->underlineShader,
       "fgColor");
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glEnableVertexAttribArray(fgColorLocation);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glVertexAttribPointer(
       fgColorLocation,  /* index */
       3,  /* size */
@@ -547,16 +571,16 @@ void ttoy_TextRenderer_initUnderlineInstanceVAO(
       sizeof(ttoy_TextRenderer_UnderlineInstance),  /* stride */
       (void *)offsetof(ttoy_TextRenderer_UnderlineInstance, fgColor)  /* pointer */
       );
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
   glVertexAttribDivisor(fgColorLocation, 1);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
 
   /* Configure the IBO for drawing underline quads */
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, self->internal->quadIndexBuffer);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
 
   glBindVertexArray(0);
-  FORCE_ASSERT_GL_ERROR();
+  ASSERT_GL_ERROR();
 }
 
 void ttoy_TextRenderer_destroy(
@@ -568,9 +592,11 @@ void ttoy_TextRenderer_destroy(
   /* Disown our glyph renderer */
   ttoy_GlyphRendererRef_decrement(self->internal->glyphRenderer);
   /* Free internal data structures */
-  free(self->internal->underlines);
-  free(self->internal->backgroundCells);
-  free(self->internal->glyphs);
+  ttoy_TextRenderer_UnderlineInstanceVector_destroy(
+      &self->internal->underlines);
+  ttoy_TextRenderer_BackgroundInstanceVector_destroy(
+      &self->internal->backgroundCells);
+  ttoy_TextRenderer_GlyphInstanceVector_destroy(&self->internal->glyphs);
   free(self->internal);
 }
 
@@ -603,6 +629,8 @@ void ttoy_TextRenderer_setGlyphRenderer(
 void ttoy_TextRenderer_updateScreen(
     ttoy_TextRenderer *self,
     struct tsm_screen *screen,
+    ttoy_Scrollback *scrollback,
+    size_t scrollOffset,
     int cellWidth,
     int cellHeight)
 {
@@ -616,7 +644,7 @@ void ttoy_TextRenderer_updateScreen(
   ASSERT_GL_ERROR();
   glBufferData(
       GL_ARRAY_BUFFER,  /* target */
-      self->internal->numGlyphs
+      ttoy_TextRenderer_GlyphInstanceVector_size(&self->internal->glyphs)
       * sizeof(ttoy_TextRenderer_GlyphInstance),  /* size */
       NULL,  /* data */
       GL_STREAM_DRAW  /* usage */
@@ -626,7 +654,8 @@ void ttoy_TextRenderer_updateScreen(
   ASSERT_GL_ERROR();
   glBufferData(
       GL_ARRAY_BUFFER,  /* target */
-      self->internal->numBackgroundCells
+      ttoy_TextRenderer_BackgroundInstanceVector_size(
+        &self->internal->backgroundCells)
       * sizeof(ttoy_TextRenderer_BackgroundInstance),  /* size */
       NULL,  /* data */
       GL_STREAM_DRAW  /* usage */
@@ -638,9 +667,20 @@ void ttoy_TextRenderer_updateScreen(
   data.self = self;
   data.cellWidth = cellWidth;
   data.cellHeight = cellHeight;
-  self->internal->numGlyphs = 0;
-  self->internal->numBackgroundCells = 0;
-  self->internal->numUnderlines = 0;
+  data.rowOffset = 0;
+  data.rows = tsm_screen_get_height(screen);
+  ttoy_TextRenderer_GlyphInstanceVector_clear(&self->internal->glyphs);
+  ttoy_TextRenderer_BackgroundInstanceVector_clear(
+      &self->internal->backgroundCells);
+  ttoy_TextRenderer_UnderlineInstanceVector_clear(&self->internal->underlines);
+  if (scrollOffset > 0) {
+    ttoy_TextRenderer_drawScrollback(self,
+        screen,  /* screen */
+        scrollback,  /* scrollback */
+        scrollOffset,  /* scrollOffset */
+        &data  /* data */
+        );
+  }
   tsm_screen_draw(
       screen,  /* con */
       (tsm_screen_draw_cb)ttoy_TextRenderer_screenDrawCallback,  /* draw_cb */
@@ -652,9 +692,10 @@ void ttoy_TextRenderer_updateScreen(
   ASSERT_GL_ERROR();
   glBufferData(
       GL_ARRAY_BUFFER,  /* target */
-      self->internal->numGlyphs
+      ttoy_TextRenderer_GlyphInstanceVector_size(&self->internal->glyphs)
       * sizeof(ttoy_TextRenderer_GlyphInstance),  /* size */
-      self->internal->glyphs,  /* data */
+      ttoy_TextRenderer_GlyphInstanceVector_data(
+        &self->internal->glyphs),  /* data */
       GL_STREAM_DRAW  /* usage */
       );
   ASSERT_GL_ERROR();
@@ -664,9 +705,11 @@ void ttoy_TextRenderer_updateScreen(
   ASSERT_GL_ERROR();
   glBufferData(
       GL_ARRAY_BUFFER,  /* target */
-      self->internal->numBackgroundCells
+      ttoy_TextRenderer_BackgroundInstanceVector_size(
+        &self->internal->backgroundCells)
       * sizeof(ttoy_TextRenderer_BackgroundInstance),  /* size */
-      self->internal->backgroundCells,  /* data */
+      ttoy_TextRenderer_BackgroundInstanceVector_data(
+        &self->internal->backgroundCells),  /* data */
       GL_STREAM_DRAW  /* usage */
       );
   ASSERT_GL_ERROR();
@@ -676,14 +719,81 @@ void ttoy_TextRenderer_updateScreen(
   ASSERT_GL_ERROR();
   glBufferData(
       GL_ARRAY_BUFFER,  /* target */
-      self->internal->numUnderlines
+      ttoy_TextRenderer_UnderlineInstanceVector_size(
+        &self->internal->underlines)
       * sizeof(ttoy_TextRenderer_UnderlineInstance),  /* size */
-      self->internal->underlines,  /* data */
+      ttoy_TextRenderer_UnderlineInstanceVector_data(
+        &self->internal->underlines),  /* data */
       GL_STREAM_DRAW  /* usage */
       );
   ASSERT_GL_ERROR();
 }
 
+/** Draws the scrollback lines that are scrolled into view through the same
+ * callback as the screen, and arranges for the screen to be drawn below
+ * them. Only the lines in view are decoded. */
+void ttoy_TextRenderer_drawScrollback(
+    ttoy_TextRenderer *self,
+    struct tsm_screen *screen,
+    ttoy_Scrollback *scrollback,
+    size_t scrollOffset,
+    ttoy_TextRenderer_ScreenDrawCallbackData *data)
+{
+  ttoy_ScrollbackCell *cells;
+  ttoy_ErrorCode error;
+  ttoy_Arena *arena;
+  ttoy_ArenaMark mark;
+  unsigned int columns, rows;
+  size_t numLines;
+
+  numLines = ttoy_Scrollback_numLines(scrollback);
+  if (scrollOffset > numLines)
+    scrollOffset = numLines;
+  columns = tsm_screen_get_width(screen);
+  rows = scrollOffset < data->rows ? (unsigned int)scrollOffset : data->rows;
+
+  arena = ttoy_Arena_frame();
+  mark = ttoy_Arena_mark(arena);
+  cells = (ttoy_ScrollbackCell *)ttoy_Arena_alloc(arena,
+      sizeof(ttoy_ScrollbackCell) * columns  /* size */
+      );
+  if (cells == NULL) {
+    TTOY_LOG_ERROR_CODE(TTOY_ERROR_OUT_OF_MEMORY);
+    return;
+  }
+  for (unsigned int row = 0; row < rows; ++row) {
+    error = ttoy_Scrollback_getLine(scrollback,
+        numLines - scrollOffset + row,  /* index */
+        cells,  /* cells */
+        columns,  /* maxCells */
+        NULL  /* numCells */
+        );
+    if (error != TTOY_NO_ERROR) {
+      TTOY_LOG_ERROR_CODE(error);
+      continue;
+    }
+    for (unsigned int column = 0; column < columns; ++column) {
+      if (cells[column].width == 0)
+        continue;  /* The trailing half of a wide character */
+      ttoy_TextRenderer_screenDrawCallback(
+          screen,  /* con */
+          0,  /* id */
+          cells[column].ch,  /* ch */
+          cells[column].len,  /* len */
+          cells[column].width,  /* width */
+          column,  /* posx */
+          row,  /* posy */
+          &cells[column].attr,  /* attr */
+          0,  /* age */
+          data  /* data */
+          );
+    }
+  }
+  ttoy_Arena_rewind(arena, mark);
+
+  data->rowOffset = rows;
+}
+
 /** This routine "draws" the each glyph by adding an instance of the glyph to
  * our buffer of glyph instances. The glyphs are not actually drawn
  * immediately, but the GL glyph instances are updated. */
@@ -703,6 +813,11 @@ void ttoy_TextRenderer_screenDrawCallback(
 
   self = data->self;
 
+  /* Skip the rows that were pushed off the bottom by the scrollback */
+  posy += data->rowOffset;
+  if (posy >= data->rows)
+    return;
+
   /* Add background instances for cells with a background color */
   /* FIXME: I'm not sure how to check for no background color. It might be
    * color codes 16 or 17. */
@@ -777,28 +892,14 @@ void ttoy_TextRenderer_addBackgroundCellInstance(
     }
   }
 
-  /* TODO: Consolidate array appending code for the background cell instances */
-  /* Make sure we have memory allocated for the new background instance */
-  if (self->internal->numBackgroundCells + 1 > self->internal->sizeBackgroundCells) {
-    ttoy_TextRenderer_BackgroundInstance *newBackgroundCells;
-
-    /* Double the number of background cells to ensure we have enough space */
-    newBackgroundCells = (ttoy_TextRenderer_BackgroundInstance*)malloc(
-        sizeof(ttoy_TextRenderer_BackgroundInstance)
-        * self->internal->sizeBackgroundCells * 2);
-    memcpy(newBackgroundCells, self->internal->backgroundCells,
-        sizeof(ttoy_TextRenderer_BackgroundInstance)
-        * self->internal->sizeBackgroundCells);
-    free(self->internal->backgroundCells);
-    self->internal->backgroundCells = newBackgroundCells;
-    self->internal->sizeBackgroundCells *= 2;
-  }
-
   /* Append the background instance data structure to our buffer */
-  memcpy(
-      &self->internal->backgroundCells[self->internal->numBackgroundCells++],
-      &backgroundInstance,
-      sizeof(ttoy_TextRenderer_BackgroundInstance));
+  result = ttoy_TextRenderer_BackgroundInstanceVector_append(
+      &self->internal->backgroundCells,
+      &backgroundInstance  /* value */
+      );
+  if (result != TTOY_NO_ERROR) {
+    TTOY_LOG_ERROR_CODE(result);
+  }
 }
 
 void ttoy_TextRenderer_addGlyphInstance(
@@ -885,24 +986,13 @@ void ttoy_TextRenderer_addGlyphInstance(
   /* TODO: Implement bold glyph attributes */
   /* TODO: Implement inverse colors */
 
-  /* TODO: Consolidate array appending code for the glyph instances */
-  /* Make sure we have memory allocated for the new glyph instance */
-  if (self->internal->numGlyphs + 1 > self->internal->sizeGlyphs) {
-    ttoy_TextRenderer_GlyphInstance *newGlyphs;
-
-    /* Double the number of glyphs to ensure we have enough space */
-    newGlyphs = (ttoy_TextRenderer_GlyphInstance*)malloc(
-        sizeof(ttoy_TextRenderer_GlyphInstance) * self->internal->sizeGlyphs * 2);
-    memcpy(newGlyphs, self->internal->glyphs,
-        sizeof(ttoy_TextRenderer_GlyphInstance) * self->internal->sizeGlyphs);
-    free(self->internal->glyphs);
-    self->internal->glyphs = newGlyphs;
-    self->internal->sizeGlyphs *= 2;
-  }
-
   /* Append the glyph instance data structure to our buffer */
-  memcpy(&self->internal->glyphs[self->internal->numGlyphs++], &glyphInstance,
-      sizeof(ttoy_TextRenderer_GlyphInstance));
+  error = ttoy_TextRenderer_GlyphInstanceVector_append(&self->internal->glyphs,
+      &glyphInstance  /* value */
+      );
+  if (error != TTOY_NO_ERROR) {
+    TTOY_LOG_ERROR_CODE(error);
+  }
 }
 
 void ttoy_TextRenderer_addUnderlineInstance(
@@ -939,24 +1029,14 @@ void ttoy_TextRenderer_addUnderlineInstance(
     }
   }
 
-  /* TODO: Consolidate array appending code for the underline instances */
-  /* Make sure we have memory allocated for the new underline instance */
-  if (self->internal->numUnderlines + 1 > self->internal->sizeUnderlines) {
-    ttoy_TextRenderer_UnderlineInstance *newUnderlines;
-
-    /* Double the number of underlines to ensure we have enough space */
-    newUnderlines = (ttoy_TextRenderer_UnderlineInstance*)malloc(
-        sizeof(ttoy_TextRenderer_UnderlineInstance) * self->internal->sizeUnderlines * 2);
-    memcpy(newUnderlines, self->internal->underlines,
-        sizeof(ttoy_TextRenderer_UnderlineInstance) * self->internal->sizeUnderlines);
-    free(self->internal->underlines);
-    self->internal->underlines = newUnderlines;
-    self->internal->sizeUnderlines *= 2;
-  }
-
   /* Append the underline instance data structure to our buffer */
-  memcpy(&self->internal->underlines[self->internal->numUnderlines++], &underlineInstance,
-      sizeof(ttoy_TextRenderer_UnderlineInstance));
+  result = ttoy_TextRenderer_UnderlineInstanceVector_append(
+      &self->internal->underlines,
+      &underlineInstance  /* value */
+      );
+  if (result != TTOY_NO_ERROR) {
+    TTOY_LOG_ERROR_CODE(result);
+  }
 }
 
 ttoy_ErrorCode
@@ -991,7 +1071,7 @@ ttoy_TextRenderer_colorCodeToRGB(
           sizeof(ttoy_Color));
       return TTOY_NO_ERROR;
     default:
-      TTOY_LOG_ERROR("Unknown color code: '%d'\n", code);
+      TTOY_LOG_ERROR("Unknown color code: '%d'", code);
   }
   return TTOY_ERROR_UNKNOWN_COLOR_CODE;
 }
@@ -1040,7 +1120,8 @@ void ttoy_TextRenderer_drawBackgroundCells(
       6,  /* count */
       GL_UNSIGNED_INT,  /* mode */
       0,  /* indices */
-      self->internal->numBackgroundCells  /* primcount */
+      ttoy_TextRenderer_BackgroundInstanceVector_size(
+        &self->internal->backgroundCells)  /* primcount */
       );
   ASSERT_GL_ERROR();
 
@@ -1102,7 +1183,8 @@ void ttoy_TextRenderer_drawUnderlines(
       6,  /* count */
       GL_UNSIGNED_INT,  /* mode */
       0,  /* indices */
-      self->internal->numUnderlines  /* primcount */
+      ttoy_TextRenderer_UnderlineInstanceVector_size(
+        &self->internal->underlines)  /* primcount */
       );
   ASSERT_GL_ERROR();
 
@@ -1198,7 +1280,8 @@ void ttoy_TextRenderer_drawGlyphs(
       6,  /* count */
       GL_UNSIGNED_INT,  /* type */
       0,  /* indices */
-      self->internal->numGlyphs  /* primcount */
+      ttoy_TextRenderer_GlyphInstanceVector_size(
+        &self->internal->glyphs)  /* primcount */
       );
   ASSERT_GL_ERROR();
 
@@ -29,6 +29,7 @@
 #include "glyphAtlas.h"
 #include "glyphRendererRef.h"
 #include "profile.h"
+#include "scrollback.h"
 
 struct ttoy_TextRenderer_Internal;
 
@@ -36,10 +37,17 @@ typedef struct ttoy_TextRenderer_ {
   struct ttoy_TextRenderer_Internal *internal;
 } ttoy_TextRenderer;
 
+/**
+ * Initializes the given text renderer. If a staging atlas is given, it must
+ * have been prepared with the given glyph renderer, and its glyphs are
+ * uploaded instead of rendering the ASCII glyphs here. Otherwise, stagingAtlas
+ * may be NULL.
+ */
 void ttoy_TextRenderer_init(
     ttoy_TextRenderer *self,
     ttoy_GlyphRendererRef *glyphRenderer,
-    ttoy_Profile *profile);
+    ttoy_Profile *profile,
+    const ttoy_GlyphAtlasStaging *stagingAtlas);
 
 void ttoy_TextRenderer_destroy(
     ttoy_TextRenderer *self);
@@ -48,9 +56,17 @@ void ttoy_TextRenderer_setGlyphRenderer(
     ttoy_TextRenderer *self,
     ttoy_GlyphRendererRef *glyphRenderer);
 
+/**
+ * Rebuilds the text instances from the screen contents. When scrollOffset is
+ * non-zero, that many lines from the end of the scrollback are shown above
+ * the screen, which is pushed down to make room for them. The scrollback may
+ * be NULL if scrollOffset is zero.
+ */
 void ttoy_TextRenderer_updateScreen(
     ttoy_TextRenderer *self,
     struct tsm_screen *screen,
+    ttoy_Scrollback *scrollback,
+    size_t scrollOffset,
     int cellWidth,
     int cellHeight);
 
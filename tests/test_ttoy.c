@@ -26,6 +26,7 @@
 
 #include "test_ttoy_BoundingBox.h"
 #include "test_ttoy_Config.h"
+#include "test_ttoy_Scrollback.h"
 #include "test_ttoy_Terminal.h"
 
 int main(int argc, char **argv) {
@@ -43,6 +44,8 @@ int main(int argc, char **argv) {
     s = ttoy_BoundingBox_test_suite();
   } else if (strcmp(test_name, "Config") == 0) {
     s = ttoy_Config_test_suite();
+  } else if (strcmp(test_name, "Scrollback") == 0) {
+    s = ttoy_Scrollback_test_suite();
   } else if (strcmp(test_name, "Terminal") == 0) {
     s = ttoy_Terminal_test_suite();
   } else {
@@ -0,0 +1,363 @@
+/*
+ * Copyright (c) 2016-2017 Jonathan Glines
+ * Jonathan Glines <jonathan@glines.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "../src/scrollback.h"
+
+#include "test_ttoy_Scrollback.h"
+
+#define TEST_COLUMNS 80
+
+/* Fills a line with text and a few attribute changes that depend on the line
+ * number, so that every line is different */
+void ttoy_test_Scrollback_makeLine(
+    size_t n,
+    ttoy_ScrollbackCell *cells)
+{
+  char text[TEST_COLUMNS + 1];
+  int len;
+
+  for (int i = 0; i < TEST_COLUMNS; ++i) {
+    ttoy_ScrollbackCell_clear(&cells[i]);
+  }
+  len = snprintf(text, sizeof(text), "line %zu: the quick brown fox", n);
+  for (int i = 0; i < len; ++i) {
+    cells[i].ch[0] = (uint32_t)text[i];
+    cells[i].len = 1;
+  }
+  /* Color the line number */
+  for (int i = 5; i < 10; ++i) {
+    cells[i].attr.fccode = n % 16;
+    cells[i].attr.bold = 1;
+  }
+  /* Give every third line a true color background */
+  if (n % 3 == 0) {
+    for (int i = 12; i < 20; ++i) {
+      cells[i].attr.bccode = -1;
+      cells[i].attr.br = (uint8_t)n;
+      cells[i].attr.bg = 0x80;
+      cells[i].attr.bb = 0xff;
+    }
+  }
+  /* Put a wide character at the end of every seventh line */
+  if (n % 7 == 0) {
+    cells[len + 1].ch[0] = 0x4e16;
+    cells[len + 1].len = 1;
+    cells[len + 1].width = 2;
+    cells[len + 2].width = 0;
+  }
+  /* Give every fifth line combining characters, which are kept with the
+   * character before them */
+  if (n % 5 == 0) {
+    /* "fox" becomes "fo\u0302x\u0323\u0307" */
+    cells[len - 2].ch[1] = 0x0302;
+    cells[len - 2].len = 2;
+    cells[len - 1].ch[1] = 0x0323;
+    cells[len - 1].ch[2] = 0x0307;
+    cells[len - 1].len = 3;
+  }
+}
+
+void ttoy_test_Scrollback_checkLine(
+    ttoy_Scrollback *scrollback,
+    size_t index,
+    size_t n)
+{
+  ttoy_ScrollbackCell expected[TEST_COLUMNS], actual[TEST_COLUMNS];
+  ttoy_ErrorCode error;
+
+  ttoy_test_Scrollback_makeLine(n, expected);
+  error = ttoy_Scrollback_getLine(scrollback,
+      index,  /* index */
+      actual,  /* cells */
+      TEST_COLUMNS,  /* maxCells */
+      NULL  /* numCells */
+      );
+  ck_assert_int_eq(error, TTOY_NO_ERROR);
+  for (int i = 0; i < TEST_COLUMNS; ++i) {
+    ck_assert_uint_eq(actual[i].len, expected[i].len);
+    for (size_t j = 0; j < expected[i].len; ++j) {
+      ck_assert_uint_eq(actual[i].ch[j], expected[i].ch[j]);
+    }
+    ck_assert_uint_eq(actual[i].width, expected[i].width);
+    ck_assert_int_eq(actual[i].attr.fccode, expected[i].attr.fccode);
+    ck_assert_int_eq(actual[i].attr.bccode, expected[i].attr.bccode);
+    ck_assert_int_eq(actual[i].attr.bold, expected[i].attr.bold);
+    if (expected[i].attr.bccode < 0) {
+      ck_assert_uint_eq(actual[i].attr.br, expected[i].attr.br);
+      ck_assert_uint_eq(actual[i].attr.bg, expected[i].attr.bg);
+      ck_assert_uint_eq(actual[i].attr.bb, expected[i].attr.bb);
+    }
+  }
+}
+
+START_TEST(ttoy_test_Scrollback_roundTrip)
+{
+  ttoy_Scrollback scrollback;
+  ttoy_ScrollbackCell cells[TEST_COLUMNS];
+  const size_t numLines = 20000;
+
+  ttoy_Scrollback_init(&scrollback, 64 * 1024 * 1024);
+
+  for (size_t n = 0; n < numLines; ++n) {
+    ttoy_test_Scrollback_makeLine(n, cells);
+    ck_assert_int_eq(
+        ttoy_Scrollback_pushLine(&scrollback, cells, TEST_COLUMNS),
+        TTOY_NO_ERROR);
+  }
+  ck_assert_uint_eq(ttoy_Scrollback_numLines(&scrollback), numLines);
+
+  /* Read lines from the newest, compressed and oldest blocks, in an order
+   * that moves between blocks */
+  for (size_t n = 0; n < numLines; n += 997) {
+    ttoy_test_Scrollback_checkLine(&scrollback, n, n);
+    ttoy_test_Scrollback_checkLine(&scrollback, numLines - 1 - n,
+        numLines - 1 - n);
+  }
+  ck_assert_int_eq(
+      ttoy_Scrollback_getLine(&scrollback, numLines, cells, TEST_COLUMNS,
+        NULL),
+      TTOY_ERROR_SCROLLBACK_LINE_NOT_FOUND);
+
+  /* The scrollback should be much smaller than full cells, even counting
+   * only a single character for each */
+  ck_assert(ttoy_Scrollback_memoryUsage(&scrollback)
+      < numLines * TEST_COLUMNS * (sizeof(uint32_t) + sizeof(unsigned int)
+        + sizeof(struct tsm_screen_attr)) / 10);
+
+  ttoy_Scrollback_destroy(&scrollback);
+}
+END_TEST
+
+START_TEST(ttoy_test_Scrollback_maxBytes)
+{
+  ttoy_Scrollback scrollback;
+  ttoy_ScrollbackCell cells[TEST_COLUMNS];
+  const size_t maxBytes = 8 * TTOY_SCROLLBACK_BLOCK_SIZE;
+  const size_t numLines = 50000;
+  size_t retained;
+
+  ttoy_Scrollback_init(&scrollback, maxBytes);
+
+  for (size_t n = 0; n < numLines; ++n) {
+    ttoy_test_Scrollback_makeLine(n, cells);
+    ck_assert_int_eq(
+        ttoy_Scrollback_pushLine(&scrollback, cells, TEST_COLUMNS),
+        TTOY_NO_ERROR);
+    ck_assert(scrollback.bytes <= maxBytes);
+  }
+
+  /* The oldest lines were discarded, and the newest lines are intact */
+  retained = ttoy_Scrollback_numLines(&scrollback);
+  ck_assert(retained > 0);
+  ck_assert(retained < numLines);
+  ttoy_test_Scrollback_checkLine(&scrollback, 0, numLines - retained);
+  ttoy_test_Scrollback_checkLine(&scrollback, retained - 1, numLines - 1);
+
+  ttoy_Scrollback_destroy(&scrollback);
+}
+END_TEST
+
+START_TEST(ttoy_test_Scrollback_spill)
+{
+  ttoy_Scrollback scrollback;
+  ttoy_ScrollbackCell cells[TEST_COLUMNS];
+  const size_t maxBytes = 4 * TTOY_SCROLLBACK_BLOCK_SIZE;
+  const size_t numLines = 3 * TTOY_SCROLLBACK_SEGMENT_LINES;
+
+  ttoy_Scrollback_init(&scrollback, maxBytes);
+  ck_assert_int_eq(
+      ttoy_Scrollback_setSpillDirectory(&scrollback, P_tmpdir, SIZE_MAX),
+      TTOY_NO_ERROR);
+
+  for (size_t n = 0; n < numLines; ++n) {
+    ttoy_test_Scrollback_makeLine(n, cells);
+    ck_assert_int_eq(
+        ttoy_Scrollback_pushLine(&scrollback, cells, TEST_COLUMNS),
+        TTOY_NO_ERROR);
+    ck_assert(scrollback.bytes <= maxBytes);
+  }
+
+  /* No lines were discarded, and most of them live on disk */
+  ck_assert_uint_eq(ttoy_Scrollback_numLines(&scrollback), numLines);
+  ck_assert(ttoy_Scrollback_diskUsage(&scrollback) > maxBytes);
+  ck_assert(scrollback.numSegments > 1);
+
+  /* Read lines from across segment boundaries and from memory */
+  for (size_t n = 0; n < numLines; n += 4999) {
+    ttoy_test_Scrollback_checkLine(&scrollback, n, n);
+  }
+  ttoy_test_Scrollback_checkLine(&scrollback,
+      TTOY_SCROLLBACK_SEGMENT_LINES - 1, TTOY_SCROLLBACK_SEGMENT_LINES - 1);
+  ttoy_test_Scrollback_checkLine(&scrollback,
+      TTOY_SCROLLBACK_SEGMENT_LINES, TTOY_SCROLLBACK_SEGMENT_LINES);
+  ttoy_test_Scrollback_checkLine(&scrollback, numLines - 1, numLines - 1);
+
+  ttoy_Scrollback_destroy(&scrollback);
+}
+END_TEST
+
+START_TEST(ttoy_test_Scrollback_spillLimit)
+{
+  ttoy_Scrollback scrollback;
+  ttoy_ScrollbackCell cells[TEST_COLUMNS];
+  const size_t maxBytes = 4 * TTOY_SCROLLBACK_BLOCK_SIZE;
+  const size_t maxDiskBytes = 5 * 1024 * 1024;
+  const size_t numLines = 4 * TTOY_SCROLLBACK_SEGMENT_LINES;
+  size_t retained;
+
+  ttoy_Scrollback_init(&scrollback, maxBytes);
+  ck_assert_int_eq(
+      ttoy_Scrollback_setSpillDirectory(&scrollback, P_tmpdir, maxDiskBytes),
+      TTOY_NO_ERROR);
+
+  for (size_t n = 0; n < numLines; ++n) {
+    ttoy_test_Scrollback_makeLine(n, cells);
+    ck_assert_int_eq(
+        ttoy_Scrollback_pushLine(&scrollback, cells, TEST_COLUMNS),
+        TTOY_NO_ERROR);
+    ck_assert(ttoy_Scrollback_diskUsage(&scrollback) <= maxDiskBytes);
+  }
+
+  /* Whole segments were discarded from the oldest end, while the newer
+   * segments are still on disk */
+  retained = ttoy_Scrollback_numLines(&scrollback);
+  ck_assert(retained < numLines);
+  ck_assert(ttoy_Scrollback_diskUsage(&scrollback) > 0);
+  ttoy_test_Scrollback_checkLine(&scrollback, 0, numLines - retained);
+  ttoy_test_Scrollback_checkLine(&scrollback, retained - 1, numLines - 1);
+
+  ttoy_Scrollback_destroy(&scrollback);
+}
+END_TEST
+
+START_TEST(ttoy_test_Scrollback_spillFailure)
+{
+  ttoy_Scrollback scrollback;
+  ttoy_ScrollbackCell cells[TEST_COLUMNS];
+  char path[] = P_tmpdir "/ttoy-test-XXXXXX";
+  const size_t maxBytes = 4 * TTOY_SCROLLBACK_BLOCK_SIZE;
+  const size_t numLines = 2 * TTOY_SCROLLBACK_SEGMENT_LINES;
+  size_t firstLost, firstKept, numCells;
+
+  ck_assert(mkdtemp(path) != NULL);
+  ttoy_Scrollback_init(&scrollback, maxBytes);
+  ck_assert_int_eq(
+      ttoy_Scrollback_setSpillDirectory(&scrollback, path, SIZE_MAX),
+      TTOY_NO_ERROR);
+
+  /* Fill one segment, then take the spill directory away, so that the next
+   * segment cannot be created */
+  for (size_t n = 0; n < numLines; ++n) {
+    if (n == TTOY_SCROLLBACK_SEGMENT_LINES)
+      ck_assert_int_eq(rmdir(path), 0);
+    ttoy_test_Scrollback_makeLine(n, cells);
+    ck_assert_int_eq(
+        ttoy_Scrollback_pushLine(&scrollback, cells, TEST_COLUMNS),
+        TTOY_NO_ERROR);
+    ck_assert(scrollback.bytes <= maxBytes);
+  }
+
+  /* The first segment can still be read, the lines that could not be
+   * spilled after it read as blank lines, and every line kept its place */
+  ck_assert_uint_eq(ttoy_Scrollback_numLines(&scrollback), numLines);
+  for (firstLost = 0; firstLost < numLines; ++firstLost) {
+    ck_assert_int_eq(
+        ttoy_Scrollback_getLine(&scrollback, firstLost, cells, TEST_COLUMNS,
+          &numCells),
+        TTOY_NO_ERROR);
+    if (numCells == 0)
+      break;
+  }
+  for (firstKept = firstLost; firstKept < numLines; ++firstKept) {
+    ck_assert_int_eq(
+        ttoy_Scrollback_getLine(&scrollback, firstKept, cells, TEST_COLUMNS,
+          &numCells),
+        TTOY_NO_ERROR);
+    if (numCells > 0)
+      break;
+  }
+  ck_assert(firstLost > 0);
+  ck_assert(firstLost <= TTOY_SCROLLBACK_SEGMENT_LINES);
+  ck_assert(firstKept < numLines);
+  ttoy_test_Scrollback_checkLine(&scrollback, 0, 0);
+  ttoy_test_Scrollback_checkLine(&scrollback, firstLost - 1, firstLost - 1);
+  ttoy_test_Scrollback_checkLine(&scrollback, firstKept, firstKept);
+  ttoy_test_Scrollback_checkLine(&scrollback, numLines - 1, numLines - 1);
+
+  ttoy_Scrollback_destroy(&scrollback);
+}
+END_TEST
+
+START_TEST(ttoy_test_Scrollback_disabled)
+{
+  ttoy_Scrollback scrollback;
+  ttoy_ScrollbackCell cells[TEST_COLUMNS];
+
+  ttoy_Scrollback_init(&scrollback, 0);
+
+  ttoy_test_Scrollback_makeLine(0, cells);
+  ck_assert_int_eq(
+      ttoy_Scrollback_pushLine(&scrollback, cells, TEST_COLUMNS),
+      TTOY_NO_ERROR);
+  ck_assert_uint_eq(ttoy_Scrollback_numLines(&scrollback), 0);
+
+  ttoy_Scrollback_destroy(&scrollback);
+}
+END_TEST
+
+Suite *ttoy_Scrollback_test_suite() {
+  Suite *s;
+  TCase *tc;
+
+  s = suite_create("ttoy_Scrollback");
+
+  tc = tcase_create("roundTrip");
+  tcase_add_test(tc, ttoy_test_Scrollback_roundTrip);
+  suite_add_tcase(s, tc);
+
+  tc = tcase_create("maxBytes");
+  tcase_add_test(tc, ttoy_test_Scrollback_maxBytes);
+  suite_add_tcase(s, tc);
+
+  tc = tcase_create("spill");
+  tcase_add_test(tc, ttoy_test_Scrollback_spill);
+  suite_add_tcase(s, tc);
+
+  tc = tcase_create("spillLimit");
+  tcase_add_test(tc, ttoy_test_Scrollback_spillLimit);
+  suite_add_tcase(s, tc);
+
+  tc = tcase_create("spillFailure");
+  tcase_add_test(tc, ttoy_test_Scrollback_spillFailure);
+  suite_add_tcase(s, tc);
+
+  tc = tcase_create("disabled");
+  tcase_add_test(tc, ttoy_test_Scrollback_disabled);
+  suite_add_tcase(s, tc);
+
+  return s;
+}
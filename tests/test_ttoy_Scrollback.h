@@ -21,6 +21,11 @@
  * IN THE SOFTWARE.
  */
 
-#include "fontRefArray.h"
+#ifndef TTOY_TEST_TTOY_SCROLLBACK_H_
+#define TTOY_TEST_TTOY_SCROLLBACK_H_
 
-TTOY_DEFINE_ARRAY(ttoy_FontRef)
+#include <check.h>
+
+Suite *ttoy_Scrollback_test_suite();
+
+#endif